@@ -228,6 +228,52 @@ fill_usable_area_override(xmlNode *node)
 	}
 }
 
+static void
+fill_max_render_time(xmlNode *node)
+{
+	struct max_render_time *mrt = znew(*mrt);
+	wl_list_append(&rc.max_render_times, &mrt->link);
+
+	xmlNode *child;
+	char *key, *content;
+	LAB_XML_FOR_EACH(node, child, key, content) {
+		if (!strcmp(key, "output")) {
+			xstrdup_replace(mrt->output, content);
+		} else if (!strcmp(key, "time")) {
+			if (!strcasecmp(content, "auto")) {
+				mrt->time = MAX_RENDER_TIME_AUTO;
+			} else if (!strcasecmp(content, "off")) {
+				mrt->time = 0;
+			} else {
+				mrt->time = MAX(atoi(content), 0);
+			}
+		} else {
+			wlr_log(WLR_ERROR, "Unexpected data in maxRenderTime "
+				"parser: %s=\"%s\"", key, content);
+		}
+	}
+}
+
+static void
+fill_ipc_throttle(xmlNode *node)
+{
+	struct ipc_throttle *throttle = znew(*throttle);
+	wl_list_append(&rc.ipc_throttles, &throttle->link);
+
+	xmlNode *child;
+	char *key, *content;
+	LAB_XML_FOR_EACH(node, child, key, content) {
+		if (!strcmp(key, "output")) {
+			xstrdup_replace(throttle->output, content);
+		} else if (!strcmp(key, "interval")) {
+			throttle->interval = MAX(atoi(content), 0);
+		} else {
+			wlr_log(WLR_ERROR, "Unexpected data in ipc throttle "
+				"parser: %s=\"%s\"", key, content);
+		}
+	}
+}
+
 /* Does a boolean-parse but also allows 'default' */
 static void
 set_property(const char *str, enum property *variable)
@@ -1042,6 +1088,10 @@ entry(xmlNode *node, char *nodename, char *content)
 	/* handle nested nodes */
 	if (!strcasecmp(nodename, "margin")) {
 		fill_usable_area_override(node);
+	} else if (!strcasecmp(nodename, "maxRenderTime.core")) {
+		fill_max_render_time(node);
+	} else if (!strcasecmp(nodename, "throttle.ipc")) {
+		fill_ipc_throttle(node);
 	} else if (!strcasecmp(nodename, "keybind.keyboard")) {
 		fill_keybind(node);
 	} else if (!strcasecmp(nodename, "context.mouse")) {
@@ -1102,6 +1152,8 @@ entry(xmlNode *node, char *nodename, char *content)
 
 	} else if (!strcasecmp(nodename, "promptCommand.core")) {
 		xstrdup_replace(rc.prompt_command, content);
+	} else if (!strcasecmp(nodename, "titleUpdateInterval.core")) {
+		rc.title_update_interval = MAX(atoi(content), 0);
 
 	} else if (!strcmp(nodename, "policy.placement")) {
 		enum lab_placement_policy policy = view_placement_parse(content);
@@ -1342,6 +1394,8 @@ entry(xmlNode *node, char *nodename, char *content)
 		rc.mag_increment = MAX(0, rc.mag_increment);
 	} else if (!strcasecmp(nodename, "useFilter.magnifier")) {
 		set_bool(content, &rc.mag_filter);
+	} else if (!strcasecmp(nodename, "backlog.ipc")) {
+		rc.ipc_backlog = MAX(atoi(content), 1);
 	}
 
 	return false;
@@ -1395,6 +1449,8 @@ rcxml_init(void)
 
 	if (!has_run) {
 		wl_list_init(&rc.usable_area_overrides);
+		wl_list_init(&rc.max_render_times);
+		wl_list_init(&rc.ipc_throttles);
 		wl_list_init(&rc.keybinds);
 		wl_list_init(&rc.mousebinds);
 		wl_list_init(&rc.libinput_categories);
@@ -1426,6 +1482,7 @@ rcxml_init(void)
 	rc.reuse_output_mode = false;
 	rc.xwayland_persistence = false;
 	rc.primary_selection = true;
+	rc.title_update_interval = 0;
 
 	init_font_defaults(&rc.font_activewindow);
 	init_font_defaults(&rc.font_inactivewindow);
@@ -1491,6 +1548,8 @@ rcxml_init(void)
 	rc.mag_scale = 2.0;
 	rc.mag_increment = 0.2;
 	rc.mag_filter = true;
+
+	rc.ipc_backlog = 128;
 }
 
 static void
@@ -1955,6 +2014,20 @@ rcxml_finish(void)
 		zfree(area);
 	}
 
+	struct max_render_time *mrt, *mrt_tmp;
+	wl_list_for_each_safe(mrt, mrt_tmp, &rc.max_render_times, link) {
+		wl_list_remove(&mrt->link);
+		zfree(mrt->output);
+		zfree(mrt);
+	}
+
+	struct ipc_throttle *throttle, *throttle_tmp;
+	wl_list_for_each_safe(throttle, throttle_tmp, &rc.ipc_throttles, link) {
+		wl_list_remove(&throttle->link);
+		zfree(throttle->output);
+		zfree(throttle);
+	}
+
 	struct keybind *k, *k_tmp;
 	wl_list_for_each_safe(k, k_tmp, &rc.keybinds, link) {
 		wl_list_remove(&k->link);
@@ -29,6 +29,7 @@ static const char *const env_vars[] = {
 	"XDG_SESSION_TYPE",
 	"LABWC_PID",
 	"LABWC_VER",
+	"LABWC_IPC_SOCKET",
 	NULL
 };
 
@@ -1,13 +1,17 @@
 // SPDX-License-Identifier: GPL-2.0-only
 #include "config.h"
 #include <assert.h>
+#include <math.h>
+#include <pixman.h>
 #include <wlr/types/wlr_cursor.h>
 #include <wlr/types/wlr_layer_shell_v1.h>
+#include <wlr/types/wlr_output.h>
 #include <wlr/types/wlr_output_layout.h>
 #include <wlr/types/wlr_scene.h>
 #include <wlr/types/wlr_seat.h>
 #include <wlr/types/wlr_subcompositor.h>
 #include <wlr/types/wlr_xdg_shell.h>
+#include <wlr/util/box.h>
 #include "common/scene-helpers.h"
 #include "dnd.h"
 #include "labwc.h"
@@ -276,8 +280,8 @@ avoid_edge_rounding_issues(struct cursor_context *ctx)
 }
 
 /* TODO: make this less big and scary */
-struct cursor_context
-get_cursor_context(struct server *server)
+static struct cursor_context
+lookup_cursor_context(struct server *server)
 {
 	struct cursor_context ret = {.type = LAB_NODE_NONE};
 	struct wlr_cursor *cursor = server->seat.cursor;
@@ -400,3 +404,265 @@ get_cursor_context(struct server *server)
 	return ret;
 }
 
+/*
+ * Hit-test cache
+ *
+ * Pointer motion mostly stays on the same client surface. For the last
+ * surface that was found, the part of its input region that no other node
+ * covers is kept. As long as the cursor stays in there and the scene did
+ * not change, the result is known without walking the scene.
+ *
+ * Any change of the scene that could put another node under the cursor
+ * damages that spot, so pending scene damage touching the region drops
+ * the cache. Changes of input areas that do not damage anything, like the
+ * invisible resize extents of windows, increment server->scene_generation.
+ */
+
+static void
+hit_cache_reset(struct seat *seat)
+{
+	if (seat->hit_cache.ctx.node) {
+		wl_list_remove(&seat->hit_cache.node_destroy.link);
+		wl_list_init(&seat->hit_cache.node_destroy.link);
+	}
+	seat->hit_cache.ctx = (struct cursor_context){0};
+}
+
+static void
+handle_hit_cache_node_destroy(struct wl_listener *listener, void *data)
+{
+	struct seat *seat = wl_container_of(listener, seat,
+		hit_cache.node_destroy);
+	hit_cache_reset(seat);
+}
+
+void
+cursor_context_cache_init(struct seat *seat)
+{
+	pixman_region32_init(&seat->hit_cache.region);
+	seat->hit_cache.node_destroy.notify = handle_hit_cache_node_destroy;
+	wl_list_init(&seat->hit_cache.node_destroy.link);
+}
+
+void
+cursor_context_cache_finish(struct seat *seat)
+{
+	hit_cache_reset(seat);
+	pixman_region32_fini(&seat->hit_cache.region);
+}
+
+void
+cursor_context_cache_damage(struct seat *seat,
+		const pixman_region32_t *damage)
+{
+	if (!seat->hit_cache.ctx.node) {
+		return;
+	}
+	pixman_region32_t overlap;
+	pixman_region32_init(&overlap);
+	pixman_region32_intersect(&overlap, damage, &seat->hit_cache.region);
+	if (pixman_region32_not_empty(&overlap)) {
+		hit_cache_reset(seat);
+	}
+	pixman_region32_fini(&overlap);
+}
+
+/*
+ * Returns true if damage that was not rendered yet touches the layout
+ * point @lx,@ly. Only the pixels around the point are taken to buffer
+ * coordinates, so this is cheap enough for every motion event.
+ */
+static bool
+scene_output_damaged_at(struct wlr_scene_output *scene_output,
+		double lx, double ly)
+{
+	pixman_region32_t *pending =
+		&scene_output->WLR_PRIVATE.pending_commit_damage;
+	if (!pixman_region32_not_empty(pending)) {
+		return false;
+	}
+
+	struct wlr_output *wlr_output = scene_output->output;
+	int size = ceil(wlr_output->scale);
+	/* Add a pixel on each side to make up for rounding in the scale */
+	struct wlr_box box = {
+		.x = floor((lx - scene_output->x) * wlr_output->scale) - 1,
+		.y = floor((ly - scene_output->y) * wlr_output->scale) - 1,
+		.width = size + 2,
+		.height = size + 2,
+	};
+	int width, height;
+	wlr_output_transformed_resolution(wlr_output, &width, &height);
+	wlr_box_transform(&box, &box,
+		wlr_output_transform_invert(wlr_output->transform),
+		width, height);
+
+	pixman_box32_t rect = {
+		.x1 = box.x,
+		.y1 = box.y,
+		.x2 = box.x + box.width,
+		.y2 = box.y + box.height,
+	};
+	return pixman_region32_contains_rectangle(pending, &rect)
+		!= PIXMAN_REGION_OUT;
+}
+
+static void
+subtract_box(pixman_region32_t *region, int x, int y, int width, int height)
+{
+	if (width <= 0 || height <= 0) {
+		return;
+	}
+	pixman_region32_t box;
+	pixman_region32_init_rect(&box, x, y, width, height);
+	pixman_region32_subtract(region, region, &box);
+	pixman_region32_fini(&box);
+}
+
+/*
+ * Subtracts the area of every node above @target from @region, walking
+ * the scene from the top like wlr_scene_node_at() does. Nodes are taken
+ * out whole, whether they accept input or not, which keeps the region on
+ * the safe side. Returns true once @target is reached.
+ */
+static bool
+subtract_nodes_above(struct wlr_scene_node *node, int lx, int ly,
+		struct wlr_scene_node *target, pixman_region32_t *region)
+{
+	if (node == target) {
+		return true;
+	}
+	if (!node->enabled) {
+		return false;
+	}
+	lx += node->x;
+	ly += node->y;
+
+	switch (node->type) {
+	case WLR_SCENE_NODE_TREE: {
+		struct wlr_scene_tree *tree = wlr_scene_tree_from_node(node);
+		struct wlr_scene_node *child;
+		wl_list_for_each_reverse(child, &tree->children, link) {
+			if (subtract_nodes_above(child, lx, ly, target, region)) {
+				return true;
+			}
+		}
+		break;
+	}
+	case WLR_SCENE_NODE_RECT: {
+		struct wlr_scene_rect *rect = wlr_scene_rect_from_node(node);
+		subtract_box(region, lx, ly, rect->width, rect->height);
+		break;
+	}
+	case WLR_SCENE_NODE_BUFFER: {
+		struct wlr_scene_buffer *buffer = wlr_scene_buffer_from_node(node);
+		int width = buffer->dst_width;
+		int height = buffer->dst_height;
+		if ((!width || !height) && buffer->buffer) {
+			width = buffer->buffer->width;
+			height = buffer->buffer->height;
+			if (buffer->transform & WL_OUTPUT_TRANSFORM_90) {
+				int tmp = width;
+				width = height;
+				height = tmp;
+			}
+		}
+		subtract_box(region, lx, ly, width, height);
+		break;
+	}
+	}
+	return false;
+}
+
+/* Remembers where @ctx holds, only client surfaces are cached */
+static void
+hit_cache_store(struct server *server, const struct cursor_context *ctx)
+{
+	struct seat *seat = &server->seat;
+	hit_cache_reset(seat);
+
+	int lx, ly;
+	if (!ctx->surface || !wlr_scene_node_coords(ctx->node, &lx, &ly)) {
+		return;
+	}
+	pixman_region32_t *region = &seat->hit_cache.region;
+	pixman_region32_intersect_rect(region, &ctx->surface->input_region,
+		0, 0, ctx->surface->current.width,
+		ctx->surface->current.height);
+	pixman_region32_translate(region, lx, ly);
+	subtract_nodes_above(&server->scene->tree.node, 0, 0, ctx->node,
+		region);
+	if (!pixman_region32_not_empty(region)) {
+		return;
+	}
+
+	seat->hit_cache.ctx = *ctx;
+	seat->hit_cache.lx = lx;
+	seat->hit_cache.ly = ly;
+	seat->hit_cache.generation = server->scene_generation;
+	wl_signal_add(&ctx->node->events.destroy,
+		&seat->hit_cache.node_destroy);
+}
+
+static bool
+hit_cache_lookup(struct server *server, struct cursor_context *ctx)
+{
+	struct seat *seat = &server->seat;
+	if (!seat->hit_cache.ctx.node
+			|| seat->hit_cache.generation != server->scene_generation) {
+		return false;
+	}
+
+	double x = seat->cursor->x;
+	double y = seat->cursor->y;
+	if (!pixman_region32_contains_point(&seat->hit_cache.region,
+			floor(x), floor(y), NULL)) {
+		return false;
+	}
+
+	/*
+	 * Damage elsewhere is checked once per frame by
+	 * cursor_context_cache_damage(). Until then, only a change right
+	 * under the cursor can make the cached result wrong.
+	 */
+	struct wlr_output *wlr_output = wlr_output_layout_output_at(
+		server->output_layout, x, y);
+	struct output *output = wlr_output ? wlr_output->data : NULL;
+	if (output && output->scene_output
+			&& scene_output_damaged_at(output->scene_output, x, y)) {
+		hit_cache_reset(seat);
+		return false;
+	}
+	*ctx = seat->hit_cache.ctx;
+	ctx->sx = x - seat->hit_cache.lx;
+	ctx->sy = y - seat->hit_cache.ly;
+	/* The input region can change with a commit that damages nothing */
+	if (!wlr_surface_point_accepts_input(ctx->surface, ctx->sx, ctx->sy)) {
+		return false;
+	}
+	avoid_edge_rounding_issues(ctx);
+	return true;
+}
+
+struct cursor_context
+get_cursor_context(struct server *server)
+{
+	struct seat *seat = &server->seat;
+	struct cursor_context ret;
+
+	/* Drag icons follow the cursor, the scene changes every time */
+	if (seat->drag.active) {
+		hit_cache_reset(seat);
+		return lookup_cursor_context(server);
+	}
+
+	if (hit_cache_lookup(server, &ret)) {
+		seat->hit_cache.hits++;
+		return ret;
+	}
+	seat->hit_cache.misses++;
+	ret = lookup_cursor_context(server);
+	hit_cache_store(server, &ret);
+	return ret;
+}
+
@@ -0,0 +1,158 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#define _POSIX_C_SOURCE 200809L
+#include "frame-timing.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <wlr/util/log.h>
+#include "common/macros.h"
+
+/* Present events arrive within a few frames of the commit, if at all */
+#define PRESENT_SEARCH_DEPTH 4
+
+#define ESTIMATE_WINDOW 64
+#define ESTIMATE_MIN_FRAMES 8
+#define ESTIMATE_PERCENTILE 95
+
+static FILE *trace;
+
+const char frame_timing_csv_header[] =
+	"output,start_ns,delay_us,build_us,commit_us,present_us,commit_seq,"
+	"skipped\n";
+
+static struct frame_timing_sample *
+sample_at(struct frame_timing *timing, uint64_t frame)
+{
+	return &timing->samples[frame % FRAME_TIMING_SAMPLES];
+}
+
+static void
+trace_write(const char *name, const struct frame_timing_sample *sample)
+{
+	char line[256];
+	int len = frame_timing_format_csv(line, sizeof(line), name, sample);
+	if (len > 0 && (size_t)len < sizeof(line)) {
+		fwrite(line, 1, len, trace);
+	}
+}
+
+void
+frame_timing_record(struct frame_timing *timing, const char *name,
+		const struct frame_timing_sample *sample)
+{
+	if (trace && timing->nr_frames) {
+		trace_write(name, sample_at(timing, timing->nr_frames - 1));
+	}
+
+	struct frame_timing_sample *slot = sample_at(timing, timing->nr_frames);
+	*slot = *sample;
+	slot->present_us = -1;
+	timing->nr_frames++;
+	if (sample->skipped) {
+		timing->nr_skipped++;
+	}
+}
+
+void
+frame_timing_presented(struct frame_timing *timing, uint32_t commit_seq,
+		uint64_t present_ns)
+{
+	uint64_t depth = MIN(timing->nr_frames, PRESENT_SEARCH_DEPTH);
+	for (uint64_t i = 1; i <= depth; i++) {
+		struct frame_timing_sample *sample =
+			sample_at(timing, timing->nr_frames - i);
+		if (sample->skipped || sample->commit_seq != commit_seq) {
+			continue;
+		}
+		if (present_ns >= sample->commit_end_ns) {
+			uint64_t us = (present_ns - sample->commit_end_ns) / 1000;
+			sample->present_us = MIN(us, INT32_MAX);
+		}
+		return;
+	}
+}
+
+void
+frame_timing_finish(struct frame_timing *timing, const char *name)
+{
+	if (trace && timing->nr_frames) {
+		trace_write(name, sample_at(timing, timing->nr_frames - 1));
+	}
+}
+
+static int
+compare_u32(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a;
+	uint32_t y = *(const uint32_t *)b;
+	return (x > y) - (x < y);
+}
+
+uint32_t
+frame_timing_render_estimate(const struct frame_timing *timing)
+{
+	uint32_t times[ESTIMATE_WINDOW];
+	size_t count = 0;
+
+	uint64_t depth = MIN(timing->nr_frames, FRAME_TIMING_SAMPLES);
+	for (uint64_t i = 1; i <= depth && count < ESTIMATE_WINDOW; i++) {
+		const struct frame_timing_sample *sample = &timing->samples[
+			(timing->nr_frames - i) % FRAME_TIMING_SAMPLES];
+		if (!sample->skipped) {
+			times[count++] = sample->build_us + sample->commit_us;
+		}
+	}
+	if (count < ESTIMATE_MIN_FRAMES) {
+		return 0;
+	}
+
+	qsort(times, count, sizeof(times[0]), compare_u32);
+	return times[(count * ESTIMATE_PERCENTILE - 1) / 100];
+}
+
+size_t
+frame_timing_get(const struct frame_timing *timing,
+		struct frame_timing_sample *out, size_t max)
+{
+	uint64_t count = MIN(timing->nr_frames, FRAME_TIMING_SAMPLES);
+	count = MIN(count, max);
+	uint64_t first = timing->nr_frames - count;
+	for (uint64_t i = 0; i < count; i++) {
+		out[i] = timing->samples[(first + i) % FRAME_TIMING_SAMPLES];
+	}
+	return count;
+}
+
+int
+frame_timing_format_csv(char *out, size_t size, const char *name,
+		const struct frame_timing_sample *sample)
+{
+	return snprintf(out, size, "%s,%" PRIu64 ",%" PRIu32 ",%" PRIu32
+		",%" PRIu32 ",%" PRId32 ",%" PRIu32 ",%d\n", name,
+		sample->start_ns, sample->delay_us, sample->build_us,
+		sample->commit_us, sample->present_us, sample->commit_seq,
+		sample->skipped);
+}
+
+bool
+frame_timing_trace_open(const char *path)
+{
+	frame_timing_trace_close();
+	trace = fopen(path, "we");
+	if (!trace) {
+		wlr_log_errno(WLR_ERROR, "cannot open frame trace %s", path);
+		return false;
+	}
+	fputs(frame_timing_csv_header, trace);
+	wlr_log(WLR_INFO, "writing frame trace to %s", path);
+	return true;
+}
+
+void
+frame_timing_trace_close(void)
+{
+	if (trace) {
+		fclose(trace);
+		trace = NULL;
+	}
+}
@@ -0,0 +1,61 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_FONT_CACHE_H
+#define LABWC_FONT_CACHE_H
+
+#include <cairo.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct font;
+struct lab_data_buffer;
+
+/*
+ * Process-wide cache of rendered text, so that labels with the same text
+ * and style (titles flipping back and forth, many windows of one app)
+ * share one buffer per scale instead of being shaped and rasterized each
+ * time. Entries are evicted least recently used first once the buffers
+ * exceed FONT_CACHE_MAX_BYTES.
+ */
+#define FONT_CACHE_MAX_BYTES (8 * 1024 * 1024)
+
+/* The arguments of font_buffer_create(), apart from the scale */
+struct font_cache_key {
+	const char *text;
+	struct font *font;
+	int max_width;
+	/* 0 for the height of the text */
+	int fixed_height;
+	const float *color;
+	/* Used if bg_pattern is NULL */
+	const float *bg_color;
+	/* Compared by identity, referenced while cached */
+	cairo_pattern_t *bg_pattern;
+};
+
+struct font_cache_stats {
+	uint64_t hits;
+	uint64_t misses;
+	size_t entries;
+	size_t bytes;
+};
+
+/* Like font_get_buffer_size(), returns the height of the buffer though */
+void font_cache_get_size(const struct font_cache_key *key, int *width,
+	int *height);
+
+/**
+ * font_cache_get_buffer - rendered text for @key at @scale
+ *
+ * Returns NULL if there is no text or rendering failed. The buffer may
+ * be shared with other users, so it must be dropped only if it was not
+ * dropped already, like scaled_buffer does.
+ */
+struct lab_data_buffer *font_cache_get_buffer(const struct font_cache_key *key,
+	double scale);
+
+/* Drops everything, to be called when the theme changes */
+void font_cache_clear(void);
+
+void font_cache_get_stats(struct font_cache_stats *stats);
+
+#endif /* LABWC_FONT_CACHE_H */
@@ -0,0 +1,39 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_HASH_H
+#define LABWC_HASH_H
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * FNV-1a, for hashing cache keys into a lab_id_map. Start with
+ * LAB_HASH_INIT and feed each field of the key in turn.
+ */
+#define LAB_HASH_INIT 0xcbf29ce484222325
+
+static inline uint64_t
+lab_hash_bytes(uint64_t hash, const void *data, size_t size)
+{
+	const uint8_t *bytes = data;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 0x100000001b3;
+	}
+	return hash;
+}
+
+static inline uint64_t
+lab_hash_string(uint64_t hash, const char *string)
+{
+	/* Including the terminator tells "ab" + "c" from "a" + "bc" */
+	return string ? lab_hash_bytes(hash, string, strlen(string) + 1) : hash;
+}
+
+/* lab_id_map reserves 0 */
+static inline uint64_t
+lab_hash_to_id(uint64_t hash)
+{
+	return hash ? hash : 1;
+}
+
+#endif /* LABWC_HASH_H */
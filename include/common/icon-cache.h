@@ -0,0 +1,68 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_ICON_CACHE_H
+#define LABWC_ICON_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct lab_data_buffer;
+
+/*
+ * Process-wide cache of rendered icons, so that titlebars, the window
+ * switcher and menus showing the icon of the same app or name share one
+ * buffer per size and scale instead of each decoding it from disk.
+ * Lookups that found no icon are cached as well. Entries are evicted least
+ * recently used first once the buffers exceed ICON_CACHE_MAX_BYTES.
+ *
+ * Only to be used from the event loop thread.
+ */
+#define ICON_CACHE_MAX_BYTES (16 * 1024 * 1024)
+
+enum icon_cache_source {
+	/* Icon theme name or absolute path */
+	ICON_CACHE_ICON_NAME,
+	/* Icon of the desktop entry of an app_id */
+	ICON_CACHE_APP_ID,
+};
+
+struct icon_cache_key {
+	enum icon_cache_source source;
+	const char *name;
+	/* Logical size of the buffer */
+	int width;
+	int height;
+	double scale;
+};
+
+struct icon_cache_stats {
+	uint64_t hits;
+	uint64_t misses;
+	size_t entries;
+	size_t bytes;
+};
+
+/**
+ * icon_cache_lookup() - find the icon for @key
+ * @buffer: set to the icon, or to NULL if it is known there is none
+ *
+ * Returns false if @key is not cached. Like with font_cache_get_buffer(),
+ * the buffer may be shared, so it must be dropped only if it was not
+ * dropped already, like scaled_buffer does.
+ */
+bool icon_cache_lookup(const struct icon_cache_key *key,
+	struct lab_data_buffer **buffer);
+
+/*
+ * Adds the icon loaded for @key, NULL if there is none. The cache takes
+ * over @buffer. If @key is cached already, the cached icon is kept.
+ */
+void icon_cache_insert(const struct icon_cache_key *key,
+	struct lab_data_buffer *buffer);
+
+/* Drops everything, to be called when the icon theme may change */
+void icon_cache_clear(void);
+
+void icon_cache_get_stats(struct icon_cache_stats *stats);
+
+#endif /* LABWC_ICON_CACHE_H */
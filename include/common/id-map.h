@@ -0,0 +1,34 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_ID_MAP_H
+#define LABWC_ID_MAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct lab_id_map_entry {
+	uint64_t id; /* 0 for empty slots */
+	void *value;
+};
+
+/*
+ * Hash table mapping non-zero 64-bit ids to pointers, using open
+ * addressing with linear probing. Zero-initialized maps are valid and
+ * empty.
+ */
+struct lab_id_map {
+	struct lab_id_map_entry *entries;
+	size_t capacity; /* always a power of two, or zero */
+	size_t count;
+};
+
+void lab_id_map_finish(struct lab_id_map *map);
+
+/* Adds or replaces the value for @id, which must not be 0 */
+void lab_id_map_insert(struct lab_id_map *map, uint64_t id, void *value);
+
+/* Returns NULL if @id is not in the map */
+void *lab_id_map_lookup(struct lab_id_map *map, uint64_t id);
+
+void lab_id_map_remove(struct lab_id_map *map, uint64_t id);
+
+#endif /* LABWC_ID_MAP_H */
@@ -0,0 +1,75 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_LRU_CACHE_H
+#define LABWC_LRU_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "common/id-map.h"
+#include "common/list.h"
+
+/*
+ * Node of a lab_id_map whose ids may collide, embedded in the values.
+ * Nodes with the same id are chained, the map holds the first of them.
+ */
+struct lab_id_chain {
+	uint64_t id; /* 0 if not in a map */
+	struct lab_id_chain *next; /* same id */
+};
+
+/* Returns NULL if no node has @id, otherwise walk the chain via ->next */
+struct lab_id_chain *lab_id_chain_first(struct lab_id_map *map, uint64_t id);
+
+/* Adds @node for @id, which must not be 0 */
+void lab_id_chain_insert(struct lab_id_map *map, struct lab_id_chain *node,
+	uint64_t id);
+
+/* Does nothing if @node is not in @map */
+void lab_id_chain_remove(struct lab_id_map *map, struct lab_id_chain *node);
+
+struct lab_lru_entry {
+	struct lab_id_chain chain;
+	struct wl_list link; /* lab_lru_cache.lru, most recently used first */
+	size_t bytes;
+};
+
+/*
+ * Entries chained by key hash, which are evicted least recently used
+ * first once they take more than max_bytes. The destroy() callback must
+ * call lab_lru_cache_remove() and free the entry.
+ */
+struct lab_lru_cache {
+	struct lab_id_map by_id;
+	struct wl_list lru;
+	size_t nr_entries;
+	size_t bytes;
+	size_t max_bytes;
+	void (*destroy)(struct lab_lru_entry *entry);
+};
+
+#define LAB_LRU_CACHE_INIT(cache, max, destroy_fn) { \
+	.lru = WL_LIST_INIT(&(cache).lru), \
+	.max_bytes = (max), \
+	.destroy = (destroy_fn), \
+}
+
+/* Adds @entry as the most recently used one, @entry->bytes set already */
+void lab_lru_cache_add(struct lab_lru_cache *cache,
+	struct lab_lru_entry *entry, uint64_t id);
+void lab_lru_cache_remove(struct lab_lru_cache *cache,
+	struct lab_lru_entry *entry);
+
+/* Marks @entry as the most recently used one */
+void lab_lru_cache_touch(struct lab_lru_cache *cache,
+	struct lab_lru_entry *entry);
+
+void lab_lru_cache_set_bytes(struct lab_lru_cache *cache,
+	struct lab_lru_entry *entry, size_t bytes);
+
+/* Keeps @keep, which was just used, even if it is over the limit alone */
+void lab_lru_cache_evict(struct lab_lru_cache *cache,
+	struct lab_lru_entry *keep);
+
+/* Destroys all entries */
+void lab_lru_cache_clear(struct lab_lru_cache *cache);
+
+#endif /* LABWC_LRU_CACHE_H */
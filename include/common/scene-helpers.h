@@ -8,6 +8,7 @@ struct wlr_scene_node;
 struct wlr_surface;
 struct wlr_scene_output;
 struct wlr_output_state;
+struct frame_timing_sample;
 
 struct wlr_surface *lab_wlr_surface_from_node(struct wlr_scene_node *node);
 
@@ -18,8 +19,11 @@ struct wlr_surface *lab_wlr_surface_from_node(struct wlr_scene_node *node);
  */
 struct wlr_scene_node *lab_wlr_scene_get_prev_node(struct wlr_scene_node *node);
 
-/* A variant of wlr_scene_output_commit() that respects wlr_output->pending */
+/*
+ * A variant of wlr_scene_output_commit() that respects wlr_output->pending.
+ * Build and commit times are stored in @sample, if not NULL.
+ */
 bool lab_wlr_scene_output_commit(struct wlr_scene_output *scene_output,
-	struct wlr_output_state *state);
+	struct wlr_output_state *state, struct frame_timing_sample *sample);
 
 #endif /* LABWC_SCENE_HELPERS_H */
@@ -57,6 +57,20 @@ struct usable_area_override {
 	struct wl_list link; /* struct rcxml.usable_area_overrides */
 };
 
+#define MAX_RENDER_TIME_AUTO (-1)
+
+struct max_render_time {
+	char *output;
+	int time; /* in ms, 0 for off or MAX_RENDER_TIME_AUTO */
+	struct wl_list link; /* struct rcxml.max_render_times */
+};
+
+struct ipc_throttle {
+	char *output;
+	int interval; /* in ms */
+	struct wl_list link; /* struct rcxml.ipc_throttles */
+};
+
 struct rcxml {
 	/* from command line */
 	char *config_dir;
@@ -74,6 +88,7 @@ struct rcxml {
 	bool xwayland_persistence;
 	bool primary_selection;
 	char *prompt_command;
+	int title_update_interval; /* in ms */
 
 	/* placement */
 	enum lab_placement_policy placement_policy;
@@ -199,6 +214,13 @@ struct rcxml {
 	float mag_scale;
 	float mag_increment;
 	bool mag_filter;
+
+	/* <core><maxRenderTime output="" time="" /></core> */
+	struct wl_list max_render_times;
+
+	/* <ipc><throttle output="" interval="" /></ipc> */
+	struct wl_list ipc_throttles;
+	int ipc_backlog;
 };
 
 extern struct rcxml rc;
@@ -4,6 +4,9 @@
 #include "config.h"
 #if HAVE_LIBSFDO
 
+#include <stdbool.h>
+#include "work-queue.h"
+
 struct server;
 
 void desktop_entry_init(struct server *server);
@@ -12,9 +15,22 @@ void desktop_entry_finish(struct server *server);
 struct lab_img *desktop_entry_load_icon_from_app_id(
 	struct server *server, const char *app_id, int size, float scale);
 
+/*
+ * The icon loaders may also be called from desktop_entry_queue_work()
+ * jobs. They only block on the disk and on other lookups then.
+ */
 struct lab_img *desktop_entry_load_icon(
 	struct server *server, const char *icon_name, int size, float scale);
 
+/**
+ * desktop_entry_queue_work() - run @work on an icon loader thread
+ *
+ * See work_queue_submit(). Returns false without calling anything if
+ * there are no loader threads, the caller should load the icon itself.
+ */
+bool desktop_entry_queue_work(struct server *server, work_func_t work,
+	work_done_func_t done, void *data);
+
 /**
  * desktop_entry_name_lookup() - return the application name
  * from the sfdo desktop entry database based on app_id
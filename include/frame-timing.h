@@ -0,0 +1,90 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_FRAME_TIMING_H
+#define LABWC_FRAME_TIMING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Number of frames kept per output, about 4 seconds at 60Hz */
+#define FRAME_TIMING_SAMPLES 256
+
+struct frame_timing_sample {
+	/* Frame event, CLOCK_MONOTONIC */
+	uint64_t start_ns;
+	/* End of wlr_output_commit_state(), used for the present latency */
+	uint64_t commit_end_ns;
+	/* Time rendering was held back for <core><maxRenderTime> */
+	uint32_t delay_us;
+	/* Scene and magnifier rendering */
+	uint32_t build_us;
+	/* wlr_output_commit_state() */
+	uint32_t commit_us;
+	/* From the end of the commit until presentation, -1 if unknown */
+	int32_t present_us;
+	/* wlr_output.commit_seq of the commit, matches present events */
+	uint32_t commit_seq;
+	/* Nothing was damaged, no buffer was rendered or committed */
+	bool skipped;
+};
+
+/*
+ * Ring buffer of the last frames of an output. Samples are written from
+ * the frame handler and completed by wlr_output present events.
+ */
+struct frame_timing {
+	struct frame_timing_sample samples[FRAME_TIMING_SAMPLES];
+	/* Number of frames recorded so far, the next one goes to the slot */
+	uint64_t nr_frames;
+	uint64_t nr_skipped;
+};
+
+/**
+ * frame_timing_record() - add a frame to the ring buffer
+ * @name: output name, only used for the trace file
+ *
+ * If a trace is open, the previous frame of @timing is written to it now
+ * that its present event had a chance to arrive.
+ */
+void frame_timing_record(struct frame_timing *timing, const char *name,
+	const struct frame_timing_sample *sample);
+
+/*
+ * Completes the frame that was committed with @commit_seq; @present_ns is
+ * 0 if the frame was discarded.
+ */
+void frame_timing_presented(struct frame_timing *timing, uint32_t commit_seq,
+	uint64_t present_ns);
+
+/* Writes the last frame to the trace, to be called when the output goes */
+void frame_timing_finish(struct frame_timing *timing, const char *name);
+
+/**
+ * frame_timing_render_estimate() - predict the build and commit time
+ *
+ * Uses the 95th percentile of the last 64 rendered frames, so that single
+ * outliers do not disable the render delay. Return: the estimate in
+ * microseconds, or 0 while fewer than 8 frames have been rendered
+ */
+uint32_t frame_timing_render_estimate(const struct frame_timing *timing);
+
+/**
+ * frame_timing_get() - copy recorded frames, oldest first
+ * Return: the number of samples copied, at most @max
+ */
+size_t frame_timing_get(const struct frame_timing *timing,
+	struct frame_timing_sample *out, size_t max);
+
+/* Header and rows of the CSV trace, both terminated by '\n' */
+extern const char frame_timing_csv_header[];
+int frame_timing_format_csv(char *out, size_t size, const char *name,
+	const struct frame_timing_sample *sample);
+
+/*
+ * Appends every frame of every output to the CSV file at @path, as
+ * requested by the LABWC_FRAME_TRACE environment variable.
+ */
+bool frame_timing_trace_open(const char *path);
+void frame_timing_trace_close(void);
+
+#endif /* LABWC_FRAME_TIMING_H */
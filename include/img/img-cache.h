@@ -0,0 +1,52 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_IMG_CACHE_H
+#define LABWC_IMG_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct lab_data_buffer;
+
+/*
+ * On-disk cache of rendered images below $XDG_CACHE_HOME/labwc, so that
+ * SVG button images and icons don't have to be parsed and rendered again
+ * on every startup and reconfigure. Rasters are stored as premultiplied
+ * ARGB32 for each size and scale and are memory-mapped when loaded.
+ *
+ * Entries are keyed by the path, modification time and size of the
+ * source file, so editing or replacing it never hits a stale raster.
+ * Files unused for a month are removed at startup, as are the least
+ * recently used ones while the directory exceeds its size bound. The
+ * directory can safely be removed at any time.
+ *
+ * Safe to be used from worker threads.
+ */
+
+/* Identifies one version of a source file */
+struct img_cache_source {
+	char *path; /* NULL if the file could not be stat'ed */
+	int64_t mtime_sec;
+	int64_t mtime_nsec;
+	int64_t size;
+};
+
+/* Returns false if @path could not be stat'ed, the cache is unusable then */
+bool img_cache_source_init(struct img_cache_source *source, const char *path);
+void img_cache_source_finish(struct img_cache_source *source);
+
+/*
+ * Returns true if @source was marked as loading fine before, allowing to
+ * skip parsing it until a raster is missing.
+ */
+bool img_cache_source_known(const struct img_cache_source *source);
+void img_cache_mark_source(const struct img_cache_source *source);
+
+/* Returns NULL if there is no raster for the given size and scale */
+struct lab_data_buffer *img_cache_load(const struct img_cache_source *source,
+	int width, int height, double scale);
+
+/* Stores @buffer, which was rendered for the given size and scale */
+void img_cache_store(const struct img_cache_source *source,
+	struct lab_data_buffer *buffer, int width, int height, double scale);
+
+#endif /* LABWC_IMG_CACHE_H */
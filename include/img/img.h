@@ -4,6 +4,7 @@
 
 #include <cairo.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <wayland-util.h>
 
 enum lab_img_type {
@@ -74,4 +75,9 @@ void lab_img_destroy(struct lab_img *img);
  */
 bool lab_img_equal(struct lab_img *img_a, struct lab_img *img_b);
 
+/**
+ * lab_img_hash() - Returns a hash of the content compared by lab_img_equal()
+ */
+uint64_t lab_img_hash(struct lab_img *img);
+
 #endif /* LABWC_IMG_H */
@@ -0,0 +1,46 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_INPUT_TIMING_H
+#define LABWC_INPUT_TIMING_H
+
+#include <stdint.h>
+
+/*
+ * 8 buckets per power of two nanoseconds, which keeps percentiles within
+ * 12.5% of the real value over the whole range of a uint40.
+ */
+#define LATENCY_HISTOGRAM_SUB_BITS 3
+#define LATENCY_HISTOGRAM_BUCKETS 304
+
+struct latency_histogram {
+	uint32_t buckets[LATENCY_HISTOGRAM_BUCKETS];
+	uint64_t count;
+	uint64_t sum_ns;
+	uint64_t max_ns;
+};
+
+/*
+ * Time spent in the pointer motion path, from the wlr_cursor event to the
+ * IPC update, and in publishing coalesced IPC updates on output frames.
+ * Reported and reset by the IPC command "input_timing".
+ */
+struct input_timing {
+	struct latency_histogram motion;
+	struct latency_histogram publish;
+};
+
+/* CLOCK_MONOTONIC in nanoseconds */
+uint64_t input_timing_now_ns(void);
+
+void latency_histogram_add(struct latency_histogram *histogram, uint64_t ns);
+
+/**
+ * latency_histogram_percentile() - upper bound of a percentile
+ * @percentile: 1..100
+ *
+ * Return: the upper end of the bucket holding the percentile, but never
+ * more than the largest value recorded; 0 if the histogram is empty
+ */
+uint64_t latency_histogram_percentile(const struct latency_histogram *histogram,
+	unsigned int percentile);
+
+#endif /* LABWC_INPUT_TIMING_H */
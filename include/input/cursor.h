@@ -2,6 +2,7 @@
 #ifndef LABWC_CURSOR_H
 #define LABWC_CURSOR_H
 
+#include <pixman.h>
 #include <wayland-server-protocol.h>
 #include "common/edge.h"
 #include "common/node-type.h"
@@ -56,6 +57,17 @@ struct cursor_context {
  */
 struct cursor_context get_cursor_context(struct server *server);
 
+void cursor_context_cache_init(struct seat *seat);
+void cursor_context_cache_finish(struct seat *seat);
+
+/*
+ * Drops the hit-test cache of get_cursor_context() if @damage, in layout
+ * coordinates, touches it. Called with the pending damage of each output
+ * before it is consumed by rendering.
+ */
+void cursor_context_cache_damage(struct seat *seat,
+	const pixman_region32_t *damage);
+
 /**
  * cursor_set - set cursor icon
  * @seat - current seat
@@ -0,0 +1,469 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_IPC_PROTO_H
+#define LABWC_IPC_PROTO_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+struct buf;
+struct frame_timing_sample;
+struct latency_histogram;
+struct wl_array;
+
+/*
+ * Wire format of the shell IPC socket.
+ *
+ * Clients start out in JSON mode, where every message is a single line of
+ * JSON terminated by '\n'. Sending {"cmd":"protocol","mode":"binary"}
+ * switches the connection to binary mode. The server acknowledges with an
+ * IPC_MSG_HELLO frame and all following traffic in both directions consists
+ * of frames:
+ *
+ *   u32 payload length
+ *   u16 message type (enum ipc_msg_type)
+ *   u16 reserved (must be zero)
+ *   payload
+ *
+ * All integers are little-endian. Strings are not NUL-terminated and are
+ * prefixed by their length instead.
+ */
+#define IPC_PROTO_VERSION 1
+#define IPC_FRAME_HEADER_SIZE 8
+/* Limit for frames sent by clients; server frames are not bounded */
+#define IPC_FRAME_MAX_PAYLOAD (64 * 1024)
+
+/*
+ * Fixed-size part of a window record; the title and app_id bytes follow.
+ *
+ *   u64 id
+ *   i32 x, y, width, height
+ *   u8  event (enum ipc_window_event)
+ *   u8  flags (enum ipc_window_flags)
+ *   u8  maximized (enum view_axis)
+ *   u8  reserved
+ *   u16 title length
+ *   u16 app_id length
+ */
+#define IPC_WINDOW_RECORD_SIZE 32
+
+/*
+ * Command payload:
+ *
+ *   u32 command (enum ipc_command_type)
+ *   u32 argument (protocol mode for IPC_CMD_PROTOCOL, rate for
+ *       IPC_CMD_THUMBNAIL)
+ *   u64 id
+ *   i32 x, y, width, height
+ */
+#define IPC_COMMAND_RECORD_SIZE 32
+
+/*
+ * A batch is an IPC_CMD_BATCH command record followed by the command
+ * records of its operations, or {"cmd":"batch","ops":[{...},...]} in JSON
+ * mode. Only commands that act on a single view can be batched.
+ */
+#define IPC_BATCH_MAX_OPS 1024
+
+/*
+ * The "subscribe" command is a command record with the event mask as
+ * argument, optionally followed by the app_id and output filters, each
+ * as u16 length and bytes. In JSON mode it is
+ * {"cmd":"subscribe","events":<mask>,"app_id":"...","output":"..."}.
+ */
+#define IPC_FILTER_MAX_LEN 255
+
+enum ipc_proto_mode {
+	IPC_PROTO_JSON = 0,
+	IPC_PROTO_BINARY,
+};
+
+enum ipc_msg_type {
+	IPC_MSG_HELLO = 1,      /* u32 protocol version */
+	IPC_MSG_CURSOR,         /* i32 x, i32 y */
+	IPC_MSG_WINDOW_EVENT,   /* window record */
+	IPC_MSG_WINDOW_LIST,    /* u32 count, u32 reserved, window records */
+	IPC_MSG_COMMAND,        /* command record, client to server */
+	IPC_MSG_NOTICE,         /* u32 enum ipc_notice */
+	IPC_MSG_SHM,            /* u32 size, u32 version, fd in SCM_RIGHTS */
+	IPC_MSG_STATS,          /* u64 queued bytes, u64 dropped, u64 coalesced */
+	IPC_MSG_WINDOW_SNAPSHOT, /* u32 count, u32 reserved, u64 generation,
+	                            window records */
+	IPC_MSG_WINDOW_DELTA,   /* see ipc_bin_encode_window_delta() */
+	IPC_MSG_BATCH_RESULT,   /* u32 applied, u32 failed */
+	IPC_MSG_THUMBNAIL,      /* see ipc_bin_encode_thumbnail(), fd in
+	                           SCM_RIGHTS unless the stream ended */
+	IPC_MSG_FRAME_TIMING,   /* u32 count, u32 reserved, output records */
+	IPC_MSG_INPUT_TIMING,   /* motion and publish latency records */
+};
+
+enum ipc_window_event {
+	IPC_WINDOW_INFO = 0,    /* plain state, used for window list entries */
+	IPC_WINDOW_MAPPED,
+	IPC_WINDOW_UNMAPPED,
+	IPC_WINDOW_CLOSED,
+	IPC_WINDOW_MOVED,
+	IPC_WINDOW_FOCUSED,
+	IPC_WINDOW_MINIMIZED,
+	IPC_WINDOW_MAXIMIZED,
+	IPC_WINDOW_FULLSCREEN,
+	IPC_WINDOW_TITLE_CHANGED,
+};
+
+enum ipc_window_flags {
+	IPC_WINDOW_FLAG_MINIMIZED = 1 << 0,
+	IPC_WINDOW_FLAG_FULLSCREEN = 1 << 1,
+	IPC_WINDOW_FLAG_FOCUSED = 1 << 2,
+};
+
+/*
+ * Fields of a window that changed in an IPC_MSG_WINDOW_DELTA. A delta with
+ * all of IPC_WINDOW_FIELDS_ALL set for an unknown id adds a window, one
+ * with IPC_WINDOW_REMOVED removes it.
+ */
+enum ipc_window_field {
+	IPC_WINDOW_FIELD_TITLE = 1 << 0,
+	IPC_WINDOW_FIELD_APP_ID = 1 << 1,
+	IPC_WINDOW_FIELD_X = 1 << 2,
+	IPC_WINDOW_FIELD_Y = 1 << 3,
+	IPC_WINDOW_FIELD_WIDTH = 1 << 4,
+	IPC_WINDOW_FIELD_HEIGHT = 1 << 5,
+	IPC_WINDOW_FIELD_MINIMIZED = 1 << 6,
+	IPC_WINDOW_FIELD_MAXIMIZED = 1 << 7,
+	IPC_WINDOW_FIELD_FULLSCREEN = 1 << 8,
+	IPC_WINDOW_FIELD_FOCUSED = 1 << 9,
+
+	IPC_WINDOW_FIELDS_ALL = (1 << 10) - 1,
+	IPC_WINDOW_REMOVED = 1 << 15,
+};
+
+/* Events a client can subscribe to, see struct ipc_subscription */
+enum ipc_event_mask {
+	IPC_EVENT_CURSOR = 1 << 0,
+	IPC_EVENT_MAPPED = 1 << 1,      /* "mapped" and "unmapped" */
+	IPC_EVENT_CLOSED = 1 << 2,
+	IPC_EVENT_MOVED = 1 << 3,
+	IPC_EVENT_FOCUSED = 1 << 4,
+	IPC_EVENT_STATE = 1 << 5,       /* minimized, maximized, fullscreen */
+	IPC_EVENT_TITLE = 1 << 6,
+
+	IPC_EVENT_WINDOW = IPC_EVENT_MAPPED | IPC_EVENT_CLOSED
+		| IPC_EVENT_MOVED | IPC_EVENT_FOCUSED | IPC_EVENT_STATE
+		| IPC_EVENT_TITLE,
+	IPC_EVENT_ALL = IPC_EVENT_CURSOR | IPC_EVENT_WINDOW,
+};
+
+enum ipc_notice {
+	IPC_NOTICE_DECORATIONS_DISABLED = 1,
+};
+
+enum ipc_command_type {
+	IPC_CMD_NONE = 0,
+	IPC_CMD_CLOSE,
+	IPC_CMD_MINIMIZE,
+	IPC_CMD_MAXIMIZE,
+	IPC_CMD_MOVE,
+	IPC_CMD_FOCUS,
+	IPC_CMD_ALWAYS_ON_TOP,
+	IPC_CMD_ALWAYS_ON_BOTTOM,
+	IPC_CMD_LIST,
+	IPC_CMD_ENABLE_DECORATIONS,
+	IPC_CMD_PROTOCOL,
+	IPC_CMD_SHM,
+	IPC_CMD_STATS,
+	IPC_CMD_SUBSCRIBE_WINDOWS,
+	IPC_CMD_BATCH,
+	IPC_CMD_SUBSCRIBE,
+	IPC_CMD_THUMBNAIL,
+	IPC_CMD_FRAME_TIMING,
+	IPC_CMD_INPUT_TIMING,
+
+	IPC_CMD_COUNT
+};
+
+struct ipc_command {
+	enum ipc_command_type type;
+	enum ipc_proto_mode mode; /* IPC_CMD_PROTOCOL only */
+	uint32_t rate; /* IPC_CMD_THUMBNAIL only, frames per second */
+	uint64_t id;
+	int32_t x, y, width, height;
+};
+
+#define IPC_SHM_MAGIC 0x4853424c /* "LBSH" */
+#define IPC_SHM_VERSION 1
+
+/*
+ * Layout of the shared state region handed out by the "shm" command as a
+ * read-only memfd. The compositor is the only writer and updates it without
+ * any syscalls. Readers use it as a seqlock: read @seq, copy the fields,
+ * read @seq again and retry if it was odd or has changed.
+ */
+struct ipc_shm_state {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t seq;
+	uint32_t reserved;
+	int32_t cursor_x;
+	int32_t cursor_y;
+	/* 0 if no view is active */
+	uint64_t active_view_id;
+	/* Incremented on every window event, poll to detect changes */
+	uint64_t window_generation;
+};
+
+/*
+ * Events a client receives. Window events are only sent for views whose
+ * app_id and output match the filters, if set. The output filter also
+ * limits cursor events to positions on that output.
+ */
+struct ipc_subscription {
+	uint32_t events; /* enum ipc_event_mask */
+	char *app_id;
+	char *output;
+};
+
+enum ipc_thumbnail_type {
+	IPC_THUMBNAIL_END = 0,  /* view gone or stream stopped, no fd */
+	IPC_THUMBNAIL_SHM,      /* fd can be mmap()ed */
+	IPC_THUMBNAIL_DMABUF,   /* single plane dmabuf */
+};
+
+/* Describes a thumbnail frame; the pixels are in the attached fd */
+struct ipc_thumbnail_info {
+	uint64_t id;
+	enum ipc_thumbnail_type type;
+	uint32_t width, height;
+	uint32_t format; /* DRM fourcc */
+	uint64_t modifier;
+	uint32_t offset, stride;
+};
+
+/* Recent frames of an output, as reported by the "frame_timing" command */
+struct ipc_frame_timing {
+	const char *output;
+	uint64_t frames;
+	uint64_t skipped;
+	uint64_t magnifier_skipped;
+	const struct frame_timing_sample *samples; /* oldest first */
+	uint32_t nr_samples;
+};
+
+/* Snapshot of the view state that is sent to clients */
+struct ipc_window_info {
+	uint64_t id;
+	const char *title;
+	const char *app_id;
+	int32_t x, y, width, height;
+	bool minimized;
+	uint8_t maximized;
+	bool fullscreen;
+	bool focused;
+};
+
+/* Returns the JSON "event" name, e.g. "moved" for IPC_WINDOW_MOVED */
+const char *ipc_window_event_name(enum ipc_window_event event);
+
+/* Returns the enum ipc_event_mask bit a window event belongs to */
+uint32_t ipc_window_event_mask(enum ipc_window_event event);
+
+/* Frees the filters of @sub, leaving it empty */
+void ipc_subscription_finish(struct ipc_subscription *sub);
+
+/**
+ * ipc_json_encode_cursor() - format a cursor event as one line of JSON
+ * Return: the number of characters that would have been written, as
+ * returned by snprintf()
+ */
+int ipc_json_encode_cursor(char *out, size_t size, double x, double y);
+
+/**
+ * ipc_json_encode_window_event() - append a window event as one line of JSON
+ * Title and app_id are escaped and never truncated.
+ */
+void ipc_json_encode_window_event(struct buf *out,
+	enum ipc_window_event event, const struct ipc_window_info *info);
+
+/* Announces the shm region that is passed along with the message */
+int ipc_json_encode_shm(char *out, size_t size, uint32_t shm_size);
+
+/* Reply to the "stats" command with the client's output queue counters */
+int ipc_json_encode_stats(char *out, size_t size, uint64_t queued,
+	uint64_t dropped, uint64_t coalesced);
+
+int ipc_json_encode_thumbnail(char *out, size_t size,
+	const struct ipc_thumbnail_info *info);
+
+/*
+ * Reply to the "input_timing" command: count, mean, 50th, 95th and 99th
+ * percentile and maximum of the pointer motion and IPC publish times
+ */
+int ipc_json_encode_input_timing(char *out, size_t size,
+	const struct latency_histogram *motion,
+	const struct latency_histogram *publish);
+
+/* Reply to a batch, @failed is the number of invalid operations */
+int ipc_json_encode_batch_result(char *out, size_t size, uint32_t applied,
+	uint32_t failed);
+
+/* Appends a window as JSON object, without separators or newline */
+void ipc_json_add_window(struct buf *out, const struct ipc_window_info *info);
+
+/*
+ * Appends an output as JSON object, without separators or newline. The
+ * samples are arrays of start_ns, delay_us, build_us, commit_us,
+ * present_us and skipped, to keep replies of a few hundred frames compact.
+ */
+void ipc_json_add_frame_timing(struct buf *out,
+	const struct ipc_frame_timing *timing);
+
+/**
+ * ipc_json_encode_window_delta() - append a window delta line to @out
+ * @generation: window table generation after the change
+ * @fields: changed fields (enum ipc_window_field), only these are encoded
+ * @info: new window state, only @info->id is used for removals
+ */
+void ipc_json_encode_window_delta(struct buf *out, uint64_t generation,
+	uint32_t fields, const struct ipc_window_info *info);
+
+/**
+ * ipc_json_parse_command() - parse one line received in JSON mode
+ * @line: NUL-terminated line without the trailing newline
+ * @cmd: filled in on success
+ * Return: false if the line does not contain a known command
+ */
+bool ipc_json_parse_command(const char *line, struct ipc_command *cmd);
+
+/**
+ * ipc_json_parse_batch() - parse the operations of a "batch" command
+ * @line: as for ipc_json_parse_command()
+ * @ops: array of struct ipc_command the operations are appended to
+ * Return: false if any operation is malformed or cannot be batched
+ */
+bool ipc_json_parse_batch(const char *line, struct wl_array *ops);
+
+/**
+ * ipc_json_parse_subscribe() - parse a "subscribe" command
+ * @sub: filled in on success, to be freed by ipc_subscription_finish()
+ * Return: false if a filter is too long
+ */
+bool ipc_json_parse_subscribe(const char *line, struct ipc_subscription *sub);
+
+/* Whether @type acts on the view given by the command's id */
+bool ipc_command_is_view_command(enum ipc_command_type type);
+
+/*
+ * The ipc_bin_encode_*() functions append one complete frame to @out, so
+ * several frames can be batched into a single write().
+ */
+void ipc_bin_encode_hello(struct wl_array *out);
+void ipc_bin_encode_notice(struct wl_array *out, enum ipc_notice notice);
+void ipc_bin_encode_cursor(struct wl_array *out, double x, double y);
+void ipc_bin_encode_shm(struct wl_array *out, uint32_t size);
+void ipc_bin_encode_stats(struct wl_array *out, uint64_t queued,
+	uint64_t dropped, uint64_t coalesced);
+void ipc_bin_encode_batch_result(struct wl_array *out, uint32_t applied,
+	uint32_t failed);
+
+/*
+ * Input timing payload, one record for pointer motion followed by one for
+ * publishing IPC updates:
+ *
+ *   u64 count, u64 mean ns, u64 p50 ns, u64 p95 ns, u64 p99 ns, u64 max ns
+ */
+#define IPC_INPUT_TIMING_RECORD_SIZE 48
+void ipc_bin_encode_input_timing(struct wl_array *out,
+	const struct latency_histogram *motion,
+	const struct latency_histogram *publish);
+
+/*
+ * Thumbnail payload:
+ *
+ *   u64 id
+ *   u64 modifier
+ *   u32 type (enum ipc_thumbnail_type)
+ *   u32 width, height
+ *   u32 format
+ *   u32 offset, stride
+ */
+void ipc_bin_encode_thumbnail(struct wl_array *out,
+	const struct ipc_thumbnail_info *info);
+void ipc_bin_encode_window_event(struct wl_array *out,
+	enum ipc_window_event event, const struct ipc_window_info *info);
+
+/*
+ * Window lists, snapshots and frame timing replies are built with their
+ * _begin(), any number of _add() and a final ipc_bin_frame_end() which
+ * patches the payload length and the record count.
+ */
+size_t ipc_bin_window_list_begin(struct wl_array *out);
+void ipc_bin_window_list_add(struct wl_array *out,
+	const struct ipc_window_info *info);
+
+/*
+ * Snapshots share the layout of window lists apart from the generation
+ * after the count.
+ */
+size_t ipc_bin_window_snapshot_begin(struct wl_array *out,
+	uint64_t generation);
+
+/*
+ * Delta payload:
+ *
+ *   u64 generation
+ *   u64 id
+ *   u32 fields (enum ipc_window_field)
+ *   u32 reserved
+ *
+ * followed by the changed fields in the order of their bits: title and
+ * app_id as u16 length and bytes, x, y, width and height as i32 and the
+ * remaining fields as one u8 each.
+ */
+void ipc_bin_encode_window_delta(struct wl_array *out, uint64_t generation,
+	uint32_t fields, const struct ipc_window_info *info);
+
+/*
+ * Frame timing replies start with a u32 output count and a u32 reserved
+ * field. Each output record is:
+ *
+ *   u16 name length
+ *   u16 reserved
+ *   u32 sample count
+ *   u64 frames, skipped, magnifier_skipped
+ *   name bytes
+ *
+ * followed by the samples, each as u64 start_ns, u32 delay_us,
+ * u32 build_us, u32 commit_us, i32 present_us and u32 flags (1 if
+ * skipped).
+ */
+size_t ipc_bin_frame_timing_begin(struct wl_array *out);
+void ipc_bin_frame_timing_add(struct wl_array *out,
+	const struct ipc_frame_timing *timing);
+void ipc_bin_frame_end(struct wl_array *out, size_t start, uint32_t count);
+
+/**
+ * ipc_bin_decode_frame() - split the next frame off a receive buffer
+ * @data: start of buffered bytes
+ * @len: number of buffered bytes
+ * @type: set to the message type of the frame
+ * @payload: set to the start of the payload within @data
+ * @payload_len: set to the payload length
+ * Return: bytes consumed by the frame, 0 if the frame is still incomplete,
+ * or -1 if the stream is corrupt (oversized payload, reserved field not
+ * zero) and the connection should be dropped
+ */
+ssize_t ipc_bin_decode_frame(const uint8_t *data, size_t len, uint16_t *type,
+	const uint8_t **payload, uint32_t *payload_len);
+
+bool ipc_bin_decode_command(const uint8_t *payload, uint32_t len,
+	struct ipc_command *cmd);
+
+/* Binary counterpart of ipc_json_parse_batch() */
+bool ipc_bin_decode_batch(const uint8_t *payload, uint32_t len,
+	struct wl_array *ops);
+
+/* Binary counterpart of ipc_json_parse_subscribe() */
+bool ipc_bin_decode_subscribe(const uint8_t *payload, uint32_t len,
+	struct ipc_subscription *sub);
+
+#endif /* LABWC_IPC_PROTO_H */
@@ -0,0 +1,74 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_IPC_QUEUE_H
+#define LABWC_IPC_QUEUE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <wayland-util.h>
+#include "labwc-ipc-proto.h"
+
+/* Identifies a message for coalescing in the output queue */
+struct ipc_msg_key {
+	enum ipc_msg_type type;
+	enum ipc_window_event event; /* IPC_MSG_WINDOW_EVENT only */
+	uint64_t view_id;            /* IPC_MSG_WINDOW_EVENT only */
+};
+
+/*
+ * Bounded per-client output queue, used once the socket stops accepting
+ * data. Messages are kept whole: they are either queued completely or
+ * dropped, so the stream the client sees never contains partial messages.
+ *
+ * While the client is behind, messages that supersede earlier ones are
+ * not queued but held back in slots of which only the latest is kept:
+ * one for the cursor position and one per view for "moved" events. The
+ * slots are appended to the ring when it drains, or before any other
+ * event of the same view to preserve ordering.
+ */
+struct ipc_out_queue {
+	char *ring;
+	size_t size;
+	size_t head;
+	size_t len;
+
+	char cursor[128];
+	size_t cursor_len;
+	struct wl_array moved; /* struct ipc_pending_moved */
+
+	uint64_t nr_dropped;
+	uint64_t nr_coalesced;
+};
+
+void ipc_out_queue_init(struct ipc_out_queue *queue, size_t size);
+void ipc_out_queue_finish(struct ipc_out_queue *queue);
+
+bool ipc_out_queue_is_empty(struct ipc_out_queue *queue);
+
+/* Number of bytes waiting in the ring and in the coalescing slots */
+size_t ipc_out_queue_pending(struct ipc_out_queue *queue);
+
+/**
+ * ipc_out_queue_push() - queue a complete message
+ *
+ * The message may be coalesced with a previous one or dropped (and
+ * counted) if there is no room left.
+ */
+void ipc_out_queue_push(struct ipc_out_queue *queue,
+	const struct ipc_msg_key *key, const void *data, size_t len);
+
+/**
+ * ipc_out_queue_push_tail() - queue the unwritten rest of a message
+ * Return: false if it does not fit, in which case the stream is broken
+ */
+bool ipc_out_queue_push_tail(struct ipc_out_queue *queue, const void *data,
+	size_t len);
+
+/**
+ * ipc_out_queue_flush() - write as much queued data to @fd as possible
+ * Return: 0 when everything was written, 1 if the socket is full again
+ * or -1 on write errors
+ */
+int ipc_out_queue_flush(struct ipc_out_queue *queue, int fd);
+
+#endif /* LABWC_IPC_QUEUE_H */
@@ -0,0 +1,28 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_IPC_SHM_H
+#define LABWC_IPC_SHM_H
+
+#include <stdint.h>
+
+struct ipc_shm_state;
+
+/*
+ * Shared-memory mirror of frequently changing state (cursor position,
+ * active view, window-table generation), see struct ipc_shm_state.
+ */
+struct ipc_shm {
+	int fd;
+	uint32_t size;
+	struct ipc_shm_state *state;
+};
+
+/* Returns NULL if the memfd could not be created */
+struct ipc_shm *ipc_shm_create(void);
+void ipc_shm_destroy(struct ipc_shm *shm);
+
+void ipc_shm_set_cursor(struct ipc_shm *shm, double x, double y);
+
+/* Records a window event, optionally with a new active view */
+void ipc_shm_window_changed(struct ipc_shm *shm, uint64_t active_view_id);
+
+#endif /* LABWC_IPC_SHM_H */
@@ -0,0 +1,47 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_IPC_TABLE_H
+#define LABWC_IPC_TABLE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <wayland-util.h>
+#include "common/id-map.h"
+#include "labwc-ipc-proto.h"
+
+struct ipc_window_entry {
+	/* title and app_id are owned by the entry */
+	struct ipc_window_info info;
+	struct wl_list link; /* struct ipc_window_table.entries */
+};
+
+/*
+ * Copy of the window state last sent to subscribed clients. Diffing new
+ * state against it yields the fields for IPC_MSG_WINDOW_DELTA, and every
+ * change increments the generation by one so that clients can tell
+ * whether they missed a delta.
+ */
+struct ipc_window_table {
+	uint64_t generation;
+	struct wl_list entries; /* in the order the windows were added */
+	struct lab_id_map index;
+	uint64_t focused_id; /* 0 if no window is focused */
+};
+
+void ipc_window_table_init(struct ipc_window_table *table);
+void ipc_window_table_finish(struct ipc_window_table *table);
+
+/* Removes all windows, keeping the generation */
+void ipc_window_table_clear(struct ipc_window_table *table);
+
+/**
+ * ipc_window_table_update() - store the current state of a window
+ * Return: the changed fields (enum ipc_window_field), all of them if the
+ * window was not in the table before, or 0 if nothing changed
+ */
+uint32_t ipc_window_table_update(struct ipc_window_table *table,
+	const struct ipc_window_info *info);
+
+/* Return: false if the window was not in the table */
+bool ipc_window_table_remove(struct ipc_window_table *table, uint64_t id);
+
+#endif /* LABWC_IPC_TABLE_H */
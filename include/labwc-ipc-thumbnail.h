@@ -0,0 +1,34 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_IPC_THUMBNAIL_H
+#define LABWC_IPC_THUMBNAIL_H
+
+#include <pixman.h>
+#include <stdint.h>
+
+struct ipc_client;
+struct ipc_server;
+struct view;
+
+/**
+ * ipc_thumbnail_stream() - start, update or stop a thumbnail stream
+ * @width: width of the box the thumbnail is fitted into
+ * @height: height of the box, the aspect ratio of the view is kept
+ * @rate: maximum number of frames per second, 0 stops the stream
+ *
+ * Frames are rendered only after the view's scene tree was damaged, and
+ * at most @rate times per second.
+ */
+void ipc_thumbnail_stream(struct ipc_client *client, struct view *view,
+	int width, int height, uint32_t rate);
+
+/*
+ * Marks streams of views that @damage, in layout coordinates, touches.
+ * Called with the pending damage of each output before it is rendered.
+ */
+void ipc_thumbnail_damage(struct ipc_server *ipc_server,
+	const pixman_region32_t *damage);
+
+/* Stops all streams of a disconnecting client */
+void ipc_thumbnail_finish_client(struct ipc_client *client);
+
+#endif /* LABWC_IPC_THUMBNAIL_H */
@@ -0,0 +1,140 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_IPC_H
+#define LABWC_IPC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <wayland-server-core.h>
+#include "common/buf.h"
+#include "labwc-ipc-proto.h"
+#include "labwc-ipc-queue.h"
+#include "labwc-ipc-table.h"
+
+struct output;
+struct server;
+struct timespec;
+struct view;
+
+struct ipc_client {
+	struct ipc_server *ipc_server;
+	struct wl_list link; /* struct ipc_server.clients */
+	int fd;
+	struct wl_event_source *event_source;
+	/* Negotiated with the "protocol" command, JSON until then */
+	enum ipc_proto_mode mode;
+	/* Set by the "subscribe" command, all events by default */
+	struct ipc_subscription sub;
+	/* Reads cursor state from the shm region instead of the socket */
+	bool uses_shm;
+
+	/* Receives window deltas, see the "subscribe_windows" command */
+	bool windows_subscribed;
+	/* A delta was dropped, send a new snapshot once the queue drains */
+	bool windows_resync;
+
+	/* Set on write errors, the client is destroyed on the next event */
+	bool broken;
+
+	struct wl_list thumbnails; /* struct ipc_thumbnail.link */
+
+	/* Data the socket did not accept yet, flushed on WL_EVENT_WRITABLE */
+	struct ipc_out_queue out;
+	bool watching_writable;
+
+	/* Received data not yet processed */
+	char *buffer;
+	size_t buffer_size;
+	size_t buffer_used;
+};
+
+struct ipc_server {
+	struct server *server;
+	/* $XDG_RUNTIME_DIR/labwc-ipc.$WAYLAND_DISPLAY.sock, see ipc_server_listen() */
+	char *socket_path;
+	int sock_fd;
+	struct wl_event_source *event_source;
+	struct wl_list clients; /* struct ipc_client.link */
+
+	/*
+	 * Number of connected clients per protocol mode, so that messages
+	 * are only encoded in the formats that somebody is listening to.
+	 */
+	int nr_json_clients;
+	int nr_binary_clients;
+	int nr_shm_clients;
+
+	/* Union of the events any client receives, see ipc_client_wants() */
+	uint32_t event_mask;
+
+	/* Created when the first client asks for it with the "shm" command */
+	struct ipc_shm *shm;
+
+	/*
+	 * Cursor positions and "moved" events are coalesced and published
+	 * once per frame of the output under the cursor.
+	 */
+	struct {
+		bool cursor_dirty;
+		double cursor_x, cursor_y;
+		struct wl_array views; /* struct view * */
+		/* Output whose next frame publishes, NULL if nothing pending */
+		struct output *output;
+		uint64_t last_publish_ms;
+		/* Delays publishing for <ipc><throttle interval=""> */
+		struct wl_event_source *throttle_timer;
+	} pending;
+
+	/* Events held back while a "batch" command is applied */
+	struct {
+		bool active;
+		struct wl_array events; /* struct ipc_batch_event */
+	} batch;
+
+	/* Window state as last sent to subscribers, empty if there are none */
+	struct ipc_window_table windows;
+	int nr_window_subscribers;
+
+	/* Reused for encoding binary frames to avoid reallocations */
+	struct wl_array frame_buf;
+	/* Likewise for JSON messages that do not fit on the stack */
+	struct buf json_buf;
+};
+
+/* Used by the IPC submodules to reply to a client */
+void ipc_reply(struct ipc_client *client, enum ipc_msg_type type,
+	const void *data, size_t len);
+/* Returns false if the message was dropped because the client is busy */
+bool ipc_send_fd_to_client(struct ipc_client *client, const void *data,
+	size_t len, int fd);
+
+struct ipc_server *ipc_server_init(struct server *server);
+
+/*
+ * Binds the socket next to the Wayland socket of @wayland_display and
+ * exports its path as LABWC_IPC_SOCKET. Returns false if IPC is unavailable.
+ */
+bool ipc_server_listen(struct ipc_server *ipc_server,
+	const char *wayland_display);
+void ipc_server_finish(struct ipc_server *ipc_server);
+
+/*
+ * IPC_WINDOW_MOVED events are deferred to the next frame like cursor
+ * updates; all other events are sent right away.
+ */
+void ipc_send_window_event(struct ipc_server *ipc_server, struct view *view,
+	enum ipc_window_event event);
+
+/*
+ * To be called on every pointer motion. Updates the shm region right away
+ * and sends the position to socket clients on the next frame.
+ */
+void ipc_cursor_moved(struct ipc_server *ipc_server, double x, double y);
+
+/* Publishes coalesced updates, called from the output frame handler */
+void ipc_output_frame(struct ipc_server *ipc_server, struct output *output,
+	const struct timespec *now);
+void ipc_output_destroyed(struct ipc_server *ipc_server,
+	struct output *output);
+
+#endif /* LABWC_IPC_H */
@@ -2,10 +2,13 @@
 #ifndef LABWC_H
 #define LABWC_H
 #include "config.h"
+#include <pixman.h>
 #include <wlr/util/box.h>
 #include <wlr/util/log.h>
+#include "common/id-map.h"
 #include "common/set.h"
 #include "input/cursor.h"
+#include "input-timing.h"
 #include "overlay.h"
 
 #define XCURSOR_DEFAULT "left_ptr"
@@ -81,6 +84,20 @@ struct seat {
 	 */
 	struct cursor_context pressed;
 
+	/*
+	 * Last client surface found by get_cursor_context() and the part of
+	 * the layout in which it is the topmost node. Lookups within that
+	 * region skip walking the scene until it changes, see desktop.c.
+	 */
+	struct {
+		struct cursor_context ctx; /* ctx.node is NULL if unset */
+		pixman_region32_t region;
+		int lx, ly;
+		uint64_t generation;
+		struct wl_listener node_destroy;
+		uint64_t hits, misses;
+	} hit_cache;
+
 	struct lab_set bound_buttons;
 
 	struct {
@@ -190,6 +207,14 @@ struct server {
 
 	struct wl_list views;
 	struct wl_list unmanaged_surfaces;
+	/* Indexes server->views by view->id */
+	struct lab_id_map view_ids;
+	uint64_t next_view_id;
+	/* Views with unpublished titles, see view_set_title() */
+	struct wl_list pending_titles;
+	struct wl_event_source *title_update_timer;
+	/* Pending scaled_buffer_evict_inactive_scales(), see output.c */
+	struct wl_event_source *evict_scales_idle;
 
 	struct seat seat;
 	struct wlr_scene *scene;
@@ -313,12 +338,29 @@ struct server {
 	} osd_state;
 
 	struct theme *theme;
+	/* Workers rasterizing themes, see theme_build_async() */
+	struct work_queue *theme_queue;
+	struct theme_build *theme_build;
+	/* Reconfigure requested while a theme was being built */
+	bool reconfigure_deferred;
 
 	struct menu *menu_current;
 	struct wl_list menus;
 
 	struct sfdo *sfdo;
 
+	/* Shell IPC socket, may be NULL if it could not be created */
+	struct ipc_server *ipc_server;
+	/*
+	 * Incremented on changes of input areas that may not damage the
+	 * scene, like the invisible resize extents of windows. Invalidates
+	 * the hit-test cache of get_cursor_context().
+	 */
+	uint64_t scene_generation;
+
+	/* Pointer motion and IPC publish times, see input-timing.h */
+	struct input_timing input_timing;
+
 	pid_t primary_client_pid;
 };
 
@@ -6,8 +6,8 @@
 
 struct server;
 struct output;
-struct wlr_buffer;
 struct wlr_box;
+struct wlr_output_state;
 
 enum magnify_dir {
 	MAGNIFY_INCREASE,
@@ -16,8 +16,22 @@ enum magnify_dir {
 
 void magnifier_toggle(struct server *server);
 void magnifier_set_scale(struct server *server, enum magnify_dir dir);
+
+/*
+ * Whether @output has to render a frame for the magnifier to follow the
+ * cursor, a new scale, or to disappear.
+ */
 bool output_wants_magnification(struct output *output);
-void magnifier_draw(struct output *output, struct wlr_buffer *output_buffer,
+
+/* Schedules a frame on every output for which the above is true */
+void magnifier_update(struct server *server);
+
+/*
+ * Draws the magnifier into the buffer of @state, if it is shown on @output,
+ * and adds what changed to the damage of @state. @damage receives the area
+ * drawn over, which the scene has to repaint in later frames.
+ */
+void magnifier_draw(struct output *output, struct wlr_output_state *state,
 	struct wlr_box *damage);
 bool magnifier_is_enabled(void);
 void magnifier_reset(void);
@@ -45,6 +45,8 @@ struct window_switcher_field {
 struct buf;
 struct view;
 struct server;
+struct wlr_buffer;
+struct wlr_drm_format;
 struct wlr_scene_node;
 
 /* Begin window switcher */
@@ -62,6 +64,14 @@ void osd_on_view_destroy(struct view *view);
 /* Focus the clicked window and close OSD */
 void osd_on_cursor_release(struct server *server, struct wlr_scene_node *node);
 
+/*
+ * Renders the content of @view, scaled to @width x @height, into a new
+ * buffer. Used for window switcher thumbnails and IPC thumbnail streams.
+ * Returns NULL on failure.
+ */
+struct wlr_buffer *osd_thumbnail_render(struct view *view, int width,
+	int height, const struct wlr_drm_format *format);
+
 /* Used by osd.c internally to render window switcher fields */
 void osd_field_get_content(struct window_switcher_field *field,
 	struct buf *buf, struct view *view);
@@ -4,6 +4,7 @@
 
 #include <wlr/types/wlr_output.h>
 #include "common/edge.h"
+#include "frame-timing.h"
 
 #define LAB_NR_LAYERS (4)
 
@@ -31,6 +32,7 @@ struct output {
 
 	struct wl_listener destroy;
 	struct wl_listener frame;
+	struct wl_listener present;
 	struct wl_listener request_state;
 
 	/*
@@ -46,6 +48,34 @@ struct output {
 	uint64_t id_bit;
 
 	bool gamma_lut_changed;
+
+	/* Last frames, see handle_output_frame() */
+	struct frame_timing timing;
+
+	/* Rendering held back for <core><maxRenderTime> */
+	struct {
+		struct wl_event_source *timer;
+		bool delayed;
+		/* Frame event that started the pending or last repaint */
+		uint64_t frame_ns;
+		/* From the last present event, 0 if unknown */
+		uint64_t present_ns;
+		uint64_t refresh_ns;
+	} repaint;
+
+	/* Magnifier as last drawn on this output, see magnifier.c */
+	struct {
+		/* Physical coordinates, empty if the magnifier is not shown */
+		struct wlr_box box;
+		/* Cursor position and scale it was drawn for, 0 if hidden */
+		double cursor_x, cursor_y;
+		double scale;
+		/*
+		 * Frames that reused the previous magnified image, plus frame
+		 * events that rendered nothing while the magnifier was shown
+		 */
+		uint64_t frames_skipped;
+	} magnifier;
 };
 
 #undef LAB_NR_LAYERS
@@ -2,7 +2,9 @@
 #ifndef LABWC_SCALED_BUFFER_H
 #define LABWC_SCALED_BUFFER_H
 
+#include <stdint.h>
 #include <wayland-server-core.h>
+#include "common/lru-cache.h"
 
 #define LAB_SCALED_BUFFER_MAX_CACHE 2
 
@@ -20,6 +22,17 @@ struct scaled_buffer_impl {
 	/* Returns true if the two buffers are visually the same */
 	bool (*equal)(struct scaled_buffer *scaled_buffer_a,
 		struct scaled_buffer *scaled_buffer_b);
+	/*
+	 * Required if equal is set. Returns a hash of everything compared
+	 * by equal(), so buffers which are equal hash the same.
+	 */
+	uint64_t (*hash)(struct scaled_buffer *scaled_buffer);
+	/*
+	 * Might be NULL, called after the buffer for a new scale was set.
+	 * Allows buffers which are cropped or stretched to override the
+	 * default destination size, the unscaled size of the buffer.
+	 */
+	void (*buffer_updated)(struct scaled_buffer *scaled_buffer);
 };
 
 struct scaled_buffer {
@@ -54,7 +67,8 @@ struct scaled_buffer {
  *    |        .------.       .--------------------------.   |   |
  *    |        | impl |       | wlr_buffer LRU cache of  |   |   |
  *    |        ´------`       |   other scaled_buffers   |   |   |
- *    |                       |   with impl->equal()     |   |   |
+ *    |                       | by impl, impl->hash()    |   |   |
+ *    |                       | and scale                |   |   |
  *    |                       ´--------------------------`   |   |
  *    |                          /              |            |   |
  *    |                   not found           found          |   |
@@ -84,9 +98,10 @@ struct scaled_buffer {
  * allocations.
  *
  * Besides caching buffers for each scale per scaled_buffer, we also
- * store all the scaled_buffers from all the implementers in a list
- * in order to reuse backing buffers for visually duplicated
- * scaled_buffers found via impl->equal().
+ * index the cached buffers of all the scaled_buffers from all the
+ * implementers by impl, impl->hash() and scale in order to reuse backing
+ * buffers for visually duplicated scaled_buffers, confirmed via
+ * impl->equal().
  *
  * All requested lab_data_buffers via impl->create_buffer() will be locked
  * during the lifetime of the buffer in the internal cache and unlocked
@@ -129,18 +144,30 @@ void scaled_buffer_request_update(struct scaled_buffer *self,
 	int width, int height);
 
 /**
- * scaled_buffer_invalidate_sharing - clear the list of entire cached
- * scaled_buffers used to share visually dupliated buffers. This should
+ * scaled_buffer_invalidate_sharing - clear the list and index of entire
+ * cached scaled_buffers used to share visually dupliated buffers. This should
  * be called on Reconfigure to force updates of newly created
  * scaled_buffers rather than reusing ones created before Reconfigure.
  */
 void scaled_buffer_invalidate_sharing(void);
 
+/**
+ * scaled_buffer_evict_inactive_scales - drop the cached buffers of all
+ * shared scaled_buffers (see above) except those for the scale they
+ * currently show. This should be called once outputs are gone, so buffers
+ * rendered for their scale don't linger in the LRU caches.
+ */
+void scaled_buffer_evict_inactive_scales(void);
+
 /* Private */
 struct scaled_buffer_cache_entry {
 	struct wl_list link;   /* struct scaled_buffer.cache */
 	struct wlr_buffer *buffer;
 	double scale;
+
+	/* Sharing index, only set for shared scaled_buffers */
+	struct scaled_buffer *owner;
+	struct lab_id_chain chain; /* chain.id is 0 if not indexed */
 };
 
 #endif /* LABWC_SCALED_BUFFER_H */
@@ -8,6 +8,7 @@
 struct wlr_scene_tree;
 struct wlr_scene_node;
 struct wlr_scene_buffer;
+struct icon_job;
 
 struct scaled_icon_buffer {
 	struct scaled_buffer *scaled_buffer;
@@ -30,6 +31,10 @@ struct scaled_icon_buffer {
 
 	int width;
 	int height;
+
+	/* Icon being loaded off the event loop, NULL if none */
+	struct icon_job *job;
+	struct wl_list job_link; /* icon_job.waiters */
 };
 
 /*
@@ -37,6 +42,10 @@ struct scaled_icon_buffer {
  * display. It gets destroyed automatically when the backing scaled_buffer
  * is being destroyed which in turn happens automatically when the backing
  * wlr_scene_buffer (or one of its parents) is being destroyed.
+ *
+ * Icons are shared through icon-cache.h. Those not cached yet are looked
+ * up and decoded on the icon loader threads, see desktop_entry_queue_work().
+ * The buffer stays empty until they arrive.
  */
 struct scaled_icon_buffer *scaled_icon_buffer_create(
 	struct wlr_scene_tree *parent, struct server *server,
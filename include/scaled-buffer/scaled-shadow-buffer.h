@@ -0,0 +1,43 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_SCALED_SHADOW_BUFFER_H
+#define LABWC_SCALED_SHADOW_BUFFER_H
+
+#include <wlr/util/box.h>
+#include "shadow-raster.h"
+
+struct wlr_scene_tree;
+struct wlr_scene_buffer;
+struct scaled_buffer;
+
+struct scaled_shadow_buffer {
+	struct scaled_buffer *scaled_buffer;
+	struct wlr_scene_buffer *scene_buffer;
+	/* key.scale is ignored, buffers are drawn for each output scale */
+	struct shadow_raster_key key;
+	/* Unscaled part of the buffer shown, empty for all of it */
+	struct wlr_fbox crop;
+	int dest_width;
+	int dest_height;
+};
+
+/*
+ * Create an auto scaling drop-shadow edge or corner, see shadow-raster.h.
+ * Buffers are shared with all other shadows of the same key and scale
+ * through scaled_buffer, so every window uses the same few buffers.
+ */
+struct scaled_shadow_buffer *scaled_shadow_buffer_create(
+	struct wlr_scene_tree *parent, const struct shadow_raster_key *key);
+
+/**
+ * scaled_shadow_buffer_set_geometry - crop and stretch the shadow
+ * @crop: unscaled part of the buffer to show, NULL for all of it
+ * @width: size of the node in scene coordinates
+ * @height: size of the node in scene coordinates
+ *
+ * Both are kept across scale changes, the crop is converted to the pixels
+ * of each buffer.
+ */
+void scaled_shadow_buffer_set_geometry(struct scaled_shadow_buffer *self,
+	const struct wlr_fbox *crop, int width, int height);
+
+#endif /* LABWC_SCALED_SHADOW_BUFFER_H */
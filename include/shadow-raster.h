@@ -0,0 +1,66 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_SHADOW_RASTER_H
+#define LABWC_SHADOW_RASTER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Window drop-shadow rasters in premultiplied ARGB8888. The Gaussian
+ * falloff is computed once per size into a 1D table and the pixels are
+ * generated from it with SSE2 or AVX2 where the CPU has them.
+ */
+
+struct shadow_raster_key {
+	/* Logical size of the shadow beyond the window and with the inset */
+	int visible_size;
+	int total_size;
+	/* Corners only: the height behind which nothing is erased, see below */
+	int titlebar_height;
+	/* Corner of total_size squared, else edge of visible_size by 1 */
+	bool corner;
+	/* Premultiplied RGBA */
+	float color[4];
+	float scale;
+};
+
+/*
+ * Size in pixels of the raster for @key, which is that of a buffer from
+ * buffer_create_cairo() with the logical size and scale of @key
+ */
+void shadow_raster_size(const struct shadow_raster_key *key, int *width,
+	int *height);
+
+/**
+ * shadow_raster_draw() - write the raster for @key
+ * @data: shadow_raster_size() pixels of memory, rows @stride bytes apart
+ *
+ * Edges are drawn as found at the right-hand side of a window, fading out
+ * to the right. Corners are drawn for the bottom-right, fading out from
+ * the top-left. The L-shaped part of a corner which would show through a
+ * translucent window below its titlebar is left clear.
+ *
+ * The last few rasters are cached, so drawing the same key again on a
+ * reconfigure only copies the pixels.
+ */
+void shadow_raster_draw(const struct shadow_raster_key *key, uint8_t *data,
+	int stride);
+
+void shadow_raster_cache_stats(uint64_t *hits, uint64_t *misses);
+
+/* The kernels, exposed for tests and benchmarks */
+
+/* Fills @lut with the falloff at i / @size for i = 0 .. @size - 1 */
+void shadow_falloff_lut(float *lut, int size);
+
+/*
+ * Writes @count pixels of @color faded by lut[i] * @weight. Picks the
+ * widest implementation the CPU supports.
+ */
+void shadow_fill_row(uint32_t *row, const float *lut, float weight,
+	int count, const float color[4]);
+/* Same result without SIMD */
+void shadow_fill_row_scalar(uint32_t *row, const float *lut, float weight,
+	int count, const float color[4]);
+
+#endif /* LABWC_SHADOW_RASTER_H */
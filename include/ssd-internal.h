@@ -122,7 +122,7 @@ struct ssd {
 		struct wlr_scene_tree *tree;
 		struct ssd_shadow_subtree {
 			struct wlr_scene_tree *tree;
-			struct wlr_scene_buffer *top, *bottom, *left, *right,
+			struct scaled_shadow_buffer *top, *bottom, *left, *right,
 				*top_left, *top_right, *bottom_left, *bottom_right;
 		} subtrees[2]; /* indexed by enum ssd_active_state */
 	} shadow;
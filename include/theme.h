@@ -125,10 +125,6 @@ struct theme {
 
 		struct lab_data_buffer *corner_top_left_normal;
 		struct lab_data_buffer *corner_top_right_normal;
-
-		struct lab_data_buffer *shadow_corner_top;
-		struct lab_data_buffer *shadow_corner_bottom;
-		struct lab_data_buffer *shadow_edge;
 	} window[2];
 
 	/* Derived from font sizes */
@@ -220,9 +216,30 @@ struct server;
  * @server: server
  * @theme_name: theme-name in <theme-dir>/<theme-name>/labwc/themerc
  * Note <theme-dir> is obtained in theme-dir.c
+ *
+ * The textures are generated in parallel on worker threads, this waits
+ * until they are all done.
  */
 void theme_init(struct theme *theme, struct server *server, const char *theme_name);
 
+/* Takes over @theme, to be released with theme_finish() and free() */
+typedef void (*theme_ready_func_t)(struct theme *theme, void *data);
+
+/**
+ * theme_build_async - like theme_init() but without waiting for textures
+ * @ready: called on the event loop with the new theme once it is complete
+ *
+ * The themerc files are read right away. Only one build may be running at
+ * a time, see server->theme_build. Until @ready is called, rc must not be
+ * re-read, as the workers still use it.
+ */
+void theme_build_async(struct server *server, const char *theme_name,
+	theme_ready_func_t ready, void *data);
+
+/* Set up and tear down the worker threads, cancelling a running build */
+void theme_builder_init(struct server *server);
+void theme_builder_finish(struct server *server);
+
 /**
  * theme_finish - free button textures
  * @theme: theme data
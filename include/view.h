@@ -85,6 +85,7 @@ enum view_wants_focus {
 struct view;
 struct wlr_surface;
 struct foreign_toplevel;
+struct timespec;
 
 /* Common to struct view and struct xwayland_unmanaged */
 struct mappable {
@@ -134,6 +135,12 @@ struct view {
 	const struct view_impl *impl;
 	struct wl_list link;
 
+	/*
+	 * Unique for the lifetime of the compositor and never reused, so
+	 * that it can be handed out to clients instead of pointers. Never 0.
+	 */
+	uint64_t id;
+
 	/*
 	 * The primary output that the view is displayed on. Specifically:
 	 *
@@ -221,6 +228,13 @@ struct view {
 	uint32_t pending_configure_serial;
 	struct wl_event_source *pending_configure_timeout;
 
+	/* Title changes waiting for the next frame, see view_set_title() */
+	struct {
+		bool pending;
+		struct wl_list link; /* server.pending_titles */
+		uint64_t last_publish_ms;
+	} title_update;
+
 	struct ssd *ssd;
 	struct resize_indicator {
 		int width, height;
@@ -305,6 +319,12 @@ struct xdg_toplevel_view {
  */
 struct view *view_from_wlr_surface(struct wlr_surface *surface);
 
+/**
+ * view_from_id() - returns the view with the given view->id, or NULL if
+ * there is no such view (anymore).
+ */
+struct view *view_from_id(struct server *server, uint64_t id);
+
 /**
  * view_query_create() - Create a new heap allocated view query with
  * all members initialized to their default values (window_type = -1,
@@ -566,7 +586,21 @@ bool view_on_output(struct view *view, struct output *output);
  */
 bool view_has_strut_partial(struct view *view);
 
+/*
+ * view_set_title() - set the title of the view
+ *
+ * view->title changes right away, but the SSD, foreign-toplevel handles
+ * and IPC clients only see the latest title once per frame of the view's
+ * output and at most every <core><titleUpdateInterval> milliseconds.
+ */
 void view_set_title(struct view *view, const char *title);
+void view_title_updates_init(struct server *server);
+void view_title_updates_finish(struct server *server);
+/* Publishes the titles due on a frame of @output, at @now */
+void view_publish_titles(struct server *server, struct output *output,
+	const struct timespec *now);
+/* Publishes pending titles of views on @output right away */
+void view_flush_titles(struct server *server, struct output *output);
 void view_set_app_id(struct view *view, const char *app_id);
 void view_reload_ssd(struct view *view);
 
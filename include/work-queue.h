@@ -0,0 +1,53 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_WORK_QUEUE_H
+#define LABWC_WORK_QUEUE_H
+
+#include <stdbool.h>
+
+struct wl_event_loop;
+struct work_queue;
+
+/* Runs on a worker thread, must not touch compositor state */
+typedef void (*work_func_t)(void *data);
+/* Runs on the event loop once the work is done */
+typedef void (*work_done_func_t)(void *data);
+
+/*
+ * Pool of worker threads for blocking jobs like decoding images from disk.
+ * Jobs are run in the order they were submitted. Their completions are
+ * posted back to the event loop through an eventfd, so done callbacks run
+ * on the compositor thread like any other event handler.
+ */
+
+/**
+ * work_queue_create() - create a pool of up to @max_threads workers
+ *
+ * Threads are started as jobs come in, so an idle queue costs nothing
+ * but the eventfd. Returns NULL if the eventfd could not be created.
+ */
+struct work_queue *work_queue_create(struct wl_event_loop *loop,
+	int max_threads);
+
+/**
+ * work_queue_submit() - run @work(@data) on a worker thread
+ *
+ * @done(@data) is called on the event loop afterwards. Jobs which are
+ * still queued when the queue is destroyed are not run, only @done is
+ * called for them, so it must also clean up after work that never ran.
+ */
+void work_queue_submit(struct work_queue *queue, work_func_t work,
+	work_done_func_t done, void *data);
+
+/**
+ * work_queue_flush() - wait until all submitted jobs are done
+ *
+ * Blocks the event loop until every job has run, then calls their done
+ * callbacks right away. Jobs submitted by those callbacks are waited for
+ * as well. Meant for startup, where there is nothing else to do yet.
+ */
+void work_queue_flush(struct work_queue *queue);
+
+/* Waits for running jobs and calls all pending done callbacks */
+void work_queue_destroy(struct work_queue *queue);
+
+#endif /* LABWC_WORK_QUEUE_H */
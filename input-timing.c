@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#define _POSIX_C_SOURCE 200809L
+#include "input-timing.h"
+#include <time.h>
+#include "common/macros.h"
+
+#define SUB_BUCKETS (1 << LATENCY_HISTOGRAM_SUB_BITS)
+
+uint64_t
+input_timing_now_ns(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/*
+ * Values below SUB_BUCKETS get a bucket each. Above that, every power of
+ * two is split into SUB_BUCKETS buckets by the bits after the leading one.
+ */
+static unsigned int
+bucket_index(uint64_t ns)
+{
+	if (ns < SUB_BUCKETS) {
+		return ns;
+	}
+	unsigned int octave = 63 - __builtin_clzll(ns);
+	unsigned int shift = octave - LATENCY_HISTOGRAM_SUB_BITS;
+	unsigned int sub = (ns >> shift) & (SUB_BUCKETS - 1);
+	unsigned int index = (shift + 1) * SUB_BUCKETS + sub;
+	return MIN(index, LATENCY_HISTOGRAM_BUCKETS - 1);
+}
+
+static uint64_t
+bucket_upper_bound(unsigned int index)
+{
+	if (index < SUB_BUCKETS) {
+		return index;
+	} else if (index == LATENCY_HISTOGRAM_BUCKETS - 1) {
+		/* Also holds everything that is too large for the others */
+		return UINT64_MAX;
+	}
+	unsigned int shift = index / SUB_BUCKETS - 1;
+	uint64_t lower = (uint64_t)(SUB_BUCKETS + index % SUB_BUCKETS) << shift;
+	return lower + ((uint64_t)1 << shift) - 1;
+}
+
+void
+latency_histogram_add(struct latency_histogram *histogram, uint64_t ns)
+{
+	histogram->buckets[bucket_index(ns)]++;
+	histogram->count++;
+	histogram->sum_ns += ns;
+	histogram->max_ns = MAX(histogram->max_ns, ns);
+}
+
+uint64_t
+latency_histogram_percentile(const struct latency_histogram *histogram,
+		unsigned int percentile)
+{
+	if (!histogram->count) {
+		return 0;
+	}
+	uint64_t rank = (histogram->count * MIN(percentile, 100) + 99) / 100;
+	uint64_t seen = 0;
+	for (unsigned int i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++) {
+		seen += histogram->buckets[i];
+		if (seen >= rank && seen) {
+			return MIN(bucket_upper_bound(i), histogram->max_ns);
+		}
+	}
+	return histogram->max_ns;
+}
@@ -0,0 +1,1093 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#define _POSIX_C_SOURCE 200809L
+#include "labwc-ipc-proto.h"
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wayland-util.h>
+#include "common/buf.h"
+#include "common/macros.h"
+#include "common/mem.h"
+#include "frame-timing.h"
+#include "input-timing.h"
+
+static const char *const window_event_names[] = {
+	[IPC_WINDOW_INFO] = "info",
+	[IPC_WINDOW_MAPPED] = "mapped",
+	[IPC_WINDOW_UNMAPPED] = "unmapped",
+	[IPC_WINDOW_CLOSED] = "closed",
+	[IPC_WINDOW_MOVED] = "moved",
+	[IPC_WINDOW_FOCUSED] = "focused",
+	[IPC_WINDOW_MINIMIZED] = "minimized",
+	[IPC_WINDOW_MAXIMIZED] = "maximized",
+	[IPC_WINDOW_FULLSCREEN] = "fullscreen",
+	[IPC_WINDOW_TITLE_CHANGED] = "title_changed",
+};
+
+static const struct {
+	const char *name;
+	enum ipc_command_type type;
+} command_names[] = {
+	{ "close", IPC_CMD_CLOSE },
+	{ "minimize", IPC_CMD_MINIMIZE },
+	{ "maximize", IPC_CMD_MAXIMIZE },
+	{ "move", IPC_CMD_MOVE },
+	{ "focus", IPC_CMD_FOCUS },
+	{ "always_on_top", IPC_CMD_ALWAYS_ON_TOP },
+	{ "always_on_bottom", IPC_CMD_ALWAYS_ON_BOTTOM },
+	{ "list", IPC_CMD_LIST },
+	{ "enable_decorations", IPC_CMD_ENABLE_DECORATIONS },
+	{ "protocol", IPC_CMD_PROTOCOL },
+	{ "shm", IPC_CMD_SHM },
+	{ "stats", IPC_CMD_STATS },
+	{ "subscribe_windows", IPC_CMD_SUBSCRIBE_WINDOWS },
+	{ "batch", IPC_CMD_BATCH },
+	{ "subscribe", IPC_CMD_SUBSCRIBE },
+	{ "thumbnail", IPC_CMD_THUMBNAIL },
+	{ "frame_timing", IPC_CMD_FRAME_TIMING },
+	{ "input_timing", IPC_CMD_INPUT_TIMING },
+};
+
+static const uint32_t window_event_masks[] = {
+	[IPC_WINDOW_MAPPED] = IPC_EVENT_MAPPED,
+	[IPC_WINDOW_UNMAPPED] = IPC_EVENT_MAPPED,
+	[IPC_WINDOW_CLOSED] = IPC_EVENT_CLOSED,
+	[IPC_WINDOW_MOVED] = IPC_EVENT_MOVED,
+	[IPC_WINDOW_FOCUSED] = IPC_EVENT_FOCUSED,
+	[IPC_WINDOW_MINIMIZED] = IPC_EVENT_STATE,
+	[IPC_WINDOW_MAXIMIZED] = IPC_EVENT_STATE,
+	[IPC_WINDOW_FULLSCREEN] = IPC_EVENT_STATE,
+	[IPC_WINDOW_TITLE_CHANGED] = IPC_EVENT_TITLE,
+};
+
+const char *
+ipc_window_event_name(enum ipc_window_event event)
+{
+	if ((size_t)event >= ARRAY_SIZE(window_event_names)) {
+		return "unknown";
+	}
+	return window_event_names[event];
+}
+
+uint32_t
+ipc_window_event_mask(enum ipc_window_event event)
+{
+	if ((size_t)event >= ARRAY_SIZE(window_event_masks)) {
+		return 0;
+	}
+	return window_event_masks[event];
+}
+
+void
+ipc_subscription_finish(struct ipc_subscription *sub)
+{
+	zfree(sub->app_id);
+	zfree(sub->output);
+}
+
+int
+ipc_json_encode_cursor(char *out, size_t size, double x, double y)
+{
+	return snprintf(out, size,
+		"{\"event\":\"cursor\",\"x\":%.0f,\"y\":%.0f}\n", x, y);
+}
+
+static void
+json_add_string(struct buf *out, const char *str)
+{
+	buf_add_char(out, '"');
+	for (const char *p = str; *p; p++) {
+		unsigned char c = *p;
+		if (c == '"' || c == '\\') {
+			buf_add_char(out, '\\');
+			buf_add_char(out, c);
+		} else if (c < 0x20) {
+			buf_add_fmt(out, "\\u%04x", c);
+		} else {
+			buf_add_char(out, c);
+		}
+	}
+	buf_add_char(out, '"');
+}
+
+static const char *
+json_bool(bool value)
+{
+	return value ? "true" : "false";
+}
+
+void
+ipc_json_encode_window_event(struct buf *out, enum ipc_window_event event,
+		const struct ipc_window_info *info)
+{
+	buf_add_fmt(out, "{\"event\":\"%s\",\"id\":\"%" PRIx64 "\",\"title\":",
+		ipc_window_event_name(event), info->id);
+	json_add_string(out, info->title);
+	buf_add(out, ",\"app_id\":");
+	json_add_string(out, info->app_id);
+	buf_add_fmt(out, ",\"x\":%d,\"y\":%d,\"width\":%d,\"height\":%d,"
+		"\"minimized\":%s,\"maximized\":%d,\"fullscreen\":%s,"
+		"\"focused\":%s}\n",
+		info->x, info->y, info->width, info->height,
+		json_bool(info->minimized), info->maximized,
+		json_bool(info->fullscreen), json_bool(info->focused));
+}
+
+int
+ipc_json_encode_shm(char *out, size_t size, uint32_t shm_size)
+{
+	return snprintf(out, size,
+		"{\"event\":\"shm\",\"size\":%u,\"version\":%d}\n",
+		shm_size, IPC_SHM_VERSION);
+}
+
+int
+ipc_json_encode_stats(char *out, size_t size, uint64_t queued,
+		uint64_t dropped, uint64_t coalesced)
+{
+	return snprintf(out, size,
+		"{\"event\":\"stats\",\"queued\":%" PRIu64 ","
+		"\"dropped\":%" PRIu64 ",\"coalesced\":%" PRIu64 "}\n",
+		queued, dropped, coalesced);
+}
+
+int
+ipc_json_encode_thumbnail(char *out, size_t size,
+		const struct ipc_thumbnail_info *info)
+{
+	static const char *const types[] = {
+		[IPC_THUMBNAIL_END] = "end",
+		[IPC_THUMBNAIL_SHM] = "shm",
+		[IPC_THUMBNAIL_DMABUF] = "dmabuf",
+	};
+	return snprintf(out, size,
+		"{\"event\":\"thumbnail\",\"id\":\"%" PRIx64 "\","
+		"\"type\":\"%s\",\"width\":%u,\"height\":%u,\"format\":%u,"
+		"\"modifier\":\"%" PRIx64 "\",\"offset\":%u,\"stride\":%u}\n",
+		info->id, types[info->type], info->width, info->height,
+		info->format, info->modifier, info->offset, info->stride);
+}
+
+int
+ipc_json_encode_batch_result(char *out, size_t size, uint32_t applied,
+		uint32_t failed)
+{
+	return snprintf(out, size,
+		"{\"event\":\"batch_result\",\"applied\":%u,\"failed\":%u}\n",
+		applied, failed);
+}
+
+static void
+json_latency(char *out, size_t size, const char *name,
+		const struct latency_histogram *histogram)
+{
+	uint64_t mean = histogram->count
+		? histogram->sum_ns / histogram->count : 0;
+	snprintf(out, size, "\"%s\":{\"count\":%" PRIu64
+		",\"mean_ns\":%" PRIu64 ",\"p50_ns\":%" PRIu64
+		",\"p95_ns\":%" PRIu64 ",\"p99_ns\":%" PRIu64
+		",\"max_ns\":%" PRIu64 "}", name, histogram->count, mean,
+		latency_histogram_percentile(histogram, 50),
+		latency_histogram_percentile(histogram, 95),
+		latency_histogram_percentile(histogram, 99),
+		histogram->max_ns);
+}
+
+int
+ipc_json_encode_input_timing(char *out, size_t size,
+		const struct latency_histogram *motion,
+		const struct latency_histogram *publish)
+{
+	char motion_json[256], publish_json[256];
+	json_latency(motion_json, sizeof(motion_json), "motion", motion);
+	json_latency(publish_json, sizeof(publish_json), "publish", publish);
+	return snprintf(out, size, "{\"event\":\"input_timing\",%s,%s}\n",
+		motion_json, publish_json);
+}
+
+void
+ipc_json_add_window(struct buf *out, const struct ipc_window_info *info)
+{
+	buf_add_fmt(out, "{\"id\":\"%" PRIx64 "\",\"title\":", info->id);
+	json_add_string(out, info->title);
+	buf_add(out, ",\"app_id\":");
+	json_add_string(out, info->app_id);
+	buf_add_fmt(out, ",\"x\":%d,\"y\":%d,\"width\":%d,\"height\":%d,"
+		"\"minimized\":%s,\"maximized\":%d,\"fullscreen\":%s,"
+		"\"focused\":%s}",
+		info->x, info->y, info->width, info->height,
+		json_bool(info->minimized), info->maximized,
+		json_bool(info->fullscreen), json_bool(info->focused));
+}
+
+void
+ipc_json_add_frame_timing(struct buf *out,
+		const struct ipc_frame_timing *timing)
+{
+	buf_add(out, "{\"name\":");
+	json_add_string(out, timing->output);
+	buf_add_fmt(out, ",\"frames\":%" PRIu64 ",\"skipped\":%" PRIu64
+		",\"magnifier_skipped\":%" PRIu64 ",\"samples\":[",
+		timing->frames, timing->skipped, timing->magnifier_skipped);
+	for (uint32_t i = 0; i < timing->nr_samples; i++) {
+		const struct frame_timing_sample *sample = &timing->samples[i];
+		buf_add_fmt(out, "%s[%" PRIu64 ",%" PRIu32 ",%" PRIu32 ",%"
+			PRIu32 ",%" PRId32 ",%d]", i ? "," : "",
+			sample->start_ns, sample->delay_us, sample->build_us,
+			sample->commit_us, sample->present_us, sample->skipped);
+	}
+	buf_add(out, "]}");
+}
+
+void
+ipc_json_encode_window_delta(struct buf *out, uint64_t generation,
+		uint32_t fields, const struct ipc_window_info *info)
+{
+	buf_add_fmt(out, "{\"event\":\"window_delta\",\"generation\":%" PRIu64
+		",\"id\":\"%" PRIx64 "\"", generation, info->id);
+	if (fields & IPC_WINDOW_REMOVED) {
+		buf_add(out, ",\"removed\":true}\n");
+		return;
+	}
+	if (fields & IPC_WINDOW_FIELD_TITLE) {
+		buf_add(out, ",\"title\":");
+		json_add_string(out, info->title);
+	}
+	if (fields & IPC_WINDOW_FIELD_APP_ID) {
+		buf_add(out, ",\"app_id\":");
+		json_add_string(out, info->app_id);
+	}
+	if (fields & IPC_WINDOW_FIELD_X) {
+		buf_add_fmt(out, ",\"x\":%d", info->x);
+	}
+	if (fields & IPC_WINDOW_FIELD_Y) {
+		buf_add_fmt(out, ",\"y\":%d", info->y);
+	}
+	if (fields & IPC_WINDOW_FIELD_WIDTH) {
+		buf_add_fmt(out, ",\"width\":%d", info->width);
+	}
+	if (fields & IPC_WINDOW_FIELD_HEIGHT) {
+		buf_add_fmt(out, ",\"height\":%d", info->height);
+	}
+	if (fields & IPC_WINDOW_FIELD_MINIMIZED) {
+		buf_add_fmt(out, ",\"minimized\":%s", json_bool(info->minimized));
+	}
+	if (fields & IPC_WINDOW_FIELD_MAXIMIZED) {
+		buf_add_fmt(out, ",\"maximized\":%d", info->maximized);
+	}
+	if (fields & IPC_WINDOW_FIELD_FULLSCREEN) {
+		buf_add_fmt(out, ",\"fullscreen\":%s",
+			json_bool(info->fullscreen));
+	}
+	if (fields & IPC_WINDOW_FIELD_FOCUSED) {
+		buf_add_fmt(out, ",\"focused\":%s", json_bool(info->focused));
+	}
+	buf_add(out, "}\n");
+}
+
+/* Returns the closing quote of the string starting at @p, or NULL */
+static const char *
+json_string_end(const char *p)
+{
+	for (p++; *p; p++) {
+		if (*p == '\\' && p[1]) {
+			p++;
+		} else if (*p == '"') {
+			return p;
+		}
+	}
+	return NULL;
+}
+
+/* Returns the bracket closing the object or array starting at @p */
+static const char *
+json_container_end(const char *p)
+{
+	int depth = 0;
+	for (; *p; p++) {
+		switch (*p) {
+		case '{':
+		case '[':
+			depth++;
+			break;
+		case '}':
+		case ']':
+			if (!--depth) {
+				return p;
+			}
+			break;
+		case '"':
+			p = json_string_end(p);
+			if (!p) {
+				return NULL;
+			}
+			break;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Returns a pointer to the value of "key" in the outermost JSON object, or
+ * NULL. Members of nested objects are skipped, so that the operations of
+ * a batch do not shadow the keys of the batch itself.
+ */
+static const char *
+json_find_value(const char *line, const char *key)
+{
+	size_t key_len = strlen(key);
+	int depth = 0;
+	for (const char *p = line; *p; p++) {
+		switch (*p) {
+		case '{':
+		case '[':
+			depth++;
+			continue;
+		case '}':
+		case ']':
+			depth--;
+			continue;
+		case '"':
+			break;
+		default:
+			continue;
+		}
+
+		const char *start = p + 1;
+		p = json_string_end(p);
+		if (!p) {
+			return NULL;
+		}
+		if (depth != 1 || (size_t)(p - start) != key_len
+				|| strncmp(start, key, key_len)) {
+			continue;
+		}
+		const char *value = p + 1;
+		while (*value == ' ') {
+			value++;
+		}
+		if (*value != ':') {
+			/* A string value that happens to equal the key */
+			continue;
+		}
+		value++;
+		while (*value == ' ') {
+			value++;
+		}
+		return value;
+	}
+	return NULL;
+}
+
+static bool
+json_get_hex4(const char *p, uint32_t *out)
+{
+	*out = 0;
+	for (int i = 0; i < 4; i++) {
+		char c = p[i];
+		uint32_t digit;
+		if (c >= '0' && c <= '9') {
+			digit = c - '0';
+		} else if (c >= 'a' && c <= 'f') {
+			digit = c - 'a' + 10;
+		} else if (c >= 'A' && c <= 'F') {
+			digit = c - 'A' + 10;
+		} else {
+			return false;
+		}
+		*out = *out << 4 | digit;
+	}
+	return true;
+}
+
+/*
+ * Decodes the \uXXXX escape (or surrogate pair) at @p, which points to the
+ * 'u', into UTF-8. Advances @p to its last character and returns the number
+ * of bytes written to @utf8, or 0 if the escape is invalid. U+0000 is
+ * rejected as it cannot be represented in a C string.
+ */
+static size_t
+json_decode_unicode(const char **p, char utf8[4])
+{
+	uint32_t cp;
+	if (!json_get_hex4(*p + 1, &cp) || !cp) {
+		return 0;
+	}
+	*p += 4;
+	if (cp >= 0xd800 && cp <= 0xdbff) {
+		uint32_t low;
+		if ((*p)[1] != '\\' || (*p)[2] != 'u'
+				|| !json_get_hex4(*p + 3, &low)
+				|| low < 0xdc00 || low > 0xdfff) {
+			return 0;
+		}
+		*p += 6;
+		cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+	} else if (cp >= 0xdc00 && cp <= 0xdfff) {
+		return 0;
+	}
+
+	if (cp < 0x80) {
+		utf8[0] = cp;
+		return 1;
+	} else if (cp < 0x800) {
+		utf8[0] = 0xc0 | cp >> 6;
+		utf8[1] = 0x80 | (cp & 0x3f);
+		return 2;
+	} else if (cp < 0x10000) {
+		utf8[0] = 0xe0 | cp >> 12;
+		utf8[1] = 0x80 | (cp >> 6 & 0x3f);
+		utf8[2] = 0x80 | (cp & 0x3f);
+		return 3;
+	}
+	utf8[0] = 0xf0 | cp >> 18;
+	utf8[1] = 0x80 | (cp >> 12 & 0x3f);
+	utf8[2] = 0x80 | (cp >> 6 & 0x3f);
+	utf8[3] = 0x80 | (cp & 0x3f);
+	return 4;
+}
+
+/*
+ * Copies the string value of "key" to @out with escape sequences decoded.
+ * Returns false if the value is missing, not a valid string or does not
+ * fit into @size bytes including the terminator.
+ */
+static bool
+json_get_string(const char *line, const char *key, char *out, size_t size)
+{
+	const char *p = json_find_value(line, key);
+	if (!p || *p != '"') {
+		return false;
+	}
+	size_t len = 0;
+	for (p++; *p != '"'; p++) {
+		if (!*p) {
+			return false;
+		}
+		char decoded[4] = { *p };
+		size_t n = 1;
+		if (*p == '\\') {
+			switch (*++p) {
+			case '"':
+			case '\\':
+			case '/':
+				decoded[0] = *p;
+				break;
+			case 'b':
+				decoded[0] = '\b';
+				break;
+			case 'f':
+				decoded[0] = '\f';
+				break;
+			case 'n':
+				decoded[0] = '\n';
+				break;
+			case 'r':
+				decoded[0] = '\r';
+				break;
+			case 't':
+				decoded[0] = '\t';
+				break;
+			case 'u':
+				n = json_decode_unicode(&p, decoded);
+				if (!n) {
+					return false;
+				}
+				break;
+			default:
+				return false;
+			}
+		}
+		if (len + n >= size) {
+			return false;
+		}
+		memcpy(out + len, decoded, n);
+		len += n;
+	}
+	out[len] = '\0';
+	return true;
+}
+
+static void
+json_get_int(const char *line, const char *key, int32_t *out)
+{
+	const char *p = json_find_value(line, key);
+	if (p) {
+		*out = (int32_t)strtol(p, NULL, 10);
+	}
+}
+
+bool
+ipc_json_parse_command(const char *line, struct ipc_command *cmd)
+{
+	*cmd = (struct ipc_command){0};
+
+	char name[64];
+	if (!json_get_string(line, "cmd", name, sizeof(name))) {
+		return false;
+	}
+	for (size_t i = 0; i < ARRAY_SIZE(command_names); i++) {
+		if (!strcmp(name, command_names[i].name)) {
+			cmd->type = command_names[i].type;
+			break;
+		}
+	}
+	if (cmd->type == IPC_CMD_NONE) {
+		return false;
+	}
+
+	/* View ids are sent as hex strings, e.g. "id":"5612a3c0" */
+	char id[32];
+	if (json_get_string(line, "id", id, sizeof(id))) {
+		cmd->id = strtoull(id, NULL, 16);
+	}
+	json_get_int(line, "x", &cmd->x);
+	json_get_int(line, "y", &cmd->y);
+	json_get_int(line, "width", &cmd->width);
+	json_get_int(line, "height", &cmd->height);
+
+	int32_t rate = 0;
+	json_get_int(line, "rate", &rate);
+	cmd->rate = MAX(rate, 0);
+
+	char mode[16];
+	if (json_get_string(line, "mode", mode, sizeof(mode))
+			&& !strcmp(mode, "binary")) {
+		cmd->mode = IPC_PROTO_BINARY;
+	}
+	return true;
+}
+
+bool
+ipc_json_parse_subscribe(const char *line, struct ipc_subscription *sub)
+{
+	*sub = (struct ipc_subscription){ .events = IPC_EVENT_ALL };
+	int32_t events = IPC_EVENT_ALL;
+	json_get_int(line, "events", &events);
+	sub->events = (uint32_t)events & IPC_EVENT_ALL;
+
+	char filter[IPC_FILTER_MAX_LEN + 1];
+	if (json_find_value(line, "app_id")) {
+		if (!json_get_string(line, "app_id", filter, sizeof(filter))) {
+			return false;
+		}
+		sub->app_id = xstrdup(filter);
+	}
+	if (json_find_value(line, "output")) {
+		if (!json_get_string(line, "output", filter, sizeof(filter))) {
+			ipc_subscription_finish(sub);
+			return false;
+		}
+		sub->output = xstrdup(filter);
+	}
+	return true;
+}
+
+bool
+ipc_command_is_view_command(enum ipc_command_type type)
+{
+	switch (type) {
+	case IPC_CMD_CLOSE:
+	case IPC_CMD_MINIMIZE:
+	case IPC_CMD_MAXIMIZE:
+	case IPC_CMD_MOVE:
+	case IPC_CMD_FOCUS:
+	case IPC_CMD_ALWAYS_ON_TOP:
+	case IPC_CMD_ALWAYS_ON_BOTTOM:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static struct ipc_command *
+add_op(struct wl_array *ops)
+{
+	if (ops->size / sizeof(struct ipc_command) >= IPC_BATCH_MAX_OPS) {
+		return NULL;
+	}
+	struct ipc_command *op = wl_array_add(ops, sizeof(*op));
+	die_if_null(op);
+	return op;
+}
+
+bool
+ipc_json_parse_batch(const char *line, struct wl_array *ops)
+{
+	const char *p = json_find_value(line, "ops");
+	if (!p || *p != '[') {
+		return false;
+	}
+	for (p++; *p; p++) {
+		if (*p == ' ' || *p == ',') {
+			continue;
+		}
+		if (*p == ']') {
+			return true;
+		}
+		if (*p != '{') {
+			return false;
+		}
+		const char *end = json_container_end(p);
+		if (!end) {
+			return false;
+		}
+
+		/* Operations are flat objects of a few dozen bytes */
+		char obj[256];
+		size_t len = end + 1 - p;
+		if (len >= sizeof(obj)) {
+			return false;
+		}
+		memcpy(obj, p, len);
+		obj[len] = '\0';
+
+		struct ipc_command *op = add_op(ops);
+		if (!op || !ipc_json_parse_command(obj, op)
+				|| !ipc_command_is_view_command(op->type)) {
+			return false;
+		}
+		p = end;
+	}
+	return false;
+}
+
+static inline uint8_t *
+put_le16(uint8_t *p, uint16_t v)
+{
+	p[0] = v & 0xff;
+	p[1] = v >> 8;
+	return p + 2;
+}
+
+static inline uint8_t *
+put_le32(uint8_t *p, uint32_t v)
+{
+	p[0] = v & 0xff;
+	p[1] = (v >> 8) & 0xff;
+	p[2] = (v >> 16) & 0xff;
+	p[3] = v >> 24;
+	return p + 4;
+}
+
+static inline uint8_t *
+put_le64(uint8_t *p, uint64_t v)
+{
+	p = put_le32(p, (uint32_t)v);
+	return put_le32(p, (uint32_t)(v >> 32));
+}
+
+static inline uint32_t
+get_le32(const uint8_t *p)
+{
+	return (uint32_t)p[0] | (uint32_t)p[1] << 8
+		| (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static inline uint64_t
+get_le64(const uint8_t *p)
+{
+	return (uint64_t)get_le32(p) | (uint64_t)get_le32(p + 4) << 32;
+}
+
+static uint8_t *
+array_grow(struct wl_array *out, size_t len)
+{
+	uint8_t *p = wl_array_add(out, len);
+	die_if_null(p);
+	return p;
+}
+
+/* Appends a frame header and returns a pointer to its payload */
+static uint8_t *
+frame_add(struct wl_array *out, enum ipc_msg_type type, uint32_t payload_len)
+{
+	uint8_t *p = array_grow(out, IPC_FRAME_HEADER_SIZE + payload_len);
+	p = put_le32(p, payload_len);
+	p = put_le16(p, type);
+	return put_le16(p, 0);
+}
+
+void
+ipc_bin_encode_hello(struct wl_array *out)
+{
+	uint8_t *p = frame_add(out, IPC_MSG_HELLO, 4);
+	put_le32(p, IPC_PROTO_VERSION);
+}
+
+void
+ipc_bin_encode_notice(struct wl_array *out, enum ipc_notice notice)
+{
+	uint8_t *p = frame_add(out, IPC_MSG_NOTICE, 4);
+	put_le32(p, notice);
+}
+
+void
+ipc_bin_encode_cursor(struct wl_array *out, double x, double y)
+{
+	uint8_t *p = frame_add(out, IPC_MSG_CURSOR, 8);
+	p = put_le32(p, (uint32_t)(int32_t)lround(x));
+	put_le32(p, (uint32_t)(int32_t)lround(y));
+}
+
+void
+ipc_bin_encode_shm(struct wl_array *out, uint32_t size)
+{
+	uint8_t *p = frame_add(out, IPC_MSG_SHM, 8);
+	p = put_le32(p, size);
+	put_le32(p, IPC_SHM_VERSION);
+}
+
+void
+ipc_bin_encode_batch_result(struct wl_array *out, uint32_t applied,
+		uint32_t failed)
+{
+	uint8_t *p = frame_add(out, IPC_MSG_BATCH_RESULT, 8);
+	p = put_le32(p, applied);
+	put_le32(p, failed);
+}
+
+static uint8_t *
+put_latency(uint8_t *p, const struct latency_histogram *histogram)
+{
+	uint64_t mean = histogram->count
+		? histogram->sum_ns / histogram->count : 0;
+	p = put_le64(p, histogram->count);
+	p = put_le64(p, mean);
+	p = put_le64(p, latency_histogram_percentile(histogram, 50));
+	p = put_le64(p, latency_histogram_percentile(histogram, 95));
+	p = put_le64(p, latency_histogram_percentile(histogram, 99));
+	return put_le64(p, histogram->max_ns);
+}
+
+void
+ipc_bin_encode_input_timing(struct wl_array *out,
+		const struct latency_histogram *motion,
+		const struct latency_histogram *publish)
+{
+	uint8_t *p = frame_add(out, IPC_MSG_INPUT_TIMING,
+		2 * IPC_INPUT_TIMING_RECORD_SIZE);
+	p = put_latency(p, motion);
+	put_latency(p, publish);
+}
+
+void
+ipc_bin_encode_thumbnail(struct wl_array *out,
+		const struct ipc_thumbnail_info *info)
+{
+	uint8_t *p = frame_add(out, IPC_MSG_THUMBNAIL, 40);
+	p = put_le64(p, info->id);
+	p = put_le64(p, info->modifier);
+	p = put_le32(p, info->type);
+	p = put_le32(p, info->width);
+	p = put_le32(p, info->height);
+	p = put_le32(p, info->format);
+	p = put_le32(p, info->offset);
+	put_le32(p, info->stride);
+}
+
+void
+ipc_bin_encode_stats(struct wl_array *out, uint64_t queued, uint64_t dropped,
+		uint64_t coalesced)
+{
+	uint8_t *p = frame_add(out, IPC_MSG_STATS, 24);
+	p = put_le64(p, queued);
+	p = put_le64(p, dropped);
+	put_le64(p, coalesced);
+}
+
+static size_t
+window_record_size(const struct ipc_window_info *info, uint16_t *title_len,
+		uint16_t *app_id_len)
+{
+	*title_len = MIN(strlen(info->title), UINT16_MAX);
+	*app_id_len = MIN(strlen(info->app_id), UINT16_MAX);
+	return IPC_WINDOW_RECORD_SIZE + *title_len + *app_id_len;
+}
+
+static void
+window_record_write(uint8_t *p, enum ipc_window_event event,
+		const struct ipc_window_info *info, uint16_t title_len,
+		uint16_t app_id_len)
+{
+	uint8_t flags = 0;
+	if (info->minimized) {
+		flags |= IPC_WINDOW_FLAG_MINIMIZED;
+	}
+	if (info->fullscreen) {
+		flags |= IPC_WINDOW_FLAG_FULLSCREEN;
+	}
+	if (info->focused) {
+		flags |= IPC_WINDOW_FLAG_FOCUSED;
+	}
+
+	p = put_le64(p, info->id);
+	p = put_le32(p, (uint32_t)info->x);
+	p = put_le32(p, (uint32_t)info->y);
+	p = put_le32(p, (uint32_t)info->width);
+	p = put_le32(p, (uint32_t)info->height);
+	*p++ = event;
+	*p++ = flags;
+	*p++ = info->maximized;
+	*p++ = 0;
+	p = put_le16(p, title_len);
+	p = put_le16(p, app_id_len);
+	memcpy(p, info->title, title_len);
+	memcpy(p + title_len, info->app_id, app_id_len);
+}
+
+void
+ipc_bin_encode_window_event(struct wl_array *out,
+		enum ipc_window_event event, const struct ipc_window_info *info)
+{
+	uint16_t title_len, app_id_len;
+	size_t size = window_record_size(info, &title_len, &app_id_len);
+	uint8_t *p = frame_add(out, IPC_MSG_WINDOW_EVENT, size);
+	window_record_write(p, event, info, title_len, app_id_len);
+}
+
+size_t
+ipc_bin_window_list_begin(struct wl_array *out)
+{
+	size_t start = out->size;
+	uint8_t *p = frame_add(out, IPC_MSG_WINDOW_LIST, 8);
+	memset(p, 0, 8);
+	return start;
+}
+
+void
+ipc_bin_window_list_add(struct wl_array *out,
+		const struct ipc_window_info *info)
+{
+	uint16_t title_len, app_id_len;
+	size_t size = window_record_size(info, &title_len, &app_id_len);
+	uint8_t *p = array_grow(out, size);
+	window_record_write(p, IPC_WINDOW_INFO, info, title_len, app_id_len);
+}
+
+size_t
+ipc_bin_window_snapshot_begin(struct wl_array *out, uint64_t generation)
+{
+	size_t start = out->size;
+	uint8_t *p = frame_add(out, IPC_MSG_WINDOW_SNAPSHOT, 16);
+	memset(p, 0, 8);
+	put_le64(p + 8, generation);
+	return start;
+}
+
+size_t
+ipc_bin_frame_timing_begin(struct wl_array *out)
+{
+	size_t start = out->size;
+	uint8_t *p = frame_add(out, IPC_MSG_FRAME_TIMING, 8);
+	memset(p, 0, 8);
+	return start;
+}
+
+void
+ipc_bin_frame_timing_add(struct wl_array *out,
+		const struct ipc_frame_timing *timing)
+{
+	uint16_t name_len = MIN(strlen(timing->output), UINT16_MAX);
+	uint8_t *p = array_grow(out,
+		32 + name_len + (size_t)timing->nr_samples * 28);
+	p = put_le16(p, name_len);
+	p = put_le16(p, 0);
+	p = put_le32(p, timing->nr_samples);
+	p = put_le64(p, timing->frames);
+	p = put_le64(p, timing->skipped);
+	p = put_le64(p, timing->magnifier_skipped);
+	memcpy(p, timing->output, name_len);
+	p += name_len;
+	for (uint32_t i = 0; i < timing->nr_samples; i++) {
+		const struct frame_timing_sample *sample = &timing->samples[i];
+		p = put_le64(p, sample->start_ns);
+		p = put_le32(p, sample->delay_us);
+		p = put_le32(p, sample->build_us);
+		p = put_le32(p, sample->commit_us);
+		p = put_le32(p, (uint32_t)sample->present_us);
+		p = put_le32(p, sample->skipped);
+	}
+}
+
+void
+ipc_bin_frame_end(struct wl_array *out, size_t start, uint32_t count)
+{
+	uint8_t *frame = (uint8_t *)out->data + start;
+	size_t payload_len = out->size - start - IPC_FRAME_HEADER_SIZE;
+	put_le32(frame, (uint32_t)payload_len);
+	put_le32(frame + IPC_FRAME_HEADER_SIZE, count);
+}
+
+void
+ipc_bin_encode_window_delta(struct wl_array *out, uint64_t generation,
+		uint32_t fields, const struct ipc_window_info *info)
+{
+	uint16_t title_len = 0, app_id_len = 0;
+	size_t size = 24;
+	if (fields & IPC_WINDOW_FIELD_TITLE) {
+		title_len = MIN(strlen(info->title), UINT16_MAX);
+		size += 2 + title_len;
+	}
+	if (fields & IPC_WINDOW_FIELD_APP_ID) {
+		app_id_len = MIN(strlen(info->app_id), UINT16_MAX);
+		size += 2 + app_id_len;
+	}
+	const uint32_t i32_fields = IPC_WINDOW_FIELD_X | IPC_WINDOW_FIELD_Y
+		| IPC_WINDOW_FIELD_WIDTH | IPC_WINDOW_FIELD_HEIGHT;
+	const uint32_t u8_fields = IPC_WINDOW_FIELD_MINIMIZED
+		| IPC_WINDOW_FIELD_MAXIMIZED | IPC_WINDOW_FIELD_FULLSCREEN
+		| IPC_WINDOW_FIELD_FOCUSED;
+	size += 4 * __builtin_popcount(fields & i32_fields);
+	size += __builtin_popcount(fields & u8_fields);
+
+	uint8_t *p = frame_add(out, IPC_MSG_WINDOW_DELTA, size);
+	p = put_le64(p, generation);
+	p = put_le64(p, info->id);
+	p = put_le32(p, fields);
+	p = put_le32(p, 0);
+	if (fields & IPC_WINDOW_FIELD_TITLE) {
+		p = put_le16(p, title_len);
+		memcpy(p, info->title, title_len);
+		p += title_len;
+	}
+	if (fields & IPC_WINDOW_FIELD_APP_ID) {
+		p = put_le16(p, app_id_len);
+		memcpy(p, info->app_id, app_id_len);
+		p += app_id_len;
+	}
+	if (fields & IPC_WINDOW_FIELD_X) {
+		p = put_le32(p, (uint32_t)info->x);
+	}
+	if (fields & IPC_WINDOW_FIELD_Y) {
+		p = put_le32(p, (uint32_t)info->y);
+	}
+	if (fields & IPC_WINDOW_FIELD_WIDTH) {
+		p = put_le32(p, (uint32_t)info->width);
+	}
+	if (fields & IPC_WINDOW_FIELD_HEIGHT) {
+		p = put_le32(p, (uint32_t)info->height);
+	}
+	if (fields & IPC_WINDOW_FIELD_MINIMIZED) {
+		*p++ = info->minimized;
+	}
+	if (fields & IPC_WINDOW_FIELD_MAXIMIZED) {
+		*p++ = info->maximized;
+	}
+	if (fields & IPC_WINDOW_FIELD_FULLSCREEN) {
+		*p++ = info->fullscreen;
+	}
+	if (fields & IPC_WINDOW_FIELD_FOCUSED) {
+		*p++ = info->focused;
+	}
+}
+
+ssize_t
+ipc_bin_decode_frame(const uint8_t *data, size_t len, uint16_t *type,
+		const uint8_t **payload, uint32_t *payload_len)
+{
+	if (len < IPC_FRAME_HEADER_SIZE) {
+		return 0;
+	}
+	uint32_t plen = get_le32(data);
+	if (plen > IPC_FRAME_MAX_PAYLOAD || data[6] || data[7]) {
+		return -1;
+	}
+	if (len < IPC_FRAME_HEADER_SIZE + plen) {
+		return 0;
+	}
+	*type = (uint16_t)(data[4] | data[5] << 8);
+	*payload = data + IPC_FRAME_HEADER_SIZE;
+	*payload_len = plen;
+	return IPC_FRAME_HEADER_SIZE + plen;
+}
+
+bool
+ipc_bin_decode_command(const uint8_t *payload, uint32_t len,
+		struct ipc_command *cmd)
+{
+	if (len < IPC_COMMAND_RECORD_SIZE) {
+		return false;
+	}
+	uint32_t type = get_le32(payload);
+	if (type == IPC_CMD_NONE || type >= IPC_CMD_COUNT) {
+		return false;
+	}
+	*cmd = (struct ipc_command){
+		.type = type,
+		.mode = get_le32(payload + 4) == IPC_PROTO_BINARY
+			? IPC_PROTO_BINARY : IPC_PROTO_JSON,
+		.rate = get_le32(payload + 4),
+		.id = get_le64(payload + 8),
+		.x = (int32_t)get_le32(payload + 16),
+		.y = (int32_t)get_le32(payload + 20),
+		.width = (int32_t)get_le32(payload + 24),
+		.height = (int32_t)get_le32(payload + 28),
+	};
+	return true;
+}
+
+bool
+ipc_bin_decode_batch(const uint8_t *payload, uint32_t len,
+		struct wl_array *ops)
+{
+	if (len < IPC_COMMAND_RECORD_SIZE || len % IPC_COMMAND_RECORD_SIZE) {
+		return false;
+	}
+	/* The first record is the batch command itself */
+	for (uint32_t offset = IPC_COMMAND_RECORD_SIZE; offset < len;
+			offset += IPC_COMMAND_RECORD_SIZE) {
+		struct ipc_command *op = add_op(ops);
+		if (!op || !ipc_bin_decode_command(payload + offset,
+				IPC_COMMAND_RECORD_SIZE, op)
+				|| !ipc_command_is_view_command(op->type)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/* Reads an optional u16 length prefixed string, NULL if it is empty */
+static bool
+decode_filter(const uint8_t **p, const uint8_t *end, char **out)
+{
+	if (*p == end) {
+		return true;
+	}
+	if (end - *p < 2) {
+		return false;
+	}
+	uint16_t len = (*p)[0] | (*p)[1] << 8;
+	*p += 2;
+	if (len > IPC_FILTER_MAX_LEN || end - *p < len) {
+		return false;
+	}
+	if (len) {
+		*out = xzalloc(len + 1);
+		memcpy(*out, *p, len);
+	}
+	*p += len;
+	return true;
+}
+
+bool
+ipc_bin_decode_subscribe(const uint8_t *payload, uint32_t len,
+		struct ipc_subscription *sub)
+{
+	*sub = (struct ipc_subscription){0};
+	if (len < IPC_COMMAND_RECORD_SIZE) {
+		return false;
+	}
+	sub->events = get_le32(payload + 4) & IPC_EVENT_ALL;
+
+	const uint8_t *p = payload + IPC_COMMAND_RECORD_SIZE;
+	const uint8_t *end = payload + len;
+	if (!decode_filter(&p, end, &sub->app_id)
+			|| !decode_filter(&p, end, &sub->output) || p != end) {
+		ipc_subscription_finish(sub);
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,184 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#define _POSIX_C_SOURCE 200809L
+#include "labwc-ipc-queue.h"
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include "common/macros.h"
+#include "common/mem.h"
+
+struct ipc_pending_moved {
+	uint64_t view_id;
+	char *data;
+	size_t len;
+};
+
+void
+ipc_out_queue_init(struct ipc_out_queue *queue, size_t size)
+{
+	*queue = (struct ipc_out_queue){
+		.ring = xmalloc(size),
+		.size = size,
+	};
+	wl_array_init(&queue->moved);
+}
+
+void
+ipc_out_queue_finish(struct ipc_out_queue *queue)
+{
+	struct ipc_pending_moved *moved;
+	wl_array_for_each(moved, &queue->moved) {
+		free(moved->data);
+	}
+	wl_array_release(&queue->moved);
+	zfree(queue->ring);
+}
+
+bool
+ipc_out_queue_is_empty(struct ipc_out_queue *queue)
+{
+	return !queue->len && !queue->cursor_len && !queue->moved.size;
+}
+
+size_t
+ipc_out_queue_pending(struct ipc_out_queue *queue)
+{
+	size_t pending = queue->len + queue->cursor_len;
+	struct ipc_pending_moved *moved;
+	wl_array_for_each(moved, &queue->moved) {
+		pending += moved->len;
+	}
+	return pending;
+}
+
+static bool
+ring_append(struct ipc_out_queue *queue, const void *data, size_t len)
+{
+	if (len > queue->size - queue->len) {
+		return false;
+	}
+	size_t tail = (queue->head + queue->len) % queue->size;
+	size_t first = MIN(len, queue->size - tail);
+	memcpy(queue->ring + tail, data, first);
+	memcpy(queue->ring, (const char *)data + first, len - first);
+	queue->len += len;
+	return true;
+}
+
+static void
+append_or_drop(struct ipc_out_queue *queue, const void *data, size_t len)
+{
+	if (!ring_append(queue, data, len)) {
+		queue->nr_dropped++;
+	}
+}
+
+/* Moves held-back "moved" events into the ring, all views if view_id is 0 */
+static void
+release_moved(struct ipc_out_queue *queue, uint64_t view_id)
+{
+	struct ipc_pending_moved *moved = queue->moved.data;
+	size_t count = queue->moved.size / sizeof(*moved);
+	size_t kept = 0;
+	for (size_t i = 0; i < count; i++) {
+		if (view_id && moved[i].view_id != view_id) {
+			moved[kept++] = moved[i];
+			continue;
+		}
+		append_or_drop(queue, moved[i].data, moved[i].len);
+		free(moved[i].data);
+	}
+	queue->moved.size = kept * sizeof(*moved);
+}
+
+static void
+release_cursor(struct ipc_out_queue *queue)
+{
+	if (queue->cursor_len) {
+		append_or_drop(queue, queue->cursor, queue->cursor_len);
+		queue->cursor_len = 0;
+	}
+}
+
+static void
+hold_moved(struct ipc_out_queue *queue, uint64_t view_id, const void *data,
+		size_t len)
+{
+	struct ipc_pending_moved *moved;
+	wl_array_for_each(moved, &queue->moved) {
+		if (moved->view_id == view_id) {
+			queue->nr_coalesced++;
+			free(moved->data);
+			goto store;
+		}
+	}
+	moved = wl_array_add(&queue->moved, sizeof(*moved));
+	die_if_null(moved);
+	moved->view_id = view_id;
+store:
+	moved->data = xmalloc(len);
+	memcpy(moved->data, data, len);
+	moved->len = len;
+}
+
+void
+ipc_out_queue_push(struct ipc_out_queue *queue, const struct ipc_msg_key *key,
+		const void *data, size_t len)
+{
+	switch (key->type) {
+	case IPC_MSG_CURSOR:
+		if (len <= sizeof(queue->cursor)) {
+			if (queue->cursor_len) {
+				queue->nr_coalesced++;
+			}
+			memcpy(queue->cursor, data, len);
+			queue->cursor_len = len;
+			return;
+		}
+		break;
+	case IPC_MSG_WINDOW_EVENT:
+		if (key->event == IPC_WINDOW_MOVED) {
+			hold_moved(queue, key->view_id, data, len);
+			return;
+		}
+		/* Keep the view's earlier "moved" in front of this event */
+		release_moved(queue, key->view_id);
+		break;
+	case IPC_MSG_WINDOW_LIST:
+		release_moved(queue, 0);
+		break;
+	default:
+		break;
+	}
+	append_or_drop(queue, data, len);
+}
+
+bool
+ipc_out_queue_push_tail(struct ipc_out_queue *queue, const void *data,
+		size_t len)
+{
+	return ring_append(queue, data, len);
+}
+
+int
+ipc_out_queue_flush(struct ipc_out_queue *queue, int fd)
+{
+	for (;;) {
+		while (queue->len) {
+			size_t chunk = MIN(queue->len, queue->size - queue->head);
+			ssize_t written = write(fd, queue->ring + queue->head,
+				chunk);
+			if (written < 0) {
+				return errno == EAGAIN ? 1 : -1;
+			}
+			queue->head = (queue->head + written) % queue->size;
+			queue->len -= written;
+		}
+		queue->head = 0;
+		if (!queue->cursor_len && !queue->moved.size) {
+			return 0;
+		}
+		release_moved(queue, 0);
+		release_cursor(queue);
+	}
+}
@@ -0,0 +1,105 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#define _GNU_SOURCE
+#include "labwc-ipc-shm.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <wlr/util/log.h>
+#include "common/mem.h"
+#include "labwc-ipc-proto.h"
+
+/*
+ * Seqlock writer side. The counter is odd while an update is in progress
+ * so that readers can detect torn reads. The fences order the field stores
+ * between the two counter increments.
+ */
+static void
+write_begin(struct ipc_shm_state *state)
+{
+	__atomic_store_n(&state->seq, state->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void
+write_end(struct ipc_shm_state *state)
+{
+	__atomic_store_n(&state->seq, state->seq + 1, __ATOMIC_RELEASE);
+}
+
+struct ipc_shm *
+ipc_shm_create(void)
+{
+	uint32_t size = sysconf(_SC_PAGESIZE);
+	int fd = memfd_create("labwc-ipc-state", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (fd < 0) {
+		wlr_log_errno(WLR_ERROR, "IPC: memfd_create() failed");
+		return NULL;
+	}
+	if (ftruncate(fd, size) < 0) {
+		wlr_log_errno(WLR_ERROR, "IPC: ftruncate() failed");
+		close(fd);
+		return NULL;
+	}
+	void *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (data == MAP_FAILED) {
+		wlr_log_errno(WLR_ERROR, "IPC: mmap() failed");
+		close(fd);
+		return NULL;
+	}
+
+	/*
+	 * Clients get the same fd, so make sure they cannot resize it
+	 * underneath us or (where supported) map it writable.
+	 */
+	int seals = F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL;
+#ifdef F_SEAL_FUTURE_WRITE
+	seals |= F_SEAL_FUTURE_WRITE;
+#endif
+	if (fcntl(fd, F_ADD_SEALS, seals) < 0) {
+		wlr_log_errno(WLR_INFO, "IPC: failed to seal shm region");
+	}
+
+	struct ipc_shm *shm = znew(*shm);
+	shm->fd = fd;
+	shm->size = size;
+	shm->state = data;
+	shm->state->magic = IPC_SHM_MAGIC;
+	shm->state->version = IPC_SHM_VERSION;
+	return shm;
+}
+
+void
+ipc_shm_destroy(struct ipc_shm *shm)
+{
+	if (!shm) {
+		return;
+	}
+	munmap(shm->state, shm->size);
+	close(shm->fd);
+	free(shm);
+}
+
+void
+ipc_shm_set_cursor(struct ipc_shm *shm, double x, double y)
+{
+	struct ipc_shm_state *state = shm->state;
+	write_begin(state);
+	__atomic_store_n(&state->cursor_x, (int32_t)lround(x), __ATOMIC_RELAXED);
+	__atomic_store_n(&state->cursor_y, (int32_t)lround(y), __ATOMIC_RELAXED);
+	write_end(state);
+}
+
+void
+ipc_shm_window_changed(struct ipc_shm *shm, uint64_t active_view_id)
+{
+	struct ipc_shm_state *state = shm->state;
+	write_begin(state);
+	__atomic_store_n(&state->active_view_id, active_view_id,
+		__ATOMIC_RELAXED);
+	__atomic_store_n(&state->window_generation,
+		state->window_generation + 1, __ATOMIC_RELAXED);
+	write_end(state);
+}
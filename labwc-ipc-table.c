@@ -0,0 +1,135 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#define _POSIX_C_SOURCE 200809L
+#include "labwc-ipc-table.h"
+#include <stdlib.h>
+#include <string.h>
+#include "common/list.h"
+#include "common/mem.h"
+
+void
+ipc_window_table_init(struct ipc_window_table *table)
+{
+	*table = (struct ipc_window_table){0};
+	wl_list_init(&table->entries);
+}
+
+static void
+entry_destroy(struct ipc_window_entry *entry)
+{
+	wl_list_remove(&entry->link);
+	free((char *)entry->info.title);
+	free((char *)entry->info.app_id);
+	free(entry);
+}
+
+void
+ipc_window_table_clear(struct ipc_window_table *table)
+{
+	struct ipc_window_entry *entry, *tmp;
+	wl_list_for_each_safe(entry, tmp, &table->entries, link) {
+		entry_destroy(entry);
+	}
+	lab_id_map_finish(&table->index);
+	table->focused_id = 0;
+}
+
+void
+ipc_window_table_finish(struct ipc_window_table *table)
+{
+	ipc_window_table_clear(table);
+}
+
+/* Replaces *@dst by a copy of @src if they differ */
+static bool
+update_string(const char **dst, const char *src)
+{
+	if (*dst && !strcmp(*dst, src)) {
+		return false;
+	}
+	free((char *)*dst);
+	*dst = xstrdup(src);
+	return true;
+}
+
+uint32_t
+ipc_window_table_update(struct ipc_window_table *table,
+		const struct ipc_window_info *info)
+{
+	struct ipc_window_entry *entry = lab_id_map_lookup(&table->index,
+		info->id);
+	uint32_t fields = 0;
+	if (!entry) {
+		entry = znew(*entry);
+		entry->info.id = info->id;
+		wl_list_append(&table->entries, &entry->link);
+		lab_id_map_insert(&table->index, info->id, entry);
+		fields = IPC_WINDOW_FIELDS_ALL;
+	}
+
+	struct ipc_window_info *old = &entry->info;
+	if (update_string(&old->title, info->title)) {
+		fields |= IPC_WINDOW_FIELD_TITLE;
+	}
+	if (update_string(&old->app_id, info->app_id)) {
+		fields |= IPC_WINDOW_FIELD_APP_ID;
+	}
+	if (old->x != info->x) {
+		fields |= IPC_WINDOW_FIELD_X;
+	}
+	if (old->y != info->y) {
+		fields |= IPC_WINDOW_FIELD_Y;
+	}
+	if (old->width != info->width) {
+		fields |= IPC_WINDOW_FIELD_WIDTH;
+	}
+	if (old->height != info->height) {
+		fields |= IPC_WINDOW_FIELD_HEIGHT;
+	}
+	if (old->minimized != info->minimized) {
+		fields |= IPC_WINDOW_FIELD_MINIMIZED;
+	}
+	if (old->maximized != info->maximized) {
+		fields |= IPC_WINDOW_FIELD_MAXIMIZED;
+	}
+	if (old->fullscreen != info->fullscreen) {
+		fields |= IPC_WINDOW_FIELD_FULLSCREEN;
+	}
+	if (old->focused != info->focused) {
+		fields |= IPC_WINDOW_FIELD_FOCUSED;
+	}
+	if (!fields) {
+		return 0;
+	}
+
+	old->x = info->x;
+	old->y = info->y;
+	old->width = info->width;
+	old->height = info->height;
+	old->minimized = info->minimized;
+	old->maximized = info->maximized;
+	old->fullscreen = info->fullscreen;
+	old->focused = info->focused;
+	if (info->focused) {
+		table->focused_id = info->id;
+	} else if (table->focused_id == info->id) {
+		table->focused_id = 0;
+	}
+	table->generation++;
+	return fields;
+}
+
+bool
+ipc_window_table_remove(struct ipc_window_table *table, uint64_t id)
+{
+	struct ipc_window_entry *entry = lab_id_map_lookup(&table->index, id);
+	if (!entry) {
+		return false;
+	}
+	lab_id_map_remove(&table->index, id);
+	entry_destroy(entry);
+	if (table->focused_id == id) {
+		table->focused_id = 0;
+	}
+	table->generation++;
+	return true;
+}
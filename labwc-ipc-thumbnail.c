@@ -0,0 +1,411 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#define _POSIX_C_SOURCE 200809L
+#include "labwc-ipc-thumbnail.h"
+#include <drm_fourcc.h>
+#include <inttypes.h>
+#include <time.h>
+#include <wlr/interfaces/wlr_buffer.h>
+#include <wlr/render/drm_format_set.h>
+#include <wlr/types/wlr_compositor.h>
+#include <wlr/types/wlr_scene.h>
+#include <wlr/util/log.h>
+#include "common/box.h"
+#include "common/list.h"
+#include "common/macros.h"
+#include "common/mem.h"
+#include "labwc-ipc.h"
+#include "labwc.h"
+#include "osd.h"
+#include "view.h"
+
+#define THUMBNAIL_MAX_SIZE 1024
+#define THUMBNAIL_MAX_RATE 60
+
+struct ipc_thumbnail {
+	struct ipc_client *client;
+	struct view *view;
+	struct wl_list link; /* struct ipc_client.thumbnails */
+
+	int max_width, max_height;
+	int interval_ms;
+	uint64_t last_render_ms;
+	/* The view changed since the last frame was delivered */
+	bool damaged;
+	struct wl_event_source *timer;
+
+	struct wl_listener surface_commit;
+	struct wl_listener surface_unmap;
+	struct wl_listener surface_destroy;
+	struct wl_listener view_destroy;
+};
+
+/*
+ * Linear ARGB8888 can be allocated by the shm allocator used with pixman
+ * as well as by GBM, and is mappable by clients without knowing about
+ * tiling modifiers.
+ */
+static uint64_t linear_modifier = DRM_FORMAT_MOD_LINEAR;
+static const struct wlr_drm_format thumbnail_format = {
+	.format = DRM_FORMAT_ARGB8888,
+	.len = 1,
+	.capacity = 1,
+	.modifiers = &linear_modifier,
+};
+
+static uint64_t
+now_msec(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/* Returns false if the client was too busy to take the fd */
+static bool
+send_thumbnail(struct ipc_client *client,
+		const struct ipc_thumbnail_info *info, int fd)
+{
+	struct wl_array frames;
+	char msg[256];
+	const void *data = msg;
+	size_t len;
+	bool sent = true;
+	wl_array_init(&frames);
+	if (client->mode == IPC_PROTO_BINARY) {
+		ipc_bin_encode_thumbnail(&frames, info);
+		data = frames.data;
+		len = frames.size;
+	} else {
+		len = ipc_json_encode_thumbnail(msg, sizeof(msg), info);
+	}
+	if (fd >= 0) {
+		sent = ipc_send_fd_to_client(client, data, len, fd);
+	} else {
+		ipc_reply(client, IPC_MSG_THUMBNAIL, data, len);
+	}
+	wl_array_release(&frames);
+	return sent;
+}
+
+/* Describes the buffer as shm or dmabuf, which the client maps by @fd */
+static bool
+export_buffer(struct wlr_buffer *buffer, struct ipc_thumbnail_info *info,
+		int *fd)
+{
+	info->width = buffer->width;
+	info->height = buffer->height;
+	struct wlr_dmabuf_attributes dmabuf;
+	struct wlr_shm_attributes shm;
+	if (wlr_buffer_get_dmabuf(buffer, &dmabuf)) {
+		if (dmabuf.n_planes != 1) {
+			wlr_log(WLR_ERROR, "IPC: multi-planar thumbnail");
+			return false;
+		}
+		info->type = IPC_THUMBNAIL_DMABUF;
+		info->format = dmabuf.format;
+		info->modifier = dmabuf.modifier;
+		info->offset = dmabuf.offset[0];
+		info->stride = dmabuf.stride[0];
+		*fd = dmabuf.fd[0];
+	} else if (wlr_buffer_get_shm(buffer, &shm)) {
+		info->type = IPC_THUMBNAIL_SHM;
+		info->format = shm.format;
+		info->modifier = DRM_FORMAT_MOD_LINEAR;
+		info->offset = shm.offset;
+		info->stride = shm.stride;
+		*fd = shm.fd;
+	} else {
+		wlr_log(WLR_ERROR, "IPC: cannot export thumbnail buffer");
+		return false;
+	}
+	return true;
+}
+
+static void
+thumbnail_destroy(struct ipc_thumbnail *thumb)
+{
+	wl_list_remove(&thumb->link);
+	wl_list_remove(&thumb->surface_commit.link);
+	wl_list_remove(&thumb->surface_unmap.link);
+	wl_list_remove(&thumb->surface_destroy.link);
+	wl_list_remove(&thumb->view_destroy.link);
+	wl_event_source_remove(thumb->timer);
+	free(thumb);
+}
+
+/* Tells the client that no more frames follow */
+static void
+thumbnail_end(struct ipc_thumbnail *thumb)
+{
+	struct ipc_thumbnail_info info = {
+		.id = thumb->view->id,
+		.type = IPC_THUMBNAIL_END,
+	};
+	send_thumbnail(thumb->client, &info, -1);
+	thumbnail_destroy(thumb);
+}
+
+static void
+thumbnail_render(struct ipc_thumbnail *thumb)
+{
+	struct view *view = thumb->view;
+	struct wlr_box bounds = {
+		.width = thumb->max_width,
+		.height = thumb->max_height,
+	};
+	struct wlr_box box = box_fit_within(view->current.width,
+		view->current.height, &bounds);
+	if (box.width <= 0 || box.height <= 0) {
+		return;
+	}
+
+	struct wlr_buffer *buffer = osd_thumbnail_render(view, box.width,
+		box.height, &thumbnail_format);
+	if (!buffer) {
+		return;
+	}
+	thumb->last_render_ms = now_msec();
+	struct ipc_thumbnail_info info = { .id = view->id };
+	int fd;
+	bool exported = export_buffer(buffer, &info, &fd);
+	bool sent = exported && send_thumbnail(thumb->client, &info, fd);
+	/* The client keeps the memory alive through its fd */
+	wlr_buffer_drop(buffer);
+	if (!exported) {
+		thumbnail_end(thumb);
+		return;
+	}
+
+	if (sent) {
+		thumb->damaged = false;
+	} else {
+		/* Try again once the client caught up */
+		wl_event_source_timer_update(thumb->timer, thumb->interval_ms);
+	}
+}
+
+/* Renders now or arms the timer for when the rate cap allows it */
+static void
+thumbnail_schedule(struct ipc_thumbnail *thumb)
+{
+	uint64_t next = thumb->last_render_ms + thumb->interval_ms;
+	uint64_t now = now_msec();
+	/* A timeout of 0 would disarm the timer */
+	int delay = next > now ? next - now : 1;
+	wl_event_source_timer_update(thumb->timer, delay);
+}
+
+static int
+handle_timer(void *data)
+{
+	struct ipc_thumbnail *thumb = data;
+	if (!thumb->damaged) {
+		return 0;
+	}
+	/* Don't pile up frames while the client is not reading */
+	if (!ipc_out_queue_is_empty(&thumb->client->out)) {
+		wl_event_source_timer_update(thumb->timer, thumb->interval_ms);
+		return 0;
+	}
+	thumbnail_render(thumb);
+	return 0;
+}
+
+static void
+thumbnail_damage(struct ipc_thumbnail *thumb)
+{
+	if (!thumb->damaged) {
+		thumb->damaged = true;
+		thumbnail_schedule(thumb);
+	}
+}
+
+/*
+ * Commits of the root surface are only needed for views that are not
+ * shown on any output, like those on other workspaces. Everything that
+ * is shown, including desync subsurfaces and popups, is caught by
+ * ipc_thumbnail_damage().
+ */
+static void
+handle_surface_commit(struct wl_listener *listener, void *data)
+{
+	struct ipc_thumbnail *thumb =
+		wl_container_of(listener, thumb, surface_commit);
+	thumbnail_damage(thumb);
+}
+
+static void
+handle_surface_unmap(struct wl_listener *listener, void *data)
+{
+	struct ipc_thumbnail *thumb =
+		wl_container_of(listener, thumb, surface_unmap);
+	thumbnail_end(thumb);
+}
+
+static void
+handle_surface_destroy(struct wl_listener *listener, void *data)
+{
+	struct ipc_thumbnail *thumb =
+		wl_container_of(listener, thumb, surface_destroy);
+	thumbnail_end(thumb);
+}
+
+static void
+handle_view_destroy(struct wl_listener *listener, void *data)
+{
+	struct ipc_thumbnail *thumb =
+		wl_container_of(listener, thumb, view_destroy);
+	thumbnail_end(thumb);
+}
+
+static struct ipc_thumbnail *
+thumbnail_find(struct ipc_client *client, struct view *view)
+{
+	struct ipc_thumbnail *thumb;
+	wl_list_for_each(thumb, &client->thumbnails, link) {
+		if (thumb->view == view) {
+			return thumb;
+		}
+	}
+	return NULL;
+}
+
+void
+ipc_thumbnail_stream(struct ipc_client *client, struct view *view,
+		int width, int height, uint32_t rate)
+{
+	struct ipc_thumbnail *thumb = thumbnail_find(client, view);
+	if (!rate) {
+		if (thumb) {
+			thumbnail_end(thumb);
+		}
+		return;
+	}
+	if (!view->mapped || !view->surface || width <= 0 || height <= 0) {
+		wlr_log(WLR_DEBUG, "IPC: cannot stream thumbnail of view %"
+			PRIx64, view->id);
+		return;
+	}
+
+	if (!thumb) {
+		thumb = znew(*thumb);
+		thumb->client = client;
+		thumb->view = view;
+		thumb->timer = wl_event_loop_add_timer(
+			view->server->wl_event_loop, handle_timer, thumb);
+		thumb->surface_commit.notify = handle_surface_commit;
+		wl_signal_add(&view->surface->events.commit,
+			&thumb->surface_commit);
+		thumb->surface_unmap.notify = handle_surface_unmap;
+		wl_signal_add(&view->surface->events.unmap,
+			&thumb->surface_unmap);
+		thumb->surface_destroy.notify = handle_surface_destroy;
+		wl_signal_add(&view->surface->events.destroy,
+			&thumb->surface_destroy);
+		thumb->view_destroy.notify = handle_view_destroy;
+		wl_signal_add(&view->events.destroy, &thumb->view_destroy);
+		wl_list_append(&client->thumbnails, &thumb->link);
+	}
+	thumb->max_width = MIN(width, THUMBNAIL_MAX_SIZE);
+	thumb->max_height = MIN(height, THUMBNAIL_MAX_SIZE);
+	thumb->interval_ms = 1000 / MIN(rate, THUMBNAIL_MAX_RATE);
+
+	/* Send the first frame right away, or re-render at the new size */
+	thumb->damaged = true;
+	thumb->last_render_ms = 0;
+	thumbnail_schedule(thumb);
+}
+
+void
+ipc_thumbnail_finish_client(struct ipc_client *client)
+{
+	struct ipc_thumbnail *thumb, *tmp;
+	wl_list_for_each_safe(thumb, tmp, &client->thumbnails, link) {
+		thumbnail_destroy(thumb);
+	}
+}
+
+/* Returns true if @damage touches any buffer or rect below @node */
+static bool
+node_damaged(struct wlr_scene_node *node, int lx, int ly,
+		const pixman_region32_t *damage)
+{
+	if (!node->enabled) {
+		return false;
+	}
+	lx += node->x;
+	ly += node->y;
+
+	int width = 0, height = 0;
+	switch (node->type) {
+	case WLR_SCENE_NODE_TREE: {
+		struct wlr_scene_tree *tree = wlr_scene_tree_from_node(node);
+		struct wlr_scene_node *child;
+		wl_list_for_each(child, &tree->children, link) {
+			if (node_damaged(child, lx, ly, damage)) {
+				return true;
+			}
+		}
+		return false;
+	}
+	case WLR_SCENE_NODE_RECT: {
+		struct wlr_scene_rect *rect = wlr_scene_rect_from_node(node);
+		width = rect->width;
+		height = rect->height;
+		break;
+	}
+	case WLR_SCENE_NODE_BUFFER: {
+		struct wlr_scene_buffer *buffer = wlr_scene_buffer_from_node(node);
+		width = buffer->dst_width;
+		height = buffer->dst_height;
+		if ((!width || !height) && buffer->buffer) {
+			width = buffer->buffer->width;
+			height = buffer->buffer->height;
+			if (buffer->transform & WL_OUTPUT_TRANSFORM_90) {
+				int tmp = width;
+				width = height;
+				height = tmp;
+			}
+		}
+		break;
+	}
+	}
+	if (width <= 0 || height <= 0) {
+		return false;
+	}
+	pixman_box32_t box = {
+		.x1 = lx,
+		.y1 = ly,
+		.x2 = lx + width,
+		.y2 = ly + height,
+	};
+	return pixman_region32_contains_rectangle(damage, &box)
+		!= PIXMAN_REGION_OUT;
+}
+
+void
+ipc_thumbnail_damage(struct ipc_server *ipc_server,
+		const pixman_region32_t *damage)
+{
+	if (!ipc_server) {
+		return;
+	}
+	struct ipc_client *client;
+	wl_list_for_each(client, &ipc_server->clients, link) {
+		struct ipc_thumbnail *thumb;
+		wl_list_for_each(thumb, &client->thumbnails, link) {
+			struct wlr_scene_node *node =
+				&thumb->view->scene_tree->node;
+			int lx, ly;
+			if (thumb->damaged
+					|| !wlr_scene_node_coords(node, &lx, &ly)) {
+				continue;
+			}
+			/* node_damaged() adds the offset of @node itself */
+			if (node_damaged(node, lx - node->x, ly - node->y,
+					damage)) {
+				thumbnail_damage(thumb);
+			}
+		}
+	}
+}
@@ -2,136 +2,920 @@
 #define _POSIX_C_SOURCE 200809L
 #include "labwc-ipc.h"
 #include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <sys/un.h>
 #include <unistd.h>
+#include <wlr/types/wlr_output_layout.h>
 #include <wlr/util/log.h>
+#include "common/array.h"
+#include "common/macros.h"
 #include "common/mem.h"
+#include "config/rcxml.h"
+#include "labwc-ipc-shm.h"
+#include "labwc-ipc-thumbnail.h"
 #include "labwc.h"
+#include "output.h"
 #include "view.h"
 
-#define IPC_SOCKET_PATH "/tmp/labwc-nwjs.sock"
 #define IPC_BUFFER_SIZE 4096
+#define IPC_OUT_QUEUE_SIZE (256 * 1024)
 
 static void ipc_client_destroy(struct ipc_client *client);
 
+/*
+ * Marks the connection as broken. The client is not destroyed right away
+ * because this may happen while one of its own commands is handled; the
+ * event loop reports the hangup afterwards.
+ */
 static void
-ipc_send_to_client(struct ipc_client *client, const char *message)
+ipc_client_fail(struct ipc_client *client, const char *what)
 {
-	size_t len = strlen(message);
-	ssize_t written = write(client->fd, message, len);
+	if (client->broken) {
+		return;
+	}
+	wlr_log(WLR_DEBUG, "IPC %s error: %s", what, strerror(errno));
+	client->broken = true;
+	shutdown(client->fd, SHUT_RDWR);
+}
+
+static void
+ipc_client_watch_writable(struct ipc_client *client, bool watch)
+{
+	if (client->watching_writable == watch) {
+		return;
+	}
+	uint32_t mask = WL_EVENT_READABLE;
+	if (watch) {
+		mask |= WL_EVENT_WRITABLE;
+	}
+	wl_event_source_fd_update(client->event_source, mask);
+	client->watching_writable = watch;
+}
+
+/*
+ * Writes a complete message, or queues it once the client stops keeping
+ * up. See struct ipc_out_queue for how a backlog is coalesced.
+ */
+static void
+ipc_send_to_client(struct ipc_client *client, const struct ipc_msg_key *key,
+		const void *data, size_t len)
+{
+	if (client->broken) {
+		return;
+	}
+	if (!ipc_out_queue_is_empty(&client->out)) {
+		ipc_out_queue_push(&client->out, key, data, len);
+		return;
+	}
+
+	ssize_t written = write(client->fd, data, len);
 	if (written < 0) {
 		if (errno != EAGAIN) {
-			wlr_log(WLR_DEBUG, "IPC write error: %s", strerror(errno));
-			ipc_client_destroy(client);
+			ipc_client_fail(client, "write");
+			return;
 		}
+		ipc_out_queue_push(&client->out, key, data, len);
 	} else if ((size_t)written < len) {
-		wlr_log(WLR_DEBUG, "IPC partial write: %zd/%zu", written, len);
+		/* The rest must follow, whatever the queue bound says */
+		if (!ipc_out_queue_push_tail(&client->out,
+				(const char *)data + written, len - written)) {
+			errno = ENOBUFS;
+			ipc_client_fail(client, "queue");
+			return;
+		}
 	}
+	ipc_client_watch_writable(client,
+		!ipc_out_queue_is_empty(&client->out));
+}
+
+/* Sends a message together with a file descriptor as SCM_RIGHTS */
+bool
+ipc_send_fd_to_client(struct ipc_client *client, const void *data, size_t len,
+		int fd)
+{
+	if (client->broken) {
+		return false;
+	}
+	if (!ipc_out_queue_is_empty(&client->out)) {
+		/* The fd would have to be attached to data still queued */
+		wlr_log(WLR_DEBUG, "IPC: client busy, dropping fd message");
+		client->out.nr_dropped++;
+		return false;
+	}
+
+	struct iovec iov = {
+		.iov_base = (void *)data,
+		.iov_len = len,
+	};
+	union {
+		char buf[CMSG_SPACE(sizeof(int))];
+		struct cmsghdr align;
+	} control = {0};
+	struct msghdr msg = {
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+		.msg_control = control.buf,
+		.msg_controllen = sizeof(control.buf),
+	};
+	struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+	memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+	ssize_t written = sendmsg(client->fd, &msg, MSG_NOSIGNAL);
+	if (written < 0) {
+		if (errno != EAGAIN) {
+			ipc_client_fail(client, "sendmsg");
+		} else {
+			client->out.nr_dropped++;
+		}
+		return false;
+	} else if ((size_t)written < len) {
+		if (!ipc_out_queue_push_tail(&client->out,
+				(const char *)data + written, len - written)) {
+			errno = ENOBUFS;
+			ipc_client_fail(client, "queue");
+			return false;
+		}
+		ipc_client_watch_writable(client, true);
+	}
+	return true;
+}
+
+/* What a broadcast is about, matched against subscription filters */
+struct ipc_event_target {
+	uint32_t event; /* enum ipc_event_mask */
+	const char *app_id; /* NULL if not applicable */
+	const char *output;
+};
+
+/* Events the client receives through ipc_broadcast() */
+static uint32_t
+ipc_client_event_mask(struct ipc_client *client)
+{
+	uint32_t mask = client->sub.events;
+	/* The cursor is read from the shm region instead */
+	if (client->uses_shm) {
+		mask &= ~IPC_EVENT_CURSOR;
+	}
+	/* Window deltas replace the window events */
+	if (client->windows_subscribed) {
+		mask &= ~IPC_EVENT_WINDOW;
+	}
+	return mask;
 }
 
 static void
-ipc_broadcast(struct ipc_server *ipc_server, const char *message)
+ipc_server_update_event_mask(struct ipc_server *ipc_server)
 {
-	struct ipc_client *client, *tmp;
-	wl_list_for_each_safe(client, tmp, &ipc_server->clients, link) {
-		ipc_send_to_client(client, message);
+	uint32_t mask = 0;
+	struct ipc_client *client;
+	wl_list_for_each(client, &ipc_server->clients, link) {
+		mask |= ipc_client_event_mask(client);
 	}
+	ipc_server->event_mask = mask;
+}
+
+static bool
+filter_matches(const char *filter, const char *value)
+{
+	return !filter || !value || !strcmp(filter, value);
 }
 
+static bool
+ipc_client_wants(struct ipc_client *client,
+		const struct ipc_event_target *target)
+{
+	return (ipc_client_event_mask(client) & target->event)
+		&& filter_matches(client->sub.app_id, target->app_id)
+		&& filter_matches(client->sub.output, target->output);
+}
+
+/* Checked before formatting, so that unwanted events cost nothing */
+static bool
+ipc_any_client_wants(struct ipc_server *ipc_server,
+		const struct ipc_event_target *target)
+{
+	if (!(ipc_server->event_mask & target->event)) {
+		return false;
+	}
+	struct ipc_client *client;
+	wl_list_for_each(client, &ipc_server->clients, link) {
+		if (ipc_client_wants(client, target)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+ * Sends the JSON line to JSON clients and the binary frame(s) to binary
+ * clients that subscribed to @target. Either may be NULL when no client
+ * of that mode is connected.
+ */
 static void
-handle_ipc_command(struct ipc_client *client, const char *command)
+ipc_broadcast(struct ipc_server *ipc_server, const struct ipc_msg_key *key,
+		const struct ipc_event_target *target, const char *json,
+		size_t json_len, const struct wl_array *frames)
 {
-	struct server *server = client->ipc_server->server;
-	
-	/* Parse JSON-like command format: {"cmd":"action","id":"view_id","x":100,"y":100} */
-	char cmd[64] = {0};
-	unsigned long view_id = 0;
-	int x = 0, y = 0, width = 0, height = 0;
-	
-	/* Simple parser - in production, use proper JSON library */
-	if (sscanf(command, "{\"cmd\":\"%63[^\"]\"", cmd) == 1) {
-		char *id_str = strstr(command, "\"id\":\"");
-		if (id_str) {
-			sscanf(id_str, "\"id\":\"%lx\"", &view_id);
-		}
-		
-		sscanf(command, "%*[^\"x\":]\"x\":%d", &x);
-		sscanf(command, "%*[^\"y\":]\"y\":%d", &y);
-		sscanf(command, "%*[^\"width\":]\"width\":%d", &width);
-		sscanf(command, "%*[^\"height\":]\"height\":%d", &height);
-		
-		/* Find view by ID */
-		struct view *view = NULL;
-		struct view *v;
-		wl_list_for_each(v, &server->views, link) {
-			if ((unsigned long)v == view_id) {
-				view = v;
-				break;
+	struct ipc_client *client;
+	wl_list_for_each(client, &ipc_server->clients, link) {
+		if (!ipc_client_wants(client, target)) {
+			continue;
+		}
+		if (client->mode == IPC_PROTO_BINARY) {
+			if (frames) {
+				ipc_send_to_client(client, key, frames->data,
+					frames->size);
+			}
+		} else if (json) {
+			ipc_send_to_client(client, key, json, json_len);
+		}
+	}
+}
+
+/* Replies to a single client, outside of any coalescing */
+void
+ipc_reply(struct ipc_client *client, enum ipc_msg_type type, const void *data,
+		size_t len)
+{
+	struct ipc_msg_key key = { .type = type };
+	ipc_send_to_client(client, &key, data, len);
+}
+
+/* Returns the reusable frame buffer, emptied */
+static struct wl_array *
+ipc_frame_buf(struct ipc_server *ipc_server)
+{
+	ipc_server->frame_buf.size = 0;
+	return &ipc_server->frame_buf;
+}
+
+/* Same as ipc_frame_buf() for JSON of unbounded size */
+static struct buf *
+ipc_json_buf(struct ipc_server *ipc_server)
+{
+	buf_clear(&ipc_server->json_buf);
+	return &ipc_server->json_buf;
+}
+
+static uint64_t
+active_view_id(struct server *server)
+{
+	return server->active_view ? server->active_view->id : 0;
+}
+
+static void
+view_to_ipc_info(struct view *view, struct ipc_window_info *info)
+{
+	*info = (struct ipc_window_info){
+		.id = view->id,
+		.title = view->title ? view->title : "",
+		.app_id = view->app_id ? view->app_id : "",
+		.x = view->current.x,
+		.y = view->current.y,
+		.width = view->current.width,
+		.height = view->current.height,
+		.minimized = view->minimized,
+		.maximized = view->maximized,
+		.fullscreen = view->fullscreen,
+		.focused = view->server->active_view == view,
+	};
+}
+
+/* Sends the legacy "window_list" of all mapped views */
+static void
+ipc_client_send_window_list(struct ipc_client *client)
+{
+	struct ipc_server *ipc_server = client->ipc_server;
+	struct ipc_window_info info;
+	struct view *view;
+
+	if (client->mode == IPC_PROTO_BINARY) {
+		struct wl_array *frames = ipc_frame_buf(ipc_server);
+		size_t start = ipc_bin_window_list_begin(frames);
+		uint32_t count = 0;
+		wl_list_for_each(view, &ipc_server->server->views, link) {
+			if (view->mapped) {
+				view_to_ipc_info(view, &info);
+				ipc_bin_window_list_add(frames, &info);
+				count++;
 			}
 		}
-		
-		if (!view && strcmp(cmd, "list") != 0 && strcmp(cmd, "enable_decorations") != 0) {
-			wlr_log(WLR_DEBUG, "IPC: view not found: %lx", view_id);
+		ipc_bin_frame_end(frames, start, count);
+		ipc_reply(client, IPC_MSG_WINDOW_LIST, frames->data,
+			frames->size);
+		return;
+	}
+
+	struct buf *json = ipc_json_buf(ipc_server);
+	buf_add(json, "{\"event\":\"window_list\",\"windows\":[");
+	bool first = true;
+	wl_list_for_each(view, &ipc_server->server->views, link) {
+		if (!view->mapped) {
+			continue;
+		}
+		if (!first) {
+			buf_add_char(json, ',');
+		}
+		view_to_ipc_info(view, &info);
+		ipc_json_add_window(json, &info);
+		first = false;
+	}
+	buf_add(json, "]}\n");
+	ipc_reply(client, IPC_MSG_WINDOW_LIST, json->data, json->len);
+}
+
+static void
+ipc_client_send_frame_timing(struct ipc_client *client)
+{
+	struct ipc_server *ipc_server = client->ipc_server;
+	struct frame_timing_sample samples[FRAME_TIMING_SAMPLES];
+	struct output *output;
+
+	struct wl_array *frames = ipc_frame_buf(ipc_server);
+	struct buf *json = ipc_json_buf(ipc_server);
+	size_t start = 0;
+	uint32_t count = 0;
+	if (client->mode == IPC_PROTO_BINARY) {
+		start = ipc_bin_frame_timing_begin(frames);
+	} else {
+		buf_add(json, "{\"event\":\"frame_timing\",\"outputs\":[");
+	}
+
+	wl_list_for_each(output, &ipc_server->server->outputs, link) {
+		struct ipc_frame_timing timing = {
+			.output = output->wlr_output->name,
+			.frames = output->timing.nr_frames,
+			.skipped = output->timing.nr_skipped,
+			.magnifier_skipped = output->magnifier.frames_skipped,
+			.samples = samples,
+			.nr_samples = frame_timing_get(&output->timing, samples,
+				ARRAY_SIZE(samples)),
+		};
+		if (client->mode == IPC_PROTO_BINARY) {
+			ipc_bin_frame_timing_add(frames, &timing);
+		} else {
+			if (count) {
+				buf_add_char(json, ',');
+			}
+			ipc_json_add_frame_timing(json, &timing);
+		}
+		count++;
+	}
+
+	if (client->mode == IPC_PROTO_BINARY) {
+		ipc_bin_frame_end(frames, start, count);
+		ipc_reply(client, IPC_MSG_FRAME_TIMING, frames->data,
+			frames->size);
+	} else {
+		buf_add(json, "]}\n");
+		ipc_reply(client, IPC_MSG_FRAME_TIMING, json->data, json->len);
+	}
+}
+
+/* Replies with the input timing collected since the previous request */
+static void
+ipc_client_send_input_timing(struct ipc_client *client)
+{
+	struct input_timing *timing = &client->ipc_server->server->input_timing;
+	if (client->mode == IPC_PROTO_BINARY) {
+		struct wl_array *frames = ipc_frame_buf(client->ipc_server);
+		ipc_bin_encode_input_timing(frames, &timing->motion,
+			&timing->publish);
+		ipc_reply(client, IPC_MSG_INPUT_TIMING, frames->data,
+			frames->size);
+	} else {
+		char msg[512];
+		int len = ipc_json_encode_input_timing(msg, sizeof(msg),
+			&timing->motion, &timing->publish);
+		ipc_reply(client, IPC_MSG_INPUT_TIMING, msg, len);
+	}
+	*timing = (struct input_timing){0};
+}
+
+/*
+ * Sends the window table with its generation. Deltas that follow carry
+ * the generations after it, without gaps.
+ */
+static void
+ipc_client_send_window_snapshot(struct ipc_client *client)
+{
+	struct ipc_server *ipc_server = client->ipc_server;
+	struct ipc_window_table *table = &ipc_server->windows;
+	struct ipc_window_entry *entry;
+	uint64_t nr_dropped = client->out.nr_dropped;
+
+	if (client->mode == IPC_PROTO_BINARY) {
+		struct wl_array *frames = ipc_frame_buf(ipc_server);
+		size_t start = ipc_bin_window_snapshot_begin(frames,
+			table->generation);
+		uint32_t count = 0;
+		wl_list_for_each(entry, &table->entries, link) {
+			ipc_bin_window_list_add(frames, &entry->info);
+			count++;
+		}
+		ipc_bin_frame_end(frames, start, count);
+		ipc_reply(client, IPC_MSG_WINDOW_SNAPSHOT, frames->data,
+			frames->size);
+	} else {
+		struct buf *json = ipc_json_buf(ipc_server);
+		buf_add_fmt(json, "{\"event\":\"window_snapshot\","
+			"\"generation\":%" PRIu64 ",\"windows\":[",
+			table->generation);
+		wl_list_for_each(entry, &table->entries, link) {
+			if (entry->link.prev != &table->entries) {
+				buf_add_char(json, ',');
+			}
+			ipc_json_add_window(json, &entry->info);
+		}
+		buf_add(json, "]}\n");
+		ipc_reply(client, IPC_MSG_WINDOW_SNAPSHOT, json->data,
+			json->len);
+	}
+
+	/* Try again once the client has caught up */
+	client->windows_resync = client->out.nr_dropped != nr_dropped;
+}
+
+static void
+ipc_client_subscribe_windows(struct ipc_client *client)
+{
+	struct ipc_server *ipc_server = client->ipc_server;
+	if (!client->windows_subscribed) {
+		client->windows_subscribed = true;
+		ipc_server_update_event_mask(ipc_server);
+		/* The table is only kept while somebody is subscribed */
+		if (!ipc_server->nr_window_subscribers++) {
+			struct ipc_window_info info;
+			struct view *view;
+			wl_list_for_each(view, &ipc_server->server->views, link) {
+				if (view->mapped) {
+					view_to_ipc_info(view, &info);
+					ipc_window_table_update(
+						&ipc_server->windows, &info);
+				}
+			}
+		}
+	}
+	ipc_client_send_window_snapshot(client);
+}
+
+static void
+broadcast_window_delta(struct ipc_server *ipc_server, uint32_t fields,
+		const struct ipc_window_info *info)
+{
+	uint64_t generation = ipc_server->windows.generation;
+	struct buf *json = NULL;
+	if (ipc_server->nr_json_clients) {
+		json = ipc_json_buf(ipc_server);
+		ipc_json_encode_window_delta(json, generation, fields, info);
+	}
+	struct wl_array *frames = NULL;
+	if (ipc_server->nr_binary_clients) {
+		frames = ipc_frame_buf(ipc_server);
+		ipc_bin_encode_window_delta(frames, generation, fields, info);
+	}
+
+	struct ipc_msg_key key = { .type = IPC_MSG_WINDOW_DELTA };
+	struct ipc_client *client;
+	wl_list_for_each(client, &ipc_server->clients, link) {
+		if (!client->windows_subscribed || client->windows_resync) {
+			continue;
+		}
+		uint64_t nr_dropped = client->out.nr_dropped;
+		if (client->mode == IPC_PROTO_BINARY) {
+			ipc_send_to_client(client, &key, frames->data,
+				frames->size);
+		} else {
+			ipc_send_to_client(client, &key, json->data, json->len);
+		}
+		/* A gap in the deltas can only be fixed by a new snapshot */
+		if (client->out.nr_dropped != nr_dropped) {
+			client->windows_resync = true;
+		}
+	}
+}
+
+/* Updates the window table and sends what changed to subscribers */
+static void
+sync_window(struct ipc_server *ipc_server, struct view *view, bool closed)
+{
+	if (!ipc_server->nr_window_subscribers) {
+		return;
+	}
+
+	struct ipc_window_table *table = &ipc_server->windows;
+	struct ipc_window_info info;
+	uint32_t fields;
+	if (closed || !view->mapped) {
+		if (!ipc_window_table_remove(table, view->id)) {
+			return;
+		}
+		info = (struct ipc_window_info){ .id = view->id };
+		fields = IPC_WINDOW_REMOVED;
+	} else {
+		view_to_ipc_info(view, &info);
+
+		/* Let the previously focused window lose focus first */
+		if (info.focused && table->focused_id
+				&& table->focused_id != info.id) {
+			struct view *prev = view_from_id(ipc_server->server,
+				table->focused_id);
+			if (prev) {
+				sync_window(ipc_server, prev, false);
+			}
+		}
+
+		fields = ipc_window_table_update(table, &info);
+		if (!fields) {
+			return;
+		}
+	}
+	broadcast_window_delta(ipc_server, fields, &info);
+}
+
+static void
+ipc_client_set_mode(struct ipc_client *client, enum ipc_proto_mode mode)
+{
+	struct ipc_server *ipc_server = client->ipc_server;
+	if (client->mode == mode) {
+		return;
+	}
+	if (mode == IPC_PROTO_BINARY) {
+		ipc_server->nr_json_clients--;
+		ipc_server->nr_binary_clients++;
+	} else {
+		ipc_server->nr_binary_clients--;
+		ipc_server->nr_json_clients++;
+	}
+	client->mode = mode;
+	wlr_log(WLR_DEBUG, "IPC client switched to %s mode",
+		mode == IPC_PROTO_BINARY ? "binary" : "JSON");
+
+	if (mode == IPC_PROTO_BINARY) {
+		struct wl_array *frames = ipc_frame_buf(ipc_server);
+		ipc_bin_encode_hello(frames);
+		ipc_reply(client, IPC_MSG_HELLO, frames->data, frames->size);
+	}
+}
+
+static void
+ipc_client_share_state(struct ipc_client *client)
+{
+	struct ipc_server *ipc_server = client->ipc_server;
+	if (!ipc_server->shm) {
+		ipc_server->shm = ipc_shm_create();
+		if (!ipc_server->shm) {
 			return;
 		}
-		
-		/* Execute command */
-		if (!strcmp(cmd, "close") && view) {
-			view_close(view);
-		} else if (!strcmp(cmd, "minimize") && view) {
-			view_minimize(view, !view->minimized);
-		} else if (!strcmp(cmd, "maximize") && view) {
-			view_toggle_maximize(view, VIEW_AXIS_BOTH);
-		} else if (!strcmp(cmd, "move") && view && width > 0 && height > 0) {
-			struct wlr_box geo = { .x = x, .y = y, .width = width, .height = height };
+		struct server *server = ipc_server->server;
+		struct seat *seat = &server->seat;
+		ipc_shm_set_cursor(ipc_server->shm, seat->cursor->x,
+			seat->cursor->y);
+		ipc_shm_window_changed(ipc_server->shm,
+			active_view_id(server));
+	}
+	if (!client->uses_shm) {
+		client->uses_shm = true;
+		ipc_server->nr_shm_clients++;
+		ipc_server_update_event_mask(ipc_server);
+	}
+
+	uint32_t size = ipc_server->shm->size;
+	if (client->mode == IPC_PROTO_BINARY) {
+		struct wl_array *frames = ipc_frame_buf(ipc_server);
+		ipc_bin_encode_shm(frames, size);
+		ipc_send_fd_to_client(client, frames->data, frames->size,
+			ipc_server->shm->fd);
+	} else {
+		char msg[128];
+		int len = ipc_json_encode_shm(msg, sizeof(msg), size);
+		ipc_send_fd_to_client(client, msg, len, ipc_server->shm->fd);
+	}
+}
+
+static void
+ipc_client_send_stats(struct ipc_client *client)
+{
+	struct ipc_out_queue *out = &client->out;
+	size_t queued = ipc_out_queue_pending(out);
+	if (client->mode == IPC_PROTO_BINARY) {
+		struct wl_array *frames = ipc_frame_buf(client->ipc_server);
+		ipc_bin_encode_stats(frames, queued, out->nr_dropped,
+			out->nr_coalesced);
+		ipc_reply(client, IPC_MSG_STATS, frames->data, frames->size);
+	} else {
+		char msg[256];
+		int len = ipc_json_encode_stats(msg, sizeof(msg), queued,
+			out->nr_dropped, out->nr_coalesced);
+		ipc_reply(client, IPC_MSG_STATS, msg, len);
+	}
+}
+
+/* Takes ownership of the filters in @sub */
+static void
+ipc_client_subscribe(struct ipc_client *client, struct ipc_subscription *sub)
+{
+	ipc_subscription_finish(&client->sub);
+	client->sub = *sub;
+	ipc_server_update_event_mask(client->ipc_server);
+	wlr_log(WLR_DEBUG, "IPC client subscribed to events 0x%x "
+		"(app_id: %s, output: %s)", sub->events,
+		sub->app_id ? sub->app_id : "any",
+		sub->output ? sub->output : "any");
+}
+
+static void
+apply_view_command(struct view *view, const struct ipc_command *cmd)
+{
+	switch (cmd->type) {
+	case IPC_CMD_CLOSE:
+		view_close(view);
+		break;
+	case IPC_CMD_MINIMIZE:
+		view_minimize(view, !view->minimized);
+		break;
+	case IPC_CMD_MAXIMIZE:
+		view_toggle_maximize(view, VIEW_AXIS_BOTH);
+		break;
+	case IPC_CMD_MOVE:
+		if (cmd->width > 0 && cmd->height > 0) {
+			struct wlr_box geo = {
+				.x = cmd->x,
+				.y = cmd->y,
+				.width = cmd->width,
+				.height = cmd->height,
+			};
 			view_move_resize(view, geo);
-		} else if (!strcmp(cmd, "focus") && view) {
-			desktop_focus_view(view, true);
-		} else if (!strcmp(cmd, "always_on_top") && view) {
-			view_toggle_always_on_top(view);
-		} else if (!strcmp(cmd, "always_on_bottom") && view) {
-			view_toggle_always_on_bottom(view);
-		} else if (!strcmp(cmd, "list")) {
-			ipc_send_window_list(client->ipc_server);
-		} else if (!strcmp(cmd, "enable_decorations")) {
-			/* Toggle SSD decorations for all views */
-			wl_list_for_each(v, &server->views, link) {
-				view_set_ssd_mode(v, LAB_SSD_MODE_NONE);
+		}
+		break;
+	case IPC_CMD_FOCUS:
+		desktop_focus_view(view, true);
+		break;
+	case IPC_CMD_ALWAYS_ON_TOP:
+		view_toggle_always_on_top(view);
+		break;
+	case IPC_CMD_ALWAYS_ON_BOTTOM:
+		view_toggle_always_on_bottom(view);
+		break;
+	default:
+		break;
+	}
+}
+
+struct ipc_batch_event {
+	struct view *view;
+	enum ipc_window_event event;
+};
+
+/*
+ * Applies all operations of a batch in one pass. It is rejected as a
+ * whole if any operation is malformed or addresses an unknown view; in
+ * the former case all operations are reported as failed.
+ * Window events caused by the batch are held back and sent once at the
+ * end, at most one per view and event type.
+ */
+static void
+ipc_client_run_batch(struct ipc_client *client, const struct wl_array *ops,
+		bool valid)
+{
+	struct ipc_server *ipc_server = client->ipc_server;
+	struct server *server = ipc_server->server;
+	const struct ipc_command *op;
+	uint32_t nr_ops = ops->size / sizeof(*op);
+	uint32_t failed = valid ? 0 : MAX(nr_ops, 1);
+
+	wl_array_for_each(op, ops) {
+		if (valid && !view_from_id(server, op->id)) {
+			wlr_log(WLR_DEBUG, "IPC: batch view not found: %" PRIx64,
+				op->id);
+			failed++;
+		}
+	}
+
+	if (!failed) {
+		ipc_server->batch.active = true;
+		wl_array_for_each(op, ops) {
+			/* Looked up again, an earlier op may have closed it */
+			struct view *view = view_from_id(server, op->id);
+			if (view) {
+				apply_view_command(view, op);
 			}
-			/* Send confirmation */
-			ipc_send_to_client(client, "{\"event\":\"decorations_disabled\"}\n");
+		}
+		ipc_server->batch.active = false;
+
+		struct ipc_batch_event *ev;
+		wl_array_for_each(ev, &ipc_server->batch.events) {
+			ipc_send_window_event(ipc_server, ev->view, ev->event);
+		}
+		ipc_server->batch.events.size = 0;
+	}
+
+	uint32_t applied = failed ? 0 : nr_ops;
+	if (client->mode == IPC_PROTO_BINARY) {
+		struct wl_array *frames = ipc_frame_buf(ipc_server);
+		ipc_bin_encode_batch_result(frames, applied, failed);
+		ipc_reply(client, IPC_MSG_BATCH_RESULT, frames->data,
+			frames->size);
+	} else {
+		char msg[128];
+		int len = ipc_json_encode_batch_result(msg, sizeof(msg),
+			applied, failed);
+		ipc_reply(client, IPC_MSG_BATCH_RESULT, msg, len);
+	}
+}
+
+static void
+handle_ipc_command(struct ipc_client *client, const struct ipc_command *cmd)
+{
+	struct server *server = client->ipc_server->server;
+
+	struct view *view = view_from_id(server, cmd->id);
+	struct view *v;
+
+	switch (cmd->type) {
+	case IPC_CMD_LIST:
+		ipc_client_send_window_list(client);
+		return;
+	case IPC_CMD_SUBSCRIBE_WINDOWS:
+		ipc_client_subscribe_windows(client);
+		return;
+	case IPC_CMD_ENABLE_DECORATIONS:
+		/* Toggle SSD decorations for all views */
+		wl_list_for_each(v, &server->views, link) {
+			view_set_ssd_mode(v, LAB_SSD_MODE_NONE);
+		}
+		/* Send confirmation */
+		if (client->mode == IPC_PROTO_BINARY) {
+			struct wl_array *frames = ipc_frame_buf(client->ipc_server);
+			ipc_bin_encode_notice(frames,
+				IPC_NOTICE_DECORATIONS_DISABLED);
+			ipc_reply(client, IPC_MSG_NOTICE, frames->data,
+				frames->size);
 		} else {
-			wlr_log(WLR_DEBUG, "IPC: unknown command: %s", cmd);
+			const char *msg = "{\"event\":\"decorations_disabled\"}\n";
+			ipc_reply(client, IPC_MSG_NOTICE, msg, strlen(msg));
 		}
+		return;
+	case IPC_CMD_PROTOCOL:
+		ipc_client_set_mode(client, cmd->mode);
+		return;
+	case IPC_CMD_SHM:
+		ipc_client_share_state(client);
+		return;
+	case IPC_CMD_STATS:
+		ipc_client_send_stats(client);
+		return;
+	case IPC_CMD_FRAME_TIMING:
+		ipc_client_send_frame_timing(client);
+		return;
+	case IPC_CMD_INPUT_TIMING:
+		ipc_client_send_input_timing(client);
+		return;
+	default:
+		break;
 	}
+
+	if (!view) {
+		wlr_log(WLR_DEBUG, "IPC: view not found: %" PRIx64, cmd->id);
+		return;
+	}
+	if (cmd->type == IPC_CMD_THUMBNAIL) {
+		ipc_thumbnail_stream(client, view, cmd->width, cmd->height,
+			cmd->rate);
+		return;
+	}
+	apply_view_command(view, cmd);
+}
+
+/*
+ * Handles one newline-delimited JSON command at the start of @data.
+ * Returns the number of bytes consumed or 0 if the line is incomplete.
+ */
+static ssize_t
+ipc_client_process_line(struct ipc_client *client, char *data, size_t len)
+{
+	char *newline = memchr(data, '\n', len);
+	if (!newline) {
+		return 0;
+	}
+	*newline = '\0';
+
+	struct ipc_command cmd;
+	struct ipc_subscription sub;
+	if (ipc_json_parse_command(data, &cmd) && cmd.type == IPC_CMD_BATCH) {
+		struct wl_array ops;
+		wl_array_init(&ops);
+		bool valid = ipc_json_parse_batch(data, &ops);
+		ipc_client_run_batch(client, &ops, valid);
+		wl_array_release(&ops);
+	} else if (cmd.type == IPC_CMD_SUBSCRIBE) {
+		if (ipc_json_parse_subscribe(data, &sub)) {
+			ipc_client_subscribe(client, &sub);
+		} else {
+			wlr_log(WLR_DEBUG, "IPC: invalid subscription: %s",
+				data);
+		}
+	} else if (cmd.type != IPC_CMD_NONE) {
+		handle_ipc_command(client, &cmd);
+	} else {
+		wlr_log(WLR_DEBUG, "IPC: unknown command: %s", data);
+	}
+	return newline + 1 - data;
+}
+
+/*
+ * Handles one binary frame at the start of @data. Returns the number of
+ * bytes consumed, 0 if the frame is incomplete or -1 on a corrupt stream.
+ */
+static ssize_t
+ipc_client_process_frame(struct ipc_client *client, char *data, size_t len)
+{
+	uint16_t type;
+	const uint8_t *payload;
+	uint32_t payload_len;
+	ssize_t consumed = ipc_bin_decode_frame((const uint8_t *)data, len,
+		&type, &payload, &payload_len);
+	if (consumed <= 0) {
+		return consumed;
+	}
+
+	struct ipc_command cmd;
+	if (type == IPC_MSG_COMMAND
+			&& ipc_bin_decode_command(payload, payload_len, &cmd)) {
+		if (cmd.type == IPC_CMD_BATCH) {
+			struct wl_array ops;
+			wl_array_init(&ops);
+			bool valid = ipc_bin_decode_batch(payload, payload_len,
+				&ops);
+			ipc_client_run_batch(client, &ops, valid);
+			wl_array_release(&ops);
+		} else if (cmd.type == IPC_CMD_SUBSCRIBE) {
+			struct ipc_subscription sub;
+			if (ipc_bin_decode_subscribe(payload, payload_len,
+					&sub)) {
+				ipc_client_subscribe(client, &sub);
+			} else {
+				wlr_log(WLR_DEBUG, "IPC: invalid subscription");
+			}
+		} else {
+			handle_ipc_command(client, &cmd);
+		}
+	} else {
+		wlr_log(WLR_DEBUG, "IPC: ignoring frame of type %u", type);
+	}
+	return consumed;
 }
 
 static int
-ipc_client_handle_readable(int fd, uint32_t mask, void *data)
+ipc_client_handle_event(int fd, uint32_t mask, void *data)
 {
 	struct ipc_client *client = data;
 	
-	if (mask & WL_EVENT_HANGUP) {
+	if ((mask & (WL_EVENT_HANGUP | WL_EVENT_ERROR)) || client->broken) {
 		ipc_client_destroy(client);
 		return 0;
 	}
 	
+	if (mask & WL_EVENT_WRITABLE) {
+		int ret = ipc_out_queue_flush(&client->out, fd);
+		if (ret < 0) {
+			ipc_client_destroy(client);
+			return 0;
+		}
+		ipc_client_watch_writable(client, ret > 0);
+		if (!ret && client->windows_resync) {
+			ipc_client_send_window_snapshot(client);
+		}
+	}
+	if (!(mask & WL_EVENT_READABLE)) {
+		return 0;
+	}
+	
 	/* Ensure buffer has space */
 	if (client->buffer_used >= client->buffer_size - 1) {
 		client->buffer_size *= 2;
-		client->buffer = realloc(client->buffer, client->buffer_size);
+		client->buffer = xrealloc(client->buffer, client->buffer_size);
 	}
 	
 	/* Read data */
 	ssize_t len = read(fd, client->buffer + client->buffer_used,
 		client->buffer_size - client->buffer_used - 1);
 	
+	if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+		return 0;
+	}
 	if (len <= 0) {
-		if (len < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+		if (len < 0) {
 			wlr_log(WLR_DEBUG, "IPC read error: %s", strerror(errno));
 		}
 		ipc_client_destroy(client);
@@ -141,19 +925,32 @@ ipc_client_handle_readable(int fd, uint32_t mask, void *data)
 	client->buffer_used += len;
 	client->buffer[client->buffer_used] = '\0';
 	
-	/* Process complete messages (newline-delimited) */
-	char *line_start = client->buffer;
-	char *newline;
-	while ((newline = strchr(line_start, '\n')) != NULL) {
-		*newline = '\0';
-		handle_ipc_command(client, line_start);
-		line_start = newline + 1;
+	/*
+	 * Process complete messages. The mode is checked for every message
+	 * because a "protocol" command switches it in the middle of a read.
+	 */
+	size_t offset = 0;
+	while (offset < client->buffer_used) {
+		char *msg = client->buffer + offset;
+		size_t avail = client->buffer_used - offset;
+		ssize_t consumed = client->mode == IPC_PROTO_BINARY
+			? ipc_client_process_frame(client, msg, avail)
+			: ipc_client_process_line(client, msg, avail);
+		if (consumed < 0) {
+			wlr_log(WLR_ERROR, "IPC: corrupt frame, dropping client");
+			ipc_client_destroy(client);
+			return 0;
+		}
+		if (!consumed) {
+			break;
+		}
+		offset += consumed;
 	}
 	
 	/* Move remaining incomplete data to buffer start */
-	size_t remaining = client->buffer + client->buffer_used - line_start;
-	if (remaining > 0 && line_start != client->buffer) {
-		memmove(client->buffer, line_start, remaining);
+	size_t remaining = client->buffer_used - offset;
+	if (remaining > 0 && offset > 0) {
+		memmove(client->buffer, client->buffer + offset, remaining);
 	}
 	client->buffer_used = remaining;
 	
@@ -163,10 +960,28 @@ ipc_client_handle_readable(int fd, uint32_t mask, void *data)
 static void
 ipc_client_destroy(struct ipc_client *client)
 {
-	wlr_log(WLR_DEBUG, "IPC client disconnected");
+	wlr_log(WLR_DEBUG, "IPC client disconnected (%" PRIu64 " messages "
+		"dropped, %" PRIu64 " coalesced)", client->out.nr_dropped,
+		client->out.nr_coalesced);
+	if (client->mode == IPC_PROTO_BINARY) {
+		client->ipc_server->nr_binary_clients--;
+	} else {
+		client->ipc_server->nr_json_clients--;
+	}
+	if (client->uses_shm) {
+		client->ipc_server->nr_shm_clients--;
+	}
+	if (client->windows_subscribed
+			&& !--client->ipc_server->nr_window_subscribers) {
+		ipc_window_table_clear(&client->ipc_server->windows);
+	}
+	ipc_thumbnail_finish_client(client);
 	wl_list_remove(&client->link);
+	ipc_server_update_event_mask(client->ipc_server);
+	ipc_subscription_finish(&client->sub);
 	wl_event_source_remove(client->event_source);
 	close(client->fd);
+	ipc_out_queue_finish(&client->out);
 	free(client->buffer);
 	free(client);
 }
@@ -182,77 +997,134 @@ ipc_handle_connection(int fd, uint32_t mask, void *data)
 		return 0;
 	}
 	
+	/* Writes must never block the compositor */
+	if (fcntl(client_fd, F_SETFL, O_NONBLOCK) < 0
+			|| fcntl(client_fd, F_SETFD, FD_CLOEXEC) < 0) {
+		wlr_log(WLR_ERROR, "IPC fcntl failed: %s", strerror(errno));
+		close(client_fd);
+		return 0;
+	}
+	
 	struct ipc_client *client = znew(*client);
 	client->fd = client_fd;
 	client->ipc_server = ipc_server;
 	client->buffer_size = IPC_BUFFER_SIZE;
-	client->buffer = malloc(client->buffer_size);
+	client->buffer = xmalloc(client->buffer_size);
 	client->buffer_used = 0;
+	ipc_out_queue_init(&client->out, IPC_OUT_QUEUE_SIZE);
+	wl_list_init(&client->thumbnails);
 	
 	client->event_source = wl_event_loop_add_fd(
 		ipc_server->server->wl_event_loop,
 		client_fd,
 		WL_EVENT_READABLE,
-		ipc_client_handle_readable,
+		ipc_client_handle_event,
 		client);
 	
+	/* Everything until the client subscribes to something else */
+	client->sub.events = IPC_EVENT_ALL;
 	wl_list_insert(&ipc_server->clients, &client->link);
+	ipc_server->nr_json_clients++;
+	ipc_server_update_event_mask(ipc_server);
 	
 	wlr_log(WLR_DEBUG, "IPC client connected");
 	
 	/* Send current window list to new client */
-	ipc_send_window_list(ipc_server);
+	ipc_client_send_window_list(client);
 	
 	return 0;
 }
 
+static int
+handle_throttle_timer(void *data)
+{
+	struct ipc_server *ipc_server = data;
+	if (ipc_server->pending.output) {
+		wlr_output_schedule_frame(ipc_server->pending.output->wlr_output);
+	}
+	return 0;
+}
+
 struct ipc_server *
 ipc_server_init(struct server *server)
 {
 	struct ipc_server *ipc_server = znew(*ipc_server);
 	ipc_server->server = server;
 	wl_list_init(&ipc_server->clients);
-	
-	/* Remove existing socket */
-	unlink(IPC_SOCKET_PATH);
-	
-	/* Create Unix socket */
-	ipc_server->sock_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
-	if (ipc_server->sock_fd < 0) {
-		wlr_log(WLR_ERROR, "Failed to create IPC socket: %s", strerror(errno));
-		free(ipc_server);
-		return NULL;
+	wl_array_init(&ipc_server->frame_buf);
+	ipc_server->json_buf = BUF_INIT;
+	ipc_window_table_init(&ipc_server->windows);
+	wl_array_init(&ipc_server->pending.views);
+	wl_array_init(&ipc_server->batch.events);
+	ipc_server->pending.throttle_timer = wl_event_loop_add_timer(
+		server->wl_event_loop, handle_throttle_timer, ipc_server);
+	ipc_server->sock_fd = -1;
+	return ipc_server;
+}
+
+bool
+ipc_server_listen(struct ipc_server *ipc_server, const char *wayland_display)
+{
+	const char *runtime_dir = getenv("XDG_RUNTIME_DIR");
+	if (!runtime_dir) {
+		wlr_log(WLR_ERROR, "XDG_RUNTIME_DIR is not set, IPC disabled");
+		return false;
 	}
-	
+
 	struct sockaddr_un addr = {
 		.sun_family = AF_UNIX,
 	};
-	strncpy(addr.sun_path, IPC_SOCKET_PATH, sizeof(addr.sun_path) - 1);
-	
-	if (bind(ipc_server->sock_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
-		wlr_log(WLR_ERROR, "Failed to bind IPC socket: %s", strerror(errno));
-		close(ipc_server->sock_fd);
-		free(ipc_server);
-		return NULL;
+	int len = snprintf(addr.sun_path, sizeof(addr.sun_path),
+		"%s/labwc-ipc.%s.sock", runtime_dir, wayland_display);
+	if (len < 0 || (size_t)len >= sizeof(addr.sun_path)) {
+		wlr_log(WLR_ERROR, "IPC socket path too long");
+		return false;
 	}
-	
-	if (listen(ipc_server->sock_fd, 3) < 0) {
-		wlr_log(WLR_ERROR, "Failed to listen on IPC socket: %s", strerror(errno));
-		close(ipc_server->sock_fd);
-		free(ipc_server);
-		return NULL;
+
+	/*
+	 * libwayland holds a lock on the display name for as long as the
+	 * compositor using it runs, so a socket by this name can only be a
+	 * leftover of an instance that crashed.
+	 */
+	unlink(addr.sun_path);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		wlr_log_errno(WLR_ERROR, "failed to create IPC socket");
+		return false;
 	}
-	
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		wlr_log_errno(WLR_ERROR, "failed to bind IPC socket %s",
+			addr.sun_path);
+		goto err_close;
+	}
+	/* XDG_RUNTIME_DIR is private already, but do not rely on it */
+	if (chmod(addr.sun_path, 0600) < 0) {
+		wlr_log_errno(WLR_ERROR, "failed to chmod IPC socket");
+		goto err_unlink;
+	}
+	if (listen(fd, rc.ipc_backlog) < 0) {
+		wlr_log_errno(WLR_ERROR, "failed to listen on IPC socket");
+		goto err_unlink;
+	}
+
+	ipc_server->sock_fd = fd;
+	ipc_server->socket_path = xstrdup(addr.sun_path);
 	ipc_server->event_source = wl_event_loop_add_fd(
-		server->wl_event_loop,
-		ipc_server->sock_fd,
-		WL_EVENT_READABLE,
-		ipc_handle_connection,
-		ipc_server);
-	
-	wlr_log(WLR_INFO, "IPC server listening on %s", IPC_SOCKET_PATH);
-	
-	return ipc_server;
+		ipc_server->server->wl_event_loop, fd, WL_EVENT_READABLE,
+		ipc_handle_connection, ipc_server);
+
+	if (setenv("LABWC_IPC_SOCKET", ipc_server->socket_path, true) < 0) {
+		wlr_log_errno(WLR_ERROR, "unable to set LABWC_IPC_SOCKET");
+	}
+	wlr_log(WLR_INFO, "IPC server listening on %s", ipc_server->socket_path);
+	return true;
+
+err_unlink:
+	unlink(addr.sun_path);
+err_close:
+	close(fd);
+	return false;
 }
 
 void
@@ -267,127 +1139,286 @@ ipc_server_finish(struct ipc_server *ipc_server)
 		ipc_client_destroy(client);
 	}
 	
-	wl_event_source_remove(ipc_server->event_source);
-	close(ipc_server->sock_fd);
-	unlink(IPC_SOCKET_PATH);
+	if (ipc_server->socket_path) {
+		wl_event_source_remove(ipc_server->event_source);
+		close(ipc_server->sock_fd);
+		unlink(ipc_server->socket_path);
+		free(ipc_server->socket_path);
+	}
+	ipc_shm_destroy(ipc_server->shm);
+	wl_event_source_remove(ipc_server->pending.throttle_timer);
+	wl_array_release(&ipc_server->pending.views);
+	wl_array_release(&ipc_server->batch.events);
+	wl_array_release(&ipc_server->frame_buf);
+	buf_reset(&ipc_server->json_buf);
+	ipc_window_table_finish(&ipc_server->windows);
 	free(ipc_server);
 	
 	wlr_log(WLR_DEBUG, "IPC server stopped");
 }
 
-void
-ipc_send_window_event(struct ipc_server *ipc_server, struct view *view, const char *event)
+static void
+broadcast_window_event(struct ipc_server *ipc_server, struct view *view,
+		enum ipc_window_event event)
 {
-	if (!ipc_server || !view || !event) {
-		return;
+	sync_window(ipc_server, view, event == IPC_WINDOW_CLOSED);
+
+	if (ipc_server->shm) {
+		ipc_shm_window_changed(ipc_server->shm,
+			active_view_id(view->server));
 	}
 	
-	/* Don't send events if no clients are connected */
-	if (wl_list_empty(&ipc_server->clients)) {
+	struct ipc_event_target target = {
+		.event = ipc_window_event_mask(event),
+		.app_id = view->app_id,
+		.output = output_is_usable(view->output)
+			? view->output->wlr_output->name : "",
+	};
+	if (!ipc_any_client_wants(ipc_server, &target)) {
 		return;
 	}
 	
-	/* Safely get title and app_id */
-	const char *title = view->title ? view->title : "";
-	const char *app_id = view->app_id ? view->app_id : "";
+	struct ipc_window_info info;
+	view_to_ipc_info(view, &info);
+	
+	struct buf *json = NULL;
+	if (ipc_server->nr_json_clients) {
+		json = ipc_json_buf(ipc_server);
+		ipc_json_encode_window_event(json, event, &info);
+	}
+	struct wl_array *frames = NULL;
+	if (ipc_server->nr_binary_clients) {
+		frames = ipc_frame_buf(ipc_server);
+		ipc_bin_encode_window_event(frames, event, &info);
+	}
 	
-	/* Check for server validity */
-	if (!view->server) {
+	struct ipc_msg_key key = {
+		.type = IPC_MSG_WINDOW_EVENT,
+		.event = event,
+		.view_id = info.id,
+	};
+	ipc_broadcast(ipc_server, &key, &target, json ? json->data : NULL,
+		json ? json->len : 0, frames);
+}
+
+static void
+broadcast_cursor(struct ipc_server *ipc_server, double x, double y)
+{
+	struct ipc_event_target target = {
+		.event = IPC_EVENT_CURSOR,
+	};
+	struct wlr_output *output = wlr_output_layout_output_at(
+		ipc_server->server->output_layout, x, y);
+	target.output = output ? output->name : "";
+	if (!ipc_any_client_wants(ipc_server, &target)) {
 		return;
 	}
 	
-	char msg[1024];
-	snprintf(msg, sizeof(msg),
-		"{\"event\":\"%s\",\"id\":\"%lx\",\"title\":\"%s\",\"app_id\":\"%s\","
-		"\"x\":%d,\"y\":%d,\"width\":%d,\"height\":%d,"
-		"\"minimized\":%s,\"maximized\":%d,\"fullscreen\":%s,\"focused\":%s}\n",
-		event,
-		(unsigned long)view,
-		title,
-		app_id,
-		view->current.x,
-		view->current.y,
-		view->current.width,
-		view->current.height,
-		view->minimized ? "true" : "false",
-		view->maximized,
-		view->fullscreen ? "true" : "false",
-		(view->server->active_view == view) ? "true" : "false");
+	char msg[128];
+	int len = 0;
+	if (ipc_server->nr_json_clients) {
+		len = ipc_json_encode_cursor(msg, sizeof(msg), x, y);
+	}
+	struct wl_array *frames = NULL;
+	if (ipc_server->nr_binary_clients) {
+		frames = ipc_frame_buf(ipc_server);
+		ipc_bin_encode_cursor(frames, x, y);
+	}
 	
-	ipc_broadcast(ipc_server, msg);
+	struct ipc_msg_key key = { .type = IPC_MSG_CURSOR };
+	ipc_broadcast(ipc_server, &key, &target, len > 0 ? msg : NULL, len,
+		frames);
+}
+
+/* Sends everything that was coalesced since the last frame */
+static void
+publish_pending(struct ipc_server *ipc_server)
+{
+	uint64_t start_ns = input_timing_now_ns();
+	if (ipc_server->pending.cursor_dirty) {
+		ipc_server->pending.cursor_dirty = false;
+		broadcast_cursor(ipc_server, ipc_server->pending.cursor_x,
+			ipc_server->pending.cursor_y);
+	}
+	struct view **view;
+	wl_array_for_each(view, &ipc_server->pending.views) {
+		broadcast_window_event(ipc_server, *view, IPC_WINDOW_MOVED);
+	}
+	ipc_server->pending.views.size = 0;
+	latency_histogram_add(&ipc_server->server->input_timing.publish,
+		input_timing_now_ns() - start_ns);
+}
+
+/* Returns the <ipc><throttle> interval configured for the output */
+static int
+throttle_interval(struct output *output)
+{
+	int interval = 0;
+	struct ipc_throttle *throttle;
+	wl_list_for_each(throttle, &rc.ipc_throttles, link) {
+		if (!throttle->output) {
+			interval = throttle->interval;
+		} else if (!strcasecmp(throttle->output,
+				output->wlr_output->name)) {
+			return throttle->interval;
+		}
+	}
+	return interval;
+}
+
+/*
+ * Arranges for pending updates to be published on the next frame of the
+ * output under the cursor. Without a usable output there is no frame to
+ * wait for, so they are published right away.
+ */
+static void
+schedule_publish(struct ipc_server *ipc_server)
+{
+	if (ipc_server->pending.output) {
+		return;
+	}
+	struct output *output = output_nearest_to_cursor(ipc_server->server);
+	if (!output_is_usable(output)) {
+		publish_pending(ipc_server);
+		return;
+	}
+	ipc_server->pending.output = output;
+	wlr_output_schedule_frame(output->wlr_output);
+}
+
+static bool
+remove_pending_view(struct ipc_server *ipc_server, struct view *view)
+{
+	struct view **pending = ipc_server->pending.views.data;
+	size_t count = ipc_server->pending.views.size / sizeof(*pending);
+	for (size_t i = 0; i < count; i++) {
+		if (pending[i] == view) {
+			pending[i] = pending[count - 1];
+			ipc_server->pending.views.size -= sizeof(*pending);
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+ * Holds back an event emitted while a batch is applied. Returns false if
+ * the event has to be sent right away instead.
+ */
+static bool
+batch_hold_event(struct ipc_server *ipc_server, struct view *view,
+		enum ipc_window_event event)
+{
+	struct ipc_batch_event *ev;
+	if (event == IPC_WINDOW_CLOSED) {
+		/* Nothing else must be sent for a destroyed view */
+		struct ipc_batch_event *events = ipc_server->batch.events.data;
+		size_t count = ipc_server->batch.events.size / sizeof(*ev);
+		size_t kept = 0;
+		for (size_t i = 0; i < count; i++) {
+			if (events[i].view != view) {
+				events[kept++] = events[i];
+			}
+		}
+		ipc_server->batch.events.size = kept * sizeof(*ev);
+		return false;
+	}
+	wl_array_for_each(ev, &ipc_server->batch.events) {
+		if (ev->view == view && ev->event == event) {
+			return true;
+		}
+	}
+	array_add(&ipc_server->batch.events,
+		((struct ipc_batch_event){ .view = view, .event = event }));
+	return true;
 }
 
 void
-ipc_send_cursor_position(struct ipc_server *ipc_server, double x, double y)
+ipc_send_window_event(struct ipc_server *ipc_server, struct view *view,
+		enum ipc_window_event event)
 {
-	if (!ipc_server) {
+	if (!ipc_server || !view || !view->server) {
 		return;
 	}
 	
-	/* Don't send cursor updates if no clients are connected */
-	if (wl_list_empty(&ipc_server->clients)) {
+	if (ipc_server->batch.active
+			&& batch_hold_event(ipc_server, view, event)) {
+		return;
+	}
+
+	/* Geometry changes are coalesced and sent once per frame */
+	if (event == IPC_WINDOW_MOVED) {
+		if (!remove_pending_view(ipc_server, view)) {
+			schedule_publish(ipc_server);
+		}
+		array_add(&ipc_server->pending.views, view);
 		return;
 	}
 	
-	char msg[128];
-	snprintf(msg, sizeof(msg), "{\"event\":\"cursor\",\"x\":%.0f,\"y\":%.0f}\n", x, y);
-	ipc_broadcast(ipc_server, msg);
+	/*
+	 * A pending "moved" must reach clients before any later event of
+	 * the same view, unless the view is going away anyway.
+	 */
+	if (remove_pending_view(ipc_server, view)
+			&& event != IPC_WINDOW_CLOSED
+			&& event != IPC_WINDOW_UNMAPPED) {
+		broadcast_window_event(ipc_server, view, IPC_WINDOW_MOVED);
+	}
+	broadcast_window_event(ipc_server, view, event);
 }
 
 void
-ipc_send_window_list(struct ipc_server *ipc_server)
+ipc_cursor_moved(struct ipc_server *ipc_server, double x, double y)
 {
 	if (!ipc_server) {
 		return;
 	}
-	
-	/* Don't send if no clients connected */
-	if (wl_list_empty(&ipc_server->clients)) {
+	if (ipc_server->shm) {
+		ipc_shm_set_cursor(ipc_server->shm, x, y);
+	}
+	if (!(ipc_server->event_mask & IPC_EVENT_CURSOR)) {
 		return;
 	}
-	
-	struct server *server = ipc_server->server;
-	if (!server) {
+	ipc_server->pending.cursor_x = x;
+	ipc_server->pending.cursor_y = y;
+	if (!ipc_server->pending.cursor_dirty) {
+		ipc_server->pending.cursor_dirty = true;
+		schedule_publish(ipc_server);
+	}
+}
+
+void
+ipc_output_frame(struct ipc_server *ipc_server, struct output *output,
+		const struct timespec *now)
+{
+	if (!ipc_server || ipc_server->pending.output != output) {
 		return;
 	}
 	
-	char msg[8192] = "{\"event\":\"window_list\",\"windows\":[";
-	size_t offset = strlen(msg);
-	
-	bool first = true;
-	struct view *view;
-	wl_list_for_each(view, &server->views, link) {
-		if (!view->mapped) {
-			continue;
-		}
-		
-		/* Safety checks */
-		const char *title = view->title ? view->title : "";
-		const char *app_id = view->app_id ? view->app_id : "";
-		
-		char window_data[512];
-		snprintf(window_data, sizeof(window_data),
-			"%s{\"id\":\"%lx\",\"title\":\"%s\",\"app_id\":\"%s\","
-			"\"x\":%d,\"y\":%d,\"width\":%d,\"height\":%d,"
-			"\"minimized\":%s,\"focused\":%s}",
-			first ? "" : ",",
-			(unsigned long)view,
-			title,
-			app_id,
-			view->current.x,
-			view->current.y,
-			view->current.width,
-			view->current.height,
-			view->minimized ? "true" : "false",
-			(server->active_view == view) ? "true" : "false");
-		
-		if (offset + strlen(window_data) + 10 < sizeof(msg)) {
-			strcat(msg, window_data);
-			offset += strlen(window_data);
-			first = false;
-		}
+	uint64_t now_ms = (uint64_t)now->tv_sec * 1000 + now->tv_nsec / 1000000;
+	int interval = throttle_interval(output);
+	uint64_t elapsed = now_ms - ipc_server->pending.last_publish_ms;
+	if (interval > 0 && elapsed < (uint64_t)interval) {
+		/* Try again on the first frame after the interval */
+		wl_event_source_timer_update(ipc_server->pending.throttle_timer,
+			interval - elapsed);
+		return;
 	}
 	
-	strcat(msg, "]}\n");
-	ipc_broadcast(ipc_server, msg);
-}
\ No newline at end of file
+	ipc_server->pending.output = NULL;
+	ipc_server->pending.last_publish_ms = now_ms;
+	publish_pending(ipc_server);
+}
+
+void
+ipc_output_destroyed(struct ipc_server *ipc_server, struct output *output)
+{
+	/*
+	 * The output may still be part of the layout at this point, so don't
+	 * pick a new one but flush what was waiting for its frame.
+	 */
+	if (ipc_server && ipc_server->pending.output == output) {
+		ipc_server->pending.output = NULL;
+		publish_pending(ipc_server);
+	}
+}
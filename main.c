@@ -6,6 +6,8 @@
 #include <unistd.h>
 #include "common/fd-util.h"
 #include "common/font.h"
+#include "common/font-cache.h"
+#include "common/icon-cache.h"
 #include "common/spawn.h"
 #include "config/rcxml.h"
 #include "config/session.h"
@@ -272,9 +274,12 @@ main(int argc, char *argv[])
 	menu_finish(&server);
 	theme_finish(&theme);
 	rcxml_finish();
+	font_cache_clear();
 	font_finish();
 
 	server_finish(&server);
+	/* After the icon loader jobs were completed */
+	icon_cache_clear();
 
 	return 0;
 }
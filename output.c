@@ -25,7 +25,10 @@
 #include "common/macros.h"
 #include "common/mem.h"
 #include "common/scene-helpers.h"
+#include "common/string-helpers.h"
 #include "config/rcxml.h"
+#include "frame-timing.h"
+#include "labwc-ipc.h"
 #include "labwc.h"
 #include "layers.h"
 #include "node.h"
@@ -34,6 +37,7 @@
 #include "protocols/cosmic-workspaces.h"
 #include "protocols/ext-workspace.h"
 #include "regions.h"
+#include "scaled-buffer/scaled-buffer.h"
 #include "session-lock.h"
 #include "view.h"
 #include "xwayland.h"
@@ -102,30 +106,32 @@ output_apply_gamma(struct output *output)
 		return;
 	}
 
-	if (!lab_wlr_scene_output_commit(scene_output, &pending)) {
+	if (!lab_wlr_scene_output_commit(scene_output, &pending, NULL)) {
 		wlr_gamma_control_v1_send_failed_and_destroy(gamma_control);
 	}
 
 	wlr_output_state_finish(&pending);
 }
 
-static void
-handle_output_frame(struct wl_listener *listener, void *data)
+static uint64_t
+timespec_to_ns(const struct timespec *ts)
+{
+	return (uint64_t)ts->tv_sec * 1000000000 + ts->tv_nsec;
+}
+
+/* Whether the output can be painted, see handle_output_frame() */
+static bool
+output_can_repaint(struct output *output)
 {
-	/*
-	 * This function is called every time an output is ready to display a
-	 * frame - which is typically at 60 Hz.
-	 */
-	struct output *output = wl_container_of(listener, output, frame);
 	if (!output_is_usable(output)) {
-		return;
+		return false;
 	}
 
 	/*
 	 * skip painting the session when it exists but is not active.
 	 */
 	if (output->server->session && !output->server->session->active) {
-		return;
+		return false;
 	}
 
 	if (!output->scene_output) {
@@ -136,8 +142,19 @@ handle_output_frame(struct wl_listener *listener, void *data)
 		 *       creating them on handle_new_output() only.
 		 */
 		wlr_log(WLR_INFO, "Failed to render new frame: no scene-output");
-		return;
+		return false;
 	}
+	return true;
+}
+
+static void
+output_repaint(struct output *output)
+{
+	struct timespec now = { 0 };
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	/* Before the commit, so that new titles are in this frame */
+	view_publish_titles(output->server, output, &now);
 
 	if (output->gamma_lut_changed) {
 		/*
@@ -154,12 +171,154 @@ handle_output_frame(struct wl_listener *listener, void *data)
 
 		pending->tearing_page_flip = output_get_tearing_allowance(output);
 
-		lab_wlr_scene_output_commit(scene_output, pending);
+		uint64_t now_ns = timespec_to_ns(&now);
+		struct frame_timing_sample sample = {
+			.start_ns = output->repaint.frame_ns,
+			.delay_us = (now_ns - output->repaint.frame_ns) / 1000,
+		};
+		lab_wlr_scene_output_commit(scene_output, pending, &sample);
+		frame_timing_record(&output->timing, output->wlr_output->name,
+			&sample);
+	}
+
+	wlr_scene_output_send_frame_done(output->scene_output, &now);
+
+	ipc_output_frame(output->server->ipc_server, output, &now);
+}
+
+/* Returns the <core><maxRenderTime> configured for the output */
+static int
+max_render_time(struct output *output)
+{
+	int time = 0;
+	struct max_render_time *mrt;
+	wl_list_for_each(mrt, &rc.max_render_times, link) {
+		if (string_null_or_empty(mrt->output)) {
+			time = mrt->time;
+		} else if (!strcasecmp(mrt->output, output->wlr_output->name)) {
+			return mrt->time;
+		}
+	}
+	return time;
+}
+
+/*
+ * Returns how many milliseconds rendering can wait so that it completes
+ * just before the next vertical blank, going by the last presentation
+ * and the refresh period.
+ */
+static int
+repaint_delay_ms(struct output *output, uint64_t now_ns)
+{
+	int time = max_render_time(output);
+	if (!time || output_get_tearing_allowance(output)) {
+		return 0;
+	}
+
+	uint64_t refresh_ns = output->repaint.refresh_ns;
+	if (!refresh_ns && output->wlr_output->refresh > 0) {
+		/* The headless backend does not report it, use the mode */
+		refresh_ns = 1000000000000ULL / output->wlr_output->refresh;
+	}
+	if (!refresh_ns) {
+		return 0;
+	}
+
+	uint64_t render_ns;
+	if (time == MAX_RENDER_TIME_AUTO) {
+		uint32_t estimate_us = frame_timing_render_estimate(&output->timing);
+		if (!estimate_us) {
+			return 0;
+		}
+		/* Leave a millisecond for timer and scheduling slack */
+		render_ns = (estimate_us + 1000) * 1000ULL;
+	} else {
+		render_ns = time * 1000000ULL;
+	}
+	if (render_ns >= refresh_ns) {
+		return 0;
+	}
+
+	/* Predict the next vblank, the frame event usually comes right after one */
+	uint64_t vblank_ns = output->repaint.present_ns;
+	if (!vblank_ns || vblank_ns > now_ns || now_ns - vblank_ns > refresh_ns) {
+		vblank_ns = now_ns;
+	}
+	uint64_t deadline_ns = vblank_ns + refresh_ns - render_ns;
+	if (deadline_ns <= now_ns) {
+		return 0;
+	}
+	/* Round down, the event loop timer has millisecond resolution */
+	return (deadline_ns - now_ns) / 1000000;
+}
+
+static int
+handle_repaint_timer(void *data)
+{
+	struct output *output = data;
+	output->repaint.delayed = false;
+	if (output_can_repaint(output)) {
+		output_repaint(output);
+	}
+	return 0;
+}
+
+static void
+handle_output_frame(struct wl_listener *listener, void *data)
+{
+	/*
+	 * This function is called every time an output is ready to display a
+	 * frame - which is typically at 60 Hz.
+	 */
+	struct output *output = wl_container_of(listener, output, frame);
+
+	/* A delayed repaint is pending already */
+	if (output->repaint.delayed) {
+		return;
+	}
+	if (!output_can_repaint(output)) {
+		return;
 	}
 
 	struct timespec now = { 0 };
 	clock_gettime(CLOCK_MONOTONIC, &now);
-	wlr_scene_output_send_frame_done(output->scene_output, &now);
+	output->repaint.frame_ns = timespec_to_ns(&now);
+
+	/*
+	 * Render as late as possible before the next vblank when
+	 * <core><maxRenderTime> is set, so that the frame shows the
+	 * latest client buffers and cursor position.
+	 */
+	int delay = repaint_delay_ms(output, output->repaint.frame_ns);
+	if (delay > 0) {
+		output->repaint.delayed = true;
+		wl_event_source_timer_update(output->repaint.timer, delay);
+		return;
+	}
+	output_repaint(output);
+}
+
+static void
+handle_output_present(struct wl_listener *listener, void *data)
+{
+	struct output *output = wl_container_of(listener, output, present);
+	struct wlr_output_event_present *event = data;
+	uint64_t present_ns =
+		event->presented ? timespec_to_ns(&event->when) : 0;
+	frame_timing_presented(&output->timing, event->commit_seq, present_ns);
+
+	if (event->presented) {
+		output->repaint.present_ns = present_ns;
+		output->repaint.refresh_ns = MAX(event->refresh, 0);
+	}
+}
+
+static void
+evict_inactive_scales(void *data)
+{
+	struct server *server = data;
+	server->evict_scales_idle = NULL;
+	scaled_buffer_evict_inactive_scales();
 }
 
 static void
@@ -167,6 +326,9 @@ handle_output_destroy(struct wl_listener *listener, void *data)
 {
 	struct output *output = wl_container_of(listener, output, destroy);
 	struct seat *seat = &output->server->seat;
+	ipc_output_destroyed(output->server->ipc_server, output);
+	view_flush_titles(output->server, output);
+	frame_timing_finish(&output->timing, output->wlr_output->name);
 	regions_evacuate_output(output);
 	regions_destroy(seat, &output->regions);
 	if (seat->overlay.active.output == output) {
@@ -174,7 +336,9 @@ handle_output_destroy(struct wl_listener *listener, void *data)
 	}
 	wl_list_remove(&output->link);
 	wl_list_remove(&output->frame.link);
+	wl_list_remove(&output->present.link);
 	wl_list_remove(&output->destroy.link);
+	wl_event_source_remove(output->repaint.timer);
 	wl_list_remove(&output->request_state.link);
 	seat_output_layout_changed(seat);
 
@@ -197,6 +361,15 @@ handle_output_destroy(struct wl_listener *listener, void *data)
 		}
 	}
 
+	/*
+	 * Buffers only switch away from the scale of this output when the
+	 * scene output is gone, so drop what was rendered for it after that
+	 */
+	if (!server->evict_scales_idle) {
+		server->evict_scales_idle = wl_event_loop_add_idle(
+			server->wl_event_loop, evict_inactive_scales, server);
+	}
+
 	wlr_output_state_finish(&output->pending);
 
 	/*
@@ -537,6 +710,10 @@ handle_new_output(struct wl_listener *listener, void *data)
 	wl_signal_add(&wlr_output->events.destroy, &output->destroy);
 	output->frame.notify = handle_output_frame;
 	wl_signal_add(&wlr_output->events.frame, &output->frame);
+	output->present.notify = handle_output_present;
+	wl_signal_add(&wlr_output->events.present, &output->present);
+	output->repaint.timer = wl_event_loop_add_timer(server->wl_event_loop,
+		handle_repaint_timer, output);
 
 	output->request_state.notify = handle_output_request_state;
 	wl_signal_add(&wlr_output->events.request_state, &output->request_state);
@@ -604,6 +781,11 @@ output_init(struct server *server)
 	server->new_output.notify = handle_new_output;
 	wl_signal_add(&server->backend->events.new_output, &server->new_output);
 
+	const char *trace = getenv("LABWC_FRAME_TRACE");
+	if (trace) {
+		frame_timing_trace_open(trace);
+	}
+
 	/*
 	 * Create an output layout, which is a wlroots utility for working with
 	 * an arrangement of screens in a physical layout.
@@ -637,6 +819,7 @@ output_finish(struct server *server)
 {
 	wl_list_remove(&server->new_output.link);
 	output_manager_finish(server);
+	frame_timing_trace_close();
 }
 
 static void
@@ -45,6 +45,8 @@
 #endif
 
 #include "action.h"
+#include "common/font-cache.h"
+#include "common/icon-cache.h"
 #include "common/macros.h"
 #include "config/rcxml.h"
 #include "config/session.h"
@@ -76,34 +78,69 @@
 #define LAB_WLR_LINUX_DMABUF_VERSION 4
 #define LAB_WLR_PRESENTATION_TIME_VERSION 2
 
+static int handle_sighup(int signal, void *data);
+
+/* Swaps in the theme built by reload_config_and_theme() */
+static void
+handle_theme_ready(struct theme *theme, void *data)
+{
+	struct server *server = data;
+
+	scaled_buffer_invalidate_sharing();
+	/* Text rendered with the old fonts and colors is of no use now */
+	font_cache_clear();
+	theme_finish(server->theme);
+	/* rc.theme points to server->theme, so update it in place */
+	*server->theme = *theme;
+	free(theme);
+
+	struct view *view;
+	wl_list_for_each(view, &server->views, link) {
+		view_reload_ssd(view);
+	}
+
+	menu_reconfigure(server);
+	resize_indicator_reconfigure(server);
+
+	if (server->reconfigure_deferred) {
+		server->reconfigure_deferred = false;
+		handle_sighup(SIGHUP, server);
+	}
+}
+
 static void
 reload_config_and_theme(struct server *server)
 {
+	if (server->theme_build) {
+		/* The theme workers still use rc, try again once done */
+		server->reconfigure_deferred = true;
+		return;
+	}
+
 	/* Avoid UAF when dialog client is used during reconfigure */
 	action_prompts_destroy();
 
-	scaled_buffer_invalidate_sharing();
 	rcxml_finish();
 	rcxml_read(rc.config_file);
-	theme_finish(server->theme);
-	theme_init(server->theme, server, rc.theme_name);
 
 #if HAVE_LIBSFDO
 	desktop_entry_finish(server);
+	/* Including icons that were not found with the old icon theme */
+	icon_cache_clear();
 	desktop_entry_init(server);
 #endif
 
-	struct view *view;
-	wl_list_for_each(view, &server->views, link) {
-		view_reload_ssd(view);
-	}
-
-	menu_reconfigure(server);
 	seat_reconfigure(server);
 	regions_reconfigure(server);
-	resize_indicator_reconfigure(server);
 	kde_server_decoration_update_default();
 	workspaces_reconfigure(server);
+
+	/*
+	 * Keep using the old theme while the new one is rasterized, so a big
+	 * theme doesn't stall input. Everything depending on the theme is
+	 * updated at once in handle_theme_ready().
+	 */
+	theme_build_async(server, rc.theme_name, handle_theme_ready, server);
 }
 
 static int
@@ -111,6 +148,12 @@ handle_sighup(int signal, void *data)
 {
 	struct server *server = data;
 
+	if (server->theme_build) {
+		/* Not even touching the environment, the workers read it */
+		server->reconfigure_deferred = true;
+		return 0;
+	}
+
 	keyboard_cancel_all_keybind_repeats(&server->seat);
 	session_environment_init();
 	reload_config_and_theme(server);
@@ -549,6 +592,8 @@ server_init(struct server *server)
 
 	wl_list_init(&server->views);
 	wl_list_init(&server->unmanaged_surfaces);
+	view_title_updates_init(server);
+	theme_builder_init(server);
 
 	server->scene = wlr_scene_create();
 	if (!server->scene) {
@@ -723,11 +768,8 @@ server_init(struct server *server)
 #if HAVE_XWAYLAND
 	xwayland_server_init(server, server->compositor);
 #endif
-	// Initialize IPC server at the end
-server->ipc_server = ipc_server_init(server);
-if (!server->ipc_server) {
-	wlr_log(WLR_ERROR, "Failed to initialize IPC server");
-}
+
+	server->ipc_server = ipc_server_init(server);
 }
 
 void
@@ -740,6 +782,13 @@ server_start(struct server *server)
 		exit(EXIT_FAILURE);
 	}
 
+	/*
+	 * The IPC socket is named after the Wayland socket so that nested and
+	 * headless instances do not clash. Listen before starting the backend
+	 * so that LABWC_IPC_SOCKET is exported before any client is spawned.
+	 */
+	ipc_server_listen(server->ipc_server, socket);
+
 	/*
 	 * Start the backend. This will enumerate outputs and inputs, become
 	 * the DRM master, etc
@@ -772,6 +821,8 @@ server_finish(struct server *server)
 	wl_event_source_remove(server->sigint_source);
 	wl_event_source_remove(server->sigterm_source);
 	wl_event_source_remove(server->sigchld_source);
+	view_title_updates_finish(server);
+	theme_builder_finish(server);
 
 	wl_display_destroy_clients(server->wl_display);
 
@@ -792,6 +843,12 @@ server_finish(struct server *server)
 	wlr_backend_destroy(server->backend);
 	wlr_allocator_destroy(server->allocator);
 
+	/* Queued by the outputs destroyed along with the backend */
+	if (server->evict_scales_idle) {
+		wl_event_source_remove(server->evict_scales_idle);
+		server->evict_scales_idle = NULL;
+	}
+
 	wl_list_remove(&server->renderer_lost.link);
 	wlr_renderer_destroy(server->renderer);
 
@@ -800,4 +857,5 @@ server_finish(struct server *server)
 
 	wl_display_destroy(server->wl_display);
 	ipc_server_finish(server->ipc_server);
+	lab_id_map_finish(&server->view_ids);
 }
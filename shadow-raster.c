@@ -0,0 +1,309 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include "shadow-raster.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "common/macros.h"
+#include "common/mem.h"
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#define HAVE_SSE2 1
+#include <immintrin.h>
+#endif
+
+/* Standard deviation normalised against the shadow width, squared */
+#define SHADOW_VARIANCE (0.3 * 0.3)
+
+/*
+ * Two states with edge, top and bottom corner each, for two output scales
+ * and some spare
+ */
+#define SHADOW_CACHE_SIZE 16
+
+struct cached_raster {
+	struct shadow_raster_key key;
+	uint32_t *pixels;
+	int width, height;
+	uint64_t last_used;
+};
+
+static struct {
+	struct cached_raster entries[SHADOW_CACHE_SIZE];
+	uint64_t clock;
+	uint64_t hits, misses;
+} cache;
+
+void
+shadow_falloff_lut(float *lut, int size)
+{
+	for (int i = 0; i < size; i++) {
+		double xn = (double)i / (double)size;
+		lut[i] = exp(-(xn * xn) / SHADOW_VARIANCE);
+	}
+}
+
+/* Channel multipliers in memory order of ARGB8888: B, G, R, A */
+static void
+channel_factors(float k[4], const float color[4])
+{
+	static const int order[4] = { 2, 1, 0, 3 };
+	for (int i = 0; i < 4; i++) {
+		k[i] = fminf(fmaxf(color[order[i]], 0.0f), 1.0f) * 255.0f;
+	}
+}
+
+static void
+fill_row_scalar(uint32_t *row, const float *lut, float weight, int count,
+		const float k[4])
+{
+	for (int i = 0; i < count; i++) {
+		float alpha = lut[i] * weight;
+		row[i] = (uint32_t)(k[0] * alpha)
+			| (uint32_t)(k[1] * alpha) << 8
+			| (uint32_t)(k[2] * alpha) << 16
+			| (uint32_t)(k[3] * alpha) << 24;
+	}
+}
+
+void
+shadow_fill_row_scalar(uint32_t *row, const float *lut, float weight,
+		int count, const float color[4])
+{
+	float k[4];
+	channel_factors(k, color);
+	fill_row_scalar(row, lut, weight, count, k);
+}
+
+#if HAVE_SSE2
+/*
+ * Same arithmetic as fill_row_scalar(), truncating conversions included,
+ * so all variants produce identical pixels.
+ */
+static void
+fill_row_sse2(uint32_t *row, const float *lut, float weight, int count,
+		const float k[4])
+{
+	__m128 w = _mm_set1_ps(weight);
+	__m128 kb = _mm_set1_ps(k[0]);
+	__m128 kg = _mm_set1_ps(k[1]);
+	__m128 kr = _mm_set1_ps(k[2]);
+	__m128 ka = _mm_set1_ps(k[3]);
+
+	int i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128 alpha = _mm_mul_ps(_mm_loadu_ps(lut + i), w);
+		__m128i b = _mm_cvttps_epi32(_mm_mul_ps(kb, alpha));
+		__m128i g = _mm_cvttps_epi32(_mm_mul_ps(kg, alpha));
+		__m128i r = _mm_cvttps_epi32(_mm_mul_ps(kr, alpha));
+		__m128i a = _mm_cvttps_epi32(_mm_mul_ps(ka, alpha));
+		__m128i pixels = _mm_or_si128(
+			_mm_or_si128(b, _mm_slli_epi32(g, 8)),
+			_mm_or_si128(_mm_slli_epi32(r, 16),
+				_mm_slli_epi32(a, 24)));
+		_mm_storeu_si128((__m128i *)(row + i), pixels);
+	}
+	fill_row_scalar(row + i, lut + i, weight, count - i, k);
+}
+
+__attribute__((target("avx2")))
+static void
+fill_row_avx2(uint32_t *row, const float *lut, float weight, int count,
+		const float k[4])
+{
+	__m256 w = _mm256_set1_ps(weight);
+	__m256 kb = _mm256_set1_ps(k[0]);
+	__m256 kg = _mm256_set1_ps(k[1]);
+	__m256 kr = _mm256_set1_ps(k[2]);
+	__m256 ka = _mm256_set1_ps(k[3]);
+
+	int i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256 alpha = _mm256_mul_ps(_mm256_loadu_ps(lut + i), w);
+		__m256i b = _mm256_cvttps_epi32(_mm256_mul_ps(kb, alpha));
+		__m256i g = _mm256_cvttps_epi32(_mm256_mul_ps(kg, alpha));
+		__m256i r = _mm256_cvttps_epi32(_mm256_mul_ps(kr, alpha));
+		__m256i a = _mm256_cvttps_epi32(_mm256_mul_ps(ka, alpha));
+		__m256i pixels = _mm256_or_si256(
+			_mm256_or_si256(b, _mm256_slli_epi32(g, 8)),
+			_mm256_or_si256(_mm256_slli_epi32(r, 16),
+				_mm256_slli_epi32(a, 24)));
+		_mm256_storeu_si256((__m256i *)(row + i), pixels);
+	}
+	fill_row_sse2(row + i, lut + i, weight, count - i, k);
+}
+#endif
+
+typedef void (*fill_row_func_t)(uint32_t *row, const float *lut,
+	float weight, int count, const float k[4]);
+
+static fill_row_func_t
+get_fill_row(void)
+{
+	static fill_row_func_t fill_row;
+	if (fill_row) {
+		return fill_row;
+	}
+	fill_row = fill_row_scalar;
+#if HAVE_SSE2
+	fill_row = fill_row_sse2;
+	if (__builtin_cpu_supports("avx2")) {
+		fill_row = fill_row_avx2;
+	}
+#endif
+	return fill_row;
+}
+
+void
+shadow_fill_row(uint32_t *row, const float *lut, float weight, int count,
+		const float color[4])
+{
+	float k[4];
+	channel_factors(k, color);
+	get_fill_row()(row, lut, weight, count, k);
+}
+
+/* Rounds like buffer_create_cairo() */
+static int
+scaled(int size, float scale)
+{
+	return lroundf(size * scale);
+}
+
+void
+shadow_raster_size(const struct shadow_raster_key *key, int *width,
+		int *height)
+{
+	if (key->corner) {
+		*width = scaled(key->total_size, key->scale);
+		*height = *width;
+	} else {
+		*width = scaled(key->visible_size, key->scale);
+		*height = MAX(scaled(1, key->scale), 1);
+	}
+}
+
+static void
+draw_edge(const struct shadow_raster_key *key, uint32_t *pixels, int height)
+{
+	int visible_size = scaled(key->visible_size, key->scale);
+	int total_size = scaled(key->total_size, key->scale);
+	float *lut = xmalloc(total_size * sizeof(*lut));
+	shadow_falloff_lut(lut, total_size);
+
+	/*
+	 * The inset is not drawn for edges, but the falloff still has to
+	 * line up with the corners which do have it.
+	 */
+	float k[4];
+	channel_factors(k, key->color);
+	get_fill_row()(pixels, lut + total_size - visible_size, 1.0f,
+		visible_size, k);
+	free(lut);
+
+	/* The one logical pixel is more than one row when scaled up */
+	for (int y = 1; y < height; y++) {
+		memcpy(pixels + y * visible_size, pixels,
+			visible_size * sizeof(*pixels));
+	}
+}
+
+static void
+draw_corner(const struct shadow_raster_key *key, uint32_t *pixels)
+{
+	int total_size = scaled(key->total_size, key->scale);
+	int inset = total_size - scaled(key->visible_size, key->scale);
+	int titlebar_height = scaled(key->titlebar_height, key->scale);
+	float *lut = xmalloc(total_size * sizeof(*lut));
+	shadow_falloff_lut(lut, total_size);
+
+	float k[4];
+	channel_factors(k, key->color);
+	fill_row_func_t fill_row = get_fill_row();
+
+	for (int y = 0; y < total_size; y++) {
+		uint32_t *row = pixels + y * total_size;
+		/*
+		 * Leave clear what could be seen through a translucent window
+		 * without being covered by the always opaque titlebar. If the
+		 * inset is smaller than the titlebar there is nothing to do.
+		 */
+		int clear = 0;
+		if (y < inset - titlebar_height) {
+			clear = inset;
+		} else if (y < inset) {
+			clear = MAX(inset - titlebar_height, 0);
+		}
+		clear = MIN(clear, total_size);
+		memset(row, 0, clear * sizeof(*row));
+
+		/* The 2D Gaussian is the outer product of the 1D profiles */
+		fill_row(row + clear, lut + clear, lut[y], total_size - clear, k);
+	}
+	free(lut);
+}
+
+static bool
+key_equal(const struct shadow_raster_key *a, const struct shadow_raster_key *b)
+{
+	return a->visible_size == b->visible_size
+		&& a->total_size == b->total_size
+		&& a->titlebar_height == b->titlebar_height
+		&& a->corner == b->corner
+		&& !memcmp(a->color, b->color, sizeof(a->color))
+		&& a->scale == b->scale;
+}
+
+static struct cached_raster *
+cache_get(const struct shadow_raster_key *key)
+{
+	struct cached_raster *lru = &cache.entries[0];
+	for (int i = 0; i < SHADOW_CACHE_SIZE; i++) {
+		struct cached_raster *entry = &cache.entries[i];
+		if (entry->pixels && key_equal(&entry->key, key)) {
+			entry->last_used = ++cache.clock;
+			cache.hits++;
+			return entry;
+		}
+		if (entry->last_used < lru->last_used) {
+			lru = entry;
+		}
+	}
+
+	cache.misses++;
+	free(lru->pixels);
+	lru->key = *key;
+	lru->last_used = ++cache.clock;
+	shadow_raster_size(key, &lru->width, &lru->height);
+	lru->pixels = xmalloc((size_t)lru->width * lru->height
+		* sizeof(*lru->pixels));
+	if (key->corner) {
+		draw_corner(key, lru->pixels);
+	} else {
+		draw_edge(key, lru->pixels, lru->height);
+	}
+	return lru;
+}
+
+void
+shadow_raster_draw(const struct shadow_raster_key *key, uint8_t *data,
+		int stride)
+{
+	int width, height;
+	shadow_raster_size(key, &width, &height);
+	if (width <= 0 || height <= 0) {
+		return;
+	}
+
+	struct cached_raster *entry = cache_get(key);
+	for (int y = 0; y < height; y++) {
+		memcpy(data + y * stride, entry->pixels + y * width,
+			width * sizeof(*entry->pixels));
+	}
+}
+
+void
+shadow_raster_cache_stats(uint64_t *hits, uint64_t *misses)
+{
+	*hits = cache.hits;
+	*misses = cache.misses;
+}
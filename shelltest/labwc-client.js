@@ -3,7 +3,7 @@ const net = require('net');
 const EventEmitter = require('events');
 
 class LabwcClient extends EventEmitter {
-    constructor(socketPath = '/tmp/labwc-nwjs.sock') {
+    constructor(socketPath = process.env.LABWC_IPC_SOCKET) {
         super();
         this.socketPath = socketPath;
         this.socket = null;
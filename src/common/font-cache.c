@@ -0,0 +1,250 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include "common/font-cache.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wayland-util.h>
+#include <wlr/types/wlr_buffer.h>
+#include <wlr/util/log.h>
+#include "buffer.h"
+#include "common/font.h"
+#include "common/graphic-helpers.h"
+#include "common/hash.h"
+#include "common/lru-cache.h"
+#include "common/mem.h"
+#include "common/string-helpers.h"
+
+/* Outputs with different scales a label is commonly shown on */
+#define FONT_CACHE_SCALES 4
+
+struct font_cache_entry {
+	/* Copy of the key */
+	char *text;
+	struct font font;
+	int max_width;
+	int fixed_height;
+	float color[4];
+	float bg_color[4];
+	cairo_pattern_t *bg_pattern;
+
+	int width, height;
+	struct {
+		double scale;
+		struct lab_data_buffer *buffer; /* locked */
+	} rendered[FONT_CACHE_SCALES];
+	int nr_rendered;
+
+	struct lab_lru_entry base;
+};
+
+static void entry_destroy(struct lab_lru_entry *base);
+
+static struct {
+	struct lab_lru_cache entries;
+	uint64_t hits, misses;
+} cache = {
+	.entries = LAB_LRU_CACHE_INIT(cache.entries, FONT_CACHE_MAX_BYTES,
+		entry_destroy),
+};
+
+static uint64_t
+key_hash(const struct font_cache_key *key)
+{
+	uint64_t hash = LAB_HASH_INIT;
+	hash = lab_hash_string(hash, key->text);
+	hash = lab_hash_string(hash, key->font->name);
+	hash = lab_hash_bytes(hash, &key->font->size, sizeof(key->font->size));
+	hash = lab_hash_bytes(hash, &key->font->slant, sizeof(key->font->slant));
+	hash = lab_hash_bytes(hash, &key->font->weight,
+		sizeof(key->font->weight));
+	hash = lab_hash_bytes(hash, &key->max_width, sizeof(key->max_width));
+	hash = lab_hash_bytes(hash, &key->fixed_height,
+		sizeof(key->fixed_height));
+	hash = lab_hash_bytes(hash, key->color, 4 * sizeof(float));
+	if (key->bg_pattern) {
+		hash = lab_hash_bytes(hash, &key->bg_pattern,
+			sizeof(key->bg_pattern));
+	} else {
+		hash = lab_hash_bytes(hash, key->bg_color, 4 * sizeof(float));
+	}
+	return lab_hash_to_id(hash);
+}
+
+static bool
+entry_matches(const struct font_cache_entry *entry,
+		const struct font_cache_key *key)
+{
+	return str_equal(entry->text, key->text)
+		&& str_equal(entry->font.name, key->font->name)
+		&& entry->font.size == key->font->size
+		&& entry->font.slant == key->font->slant
+		&& entry->font.weight == key->font->weight
+		&& entry->max_width == key->max_width
+		&& entry->fixed_height == key->fixed_height
+		&& !memcmp(entry->color, key->color, sizeof(entry->color))
+		&& entry->bg_pattern == key->bg_pattern
+		&& (key->bg_pattern || !memcmp(entry->bg_color, key->bg_color,
+			sizeof(entry->bg_color)));
+}
+
+static void
+release_buffer(struct lab_data_buffer *buffer)
+{
+	/* Users may still hold locks, see font_cache_get_buffer() */
+	if (!buffer->base.dropped) {
+		wlr_buffer_drop(&buffer->base);
+	}
+	wlr_buffer_unlock(&buffer->base);
+}
+
+static size_t
+buffer_bytes(struct lab_data_buffer *buffer)
+{
+	return (size_t)buffer->stride * buffer->base.height;
+}
+
+static void
+entry_destroy(struct lab_lru_entry *base)
+{
+	struct font_cache_entry *entry = wl_container_of(base, entry, base);
+	lab_lru_cache_remove(&cache.entries, base);
+	for (int i = 0; i < entry->nr_rendered; i++) {
+		release_buffer(entry->rendered[i].buffer);
+	}
+
+	zfree_pattern(entry->bg_pattern);
+	free(entry->text);
+	free(entry->font.name);
+	free(entry);
+}
+
+static struct font_cache_entry *
+lookup(const struct font_cache_key *key)
+{
+	uint64_t hash = key_hash(key);
+	struct lab_id_chain *node =
+		lab_id_chain_first(&cache.entries.by_id, hash);
+	for (; node; node = node->next) {
+		struct font_cache_entry *entry =
+			wl_container_of(node, entry, base.chain);
+		if (entry_matches(entry, key)) {
+			lab_lru_cache_touch(&cache.entries, &entry->base);
+			return entry;
+		}
+	}
+
+	struct font_cache_entry *entry = znew(*entry);
+	entry->text = xstrdup(key->text);
+	entry->font = *key->font;
+	entry->font.name = key->font->name ? xstrdup(key->font->name) : NULL;
+	entry->max_width = key->max_width;
+	entry->fixed_height = key->fixed_height;
+	memcpy(entry->color, key->color, sizeof(entry->color));
+	if (key->bg_pattern) {
+		entry->bg_pattern = cairo_pattern_reference(key->bg_pattern);
+	} else {
+		memcpy(entry->bg_color, key->bg_color, sizeof(entry->bg_color));
+	}
+
+	/* Shapes the text once for all scales */
+	int computed_height;
+	font_get_buffer_size(entry->max_width, entry->text, &entry->font,
+		&entry->width, &computed_height);
+	entry->height = entry->fixed_height > 0 ?
+		entry->fixed_height : computed_height;
+
+	/* Sizes of unrendered labels are cached too, count them */
+	entry->base.bytes = sizeof(*entry) + strlen(entry->text);
+	lab_lru_cache_add(&cache.entries, &entry->base, hash);
+	lab_lru_cache_evict(&cache.entries, &entry->base);
+	return entry;
+}
+
+void
+font_cache_get_size(const struct font_cache_key *key, int *width,
+		int *height)
+{
+	struct font_cache_entry *entry = lookup(key);
+	*width = entry->width;
+	*height = entry->height;
+}
+
+static struct lab_data_buffer *
+render(struct font_cache_entry *entry, double scale)
+{
+	struct lab_data_buffer *buffer = NULL;
+	cairo_pattern_t *bg_pattern = entry->bg_pattern;
+	cairo_pattern_t *solid_bg_pattern = NULL;
+
+	if (!bg_pattern) {
+		solid_bg_pattern = color_to_pattern(entry->bg_color);
+		bg_pattern = solid_bg_pattern;
+	}
+
+	font_buffer_create(&buffer, entry->max_width, entry->height,
+		entry->text, &entry->font, entry->color, bg_pattern, scale);
+	if (!buffer) {
+		wlr_log(WLR_ERROR, "font_buffer_create() failed");
+	}
+
+	zfree_pattern(solid_bg_pattern);
+	return buffer;
+}
+
+struct lab_data_buffer *
+font_cache_get_buffer(const struct font_cache_key *key, double scale)
+{
+	if (string_null_or_empty(key->text)) {
+		return NULL;
+	}
+
+	struct font_cache_entry *entry = lookup(key);
+	for (int i = 0; i < entry->nr_rendered; i++) {
+		if (entry->rendered[i].scale == scale) {
+			cache.hits++;
+			return entry->rendered[i].buffer;
+		}
+	}
+
+	cache.misses++;
+	struct lab_data_buffer *buffer = render(entry, scale);
+	if (!buffer) {
+		return NULL;
+	}
+
+	/* Make room by forgetting the scale rendered first */
+	if (entry->nr_rendered == FONT_CACHE_SCALES) {
+		struct lab_data_buffer *oldest = entry->rendered[0].buffer;
+		lab_lru_cache_set_bytes(&cache.entries, &entry->base,
+			entry->base.bytes - buffer_bytes(oldest));
+		release_buffer(oldest);
+		memmove(&entry->rendered[0], &entry->rendered[1],
+			(FONT_CACHE_SCALES - 1) * sizeof(entry->rendered[0]));
+		entry->nr_rendered--;
+	}
+
+	wlr_buffer_lock(&buffer->base);
+	entry->rendered[entry->nr_rendered].scale = scale;
+	entry->rendered[entry->nr_rendered].buffer = buffer;
+	entry->nr_rendered++;
+	lab_lru_cache_set_bytes(&cache.entries, &entry->base,
+		entry->base.bytes + buffer_bytes(buffer));
+	lab_lru_cache_evict(&cache.entries, &entry->base);
+
+	return buffer;
+}
+
+void
+font_cache_clear(void)
+{
+	lab_lru_cache_clear(&cache.entries);
+}
+
+void
+font_cache_get_stats(struct font_cache_stats *stats)
+{
+	stats->hits = cache.hits;
+	stats->misses = cache.misses;
+	stats->entries = cache.entries.nr_entries;
+	stats->bytes = cache.entries.bytes;
+}
@@ -0,0 +1,150 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include "common/icon-cache.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wayland-util.h>
+#include <wlr/types/wlr_buffer.h>
+#include "buffer.h"
+#include "common/hash.h"
+#include "common/lru-cache.h"
+#include "common/mem.h"
+#include "common/string-helpers.h"
+
+struct icon_cache_entry {
+	/* Copy of the key */
+	enum icon_cache_source source;
+	char *name;
+	int width;
+	int height;
+	double scale;
+
+	struct lab_data_buffer *buffer; /* locked, NULL if there is no icon */
+
+	struct lab_lru_entry base;
+};
+
+static void entry_destroy(struct lab_lru_entry *base);
+
+static struct {
+	struct lab_lru_cache entries;
+	uint64_t hits, misses;
+} cache = {
+	.entries = LAB_LRU_CACHE_INIT(cache.entries, ICON_CACHE_MAX_BYTES,
+		entry_destroy),
+};
+
+static uint64_t
+key_hash(const struct icon_cache_key *key)
+{
+	uint64_t hash = LAB_HASH_INIT;
+	hash = lab_hash_bytes(hash, &key->source, sizeof(key->source));
+	hash = lab_hash_string(hash, key->name);
+	hash = lab_hash_bytes(hash, &key->width, sizeof(key->width));
+	hash = lab_hash_bytes(hash, &key->height, sizeof(key->height));
+	hash = lab_hash_bytes(hash, &key->scale, sizeof(key->scale));
+	return lab_hash_to_id(hash);
+}
+
+static bool
+entry_matches(const struct icon_cache_entry *entry,
+		const struct icon_cache_key *key)
+{
+	return entry->source == key->source
+		&& str_equal(entry->name, key->name)
+		&& entry->width == key->width
+		&& entry->height == key->height
+		&& entry->scale == key->scale;
+}
+
+static void
+entry_destroy(struct lab_lru_entry *base)
+{
+	struct icon_cache_entry *entry = wl_container_of(base, entry, base);
+	lab_lru_cache_remove(&cache.entries, base);
+	if (entry->buffer) {
+		/* Users may still hold locks, see icon_cache_lookup() */
+		if (!entry->buffer->base.dropped) {
+			wlr_buffer_drop(&entry->buffer->base);
+		}
+		wlr_buffer_unlock(&entry->buffer->base);
+	}
+
+	free(entry->name);
+	free(entry);
+}
+
+static struct icon_cache_entry *
+find(const struct icon_cache_key *key, uint64_t hash)
+{
+	struct lab_id_chain *node =
+		lab_id_chain_first(&cache.entries.by_id, hash);
+	for (; node; node = node->next) {
+		struct icon_cache_entry *entry =
+			wl_container_of(node, entry, base.chain);
+		if (entry_matches(entry, key)) {
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+bool
+icon_cache_lookup(const struct icon_cache_key *key,
+		struct lab_data_buffer **buffer)
+{
+	struct icon_cache_entry *entry = find(key, key_hash(key));
+	if (!entry) {
+		cache.misses++;
+		return false;
+	}
+	cache.hits++;
+	lab_lru_cache_touch(&cache.entries, &entry->base);
+	*buffer = entry->buffer;
+	return true;
+}
+
+void
+icon_cache_insert(const struct icon_cache_key *key,
+		struct lab_data_buffer *buffer)
+{
+	uint64_t hash = key_hash(key);
+	if (find(key, hash)) {
+		/* Loaded twice, keep the one which may be in use already */
+		if (buffer) {
+			wlr_buffer_drop(&buffer->base);
+		}
+		return;
+	}
+
+	struct icon_cache_entry *entry = znew(*entry);
+	entry->source = key->source;
+	entry->name = xstrdup(key->name);
+	entry->width = key->width;
+	entry->height = key->height;
+	entry->scale = key->scale;
+	entry->buffer = buffer;
+	entry->base.bytes = sizeof(*entry) + strlen(entry->name);
+	if (buffer) {
+		wlr_buffer_lock(&buffer->base);
+		entry->base.bytes += (size_t)buffer->stride * buffer->base.height;
+	}
+
+	lab_lru_cache_add(&cache.entries, &entry->base, hash);
+	lab_lru_cache_evict(&cache.entries, &entry->base);
+}
+
+void
+icon_cache_clear(void)
+{
+	lab_lru_cache_clear(&cache.entries);
+}
+
+void
+icon_cache_get_stats(struct icon_cache_stats *stats)
+{
+	stats->hits = cache.hits;
+	stats->misses = cache.misses;
+	stats->entries = cache.entries.nr_entries;
+	stats->bytes = cache.entries.bytes;
+}
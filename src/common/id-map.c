@@ -0,0 +1,123 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include "common/id-map.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "common/mem.h"
+
+#define ID_MAP_MIN_CAPACITY 64
+
+/* Finalizer of splitmix64, spreads sequential ids over the table */
+static size_t
+hash_id(uint64_t id)
+{
+	id ^= id >> 30;
+	id *= 0xbf58476d1ce4e5b9ULL;
+	id ^= id >> 27;
+	id *= 0x94d049bb133111ebULL;
+	id ^= id >> 31;
+	return (size_t)id;
+}
+
+/* Returns the slot holding @id or the empty slot where it would go */
+static struct lab_id_map_entry *
+find_slot(struct lab_id_map_entry *entries, size_t capacity, uint64_t id)
+{
+	size_t mask = capacity - 1;
+	size_t i = hash_id(id) & mask;
+	while (entries[i].id && entries[i].id != id) {
+		i = (i + 1) & mask;
+	}
+	return &entries[i];
+}
+
+static void
+resize(struct lab_id_map *map, size_t capacity)
+{
+	struct lab_id_map_entry *entries = znew_n(*entries, capacity);
+	for (size_t i = 0; i < map->capacity; i++) {
+		struct lab_id_map_entry *entry = &map->entries[i];
+		if (entry->id) {
+			*find_slot(entries, capacity, entry->id) = *entry;
+		}
+	}
+	free(map->entries);
+	map->entries = entries;
+	map->capacity = capacity;
+}
+
+void
+lab_id_map_finish(struct lab_id_map *map)
+{
+	zfree(map->entries);
+	map->capacity = 0;
+	map->count = 0;
+}
+
+void
+lab_id_map_insert(struct lab_id_map *map, uint64_t id, void *value)
+{
+	assert(id);
+
+	/* Keep the load factor below 3/4 */
+	if ((map->count + 1) * 4 > map->capacity * 3) {
+		resize(map, map->capacity ? map->capacity * 2
+			: ID_MAP_MIN_CAPACITY);
+	}
+	struct lab_id_map_entry *entry =
+		find_slot(map->entries, map->capacity, id);
+	if (!entry->id) {
+		entry->id = id;
+		map->count++;
+	}
+	entry->value = value;
+}
+
+void *
+lab_id_map_lookup(struct lab_id_map *map, uint64_t id)
+{
+	if (!id || !map->capacity) {
+		return NULL;
+	}
+	return find_slot(map->entries, map->capacity, id)->value;
+}
+
+void
+lab_id_map_remove(struct lab_id_map *map, uint64_t id)
+{
+	if (!id || !map->capacity) {
+		return;
+	}
+	struct lab_id_map_entry *hole =
+		find_slot(map->entries, map->capacity, id);
+	if (!hole->id) {
+		return;
+	}
+	map->count--;
+
+	/*
+	 * Shift following entries of the probe sequence back into the hole,
+	 * so that lookups never need tombstones.
+	 */
+	size_t mask = map->capacity - 1;
+	size_t i = hole - map->entries;
+	size_t j = i;
+	for (;;) {
+		map->entries[i] = (struct lab_id_map_entry){ 0 };
+		for (;;) {
+			j = (j + 1) & mask;
+			if (!map->entries[j].id) {
+				return;
+			}
+			/* Entries whose home slot lies in (i, j] must stay */
+			size_t home = hash_id(map->entries[j].id) & mask;
+			bool stays = i <= j ? (i < home && home <= j)
+				: (i < home || home <= j);
+			if (!stays) {
+				break;
+			}
+		}
+		map->entries[i] = map->entries[j];
+		i = j;
+	}
+}
@@ -0,0 +1,101 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include "common/lru-cache.h"
+#include <assert.h>
+
+struct lab_id_chain *
+lab_id_chain_first(struct lab_id_map *map, uint64_t id)
+{
+	return lab_id_map_lookup(map, id);
+}
+
+void
+lab_id_chain_insert(struct lab_id_map *map, struct lab_id_chain *node,
+		uint64_t id)
+{
+	assert(id);
+	node->id = id;
+	node->next = lab_id_map_lookup(map, id);
+	lab_id_map_insert(map, id, node);
+}
+
+void
+lab_id_chain_remove(struct lab_id_map *map, struct lab_id_chain *node)
+{
+	if (!node->id) {
+		return;
+	}
+	struct lab_id_chain *head = lab_id_map_lookup(map, node->id);
+	if (head == node) {
+		if (node->next) {
+			lab_id_map_insert(map, node->id, node->next);
+		} else {
+			lab_id_map_remove(map, node->id);
+		}
+	} else {
+		while (head->next != node) {
+			head = head->next;
+		}
+		head->next = node->next;
+	}
+	node->id = 0;
+	node->next = NULL;
+}
+
+void
+lab_lru_cache_add(struct lab_lru_cache *cache, struct lab_lru_entry *entry,
+		uint64_t id)
+{
+	lab_id_chain_insert(&cache->by_id, &entry->chain, id);
+	wl_list_insert(&cache->lru, &entry->link);
+	cache->nr_entries++;
+	cache->bytes += entry->bytes;
+}
+
+void
+lab_lru_cache_remove(struct lab_lru_cache *cache, struct lab_lru_entry *entry)
+{
+	lab_id_chain_remove(&cache->by_id, &entry->chain);
+	wl_list_remove(&entry->link);
+	cache->nr_entries--;
+	cache->bytes -= entry->bytes;
+}
+
+void
+lab_lru_cache_touch(struct lab_lru_cache *cache, struct lab_lru_entry *entry)
+{
+	wl_list_remove(&entry->link);
+	wl_list_insert(&cache->lru, &entry->link);
+}
+
+void
+lab_lru_cache_set_bytes(struct lab_lru_cache *cache,
+		struct lab_lru_entry *entry, size_t bytes)
+{
+	cache->bytes = cache->bytes - entry->bytes + bytes;
+	entry->bytes = bytes;
+}
+
+void
+lab_lru_cache_evict(struct lab_lru_cache *cache, struct lab_lru_entry *keep)
+{
+	struct lab_lru_entry *entry, *tmp;
+	wl_list_for_each_reverse_safe(entry, tmp, &cache->lru, link) {
+		if (cache->bytes <= cache->max_bytes) {
+			break;
+		}
+		if (entry != keep) {
+			cache->destroy(entry);
+		}
+	}
+}
+
+void
+lab_lru_cache_clear(struct lab_lru_cache *cache)
+{
+	struct lab_lru_entry *entry, *tmp;
+	wl_list_for_each_safe(entry, tmp, &cache->lru, link) {
+		cache->destroy(entry);
+	}
+	assert(!cache->nr_entries);
+	lab_id_map_finish(&cache->by_id);
+}
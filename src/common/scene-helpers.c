@@ -2,9 +2,15 @@
 
 #include "common/scene-helpers.h"
 #include <assert.h>
+#include <time.h>
 #include <wlr/types/wlr_output.h>
 #include <wlr/types/wlr_scene.h>
 #include <wlr/util/log.h>
+#include <wlr/util/region.h>
+#include "frame-timing.h"
+#include "input/cursor.h"
+#include "labwc-ipc-thumbnail.h"
+#include "labwc.h"
 #include "magnifier.h"
 #include "output.h"
 
@@ -37,55 +43,97 @@ lab_wlr_scene_get_prev_node(struct wlr_scene_node *node)
 }
 
 /*
- * This is a slightly modified copy of scene_output_damage(),
- * required to properly add the magnifier damage to scene_output
- * ->damage_ring and scene_output->pending_commit_damage.
- *
- * The only difference is code style and removal of wlr_output_schedule_frame().
+ * The magnifier draws over the output buffer behind the back of the scene.
+ * Adding its area to the damage ring makes the scene repaint it the next
+ * time each buffer is rendered. Unlike scene_output_damage() this does not
+ * add to the pending commit damage, which would force another frame.
  */
 static void
-scene_output_damage(struct wlr_scene_output *scene_output,
-		const pixman_region32_t *damage)
+scene_output_damage_ring_add(struct wlr_scene_output *scene_output,
+		const struct wlr_box *box)
 {
 	struct wlr_output *output = scene_output->output;
 
 	pixman_region32_t clipped;
-	pixman_region32_init(&clipped);
-	pixman_region32_intersect_rect(&clipped, damage, 0, 0, output->width, output->height);
+	pixman_region32_init_rect(&clipped, box->x, box->y,
+		box->width, box->height);
+	pixman_region32_intersect_rect(&clipped, &clipped, 0, 0,
+		output->width, output->height);
 
 	if (pixman_region32_not_empty(&clipped)) {
 		wlr_damage_ring_add(&scene_output->damage_ring, &clipped);
-		pixman_region32_union(&scene_output->WLR_PRIVATE.pending_commit_damage,
-			&scene_output->WLR_PRIVATE.pending_commit_damage, &clipped);
 	}
 
 	pixman_region32_fini(&clipped);
 }
 
+/* Returns the damage that was not rendered yet, in layout coordinates */
+static void
+scene_output_layout_damage(struct wlr_scene_output *scene_output,
+		pixman_region32_t *damage)
+{
+	struct wlr_output *wlr_output = scene_output->output;
+	wlr_region_transform(damage,
+		&scene_output->WLR_PRIVATE.pending_commit_damage,
+		wlr_output->transform, wlr_output->width, wlr_output->height);
+	wlr_region_scale(damage, damage, 1.0f / wlr_output->scale);
+	/* Make up for rounding in the scale */
+	wlr_region_expand(damage, damage, 1);
+	pixman_region32_translate(damage, scene_output->x, scene_output->y);
+}
+
+static uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
 /*
  * This is a copy of wlr_scene_output_commit()
  * as it doesn't use the pending state at all.
  */
 bool
 lab_wlr_scene_output_commit(struct wlr_scene_output *scene_output,
-		struct wlr_output_state *state)
+		struct wlr_output_state *state, struct frame_timing_sample *sample)
 {
 	assert(scene_output);
 	assert(state);
 	struct wlr_output *wlr_output = scene_output->output;
 	struct output *output = wlr_output->data;
-	bool wants_magnification = output_wants_magnification(output);
 
 	/*
-	 * FIXME: Regardless of wants_magnification, we are currently adding
-	 * damages to next frame when magnifier is shown, which forces
-	 * rendering on every output commit and overloads CPU.
-	 * We also need to verify the necessity of wants_magnification.
+	 * The magnifier only needs a frame of its own when the cursor moved,
+	 * the scale changed or it was hidden; scene damage is enough to
+	 * keep its content up to date otherwise.
 	 */
-	if (!wlr_scene_output_needs_frame(scene_output) && !wants_magnification) {
+	if (!wlr_scene_output_needs_frame(scene_output)
+			&& !output_wants_magnification(output)) {
+		if (!wlr_box_empty(&output->magnifier.box)) {
+			output->magnifier.frames_skipped++;
+		}
+		if (sample) {
+			sample->skipped = true;
+		}
 		return true;
 	}
 
+	/*
+	 * Building the state consumes the damage the hit-test cache and
+	 * the thumbnail streams need
+	 */
+	if (pixman_region32_not_empty(
+			&scene_output->WLR_PRIVATE.pending_commit_damage)) {
+		pixman_region32_t damage;
+		pixman_region32_init(&damage);
+		scene_output_layout_damage(scene_output, &damage);
+		cursor_context_cache_damage(&output->server->seat, &damage);
+		ipc_thumbnail_damage(output->server->ipc_server, &damage);
+		pixman_region32_fini(&damage);
+	}
+
+	uint64_t build_start = now_ns();
 	if (!wlr_scene_output_build_state(scene_output, state, NULL)) {
 		wlr_log(WLR_ERROR, "Failed to build output state for %s",
 			wlr_output->name);
@@ -98,11 +146,12 @@ lab_wlr_scene_output_commit(struct wlr_scene_output *scene_output,
 		}
 	}
 
-	struct wlr_box additional_damage = {0};
-	if (state->buffer && magnifier_is_enabled()) {
-		magnifier_draw(output, state->buffer, &additional_damage);
+	struct wlr_box magnifier_damage = {0};
+	if (state->buffer) {
+		magnifier_draw(output, state, &magnifier_damage);
 	}
 
+	uint64_t commit_start = now_ns();
 	bool committed = wlr_output_commit_state(wlr_output, state);
 	/*
 	 * Handle case where the output state test for tearing succeeded,
@@ -112,6 +161,18 @@ lab_wlr_scene_output_commit(struct wlr_scene_output *scene_output,
 		state->tearing_page_flip = false;
 		committed = wlr_output_commit_state(wlr_output, state);
 	}
+	if (sample) {
+		sample->commit_end_ns = now_ns();
+		sample->build_us = (commit_start - build_start) / 1000;
+		sample->commit_us = (sample->commit_end_ns - commit_start) / 1000;
+		sample->commit_seq = wlr_output->commit_seq;
+	}
+
+	/* The buffer was drawn over even if the commit failed */
+	if (!wlr_box_empty(&magnifier_damage)) {
+		scene_output_damage_ring_add(scene_output, &magnifier_damage);
+	}
+
 	if (committed) {
 		if (state == &output->pending) {
 			wlr_output_state_finish(&output->pending);
@@ -123,14 +184,5 @@ lab_wlr_scene_output_commit(struct wlr_scene_output *scene_output,
 		return false;
 	}
 
-	if (!wlr_box_empty(&additional_damage)) {
-		pixman_region32_t region;
-		pixman_region32_init_rect(&region,
-			additional_damage.x, additional_damage.y,
-			additional_damage.width, additional_damage.height);
-		scene_output_damage(scene_output, &region);
-		pixman_region32_fini(&region);
-	}
-
 	return true;
 }
@@ -1,8 +1,11 @@
 // SPDX-License-Identifier: GPL-2.0-only
 #include "debug.h"
+#include <inttypes.h>
 #include <stdlib.h>
 #include <wlr/types/wlr_layer_shell_v1.h>
 #include <wlr/types/wlr_scene.h>
+#include "common/font-cache.h"
+#include "common/icon-cache.h"
 #include "common/lab-scene-rect.h"
 #include "common/scene-helpers.h"
 #include "common/string-helpers.h"
@@ -246,6 +249,28 @@ debug_dump_scene(struct server *server)
 	dump_tree(server, &server->scene->tree.node, 0, 0, 0);
 	printf("\n");
 
+	uint64_t hits = server->seat.hit_cache.hits;
+	uint64_t lookups = hits + server->seat.hit_cache.misses;
+	printf("hit-test cache: %" PRIu64 " hits, %" PRIu64
+		" misses (%.1f%%)\n\n", hits, lookups - hits,
+		lookups ? 100.0 * hits / lookups : 0.0);
+
+	struct font_cache_stats font_stats;
+	font_cache_get_stats(&font_stats);
+	lookups = font_stats.hits + font_stats.misses;
+	printf("text cache: %" PRIu64 " hits, %" PRIu64 " misses (%.1f%%), "
+		"%zu entries, %zu kB\n\n", font_stats.hits, font_stats.misses,
+		lookups ? 100.0 * font_stats.hits / lookups : 0.0,
+		font_stats.entries, font_stats.bytes / 1024);
+
+	struct icon_cache_stats icon_stats;
+	icon_cache_get_stats(&icon_stats);
+	lookups = icon_stats.hits + icon_stats.misses;
+	printf("icon cache: %" PRIu64 " hits, %" PRIu64 " misses (%.1f%%), "
+		"%zu entries, %zu kB\n\n", icon_stats.hits, icon_stats.misses,
+		lookups ? 100.0 * icon_stats.hits / lookups : 0.0,
+		icon_stats.entries, icon_stats.bytes / 1024);
+
 	/*
 	 * Reset last_view so we don't access a
 	 * potentially free'd pointer on the next call
@@ -1,18 +1,26 @@
 // SPDX-License-Identifier: GPL-2.0-only
+#define _POSIX_C_SOURCE 200809L
 #include "desktop-entry.h"
 #include <locale.h>
+#include <pthread.h>
 #include <sfdo-desktop.h>
 #include <sfdo-icon.h>
 #include <sfdo-basedir.h>
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
+#include <unistd.h>
 #include <wlr/util/log.h>
+#include "common/macros.h"
 #include "common/mem.h"
 #include "common/string-helpers.h"
 #include "config/rcxml.h"
 #include "img/img.h"
 #include "labwc.h"
+#include "work-queue.h"
+
+/* Icons are mostly decoded from disk, more threads would just wait on it */
+#define ICON_LOADER_MAX_THREADS 4
 
 static const char *debug_libsfdo;
 
@@ -21,6 +29,10 @@ struct sfdo {
 	struct sfdo_icon_ctx *icon_ctx;
 	struct sfdo_desktop_db *desktop_db;
 	struct sfdo_icon_theme *icon_theme;
+	/* Serializes lookups, libsfdo is not thread-safe */
+	pthread_mutex_t lock;
+	/* Icon loader threads, NULL if they could not be set up */
+	struct work_queue *queue;
 };
 
 static void
@@ -134,6 +146,11 @@ desktop_entry_init(struct server *server)
 	/* basedir_ctx is not referenced by other objects */
 	sfdo_basedir_ctx_destroy(basedir_ctx);
 
+	pthread_mutex_init(&sfdo->lock, NULL);
+	long nr_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	sfdo->queue = work_queue_create(server->wl_event_loop,
+		MIN(MAX(nr_cpus / 2, 1), ICON_LOADER_MAX_THREADS));
+
 	server->sfdo = sfdo;
 	return;
 
@@ -162,6 +179,14 @@ desktop_entry_finish(struct server *server)
 		return;
 	}
 
+	/*
+	 * Waits for the jobs using the icon theme. Jobs submitted by their
+	 * done callbacks meanwhile are loaded synchronously instead.
+	 */
+	struct work_queue *queue = sfdo->queue;
+	sfdo->queue = NULL;
+	work_queue_destroy(queue);
+	pthread_mutex_destroy(&sfdo->lock);
 	sfdo_icon_theme_destroy(sfdo->icon_theme);
 	sfdo_desktop_db_destroy(sfdo->desktop_db);
 	sfdo_icon_ctx_destroy(sfdo->icon_ctx);
@@ -351,7 +376,9 @@ desktop_entry_load_icon(struct server *server, const char *icon_name, int size,
 	if (icon_name[0] == '/') {
 		ret = process_abs_name(&ctx, icon_name);
 	} else {
+		pthread_mutex_lock(&sfdo->lock);
 		ret = process_rel_name(&ctx, icon_name, sfdo, lookup_size, lookup_scale);
+		pthread_mutex_unlock(&sfdo->lock);
 	}
 	if (ret < 0) {
 		wlr_log(WLR_INFO, "failed to load icon file %s", icon_name);
@@ -378,11 +405,14 @@ desktop_entry_load_icon_from_app_id(struct server *server,
 		return NULL;
 	}
 
+	/* Entries and their strings live as long as the database */
 	const char *icon_name = NULL;
+	pthread_mutex_lock(&sfdo->lock);
 	struct sfdo_desktop_entry *entry = get_desktop_entry(sfdo, app_id);
 	if (entry) {
 		icon_name = sfdo_desktop_entry_get_icon(entry, NULL);
 	}
+	pthread_mutex_unlock(&sfdo->lock);
 
 	struct lab_img *img = desktop_entry_load_icon(server, icon_name, size, scale);
 	if (!img) {
@@ -404,7 +434,9 @@ desktop_entry_name_lookup(struct server *server, const char *app_id)
 		return NULL;
 	}
 
+	pthread_mutex_lock(&sfdo->lock);
 	struct sfdo_desktop_entry *entry = get_desktop_entry(sfdo, app_id);
+	pthread_mutex_unlock(&sfdo->lock);
 	if (!entry) {
 		return NULL;
 	}
@@ -417,3 +449,15 @@ desktop_entry_name_lookup(struct server *server, const char *app_id)
 
 	return name;
 }
+
+bool
+desktop_entry_queue_work(struct server *server, work_func_t work,
+		work_done_func_t done, void *data)
+{
+	struct sfdo *sfdo = server->sfdo;
+	if (!sfdo || !sfdo->queue) {
+		return false;
+	}
+	work_queue_submit(sfdo->queue, work, done, data);
+	return true;
+}
@@ -0,0 +1,458 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#define _POSIX_C_SOURCE 200809L
+#include "img/img-cache.h"
+#include <cairo.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <glib.h>
+#include <inttypes.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <wlr/util/log.h>
+#include "buffer.h"
+#include "common/array.h"
+#include "common/hash.h"
+#include "common/macros.h"
+#include "common/mem.h"
+#include "common/string-helpers.h"
+
+/* Bump when the file format or the way images are rendered changes */
+#define RASTER_VERSION 1
+#define RASTER_MAGIC 0x5453524c /* "LRST" */
+
+/*
+ * Each file starts with this header, followed by the path of the source
+ * file without terminator and, at data_offset, the pixels. Markers from
+ * img_cache_mark_source() have no size and no pixels.
+ */
+struct raster_header {
+	uint32_t magic;
+	uint32_t version;
+
+	/* Key */
+	int64_t mtime_sec;
+	int64_t mtime_nsec;
+	int64_t size;
+	int32_t width;
+	int32_t height;
+	double scale;
+	uint32_t path_len;
+
+	/* Premultiplied ARGB32 */
+	uint32_t pixel_width;
+	uint32_t pixel_height;
+	uint32_t stride;
+	uint32_t data_offset;
+};
+
+/* Keep rows suitably aligned for pixman */
+#define RASTER_DATA_ALIGN 64
+
+/*
+ * Bounds applied at startup. Files are aged by their last access, so
+ * rasters of the current theme stay while those of old ones go.
+ */
+#define IMG_CACHE_MAX_BYTES (64 * 1024 * 1024)
+#define IMG_CACHE_MAX_AGE (30 * 24 * 60 * 60)
+/* Temporary files older than this were left behind by a crash */
+#define IMG_CACHE_TMP_AGE (60 * 60)
+
+struct raster_mapping {
+	void *addr;
+	size_t len;
+};
+
+static pthread_once_t cache_dir_once = PTHREAD_ONCE_INIT;
+static char *cache_dir; /* NULL if disabled */
+static cairo_user_data_key_t mapping_key;
+
+struct cache_file {
+	char *name;
+	time_t used;
+	off_t size;
+};
+
+static int
+compare_used(const void *a, const void *b)
+{
+	const struct cache_file *fa = a, *fb = b;
+	return (fa->used > fb->used) - (fa->used < fb->used);
+}
+
+/* Removes stale files, then the least recently used beyond the size bound */
+static void
+prune_cache_dir(const char *dir)
+{
+	DIR *d = opendir(dir);
+	if (!d) {
+		return;
+	}
+
+	struct wl_array files;
+	wl_array_init(&files);
+	off_t total = 0;
+	time_t now = time(NULL);
+	struct dirent *ent;
+	while ((ent = readdir(d))) {
+		struct stat st;
+		if (fstatat(dirfd(d), ent->d_name, &st, AT_SYMLINK_NOFOLLOW) < 0
+				|| !S_ISREG(st.st_mode)) {
+			continue;
+		}
+		time_t used = MAX(st.st_atime, st.st_mtime);
+		bool tmp = !str_endswith(ent->d_name, ".raster")
+			&& !str_endswith(ent->d_name, ".source");
+		if (now - used > (tmp ? IMG_CACHE_TMP_AGE : IMG_CACHE_MAX_AGE)) {
+			unlinkat(dirfd(d), ent->d_name, 0);
+			continue;
+		}
+		struct cache_file file = {
+			.name = xstrdup(ent->d_name),
+			.used = used,
+			.size = st.st_size,
+		};
+		array_add(&files, file);
+		total += st.st_size;
+	}
+
+	struct cache_file *file;
+	qsort(files.data, files.size / sizeof(*file), sizeof(*file),
+		compare_used);
+	wl_array_for_each(file, &files) {
+		if (total > IMG_CACHE_MAX_BYTES
+				&& !unlinkat(dirfd(d), file->name, 0)) {
+			total -= file->size;
+		}
+		free(file->name);
+	}
+	wl_array_release(&files);
+	closedir(d);
+}
+
+static void
+init_cache_dir(void)
+{
+	const char *xdg_cache_home = getenv("XDG_CACHE_HOME");
+	const char *home = getenv("HOME");
+	char *dir;
+	if (!string_null_or_empty(xdg_cache_home)) {
+		dir = strdup_printf("%s/labwc/rasters", xdg_cache_home);
+	} else if (!string_null_or_empty(home)) {
+		dir = strdup_printf("%s/.cache/labwc/rasters", home);
+	} else {
+		return;
+	}
+
+	if (g_mkdir_with_parents(dir, 0700) < 0) {
+		wlr_log_errno(WLR_INFO, "cannot create raster cache %s", dir);
+		free(dir);
+		return;
+	}
+	prune_cache_dir(dir);
+	cache_dir = dir;
+}
+
+static bool
+cache_enabled(void)
+{
+	pthread_once(&cache_dir_once, init_cache_dir);
+	return cache_dir;
+}
+
+bool
+img_cache_source_init(struct img_cache_source *source, const char *path)
+{
+	*source = (struct img_cache_source){0};
+	struct stat st;
+	if (stat(path, &st) < 0) {
+		return false;
+	}
+	source->path = xstrdup(path);
+	source->mtime_sec = st.st_mtim.tv_sec;
+	source->mtime_nsec = st.st_mtim.tv_nsec;
+	source->size = st.st_size;
+	return true;
+}
+
+void
+img_cache_source_finish(struct img_cache_source *source)
+{
+	zfree(source->path);
+}
+
+static char *
+entry_path(const struct img_cache_source *source, int width, int height,
+		double scale)
+{
+	uint64_t hash = LAB_HASH_INIT;
+	hash = lab_hash_string(hash, source->path);
+	hash = lab_hash_bytes(hash, &source->mtime_sec, sizeof(source->mtime_sec));
+	hash = lab_hash_bytes(hash, &source->mtime_nsec,
+		sizeof(source->mtime_nsec));
+	hash = lab_hash_bytes(hash, &source->size, sizeof(source->size));
+	hash = lab_hash_bytes(hash, &width, sizeof(width));
+	hash = lab_hash_bytes(hash, &height, sizeof(height));
+	hash = lab_hash_bytes(hash, &scale, sizeof(scale));
+	return strdup_printf("%s/%016" PRIx64 "%s", cache_dir, hash,
+		width ? ".raster" : ".source");
+}
+
+static void
+header_init(struct raster_header *header, const struct img_cache_source *source,
+		int width, int height, double scale)
+{
+	*header = (struct raster_header){
+		.magic = RASTER_MAGIC,
+		.version = RASTER_VERSION,
+		.mtime_sec = source->mtime_sec,
+		.mtime_nsec = source->mtime_nsec,
+		.size = source->size,
+		.width = width,
+		.height = height,
+		.scale = scale,
+		.path_len = strlen(source->path),
+	};
+}
+
+/* Returns false if @header and the path following it don't match the key */
+static bool
+header_matches(const struct raster_header *header, const char *path,
+		const struct raster_header *expected, size_t file_size)
+{
+	return header->magic == expected->magic
+		&& header->version == expected->version
+		&& header->mtime_sec == expected->mtime_sec
+		&& header->mtime_nsec == expected->mtime_nsec
+		&& header->size == expected->size
+		&& header->width == expected->width
+		&& header->height == expected->height
+		&& header->scale == expected->scale
+		&& header->path_len == expected->path_len
+		&& sizeof(*header) + header->path_len <= file_size
+		&& !memcmp(path, (const char *)(header + 1), header->path_len);
+}
+
+static bool
+write_all(int fd, const void *data, size_t len)
+{
+	const char *p = data;
+	while (len > 0) {
+		ssize_t ret = write(fd, p, len);
+		if (ret < 0 && errno == EINTR) {
+			continue;
+		}
+		if (ret <= 0) {
+			return false;
+		}
+		p += ret;
+		len -= ret;
+	}
+	return true;
+}
+
+/*
+ * Writes to a temporary file first and renames it, so concurrent readers,
+ * in this or another compositor instance, never see partial files.
+ */
+static void
+write_entry(const char *path, const struct raster_header *header,
+		const char *source_path, const void *data, size_t data_len)
+{
+	char *tmp_path = strdup_printf("%s.XXXXXX", path);
+	int fd = mkstemp(tmp_path);
+	if (fd < 0) {
+		wlr_log_errno(WLR_DEBUG, "cannot create %s", tmp_path);
+		free(tmp_path);
+		return;
+	}
+
+	static const char padding[RASTER_DATA_ALIGN];
+	size_t padding_len = data_len ? header->data_offset
+		- sizeof(*header) - header->path_len : 0;
+	bool ok = write_all(fd, header, sizeof(*header))
+		&& write_all(fd, source_path, header->path_len)
+		&& write_all(fd, padding, padding_len)
+		&& write_all(fd, data, data_len);
+	close(fd);
+
+	if (!ok || rename(tmp_path, path) < 0) {
+		wlr_log_errno(WLR_DEBUG, "cannot write %s", path);
+		unlink(tmp_path);
+	}
+	free(tmp_path);
+}
+
+/* Maps the file at @path if it matches @expected, NULL otherwise */
+static struct raster_mapping *
+map_entry(const char *path, const struct img_cache_source *source,
+		const struct raster_header *expected)
+{
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return NULL;
+	}
+	struct stat st;
+	if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(*expected)) {
+		close(fd);
+		return NULL;
+	}
+
+	/* Private and writable, so modifiers can draw over the pixels */
+	void *addr = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (addr == MAP_FAILED) {
+		wlr_log_errno(WLR_DEBUG, "cannot map %s", path);
+		return NULL;
+	}
+
+	if (!header_matches(addr, source->path, expected, st.st_size)) {
+		/* Hash collision or left over from an older version */
+		munmap(addr, st.st_size);
+		return NULL;
+	}
+
+	struct raster_mapping *mapping = znew(*mapping);
+	mapping->addr = addr;
+	mapping->len = st.st_size;
+	return mapping;
+}
+
+static void
+unmap_entry(void *data)
+{
+	struct raster_mapping *mapping = data;
+	munmap(mapping->addr, mapping->len);
+	free(mapping);
+}
+
+static int
+pixel_size(int size, double scale)
+{
+	/* Same rounding as buffer_create_cairo() */
+	return lroundf(size * (float)scale);
+}
+
+bool
+img_cache_source_known(const struct img_cache_source *source)
+{
+	if (!source->path || !cache_enabled()) {
+		return false;
+	}
+
+	struct raster_header expected;
+	header_init(&expected, source, 0, 0, 0);
+	char *path = entry_path(source, 0, 0, 0);
+	struct raster_mapping *mapping = map_entry(path, source, &expected);
+	free(path);
+	if (!mapping) {
+		return false;
+	}
+	unmap_entry(mapping);
+	return true;
+}
+
+void
+img_cache_mark_source(const struct img_cache_source *source)
+{
+	if (!source->path || !cache_enabled()) {
+		return;
+	}
+
+	struct raster_header header;
+	header_init(&header, source, 0, 0, 0);
+	char *path = entry_path(source, 0, 0, 0);
+	write_entry(path, &header, source->path, NULL, 0);
+	free(path);
+}
+
+struct lab_data_buffer *
+img_cache_load(const struct img_cache_source *source, int width, int height,
+		double scale)
+{
+	if (!source->path || width <= 0 || height <= 0 || !cache_enabled()) {
+		return NULL;
+	}
+
+	struct raster_header expected;
+	header_init(&expected, source, width, height, scale);
+	char *path = entry_path(source, width, height, scale);
+	struct raster_mapping *mapping = map_entry(path, source, &expected);
+	free(path);
+	if (!mapping) {
+		return NULL;
+	}
+
+	const struct raster_header *header = mapping->addr;
+	int pixel_width = pixel_size(width, scale);
+	int pixel_height = pixel_size(height, scale);
+	if (header->pixel_width != (uint32_t)pixel_width
+			|| header->pixel_height != (uint32_t)pixel_height
+			|| header->stride != (uint32_t)cairo_format_stride_for_width(
+				CAIRO_FORMAT_ARGB32, pixel_width)
+			|| header->data_offset % RASTER_DATA_ALIGN
+			|| header->data_offset + (size_t)header->stride
+				* header->pixel_height > mapping->len) {
+		unmap_entry(mapping);
+		return NULL;
+	}
+
+	cairo_surface_t *surface = cairo_image_surface_create_for_data(
+		(unsigned char *)mapping->addr + header->data_offset,
+		CAIRO_FORMAT_ARGB32, pixel_width, pixel_height, header->stride);
+	if (cairo_surface_status(surface)
+			|| cairo_surface_set_user_data(surface, &mapping_key,
+				mapping, unmap_entry)) {
+		cairo_surface_destroy(surface);
+		unmap_entry(mapping);
+		return NULL;
+	}
+	cairo_surface_set_device_scale(surface, scale, scale);
+
+	/* The mapping goes away along with the surface */
+	struct lab_data_buffer *buffer = buffer_adopt_cairo_surface(surface);
+	buffer->logical_width = width;
+	buffer->logical_height = height;
+	return buffer;
+}
+
+void
+img_cache_store(const struct img_cache_source *source,
+		struct lab_data_buffer *buffer, int width, int height, double scale)
+{
+	if (!source->path || width <= 0 || height <= 0 || !cache_enabled()) {
+		return;
+	}
+
+	cairo_surface_flush(buffer->surface);
+	int pixel_width = cairo_image_surface_get_width(buffer->surface);
+	int pixel_height = cairo_image_surface_get_height(buffer->surface);
+	int stride = cairo_image_surface_get_stride(buffer->surface);
+	if (pixel_width != pixel_size(width, scale)
+			|| pixel_height != pixel_size(height, scale)) {
+		return;
+	}
+
+	struct raster_header header;
+	header_init(&header, source, width, height, scale);
+	header.pixel_width = pixel_width;
+	header.pixel_height = pixel_height;
+	header.stride = stride;
+	size_t offset = sizeof(header) + header.path_len;
+	header.data_offset = (offset + RASTER_DATA_ALIGN - 1)
+		/ RASTER_DATA_ALIGN * RASTER_DATA_ALIGN;
+
+	char *path = entry_path(source, width, height, scale);
+	write_entry(path, &header, source->path,
+		cairo_image_surface_get_data(buffer->surface),
+		(size_t)stride * pixel_height);
+	free(path);
+}
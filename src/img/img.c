@@ -6,9 +6,11 @@
 #include "config.h"
 #include "common/box.h"
 #include "common/graphic-helpers.h"
+#include "common/hash.h"
 #include "common/macros.h"
 #include "common/mem.h"
 #include "common/string-helpers.h"
+#include "img/img-cache.h"
 #include "img/img-png.h"
 #if HAVE_RSVG
 #include "img/img-svg.h"
@@ -26,7 +28,8 @@ struct lab_img_data {
 	/* Handler for the loaded image file */
 	struct lab_data_buffer *buffer; /* for PNG/XBM/XPM image */
 #if HAVE_RSVG
-	RsvgHandle *svg; /* for SVG image */
+	RsvgHandle *svg; /* for SVG image, NULL until needed if cached */
+	struct img_cache_source source;
 #endif
 };
 
@@ -63,14 +66,25 @@ lab_img_load(enum lab_img_type type, const char *path, float *xbm_color)
 		break;
 	case LAB_IMG_SVG:
 #if HAVE_RSVG
+		if (img_cache_source_init(&img_data->source, path)
+				&& img_cache_source_known(&img_data->source)) {
+			/* Loaded fine before, parse once a raster is missing */
+			break;
+		}
 		img_data->svg = img_svg_load(path);
+		if (img_data->svg) {
+			img_cache_mark_source(&img_data->source);
+		} else {
+			img_cache_source_finish(&img_data->source);
+		}
 #endif
 		break;
 	}
 
 	bool img_is_loaded = (bool)img_data->buffer;
 #if HAVE_RSVG
-	img_is_loaded |= (bool)img_data->svg;
+	/* Or deferred, see above */
+	img_is_loaded |= img_data->svg || img_data->source.path;
 #endif
 
 	if (img_is_loaded) {
@@ -111,6 +125,31 @@ lab_img_add_modifier(struct lab_img *img,  lab_img_modifier_func_t modifier)
 	*mod = modifier;
 }
 
+#if HAVE_RSVG
+static struct lab_data_buffer *
+render_svg(struct lab_img_data *img_data, int width, int height, double scale)
+{
+	/* Cached rasters are unmodified, modifiers are applied on each render */
+	struct lab_data_buffer *buffer =
+		img_cache_load(&img_data->source, width, height, scale);
+	if (buffer) {
+		return buffer;
+	}
+
+	if (!img_data->svg) {
+		img_data->svg = img_svg_load(img_data->source.path);
+		if (!img_data->svg) {
+			return NULL;
+		}
+	}
+	buffer = img_svg_render(img_data->svg, width, height, scale);
+	if (buffer) {
+		img_cache_store(&img_data->source, buffer, width, height, scale);
+	}
+	return buffer;
+}
+#endif
+
 struct lab_data_buffer *
 lab_img_render(struct lab_img *img, int width, int height, double scale)
 {
@@ -125,7 +164,7 @@ lab_img_render(struct lab_img *img, int width, int height, double scale)
 		break;
 #if HAVE_RSVG
 	case LAB_IMG_SVG:
-		buffer = img_svg_render(img->data->svg, width, height, scale);
+		buffer = render_svg(img->data, width, height, scale);
 		break;
 #endif
 	default:
@@ -167,6 +206,7 @@ lab_img_destroy(struct lab_img *img)
 		if (img->data->svg) {
 			g_object_unref(img->data->svg);
 		}
+		img_cache_source_finish(&img->data->source);
 #endif
 		free(img->data);
 	}
@@ -189,3 +229,11 @@ lab_img_equal(struct lab_img *img_a, struct lab_img *img_b)
 		|| !memcmp(img_a->modifiers.data, img_b->modifiers.data,
 			img_a->modifiers.size);
 }
+
+uint64_t
+lab_img_hash(struct lab_img *img)
+{
+	uint64_t hash = LAB_HASH_INIT;
+	hash = lab_hash_bytes(hash, &img->data, sizeof(img->data));
+	return lab_hash_bytes(hash, img->modifiers.data, img->modifiers.size);
+}
@@ -29,6 +29,7 @@
 #include "input/touch.h"
 #include "labwc.h"
 #include "layers.h"
+#include "magnifier.h"
 #include "menu/menu.h"
 #include "osd.h"
 #include "output.h"
@@ -40,8 +41,6 @@
 #include "labwc-ipc.h"	
 
 #define LAB_CURSOR_SHAPE_V1_VERSION 1
-#define CURSOR_IPC_UPDATE_INTERVAL_MS 16  // ~60fps
-static uint32_t last_cursor_ipc_update_ms = 0;
 
 
 struct constraint {
@@ -844,6 +843,7 @@ handle_motion(struct wl_listener *listener, void *data)
 	 * This event is forwarded by the cursor when a pointer emits a
 	 * _relative_ pointer motion event (i.e. a delta)
 	 */
+	uint64_t start_ns = input_timing_now_ns();
 	struct seat *seat = wl_container_of(listener, seat, on_cursor.motion);
 	struct server *server = seat->server;
 	struct wlr_pointer_motion_event *event = data;
@@ -886,13 +886,12 @@ handle_motion(struct wl_listener *listener, void *data)
 		preprocess_cursor_motion(seat, event->pointer,
 			event->time_msec, event->delta_x, event->delta_y);
 	}
-	// Throttled IPC cursor update
-	 if (server && server->ipc_server && 
-        event->time_msec - last_cursor_ipc_update_ms >= CURSOR_IPC_UPDATE_INTERVAL_MS) {
-        ipc_send_cursor_position(server->ipc_server,
-            seat->cursor->x, seat->cursor->y);
-        last_cursor_ipc_update_ms = event->time_msec;
-    }
+	ipc_cursor_moved(server->ipc_server, seat->cursor->x, seat->cursor->y);
+	if (magnifier_is_enabled()) {
+		magnifier_update(server);
+	}
+	latency_histogram_add(&server->input_timing.motion,
+		input_timing_now_ns() - start_ns);
 }
 
 static void
@@ -906,6 +905,7 @@ handle_motion_absolute(struct wl_listener *listener, void *data)
 	 * window from any edge, so we have to warp the mouse there. There is
 	 * also some hardware which emits these events.
 	 */
+	uint64_t start_ns = input_timing_now_ns();
 	struct seat *seat = wl_container_of(listener, seat, on_cursor.motion_absolute);
 	struct wlr_pointer_motion_absolute_event *event = data;
 	idle_manager_notify_activity(seat->seat);
@@ -925,13 +925,13 @@ handle_motion_absolute(struct wl_listener *listener, void *data)
 
 	preprocess_cursor_motion(seat, event->pointer,
 		event->time_msec, dx, dy);
-	// Throttled IPC cursor update
- 	if (seat->server->ipc_server && 
-	    event->time_msec - last_cursor_ipc_update_ms >= CURSOR_IPC_UPDATE_INTERVAL_MS) {
-		ipc_send_cursor_position(seat->server->ipc_server,
-			seat->cursor->x, seat->cursor->y);
-		last_cursor_ipc_update_ms = event->time_msec;
+	ipc_cursor_moved(seat->server->ipc_server, seat->cursor->x,
+		seat->cursor->y);
+	if (magnifier_is_enabled()) {
+		magnifier_update(seat->server);
 	}
+	latency_histogram_add(&seat->server->input_timing.motion,
+		input_timing_now_ns() - start_ns);
 }
 
 static void
@@ -2,6 +2,8 @@
 
 #include "magnifier.h"
 #include <assert.h>
+#include <math.h>
+#include <pixman.h>
 #include <wlr/render/allocator.h>
 #include <wlr/render/swapchain.h>
 #include <wlr/types/wlr_cursor.h>
@@ -20,6 +22,9 @@ static double mag_scale = 0.0;
 /* Reuse a single scratch buffer */
 static struct wlr_buffer *tmp_buffer = NULL;
 static struct wlr_texture *tmp_texture = NULL;
+/* Output and area that tmp_buffer holds a copy of, NULL if none */
+static struct output *tmp_output;
+static struct wlr_box tmp_src_box;
 
 static void
 box_logical_to_physical(struct wlr_box *box, struct wlr_output *output)
@@ -38,11 +43,111 @@ box_logical_to_physical(struct wlr_box *box, struct wlr_output *output)
 		output_w, output_h);
 }
 
-void
-magnifier_draw(struct output *output, struct wlr_buffer *output_buffer, struct wlr_box *damage)
+/* Adds @box to the damage committed with @state */
+static void
+output_state_add_damage(struct wlr_output_state *state,
+		const struct wlr_box *box)
+{
+	/* Without damage the whole buffer is considered damaged anyway */
+	if (wlr_box_empty(box) || !(state->committed & WLR_OUTPUT_STATE_DAMAGE)) {
+		return;
+	}
+	pixman_region32_t damage;
+	pixman_region32_init(&damage);
+	pixman_region32_union_rect(&damage, &state->damage,
+		box->x, box->y, box->width, box->height);
+	wlr_output_state_set_damage(state, &damage);
+	pixman_region32_fini(&damage);
+}
+
+/* Whether the scene changed @box since the previous frame */
+static bool
+scene_damaged(struct wlr_output_state *state, const struct wlr_box *box)
+{
+	if (!(state->committed & WLR_OUTPUT_STATE_DAMAGE)) {
+		return true;
+	}
+	pixman_box32_t rect = {
+		.x1 = box->x,
+		.y1 = box->y,
+		.x2 = box->x + box->width,
+		.y2 = box->y + box->height,
+	};
+	return pixman_region32_contains_rectangle(&state->damage, &rect)
+		!= PIXMAN_REGION_OUT;
+}
+
+/*
+ * Copies @src_box of the output buffer into tmp_buffer, unless it is still
+ * there from the previous frame. The scene damage of @state must not yet
+ * include the magnifier itself.
+ */
+static bool
+update_source(struct output *output, struct wlr_output_state *state,
+		struct wlr_box *src_box, struct wlr_box *mag_box)
+{
+	struct server *server = output->server;
+
+	/*
+	 * tmp_output is only compared, never dereferenced. An output created
+	 * at the address of a destroyed one is fully damaged on its first
+	 * frame, so it cannot match a stale source.
+	 */
+	if (tmp_output == output && wlr_box_equal(&tmp_src_box, src_box)
+			&& !scene_damaged(state, src_box)) {
+		output->magnifier.frames_skipped++;
+		return true;
+	}
+	tmp_output = NULL;
+
+	struct wlr_render_pass *pass = wlr_renderer_begin_buffer_pass(
+		server->renderer, tmp_buffer, NULL);
+	if (!pass) {
+		wlr_log(WLR_ERROR, "Failed to begin magnifier render pass");
+		return false;
+	}
+
+	struct wlr_buffer *output_buffer = state->buffer;
+	wlr_buffer_lock(output_buffer);
+	struct wlr_texture *output_texture = wlr_texture_from_buffer(
+		server->renderer, output_buffer);
+	if (!output_texture) {
+		wlr_render_pass_submit(pass);
+		wlr_buffer_unlock(output_buffer);
+		return false;
+	}
+
+	struct wlr_box dst_box = *src_box;
+	dst_box.x -= mag_box->x;
+	dst_box.y -= mag_box->y;
+
+	struct wlr_render_texture_options opts = {
+		.texture = output_texture,
+		.src_box = box_to_fbox(src_box),
+		.dst_box = dst_box,
+	};
+	wlr_render_pass_add_texture(pass, &opts);
+	bool ok = wlr_render_pass_submit(pass);
+	wlr_texture_destroy(output_texture);
+	wlr_buffer_unlock(output_buffer);
+	if (!ok) {
+		wlr_log(WLR_ERROR, "Failed to extract magnifier source region");
+		return false;
+	}
+
+	tmp_output = output;
+	tmp_src_box = *src_box;
+	return true;
+}
+
+/* Draws the magnifier into the output buffer and stores the area in @damage */
+static void
+render_magnifier(struct output *output, struct wlr_output_state *state,
+		struct wlr_box *damage)
 {
 	struct server *server = output->server;
 	struct theme *theme = server->theme;
+	struct wlr_buffer *output_buffer = state->buffer;
 	bool fullscreen = (rc.mag_width == -1 || rc.mag_height == -1);
 
 	struct wlr_box output_box = {
@@ -67,9 +172,6 @@ magnifier_draw(struct output *output, struct wlr_buffer *output_buffer, struct w
 		return;
 	}
 
-	if (mag_scale == 0.0) {
-		mag_scale = rc.mag_scale;
-	}
 	assert(mag_scale >= 1.0);
 
 	/* Magnifier geometry in physical output coordinate */
@@ -88,11 +190,7 @@ magnifier_draw(struct output *output, struct wlr_buffer *output_buffer, struct w
 	if (tmp_buffer && (tmp_buffer->width != mag_box.width
 			|| tmp_buffer->height != mag_box.height)) {
 		wlr_log(WLR_DEBUG, "tmp magnifier buffer size changed, dropping");
-		assert(tmp_texture);
-		wlr_texture_destroy(tmp_texture);
-		wlr_buffer_drop(tmp_buffer);
-		tmp_buffer = NULL;
-		tmp_texture = NULL;
+		magnifier_reset();
 	}
 	if (!tmp_buffer) {
 		tmp_buffer = wlr_allocator_create_buffer(
@@ -114,47 +212,47 @@ magnifier_draw(struct output *output, struct wlr_buffer *output_buffer, struct w
 		return;
 	}
 
-	/* Extract source region into temporary buffer */
-	struct wlr_render_pass *tmp_render_pass = wlr_renderer_begin_buffer_pass(
-		server->renderer, tmp_buffer, NULL);
-	if (!tmp_render_pass) {
-		wlr_log(WLR_ERROR, "Failed to begin magnifier render pass");
-		return;
-	}
+	/* Area of tmp_buffer that is magnified, relative to mag_box */
+	struct wlr_fbox src_box_for_paste = {
+		.width = mag_box.width / mag_scale,
+		.height = mag_box.height / mag_scale,
+	};
 
-	wlr_buffer_lock(output_buffer);
-	struct wlr_texture *output_texture = wlr_texture_from_buffer(
-		server->renderer, output_buffer);
-	if (!output_texture) {
-		goto cleanup;
+	if (fullscreen) {
+		src_box_for_paste.x = cursor_pos.x - (cursor_pos.x / mag_scale);
+		src_box_for_paste.y = cursor_pos.y - (cursor_pos.y / mag_scale);
+	} else {
+		src_box_for_paste.x =
+			mag_box.width * (mag_scale - 1.0) / (2.0 * mag_scale);
+		src_box_for_paste.y =
+			mag_box.height * (mag_scale - 1.0) / (2.0 * mag_scale);
 	}
 
-	struct wlr_box src_box_for_copy;
-	wlr_box_intersection(&src_box_for_copy, &mag_box, &output_box);
-
-	struct wlr_box dst_box_for_copy = src_box_for_copy;
-	dst_box_for_copy.x -= mag_box.x;
-	dst_box_for_copy.y -= mag_box.y;
-
-	struct wlr_render_texture_options opts = {
-		.texture = output_texture,
-		.src_box = box_to_fbox(&src_box_for_copy),
-		.dst_box = dst_box_for_copy,
+	/*
+	 * Only the magnified area is copied out of the output buffer, with a
+	 * pixel of margin for the bilinear filter.
+	 */
+	struct wlr_box src_box = {
+		.x = mag_box.x + (int)floor(src_box_for_paste.x) - 1,
+		.y = mag_box.y + (int)floor(src_box_for_paste.y) - 1,
 	};
-	wlr_render_pass_add_texture(tmp_render_pass, &opts);
-	if (!wlr_render_pass_submit(tmp_render_pass)) {
-		wlr_log(WLR_ERROR, "Failed to extract magnifier source region");
-		wlr_texture_destroy(output_texture);
-		goto cleanup;
+	src_box.width = mag_box.x + (int)ceil(src_box_for_paste.x
+		+ src_box_for_paste.width) + 1 - src_box.x;
+	src_box.height = mag_box.y + (int)ceil(src_box_for_paste.y
+		+ src_box_for_paste.height) + 1 - src_box.y;
+	wlr_box_intersection(&src_box, &src_box, &mag_box);
+	wlr_box_intersection(&src_box, &src_box, &output_box);
+	if (wlr_box_empty(&src_box)
+			|| !update_source(output, state, &src_box, &mag_box)) {
+		return;
 	}
-	wlr_texture_destroy(output_texture);
 
 	/* Render to the output buffer itself */
-	tmp_render_pass = wlr_renderer_begin_buffer_pass(
+	struct wlr_render_pass *render_pass = wlr_renderer_begin_buffer_pass(
 		server->renderer, output_buffer, NULL);
-	if (!tmp_render_pass) {
+	if (!render_pass) {
 		wlr_log(WLR_ERROR, "Failed to begin second magnifier render pass");
-		goto cleanup;
+		return;
 	}
 
 	struct wlr_box damage_box;
@@ -180,67 +278,87 @@ magnifier_draw(struct output *output, struct wlr_buffer *output_buffer, struct w
 			},
 			.clip = NULL,
 		};
-		wlr_render_pass_add_rect(tmp_render_pass, &bg_opts);
+		wlr_render_pass_add_rect(render_pass, &bg_opts);
 		wlr_box_intersection(&damage_box, &border_box, &output_box);
 	}
 
-	struct wlr_fbox src_box_for_paste = {
-		.width = mag_box.width / mag_scale,
-		.height = mag_box.height / mag_scale,
-	};
-
-	if (fullscreen) {
-		src_box_for_paste.x = cursor_pos.x - (cursor_pos.x / mag_scale);
-		src_box_for_paste.y = cursor_pos.y - (cursor_pos.y / mag_scale);
-	} else {
-		src_box_for_paste.x =
-			mag_box.width * (mag_scale - 1.0) / (2.0 * mag_scale);
-		src_box_for_paste.y =
-			mag_box.height * (mag_scale - 1.0) / (2.0 * mag_scale);
-	}
-
 	/* Paste the magnified result back into the output buffer */
-	opts = (struct wlr_render_texture_options) {
+	struct wlr_render_texture_options opts = {
 		.texture = tmp_texture,
 		.src_box = src_box_for_paste,
 		.dst_box = mag_box,
 		.filter_mode = rc.mag_filter ? WLR_SCALE_FILTER_BILINEAR
 			: WLR_SCALE_FILTER_NEAREST,
 	};
-	wlr_render_pass_add_texture(tmp_render_pass, &opts);
-	if (!wlr_render_pass_submit(tmp_render_pass)) {
+	wlr_render_pass_add_texture(render_pass, &opts);
+	if (!wlr_render_pass_submit(render_pass)) {
 		wlr_log(WLR_ERROR, "Failed to submit magnifier render pass");
-		goto cleanup;
+		return;
 	}
 
 	/* And finally mark the extra damage */
 	*damage = damage_box;
-cleanup:
-	wlr_buffer_unlock(output_buffer);
+}
+
+void
+magnifier_draw(struct output *output, struct wlr_output_state *state,
+		struct wlr_box *damage)
+{
+	struct server *server = output->server;
+	struct wlr_cursor *cursor = server->seat.cursor;
+	struct wlr_box prev_box = output->magnifier.box;
+
+	*damage = (struct wlr_box){0};
+	if (magnify_on && output_nearest_to_cursor(server) == output) {
+		render_magnifier(output, state, damage);
+		output->magnifier.cursor_x = cursor->x;
+		output->magnifier.cursor_y = cursor->y;
+		output->magnifier.scale = mag_scale;
+	} else {
+		output->magnifier.scale = 0.0;
+	}
+	output->magnifier.box = *damage;
+
+	/*
+	 * The scene has repainted the previous magnifier area, see
+	 * lab_wlr_scene_output_commit(), and the new one was drawn over.
+	 * Both differ from what is on screen.
+	 */
+	output_state_add_damage(state, &prev_box);
+	output_state_add_damage(state, damage);
 }
 
 bool
 output_wants_magnification(struct output *output)
 {
-	static double x = -1;
-	static double y = -1;
-	struct wlr_cursor *cursor = output->server->seat.cursor;
-	if (!magnify_on) {
-		x = -1;
-		y = -1;
-		return false;
+	struct server *server = output->server;
+	if (!magnify_on || output_nearest_to_cursor(server) != output) {
+		/* Erase the magnifier if it is still shown */
+		return !wlr_box_empty(&output->magnifier.box);
 	}
-	if (cursor->x == x && cursor->y == y) {
-		return false;
+	struct wlr_cursor *cursor = server->seat.cursor;
+	return output->magnifier.scale != mag_scale
+		|| output->magnifier.cursor_x != cursor->x
+		|| output->magnifier.cursor_y != cursor->y;
+}
+
+void
+magnifier_update(struct server *server)
+{
+	struct output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		if (output_wants_magnification(output)) {
+			wlr_output_schedule_frame(output->wlr_output);
+		}
 	}
-	x = cursor->x;
-	y = cursor->y;
-	return output_nearest_to_cursor(output->server) == output;
 }
 
 static void
 enable_magnifier(struct server *server, bool enable)
 {
+	if (enable && mag_scale == 0.0) {
+		mag_scale = rc.mag_scale;
+	}
 	magnify_on = enable;
 	server->scene->WLR_PRIVATE.direct_scanout = enable ? false
 		: server->direct_scanout_enabled;
@@ -251,19 +369,13 @@ void
 magnifier_toggle(struct server *server)
 {
 	enable_magnifier(server, !magnify_on);
-
-	struct output *output = output_nearest_to_cursor(server);
-	if (output) {
-		wlr_output_schedule_frame(output->wlr_output);
-	}
+	magnifier_update(server);
 }
 
 /* Increases and decreases magnification scale */
 void
 magnifier_set_scale(struct server *server, enum magnify_dir dir)
 {
-	struct output *output = output_nearest_to_cursor(server);
-
 	if (dir == MAGNIFY_INCREASE) {
 		if (magnify_on) {
 			mag_scale += rc.mag_increment;
@@ -278,10 +390,7 @@ magnifier_set_scale(struct server *server, enum magnify_dir dir)
 			enable_magnifier(server, false);
 		}
 	}
-
-	if (output) {
-		wlr_output_schedule_frame(output->wlr_output);
-	}
+	magnifier_update(server);
 }
 
 /* Reset any buffers held by the magnifier */
@@ -294,6 +403,7 @@ magnifier_reset(void)
 		tmp_buffer = NULL;
 		tmp_texture = NULL;
 	}
+	tmp_output = NULL;
 }
 
 /* Report whether magnification is enabled */
@@ -1,5 +1,6 @@
 // SPDX-License-Identifier: GPL-2.0-only
 #include <assert.h>
+#include <math.h>
 #include <wlr/render/allocator.h>
 #include <wlr/render/swapchain.h>
 #include <wlr/types/wlr_output_layout.h>
@@ -10,6 +11,7 @@
 #include "common/buf.h"
 #include "common/lab-scene-rect.h"
 #include "common/list.h"
+#include "common/macros.h"
 #include "labwc.h"
 #include "node.h"
 #include "osd.h"
@@ -28,14 +30,15 @@ struct osd_thumbnail_item {
 
 static void
 render_node(struct server *server, struct wlr_render_pass *pass,
-		struct wlr_scene_node *node, int x, int y)
+		struct wlr_scene_node *node, int x, int y, double scale)
 {
 	switch (node->type) {
 	case WLR_SCENE_NODE_TREE: {
 		struct wlr_scene_tree *tree = wlr_scene_tree_from_node(node);
 		struct wlr_scene_node *child;
 		wl_list_for_each(child, &tree->children, link) {
-			render_node(server, pass, child, x + node->x, y + node->y);
+			render_node(server, pass, child, x + node->x,
+				y + node->y, scale);
 		}
 		break;
 	}
@@ -54,12 +57,14 @@ render_node(struct server *server, struct wlr_render_pass *pass,
 			.texture = texture,
 			.src_box = scene_buffer->src_box,
 			.dst_box = {
-				.x = x,
-				.y = y,
-				.width = scene_buffer->dst_width,
-				.height = scene_buffer->dst_height,
+				.x = round(x * scale),
+				.y = round(y * scale),
+				.width = MAX(round(scene_buffer->dst_width * scale), 1),
+				.height = MAX(round(scene_buffer->dst_height * scale), 1),
 			},
 			.transform = scene_buffer->transform,
+			.filter_mode = scale == 1.0 ? WLR_SCALE_FILTER_NEAREST
+				: WLR_SCALE_FILTER_BILINEAR,
 		});
 		wlr_texture_destroy(texture);
 		break;
@@ -71,23 +76,32 @@ render_node(struct server *server, struct wlr_render_pass *pass,
 	}
 }
 
-static struct wlr_buffer *
-render_thumb(struct output *output, struct view *view)
+struct wlr_buffer *
+osd_thumbnail_render(struct view *view, int width, int height,
+		const struct wlr_drm_format *format)
 {
-	if (!view->content_tree) {
+	if (!view->content_tree || view->current.width <= 0) {
 		/*
 		 * Defensive. Could possibly occur if view was unmapped
 		 * with OSD already displayed.
 		 */
 		return NULL;
 	}
-	struct server *server = output->server;
-	struct wlr_buffer *buffer = wlr_allocator_create_buffer(server->allocator,
-		view->current.width, view->current.height,
-		&output->wlr_output->swapchain->format);
+	struct server *server = view->server;
+	struct wlr_buffer *buffer = wlr_allocator_create_buffer(
+		server->allocator, width, height, format);
+	if (!buffer) {
+		wlr_log(WLR_ERROR, "failed to allocate thumbnail buffer");
+		return NULL;
+	}
 	struct wlr_render_pass *pass = wlr_renderer_begin_buffer_pass(
 		server->renderer, buffer, NULL);
-	render_node(server, pass, &view->content_tree->node, 0, 0);
+	if (!pass) {
+		wlr_buffer_drop(buffer);
+		return NULL;
+	}
+	double scale = (double)width / view->current.width;
+	render_node(server, pass, &view->content_tree->node, 0, 0, scale);
 	if (!wlr_render_pass_submit(pass)) {
 		wlr_log(WLR_ERROR, "failed to submit render pass");
 		wlr_buffer_drop(buffer);
@@ -159,7 +173,9 @@ create_item_scene(struct wlr_scene_tree *parent, struct view *view,
 		switcher_theme->item_height, (float[4]) {0});
 
 	/* thumbnail */
-	struct wlr_buffer *thumb_buffer = render_thumb(output, view);
+	struct wlr_buffer *thumb_buffer = osd_thumbnail_render(view,
+		view->current.width, view->current.height,
+		&output->wlr_output->swapchain->format);
 	if (thumb_buffer) {
 		struct wlr_scene_buffer *thumb_scene_buffer =
 			wlr_scene_buffer_create(tree, thumb_buffer);
@@ -9,7 +9,9 @@
 #include <wlr/types/wlr_scene.h>
 #include <wlr/util/log.h>
 #include "buffer.h"
+#include "common/hash.h"
 #include "common/list.h"
+#include "common/lru-cache.h"
 #include "common/macros.h"
 #include "common/mem.h"
 #include "node.h"
@@ -20,10 +22,66 @@
  */
 static struct wl_list all_scaled_buffers = WL_LIST_INIT(&all_scaled_buffers);
 
+/*
+ * The cache entries of those scaled_buffers, by impl, impl->hash() and
+ * scale. Entries whose keys collide are chained via their next pointer.
+ */
+static struct lab_id_map shared_entries;
+
 /* Internal API */
+static uint64_t
+sharing_key(struct scaled_buffer *self, double scale)
+{
+	uint64_t content = self->impl->hash(self);
+	uint64_t hash = LAB_HASH_INIT;
+	hash = lab_hash_bytes(hash, &self->impl, sizeof(self->impl));
+	hash = lab_hash_bytes(hash, &content, sizeof(content));
+	hash = lab_hash_bytes(hash, &scale, sizeof(scale));
+	return lab_hash_to_id(hash);
+}
+
+static void
+index_cache_entry(struct scaled_buffer *self,
+		struct scaled_buffer_cache_entry *cache_entry)
+{
+	/* Not shared, or no longer after scaled_buffer_invalidate_sharing() */
+	if (!self->impl->equal || wl_list_empty(&self->link)) {
+		return;
+	}
+	cache_entry->owner = self;
+	lab_id_chain_insert(&shared_entries, &cache_entry->chain,
+		sharing_key(self, cache_entry->scale));
+}
+
+static void
+unindex_cache_entry(struct scaled_buffer_cache_entry *cache_entry)
+{
+	lab_id_chain_remove(&shared_entries, &cache_entry->chain);
+	cache_entry->owner = NULL;
+}
+
+static struct scaled_buffer_cache_entry *
+find_shared_cache_entry(struct scaled_buffer *self, double scale)
+{
+	struct lab_id_chain *node =
+		lab_id_chain_first(&shared_entries, sharing_key(self, scale));
+	for (; node; node = node->next) {
+		struct scaled_buffer_cache_entry *cache_entry =
+			wl_container_of(node, cache_entry, chain);
+		struct scaled_buffer *other = cache_entry->owner;
+		if (other != self && other->impl == self->impl
+				&& cache_entry->scale == scale
+				&& self->impl->equal(self, other)) {
+			return cache_entry;
+		}
+	}
+	return NULL;
+}
+
 static void
 _cache_entry_destroy(struct scaled_buffer_cache_entry *cache_entry, bool drop_buffer)
 {
+	unindex_cache_entry(cache_entry);
 	wl_list_remove(&cache_entry->link);
 	if (cache_entry->buffer) {
 		/* Allow the buffer to get dropped if there are no further consumers */
@@ -65,6 +123,9 @@ _update_buffer(struct scaled_buffer *self, double scale)
 		 * - self->width and self->height are already set
 		 * - wlr_scene_buffer_set_dest_size() has already been called
 		 */
+		if (self->impl->buffer_updated) {
+			self->impl->buffer_updated(self);
+		}
 		return;
 	}
 
@@ -72,27 +133,12 @@ _update_buffer(struct scaled_buffer *self, double scale)
 
 	if (self->impl->equal) {
 		/* Search from other cached scaled-buffers */
-		struct scaled_buffer *scene_buffer;
-		wl_list_for_each(scene_buffer, &all_scaled_buffers, link) {
-			if (scene_buffer == self) {
-				continue;
-			}
-			if (self->impl != scene_buffer->impl) {
-				continue;
-			}
-			if (!self->impl->equal(self, scene_buffer)) {
-				continue;
-			}
-			cache_entry = find_cache_for_scale(scene_buffer, scale);
-			if (!cache_entry) {
-				continue;
-			}
-
+		cache_entry = find_shared_cache_entry(self, scale);
+		if (cache_entry) {
 			/* Ensure self->width and self->height are set correctly */
-			self->width = scene_buffer->width;
-			self->height = scene_buffer->height;
+			self->width = cache_entry->owner->width;
+			self->height = cache_entry->owner->height;
 			wlr_buffer = cache_entry->buffer;
-			break;
 		}
 	}
 
@@ -129,6 +175,7 @@ _update_buffer(struct scaled_buffer *self, double scale)
 			}
 			wlr_buffer_unlock(cache_entry->buffer);
 		}
+		unindex_cache_entry(cache_entry);
 		wl_list_remove(&cache_entry->link);
 	}
 
@@ -136,10 +183,14 @@ _update_buffer(struct scaled_buffer *self, double scale)
 	cache_entry->scale = scale;
 	cache_entry->buffer = wlr_buffer;
 	wl_list_insert(&self->cache, &cache_entry->link);
+	index_cache_entry(self, cache_entry);
 
 	/* And finally update the wlr_scene_buffer itself */
 	wlr_scene_buffer_set_buffer(self->scene_buffer, cache_entry->buffer);
 	wlr_scene_buffer_set_dest_size(self->scene_buffer, self->width, self->height);
+	if (self->impl->buffer_updated) {
+		self->impl->buffer_updated(self);
+	}
 }
 
 /* Internal event handlers */
@@ -189,6 +240,7 @@ scaled_buffer_create(struct wlr_scene_tree *parent,
 	assert(parent);
 	assert(impl);
 	assert(impl->create_buffer);
+	assert(!impl->equal || impl->hash);
 
 	struct scaled_buffer *self = znew(*self);
 	self->scene_buffer = wlr_scene_buffer_create(parent, NULL);
@@ -258,7 +310,29 @@ scaled_buffer_invalidate_sharing(void)
 {
 	struct scaled_buffer *scene_buffer, *tmp;
 	wl_list_for_each_safe(scene_buffer, tmp, &all_scaled_buffers, link) {
+		struct scaled_buffer_cache_entry *cache_entry;
+		wl_list_for_each(cache_entry, &scene_buffer->cache, link) {
+			unindex_cache_entry(cache_entry);
+		}
 		wl_list_remove(&scene_buffer->link);
 		wl_list_init(&scene_buffer->link);
 	}
+	assert(!shared_entries.count);
+	lab_id_map_finish(&shared_entries);
+}
+
+void
+scaled_buffer_evict_inactive_scales(void)
+{
+	struct scaled_buffer *scene_buffer;
+	wl_list_for_each(scene_buffer, &all_scaled_buffers, link) {
+		struct scaled_buffer_cache_entry *cache_entry, *cache_entry_tmp;
+		wl_list_for_each_safe(cache_entry, cache_entry_tmp,
+				&scene_buffer->cache, link) {
+			if (cache_entry->scale != scene_buffer->active_scale) {
+				_cache_entry_destroy(cache_entry,
+					scene_buffer->drop_buffer);
+			}
+		}
+	}
 }
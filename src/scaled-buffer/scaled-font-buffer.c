@@ -4,36 +4,37 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
-#include <wlr/util/log.h>
 #include "common/font.h"
+#include "common/font-cache.h"
 #include "common/graphic-helpers.h"
+#include "common/hash.h"
 #include "common/mem.h"
 #include "common/string-helpers.h"
 #include "scaled-buffer/scaled-buffer.h"
 
+static void
+get_cache_key(struct scaled_font_buffer *self, struct font_cache_key *key)
+{
+	*key = (struct font_cache_key){
+		.text = self->text,
+		.font = &self->font,
+		.max_width = self->max_width,
+		.fixed_height = self->fixed_height,
+		.color = self->color,
+		.bg_color = self->bg_color,
+		.bg_pattern = self->bg_pattern,
+	};
+}
+
 static struct lab_data_buffer *
 _create_buffer(struct scaled_buffer *scaled_buffer, double scale)
 {
-	struct lab_data_buffer *buffer = NULL;
 	struct scaled_font_buffer *self = scaled_buffer->data;
-	cairo_pattern_t *bg_pattern = self->bg_pattern;
-	cairo_pattern_t *solid_bg_pattern = NULL;
-
-	if (!bg_pattern) {
-		solid_bg_pattern = color_to_pattern(self->bg_color);
-		bg_pattern = solid_bg_pattern;
-	}
-
-	/* Buffer gets free'd automatically along the backing wlr_buffer */
-	font_buffer_create(&buffer, self->max_width, self->height, self->text,
-		&self->font, self->color, bg_pattern, scale);
+	struct font_cache_key key;
+	get_cache_key(self, &key);
 
-	if (!buffer) {
-		wlr_log(WLR_ERROR, "font_buffer_create() failed");
-	}
-
-	zfree_pattern(solid_bg_pattern);
-	return buffer;
+	/* Shared with other font buffers of the same text and style */
+	return font_cache_get_buffer(&key, scale);
 }
 
 static void
@@ -67,10 +68,31 @@ _equal(struct scaled_buffer *scaled_buffer_a,
 		&& a->bg_pattern == b->bg_pattern;
 }
 
+static uint64_t
+_hash(struct scaled_buffer *scaled_buffer)
+{
+	struct scaled_font_buffer *self = scaled_buffer->data;
+
+	uint64_t hash = LAB_HASH_INIT;
+	hash = lab_hash_string(hash, self->text);
+	hash = lab_hash_bytes(hash, &self->max_width, sizeof(self->max_width));
+	hash = lab_hash_string(hash, self->font.name);
+	hash = lab_hash_bytes(hash, &self->font.size, sizeof(self->font.size));
+	hash = lab_hash_bytes(hash, &self->font.slant, sizeof(self->font.slant));
+	hash = lab_hash_bytes(hash, &self->font.weight, sizeof(self->font.weight));
+	hash = lab_hash_bytes(hash, self->color, sizeof(self->color));
+	hash = lab_hash_bytes(hash, self->bg_color, sizeof(self->bg_color));
+	hash = lab_hash_bytes(hash, &self->fixed_height,
+		sizeof(self->fixed_height));
+	hash = lab_hash_bytes(hash, &self->bg_pattern, sizeof(self->bg_pattern));
+	return hash;
+}
+
 static const struct scaled_buffer_impl impl = {
 	.create_buffer = _create_buffer,
 	.destroy = _destroy,
 	.equal = _equal,
+	.hash = _hash,
 };
 
 /* Public API */
@@ -131,11 +153,9 @@ scaled_font_buffer_update(struct scaled_font_buffer *self, const char *text,
 	memcpy(self->bg_color, bg_color, sizeof(self->bg_color));
 
 	/* Calculate the size of font buffer and request re-rendering */
-	int computed_height;
-	font_get_buffer_size(self->max_width, self->text, &self->font,
-		&self->width, &computed_height);
-	self->height = (self->fixed_height > 0) ?
-		self->fixed_height : computed_height;
+	struct font_cache_key key;
+	get_cache_key(self, &key);
+	font_cache_get_size(&key, &self->width, &self->height);
 	scaled_buffer_request_update(self->scaled_buffer,
 		self->width, self->height);
 }
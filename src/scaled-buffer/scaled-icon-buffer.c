@@ -5,6 +5,10 @@
 #include <string.h>
 #include <wlr/util/log.h>
 #include "buffer.h"
+#include "common/hash.h"
+#include "common/icon-cache.h"
+#include "common/list.h"
+#include "common/macros.h"
 #include "common/mem.h"
 #include "common/string-helpers.h"
 #include "config.h"
@@ -18,6 +22,108 @@
 
 #if HAVE_LIBSFDO
 
+/*
+ * A window icon is looked up in several places in turn, see get_steps().
+ * Each lookup by name is cached in icon-cache.h, including those which
+ * found nothing, so usually the icon is found in the cache right away.
+ * The lookups that are not cached yet are run on the icon loader threads.
+ */
+#define MAX_STEPS 4
+
+enum icon_step_type {
+	STEP_ICON_NAME = ICON_CACHE_ICON_NAME,
+	STEP_APP_ID = ICON_CACHE_APP_ID,
+	STEP_CLIENT_BUFFERS,
+};
+
+struct icon_step {
+	enum icon_step_type type;
+	const char *name; /* NULL for STEP_CLIENT_BUFFERS */
+};
+
+/*
+ * Loads the icon on a worker thread. Jobs carry a copy of everything
+ * needed, so their scaled_icon_buffers may change or go away meanwhile.
+ * Buffers asking for the same icon while it is loaded share the job.
+ */
+struct icon_job {
+	struct wl_list waiters; /* scaled_icon_buffer.job_link */
+	struct wl_list link; /* jobs */
+	/* Set once there are no waiters, skips the job if it did not run */
+	bool cancelled;
+
+	struct server *server;
+	struct icon_step steps[MAX_STEPS];
+	int nr_steps;
+	bool has_client_buffers;
+	int width;
+	int height;
+	double scale;
+
+	/* Icons found by the steps that ran, added to the cache when done */
+	struct lab_data_buffer *buffers[MAX_STEPS];
+	int nr_ran;
+};
+
+/* Jobs that are not done yet */
+static struct wl_list jobs = WL_LIST_INIT(&jobs);
+
+static void
+add_step(struct icon_step *steps, int *nr_steps, enum icon_step_type type,
+		const char *name)
+{
+	if (type != STEP_CLIENT_BUFFERS && string_null_or_empty(name)) {
+		return;
+	}
+	steps[(*nr_steps)++] = (struct icon_step){ .type = type, .name = name };
+}
+
+/* Returns the places to look for the icon in, best one first */
+static int
+get_steps(struct scaled_icon_buffer *self, struct icon_step *steps)
+{
+	int nr_steps = 0;
+	if (self->icon_name) {
+		/* generic icon (e.g. menu icons) */
+		add_step(steps, &nr_steps, STEP_ICON_NAME, self->icon_name);
+		return nr_steps;
+	}
+
+	/*
+	 * Window icons can be supplied by the application as icon name or
+	 * buffers. Wayland apps can provide them via xdg-toplevel-icon
+	 * protocol, X11 apps can provide buffers via _NET_WM_ICON property.
+	 *
+	 * Otherwise, if the app_id is 'firefox' for example, then libsfdo
+	 * will parse firefox.desktop to get the Icon name and then find that
+	 * icon based on the icon theme specified in rc.xml.
+	 */
+	if (self->view_icon_prefer_client) {
+		add_step(steps, &nr_steps, STEP_ICON_NAME, self->view_icon_name);
+		add_step(steps, &nr_steps, STEP_CLIENT_BUFFERS, NULL);
+		add_step(steps, &nr_steps, STEP_APP_ID, self->view_app_id);
+	} else {
+		add_step(steps, &nr_steps, STEP_APP_ID, self->view_app_id);
+		add_step(steps, &nr_steps, STEP_ICON_NAME, self->view_icon_name);
+		add_step(steps, &nr_steps, STEP_CLIENT_BUFFERS, NULL);
+	}
+	/* If both client and server icons are unavailable, use the fallback icon */
+	add_step(steps, &nr_steps, STEP_ICON_NAME, rc.fallback_app_icon_name);
+	return nr_steps;
+}
+
+static struct icon_cache_key
+step_key(const struct icon_step *step, int width, int height, double scale)
+{
+	return (struct icon_cache_key){
+		.source = (enum icon_cache_source)step->type,
+		.name = step->name,
+		.width = width,
+		.height = height,
+		.scale = scale,
+	};
+}
+
 static struct lab_data_buffer *
 choose_best_icon_buffer(struct scaled_icon_buffer *self, int icon_size, double scale)
 {
@@ -43,54 +149,207 @@ choose_best_icon_buffer(struct scaled_icon_buffer *self, int icon_size, double s
 	return best_buffer;
 }
 
-static struct lab_data_buffer *
-img_to_buffer(struct lab_img *img, int width, int height, double scale)
+/*
+ * Goes through @steps using the cache only. Returns the index of the
+ * first step that is not cached, or -1 if the icon was found or there
+ * is none.
+ */
+static int
+lookup_icon(struct scaled_icon_buffer *self, const struct icon_step *steps,
+		int nr_steps, double scale, struct lab_data_buffer **buffer)
 {
-	struct lab_data_buffer *buffer = lab_img_render(img, width, height, scale);
-	lab_img_destroy(img);
-	return buffer;
+	*buffer = NULL;
+	for (int i = 0; i < nr_steps; i++) {
+		if (steps[i].type == STEP_CLIENT_BUFFERS) {
+			/* Client buffers are owned by the view, not cached */
+			int icon_size = MIN(self->width, self->height);
+			struct lab_data_buffer *best =
+				choose_best_icon_buffer(self, icon_size, scale);
+			if (best) {
+				wlr_log(WLR_DEBUG, "loaded icon from client buffer");
+				*buffer = buffer_resize(best, self->width,
+					self->height, scale);
+				return -1;
+			}
+			continue;
+		}
+
+		struct icon_cache_key key =
+			step_key(&steps[i], self->width, self->height, scale);
+		if (!icon_cache_lookup(&key, buffer)) {
+			return i;
+		}
+		if (*buffer) {
+			return -1;
+		}
+	}
+	return -1;
 }
 
-/*
- * Load an icon from application-supplied icon name or buffers.
- * Wayland apps can provide icon names and buffers via xdg-toplevel-icon protocol.
- * X11 apps can provide icon buffers via _NET_WM_ICON property.
- */
-static struct lab_data_buffer *
-load_client_icon(struct scaled_icon_buffer *self, int icon_size, double scale)
+/* Runs on an icon loader thread, or synchronously without them */
+static void
+job_load(void *data)
 {
-	struct lab_img *img = desktop_entry_load_icon(self->server,
-		self->view_icon_name, icon_size, scale);
-	if (img) {
-		wlr_log(WLR_DEBUG, "loaded icon from client icon name");
-		return img_to_buffer(img, self->width, self->height, scale);
+	struct icon_job *job = data;
+	int icon_size = MIN(job->width, job->height);
+
+	for (int i = 0; i < job->nr_steps; i++) {
+		if (__atomic_load_n(&job->cancelled, __ATOMIC_RELAXED)) {
+			return;
+		}
+		const struct icon_step *step = &job->steps[i];
+		struct lab_img *img = NULL;
+		switch (step->type) {
+		case STEP_CLIENT_BUFFERS:
+			if (job->has_client_buffers) {
+				/* Picked on the event loop, see lookup_icon() */
+				return;
+			}
+			break;
+		case STEP_ICON_NAME:
+			img = desktop_entry_load_icon(job->server, step->name,
+				icon_size, job->scale);
+			break;
+		case STEP_APP_ID:
+			img = desktop_entry_load_icon_from_app_id(job->server,
+				step->name, icon_size, job->scale);
+			break;
+		}
+		job->nr_ran = i + 1;
+		if (img) {
+			wlr_log(WLR_DEBUG, "loaded icon %s", step->name);
+			job->buffers[i] = lab_img_render(img, job->width,
+				job->height, job->scale);
+			lab_img_destroy(img);
+			return;
+		}
 	}
+}
 
-	struct lab_data_buffer *buffer = choose_best_icon_buffer(self, icon_size, scale);
-	if (buffer) {
-		wlr_log(WLR_DEBUG, "loaded icon from client buffer");
-		return buffer_resize(buffer, self->width, self->height, scale);
+static void
+job_destroy(struct icon_job *job)
+{
+	for (int i = 0; i < job->nr_steps; i++) {
+		free((char *)job->steps[i].name);
 	}
+	free(job);
+}
 
-	return NULL;
+/* Adds the results to the cache, also of jobs nobody waits for anymore */
+static void
+job_finish(struct icon_job *job)
+{
+	wl_list_remove(&job->link);
+	for (int i = 0; i < job->nr_ran; i++) {
+		const struct icon_step *step = &job->steps[i];
+		if (step->type != STEP_CLIENT_BUFFERS) {
+			struct icon_cache_key key = step_key(step,
+				job->width, job->height, job->scale);
+			icon_cache_insert(&key, job->buffers[i]);
+		}
+	}
+}
+
+static void
+handle_job_done(void *data)
+{
+	struct icon_job *job = data;
+	job_finish(job);
+
+	/* Replace the placeholders by calling _create_buffer() again */
+	struct scaled_icon_buffer *self, *tmp;
+	wl_list_for_each_safe(self, tmp, &job->waiters, job_link) {
+		wl_list_remove(&self->job_link);
+		self->job = NULL;
+		scaled_buffer_request_update(self->scaled_buffer, self->width,
+			self->height);
+	}
+	job_destroy(job);
+}
+
+static void
+cancel_job(struct scaled_icon_buffer *self)
+{
+	struct icon_job *job = self->job;
+	if (!job) {
+		return;
+	}
+	wl_list_remove(&self->job_link);
+	self->job = NULL;
+	if (wl_list_empty(&job->waiters)) {
+		__atomic_store_n(&job->cancelled, true, __ATOMIC_RELAXED);
+	}
+}
+
+static bool
+job_matches(struct icon_job *job, const struct icon_step *steps,
+		int nr_steps, bool has_client_buffers, int width, int height,
+		double scale)
+{
+	if (job->cancelled || job->nr_steps != nr_steps
+			|| job->has_client_buffers != has_client_buffers
+			|| job->width != width || job->height != height
+			|| job->scale != scale) {
+		return false;
+	}
+	for (int i = 0; i < nr_steps; i++) {
+		if (job->steps[i].type != steps[i].type
+				|| !str_equal(job->steps[i].name, steps[i].name)) {
+			return false;
+		}
+	}
+	return true;
 }
 
 /*
- * Load an icon by a view's app_id. For example, if the app_id is 'firefox', then
- * libsfdo will parse firefox.desktop to get the Icon name and then find that icon
- * based on the icon theme specified in rc.xml.
+ * Loads the icon from @steps into the cache. Returns false if it was
+ * loaded synchronously, true if @self waits for a job.
  */
-static struct lab_data_buffer *
-load_server_icon(struct scaled_icon_buffer *self, int icon_size, double scale)
+static bool
+load_icon(struct scaled_icon_buffer *self, const struct icon_step *steps,
+		int nr_steps, double scale)
 {
-	struct lab_img *img = desktop_entry_load_icon_from_app_id(self->server,
-		self->view_app_id, icon_size, scale);
-	if (img) {
-		wlr_log(WLR_DEBUG, "loaded icon by app_id");
-		return img_to_buffer(img, self->width, self->height, scale);
+	bool has_client_buffers = self->view_icon_buffers.size > 0;
+
+	struct icon_job *job;
+	wl_list_for_each(job, &jobs, link) {
+		if (!job_matches(job, steps, nr_steps, has_client_buffers,
+				self->width, self->height, scale)) {
+			continue;
+		}
+		if (self->job != job) {
+			cancel_job(self);
+			self->job = job;
+			wl_list_insert(&job->waiters, &self->job_link);
+		}
+		return true;
 	}
 
-	return NULL;
+	cancel_job(self);
+	job = znew(*job);
+	wl_list_init(&job->waiters);
+	wl_list_insert(&jobs, &job->link);
+	job->server = self->server;
+	for (int i = 0; i < nr_steps; i++) {
+		job->steps[i].type = steps[i].type;
+		job->steps[i].name = steps[i].name ? xstrdup(steps[i].name) : NULL;
+	}
+	job->nr_steps = nr_steps;
+	job->has_client_buffers = has_client_buffers;
+	job->width = self->width;
+	job->height = self->height;
+	job->scale = scale;
+
+	if (desktop_entry_queue_work(self->server, job_load,
+			handle_job_done, job)) {
+		self->job = job;
+		wl_list_insert(&job->waiters, &self->job_link);
+		return true;
+	}
+	job_load(job);
+	job_finish(job);
+	job_destroy(job);
+	return false;
 }
 
 #endif /* HAVE_LIBSFDO */
@@ -98,52 +357,29 @@ load_server_icon(struct scaled_icon_buffer *self, int icon_size, double scale)
 static struct lab_data_buffer *
 _create_buffer(struct scaled_buffer *scaled_buffer, double scale)
 {
+	struct lab_data_buffer *buffer = NULL;
 #if HAVE_LIBSFDO
 	struct scaled_icon_buffer *self = scaled_buffer->data;
-	int icon_size = MIN(self->width, self->height);
-	struct lab_img *img = NULL;
-	struct lab_data_buffer *buffer = NULL;
+	struct icon_step steps[MAX_STEPS];
+	int nr_steps = get_steps(self, steps);
 
-	if (self->icon_name) {
-		/* generic icon (e.g. menu icons) */
-		img = desktop_entry_load_icon(self->server, self->icon_name,
-			icon_size, scale);
-		if (img) {
-			wlr_log(WLR_DEBUG, "loaded icon by icon name");
-			return img_to_buffer(img, self->width, self->height, scale);
-		}
-		return NULL;
+	int first_missing = lookup_icon(self, steps, nr_steps, scale, &buffer);
+	if (first_missing < 0) {
+		return buffer;
 	}
 
-	/* window icon */
-	if (self->view_icon_prefer_client) {
-		buffer = load_client_icon(self, icon_size, scale);
-		if (buffer) {
-			return buffer;
-		}
-		buffer = load_server_icon(self, icon_size, scale);
-		if (buffer) {
-			return buffer;
-		}
-	} else {
-		buffer = load_server_icon(self, icon_size, scale);
-		if (buffer) {
-			return buffer;
-		}
-		buffer = load_client_icon(self, icon_size, scale);
-		if (buffer) {
-			return buffer;
-		}
-	}
-	/* If both client and server icons are unavailable, use the fallback icon */
-	img = desktop_entry_load_icon(self->server, rc.fallback_app_icon_name,
-		icon_size, scale);
-	if (img) {
-		wlr_log(WLR_DEBUG, "loaded fallback icon");
-		return img_to_buffer(img, self->width, self->height, scale);
+	/*
+	 * Leave the icon empty until it arrives, rather than stalling the
+	 * compositor on the disk. Steps before the first missing one are
+	 * known to find nothing.
+	 */
+	if (load_icon(self, &steps[first_missing], nr_steps - first_missing,
+			scale)) {
+		return NULL;
 	}
+	lookup_icon(self, steps, nr_steps, scale, &buffer);
 #endif /* HAVE_LIBSFDO */
-	return NULL;
+	return buffer;
 }
 
 static void
@@ -176,6 +412,9 @@ _destroy(struct scaled_buffer *scaled_buffer)
 		wl_list_remove(&self->on_view.new_app_id.link);
 		wl_list_remove(&self->on_view.destroy.link);
 	}
+#if HAVE_LIBSFDO
+	cancel_job(self);
+#endif
 	free(self->view_app_id);
 	free(self->view_icon_name);
 	set_icon_buffers(self, NULL);
@@ -208,10 +447,30 @@ _equal(struct scaled_buffer *scaled_buffer_a,
 		&& a->height == b->height;
 }
 
+static uint64_t
+_hash(struct scaled_buffer *scaled_buffer)
+{
+	struct scaled_icon_buffer *self = scaled_buffer->data;
+
+	uint64_t hash = LAB_HASH_INIT;
+	hash = lab_hash_string(hash, self->view_app_id);
+	hash = lab_hash_bytes(hash, &self->view_icon_prefer_client,
+		sizeof(self->view_icon_prefer_client));
+	hash = lab_hash_string(hash, self->view_icon_name);
+	/* The client buffers are compared by pointer, see _equal() */
+	hash = lab_hash_bytes(hash, self->view_icon_buffers.data,
+		self->view_icon_buffers.size);
+	hash = lab_hash_string(hash, self->icon_name);
+	hash = lab_hash_bytes(hash, &self->width, sizeof(self->width));
+	hash = lab_hash_bytes(hash, &self->height, sizeof(self->height));
+	return hash;
+}
+
 static struct scaled_buffer_impl impl = {
 	.create_buffer = _create_buffer,
 	.destroy = _destroy,
 	.equal = _equal,
+	.hash = _hash,
 };
 
 struct scaled_icon_buffer *
@@ -235,6 +494,17 @@ scaled_icon_buffer_create(struct wlr_scene_tree *parent, struct server *server,
 	return self;
 }
 
+static void
+request_update(struct scaled_icon_buffer *self)
+{
+#if HAVE_LIBSFDO
+	/* Stop waiting for the icon of the old state */
+	cancel_job(self);
+#endif
+	scaled_buffer_request_update(self->scaled_buffer,
+		self->width, self->height);
+}
+
 static void
 handle_view_set_icon(struct wl_listener *listener, void *data)
 {
@@ -255,8 +525,7 @@ handle_view_set_icon(struct wl_listener *listener, void *data)
 	}
 
 	set_icon_buffers(self, &self->view->icon.buffers);
-	scaled_buffer_request_update(self->scaled_buffer,
-		self->width, self->height);
+	request_update(self);
 }
 
 static void
@@ -271,8 +540,7 @@ handle_view_new_title(struct wl_listener *listener, void *data)
 		return;
 	}
 	self->view_icon_prefer_client = prefer_client;
-	scaled_buffer_request_update(self->scaled_buffer,
-		self->width, self->height);
+	request_update(self);
 }
 
 static void
@@ -289,8 +557,7 @@ handle_view_new_app_id(struct wl_listener *listener, void *data)
 	xstrdup_replace(self->view_app_id, app_id);
 	self->view_icon_prefer_client = window_rules_get_property(
 		self->view, "iconPreferClient") == LAB_PROP_TRUE;
-	scaled_buffer_request_update(self->scaled_buffer,
-		self->width, self->height);
+	request_update(self);
 }
 
 static void
@@ -347,5 +614,5 @@ scaled_icon_buffer_set_icon_name(struct scaled_icon_buffer *self,
 		return;
 	}
 	xstrdup_replace(self->icon_name, icon_name);
-	scaled_buffer_request_update(self->scaled_buffer, self->width, self->height);
+	request_update(self);
 }
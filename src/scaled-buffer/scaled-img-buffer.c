@@ -2,6 +2,7 @@
 #define _POSIX_C_SOURCE 200809L
 #include "scaled-buffer/scaled-img-buffer.h"
 #include <assert.h>
+#include "common/hash.h"
 #include "common/mem.h"
 #include "img/img.h"
 #include "node.h"
@@ -36,10 +37,22 @@ _equal(struct scaled_buffer *scaled_buffer_a,
 		&& a->height == b->height;
 }
 
+static uint64_t
+_hash(struct scaled_buffer *scaled_buffer)
+{
+	struct scaled_img_buffer *self = scaled_buffer->data;
+
+	uint64_t hash = lab_img_hash(self->img);
+	hash = lab_hash_bytes(hash, &self->width, sizeof(self->width));
+	hash = lab_hash_bytes(hash, &self->height, sizeof(self->height));
+	return hash;
+}
+
 static struct scaled_buffer_impl impl = {
 	.create_buffer = _create_buffer,
 	.destroy = _destroy,
 	.equal = _equal,
+	.hash = _hash,
 };
 
 struct scaled_img_buffer *
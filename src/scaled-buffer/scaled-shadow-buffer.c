@@ -0,0 +1,150 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#define _POSIX_C_SOURCE 200809L
+#include "scaled-buffer/scaled-shadow-buffer.h"
+#include <assert.h>
+#include <string.h>
+#include <wlr/types/wlr_buffer.h>
+#include <wlr/types/wlr_scene.h>
+#include "buffer.h"
+#include "common/hash.h"
+#include "common/mem.h"
+#include "scaled-buffer/scaled-buffer.h"
+
+static void
+unscaled_size(const struct shadow_raster_key *key, int *width, int *height)
+{
+	if (key->corner) {
+		*width = key->total_size;
+		*height = key->total_size;
+	} else {
+		*width = key->visible_size;
+		*height = 1;
+	}
+}
+
+static struct lab_data_buffer *
+_create_buffer(struct scaled_buffer *scaled_buffer, double scale)
+{
+	struct scaled_shadow_buffer *self = scaled_buffer->data;
+	struct shadow_raster_key key = self->key;
+	key.scale = scale;
+
+	int width, height;
+	unscaled_size(&key, &width, &height);
+	struct lab_data_buffer *buffer =
+		buffer_create_cairo(width, height, scale);
+	if (!buffer) {
+		return NULL;
+	}
+	shadow_raster_draw(&key, buffer->data, buffer->stride);
+	return buffer;
+}
+
+static void
+apply_geometry(struct scaled_shadow_buffer *self)
+{
+	struct wlr_scene_buffer *scene_buffer = self->scene_buffer;
+	struct wlr_buffer *buffer = scene_buffer->buffer;
+	if (buffer && !wlr_fbox_empty(&self->crop)) {
+		/* Source boxes are in buffer pixels */
+		double scale_x = (double)buffer->width
+			/ self->scaled_buffer->width;
+		double scale_y = (double)buffer->height
+			/ self->scaled_buffer->height;
+		struct wlr_fbox src_box = {
+			.x = self->crop.x * scale_x,
+			.y = self->crop.y * scale_y,
+			.width = self->crop.width * scale_x,
+			.height = self->crop.height * scale_y,
+		};
+		wlr_scene_buffer_set_source_box(scene_buffer, &src_box);
+	} else {
+		wlr_scene_buffer_set_source_box(scene_buffer, NULL);
+	}
+	wlr_scene_buffer_set_dest_size(scene_buffer, self->dest_width,
+		self->dest_height);
+}
+
+static void
+_buffer_updated(struct scaled_buffer *scaled_buffer)
+{
+	apply_geometry(scaled_buffer->data);
+}
+
+static void
+_destroy(struct scaled_buffer *scaled_buffer)
+{
+	free(scaled_buffer->data);
+}
+
+static bool
+_equal(struct scaled_buffer *scaled_buffer_a,
+	struct scaled_buffer *scaled_buffer_b)
+{
+	struct scaled_shadow_buffer *a = scaled_buffer_a->data;
+	struct scaled_shadow_buffer *b = scaled_buffer_b->data;
+
+	return a->key.visible_size == b->key.visible_size
+		&& a->key.total_size == b->key.total_size
+		&& a->key.titlebar_height == b->key.titlebar_height
+		&& a->key.corner == b->key.corner
+		&& !memcmp(a->key.color, b->key.color, sizeof(a->key.color));
+}
+
+static uint64_t
+_hash(struct scaled_buffer *scaled_buffer)
+{
+	struct scaled_shadow_buffer *self = scaled_buffer->data;
+	struct shadow_raster_key *key = &self->key;
+
+	uint64_t hash = LAB_HASH_INIT;
+	hash = lab_hash_bytes(hash, &key->visible_size, sizeof(key->visible_size));
+	hash = lab_hash_bytes(hash, &key->total_size, sizeof(key->total_size));
+	hash = lab_hash_bytes(hash, &key->titlebar_height,
+		sizeof(key->titlebar_height));
+	hash = lab_hash_bytes(hash, &key->corner, sizeof(key->corner));
+	hash = lab_hash_bytes(hash, key->color, sizeof(key->color));
+	return hash;
+}
+
+static struct scaled_buffer_impl impl = {
+	.create_buffer = _create_buffer,
+	.destroy = _destroy,
+	.equal = _equal,
+	.hash = _hash,
+	.buffer_updated = _buffer_updated,
+};
+
+struct scaled_shadow_buffer *
+scaled_shadow_buffer_create(struct wlr_scene_tree *parent,
+		const struct shadow_raster_key *key)
+{
+	assert(parent);
+	assert(key);
+
+	struct scaled_buffer *scaled_buffer = scaled_buffer_create(
+		parent, &impl, /* drop_buffer */ true);
+	struct scaled_shadow_buffer *self = znew(*self);
+	self->scaled_buffer = scaled_buffer;
+	self->scene_buffer = scaled_buffer->scene_buffer;
+	self->key = *key;
+	unscaled_size(key, &self->dest_width, &self->dest_height);
+
+	scaled_buffer->data = self;
+
+	scaled_buffer_request_update(scaled_buffer, self->dest_width,
+		self->dest_height);
+
+	return self;
+}
+
+void
+scaled_shadow_buffer_set_geometry(struct scaled_shadow_buffer *self,
+		const struct wlr_fbox *crop, int width, int height)
+{
+	assert(self);
+	self->crop = crop ? *crop : (struct wlr_fbox){0};
+	self->dest_width = width;
+	self->dest_height = height;
+	apply_geometry(self);
+}
@@ -20,6 +20,7 @@
 #include "config/libinput.h"
 #include "config/rcxml.h"
 #include "config/touch.h"
+#include "input/cursor.h"
 #include "input/ime.h"
 #include "input/tablet.h"
 #include "input/tablet-pad.h"
@@ -668,6 +669,7 @@ seat_init(struct server *server)
 	wl_list_init(&seat->tablet_tools);
 	wl_list_init(&seat->tablet_pads);
 
+	cursor_context_cache_init(seat);
 	input_handlers_init(seat);
 }
 
@@ -693,6 +695,7 @@ seat_finish(struct server *server)
 
 	input_handlers_finish(seat);
 	input_method_relay_finish(seat->input_method_relay);
+	cursor_context_cache_finish(seat);
 }
 
 static void
@@ -45,6 +45,8 @@
 #endif
 
 #include "action.h"
+#include "common/font-cache.h"
+#include "common/icon-cache.h"
 #include "common/macros.h"
 #include "config/rcxml.h"
 #include "config/session.h"
@@ -75,34 +77,69 @@
 #define LAB_WLR_LINUX_DMABUF_VERSION 4
 #define LAB_WLR_PRESENTATION_TIME_VERSION 2
 
+static int handle_sighup(int signal, void *data);
+
+/* Swaps in the theme built by reload_config_and_theme() */
+static void
+handle_theme_ready(struct theme *theme, void *data)
+{
+	struct server *server = data;
+
+	scaled_buffer_invalidate_sharing();
+	/* Text rendered with the old fonts and colors is of no use now */
+	font_cache_clear();
+	theme_finish(server->theme);
+	/* rc.theme points to server->theme, so update it in place */
+	*server->theme = *theme;
+	free(theme);
+
+	struct view *view;
+	wl_list_for_each(view, &server->views, link) {
+		view_reload_ssd(view);
+	}
+
+	menu_reconfigure(server);
+	resize_indicator_reconfigure(server);
+
+	if (server->reconfigure_deferred) {
+		server->reconfigure_deferred = false;
+		handle_sighup(SIGHUP, server);
+	}
+}
+
 static void
 reload_config_and_theme(struct server *server)
 {
+	if (server->theme_build) {
+		/* The theme workers still use rc, try again once done */
+		server->reconfigure_deferred = true;
+		return;
+	}
+
 	/* Avoid UAF when dialog client is used during reconfigure */
 	action_prompts_destroy();
 
-	scaled_buffer_invalidate_sharing();
 	rcxml_finish();
 	rcxml_read(rc.config_file);
-	theme_finish(server->theme);
-	theme_init(server->theme, server, rc.theme_name);
 
 #if HAVE_LIBSFDO
 	desktop_entry_finish(server);
+	/* Including icons that were not found with the old icon theme */
+	icon_cache_clear();
 	desktop_entry_init(server);
 #endif
 
-	struct view *view;
-	wl_list_for_each(view, &server->views, link) {
-		view_reload_ssd(view);
-	}
-
-	menu_reconfigure(server);
 	seat_reconfigure(server);
 	regions_reconfigure(server);
-	resize_indicator_reconfigure(server);
 	kde_server_decoration_update_default();
 	workspaces_reconfigure(server);
+
+	/*
+	 * Keep using the old theme while the new one is rasterized, so a big
+	 * theme doesn't stall input. Everything depending on the theme is
+	 * updated at once in handle_theme_ready().
+	 */
+	theme_build_async(server, rc.theme_name, handle_theme_ready, server);
 }
 
 static int
@@ -110,6 +147,12 @@ handle_sighup(int signal, void *data)
 {
 	struct server *server = data;
 
+	if (server->theme_build) {
+		/* Not even touching the environment, the workers read it */
+		server->reconfigure_deferred = true;
+		return 0;
+	}
+
 	keyboard_cancel_all_keybind_repeats(&server->seat);
 	session_environment_init();
 	reload_config_and_theme(server);
@@ -549,6 +592,8 @@ server_init(struct server *server)
 
 	wl_list_init(&server->views);
 	wl_list_init(&server->unmanaged_surfaces);
+	view_title_updates_init(server);
+	theme_builder_init(server);
 
 	server->scene = wlr_scene_create();
 	if (!server->scene) {
@@ -767,6 +812,8 @@ server_finish(struct server *server)
 	wl_event_source_remove(server->sigint_source);
 	wl_event_source_remove(server->sigterm_source);
 	wl_event_source_remove(server->sigchld_source);
+	view_title_updates_finish(server);
+	theme_builder_finish(server);
 
 	wl_display_destroy_clients(server->wl_display);
 
@@ -787,6 +834,12 @@ server_finish(struct server *server)
 	wlr_backend_destroy(server->backend);
 	wlr_allocator_destroy(server->allocator);
 
+	/* Queued by the outputs destroyed along with the backend */
+	if (server->evict_scales_idle) {
+		wl_event_source_remove(server->evict_scales_idle);
+		server->evict_scales_idle = NULL;
+	}
+
 	wl_list_remove(&server->renderer_lost.link);
 	wlr_renderer_destroy(server->renderer);
 
@@ -1,10 +1,11 @@
 // SPDX-License-Identifier: GPL-2.0-only
 
 #include <assert.h>
+#include <string.h>
 #include <wlr/types/wlr_scene.h>
-#include "buffer.h"
 #include "config/rcxml.h"
 #include "labwc.h"
+#include "scaled-buffer/scaled-shadow-buffer.h"
 #include "ssd.h"
 #include "ssd-internal.h"
 #include "theme.h"
@@ -26,19 +27,33 @@ never_accepts_input(struct wlr_scene_buffer *buffer, double *sx, double *sy)
  * to crop is controlled by vertical_overlap and horizontal_overlap.
  */
 static void
-corner_scale_crop(struct wlr_scene_buffer *buffer, int horizontal_overlap,
+corner_scale_crop(struct scaled_shadow_buffer *buffer, int horizontal_overlap,
 		int vertical_overlap, int corner_size)
 {
 	int width = MAX(corner_size - horizontal_overlap, 0);
 	int height = MAX(corner_size - vertical_overlap, 0);
-	struct wlr_fbox src_box = {
+	struct wlr_fbox crop = {
 		.x = horizontal_overlap,
 		.y = vertical_overlap,
 		.width = width,
 		.height = height,
 	};
-	wlr_scene_buffer_set_source_box(buffer, &src_box);
-	wlr_scene_buffer_set_dest_size(buffer, width, height);
+	scaled_shadow_buffer_set_geometry(buffer, &crop, width, height);
+}
+
+static void
+set_position(struct scaled_shadow_buffer *buffer, int x, int y)
+{
+	wlr_scene_node_set_position(&buffer->scene_buffer->node, x, y);
+}
+
+/* Edges are stretched along the window and hidden if it is too small */
+static void
+edge_scale(struct scaled_shadow_buffer *buffer, int width, int height,
+		bool show)
+{
+	scaled_shadow_buffer_set_geometry(buffer, NULL, width, height);
+	wlr_scene_node_set_enabled(&buffer->scene_buffer->node, show);
 }
 
 /*
@@ -89,55 +104,51 @@ set_shadow_parts_geometry(struct ssd_shadow_subtree *subtree,
 
 	x = width - inset + horizontal_overlap_downsized;
 	y = -titlebar_height + height - inset + vertical_overlap_downsized;
-	wlr_scene_node_set_position(&subtree->bottom_right->node, x, y);
+	set_position(subtree->bottom_right, x, y);
 	corner_scale_crop(subtree->bottom_right, horizontal_overlap_downsized,
 		vertical_overlap_downsized, corner_size);
 
 	x = -visible_shadow_width;
 	y = -titlebar_height + height - inset + vertical_overlap;
-	wlr_scene_node_set_position(&subtree->bottom_left->node, x, y);
+	set_position(subtree->bottom_left, x, y);
 	corner_scale_crop(subtree->bottom_left, horizontal_overlap,
 		vertical_overlap, corner_size);
 
 	x = -visible_shadow_width;
 	y = -titlebar_height - visible_shadow_width;
-	wlr_scene_node_set_position(&subtree->top_left->node, x, y);
+	set_position(subtree->top_left, x, y);
 	corner_scale_crop(subtree->top_left, horizontal_overlap_downsized,
 		vertical_overlap_downsized, corner_size);
 
 	x = width - inset + horizontal_overlap;
 	y = -titlebar_height - visible_shadow_width;
-	wlr_scene_node_set_position(&subtree->top_right->node, x, y);
+	set_position(subtree->top_right, x, y);
 	corner_scale_crop(subtree->top_right, horizontal_overlap,
 		vertical_overlap, corner_size);
 
 	x = width;
 	y = -titlebar_height + inset;
-	wlr_scene_node_set_position(&subtree->right->node, x, y);
-	wlr_scene_buffer_set_dest_size(subtree->right,
-		visible_shadow_width, MAX(height - 2 * inset, 0));
-	wlr_scene_node_set_enabled(&subtree->right->node, show_sides);
+	set_position(subtree->right, x, y);
+	edge_scale(subtree->right, visible_shadow_width,
+		MAX(height - 2 * inset, 0), show_sides);
 
 	x = inset;
 	y = -titlebar_height + height;
-	wlr_scene_node_set_position(&subtree->bottom->node, x, y);
-	wlr_scene_buffer_set_dest_size(subtree->bottom,
-		MAX(width - 2 * inset, 0), visible_shadow_width);
-	wlr_scene_node_set_enabled(&subtree->bottom->node, show_topbottom);
+	set_position(subtree->bottom, x, y);
+	edge_scale(subtree->bottom, MAX(width - 2 * inset, 0),
+		visible_shadow_width, show_topbottom);
 
 	x = -visible_shadow_width;
 	y = -titlebar_height + inset;
-	wlr_scene_node_set_position(&subtree->left->node, x, y);
-	wlr_scene_buffer_set_dest_size(subtree->left,
-		visible_shadow_width, MAX(height - 2 * inset, 0));
-	wlr_scene_node_set_enabled(&subtree->left->node, show_sides);
+	set_position(subtree->left, x, y);
+	edge_scale(subtree->left, visible_shadow_width,
+		MAX(height - 2 * inset, 0), show_sides);
 
 	x = inset;
 	y = -titlebar_height - visible_shadow_width;
-	wlr_scene_node_set_position(&subtree->top->node, x, y);
-	wlr_scene_buffer_set_dest_size(subtree->top,
-		MAX(width - 2 * inset, 0), visible_shadow_width);
-	wlr_scene_node_set_enabled(&subtree->top->node, show_topbottom);
+	set_position(subtree->top, x, y);
+	edge_scale(subtree->top, MAX(width - 2 * inset, 0),
+		visible_shadow_width, show_topbottom);
 }
 
 static void
@@ -168,8 +179,7 @@ set_shadow_geometry(struct ssd *ssd)
 		 * portion.  Top and bottom are the same size (only the cutout
 		 * is different).  The buffers are square so width == height.
 		 */
-		int corner_size =
-			theme->window[active].shadow_corner_top->logical_height;
+		int corner_size = visible_shadow_width + inset;
 
 		set_shadow_parts_geometry(subtree, width, height,
 			titlebar_height, corner_size, inset,
@@ -177,13 +187,14 @@ set_shadow_geometry(struct ssd *ssd)
 	}
 }
 
-static struct wlr_scene_buffer *
+static struct scaled_shadow_buffer *
 make_shadow(struct view *view,
-	struct wlr_scene_tree *parent, struct wlr_buffer *buf,
+	struct wlr_scene_tree *parent, const struct shadow_raster_key *key,
 	enum wl_output_transform tx)
 {
-	struct wlr_scene_buffer *scene_buf =
-		wlr_scene_buffer_create(parent, buf);
+	struct scaled_shadow_buffer *buffer =
+		scaled_shadow_buffer_create(parent, key);
+	struct wlr_scene_buffer *scene_buf = buffer->scene_buffer;
 	wlr_scene_buffer_set_transform(scene_buf, tx);
 	scene_buf->point_accepts_input = never_accepts_input;
 	/*
@@ -191,7 +202,7 @@ make_shadow(struct view *view,
 	 * pixel wide/tall. Use nearest-neighbour scaling to workaround.
 	 */
 	scene_buf->filter_mode = WLR_SCALE_FILTER_NEAREST;
-	return scene_buf;
+	return buffer;
 }
 
 void
@@ -220,29 +231,41 @@ ssd_shadow_create(struct ssd *ssd)
 
 		subtree->tree = wlr_scene_tree_create(ssd->shadow.tree);
 		struct wlr_scene_tree *parent = subtree->tree;
-		struct wlr_buffer *corner_top_buffer =
-			&theme->window[active].shadow_corner_top->base;
-		struct wlr_buffer *corner_bottom_buffer =
-			&theme->window[active].shadow_corner_bottom->base;
-		struct wlr_buffer *edge_buffer =
-			&theme->window[active].shadow_edge->base;
+
+		/*
+		 * Edge shadows don't need to be inset so the buffers are
+		 * sized just for the visible width. Corners are inset so the
+		 * buffers are larger for this.
+		 */
+		int visible_size = theme->window[active].shadow_size;
+		struct shadow_raster_key edge = {
+			.visible_size = visible_size,
+			.total_size = visible_size
+				+ (int)(visible_size * SSD_SHADOW_INSET),
+		};
+		memcpy(edge.color, theme->window[active].shadow_color,
+			sizeof(edge.color));
+		struct shadow_raster_key corner_bottom = edge;
+		corner_bottom.corner = true;
+		struct shadow_raster_key corner_top = corner_bottom;
+		corner_top.titlebar_height = theme->titlebar_height;
 
 		subtree->bottom_right = make_shadow(view, parent,
-			corner_bottom_buffer, WL_OUTPUT_TRANSFORM_NORMAL);
+			&corner_bottom, WL_OUTPUT_TRANSFORM_NORMAL);
 		subtree->bottom_left = make_shadow(view, parent,
-			corner_bottom_buffer, WL_OUTPUT_TRANSFORM_FLIPPED);
+			&corner_bottom, WL_OUTPUT_TRANSFORM_FLIPPED);
 		subtree->top_left = make_shadow(view, parent,
-			corner_top_buffer, WL_OUTPUT_TRANSFORM_180);
+			&corner_top, WL_OUTPUT_TRANSFORM_180);
 		subtree->top_right = make_shadow(view, parent,
-			corner_top_buffer, WL_OUTPUT_TRANSFORM_FLIPPED_180);
+			&corner_top, WL_OUTPUT_TRANSFORM_FLIPPED_180);
 		subtree->right = make_shadow(view, parent,
-			edge_buffer, WL_OUTPUT_TRANSFORM_NORMAL);
+			&edge, WL_OUTPUT_TRANSFORM_NORMAL);
 		subtree->bottom = make_shadow(view, parent,
-			edge_buffer, WL_OUTPUT_TRANSFORM_90);
+			&edge, WL_OUTPUT_TRANSFORM_90);
 		subtree->left = make_shadow(view, parent,
-			edge_buffer, WL_OUTPUT_TRANSFORM_180);
+			&edge, WL_OUTPUT_TRANSFORM_180);
 		subtree->top = make_shadow(view, parent,
-			edge_buffer, WL_OUTPUT_TRANSFORM_270);
+			&edge, WL_OUTPUT_TRANSFORM_270);
 	}
 
 	ssd_shadow_update(ssd);
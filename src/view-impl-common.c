@@ -9,6 +9,7 @@
 void
 view_impl_map(struct view *view)
 {
+	view->server->scene_generation++;
 	view_update_visibility(view);
 
 	if (!view->been_mapped) {
@@ -39,6 +40,7 @@ view_impl_map(struct view *view)
 void
 view_impl_unmap(struct view *view)
 {
+	view->server->scene_generation++;
 	view_update_visibility(view);
 
 	/*
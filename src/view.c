@@ -1,7 +1,9 @@
 // SPDX-License-Identifier: GPL-2.0-only
+#define _POSIX_C_SOURCE 200809L
 #include "view.h"
 #include <assert.h>
 #include <strings.h>
+#include <time.h>
 #include <wlr/types/wlr_cursor.h>
 #include <wlr/types/wlr_keyboard_group.h>
 #include <wlr/types/wlr_output_layout.h>
@@ -606,6 +608,8 @@ view_moved(struct view *view)
 	assert(view);
 	wlr_scene_node_set_position(&view->scene_tree->node,
 		view->current.x, view->current.y);
+	/* The invisible resize extents moved along without damage */
+	view->server->scene_generation++;
 	/*
 	 * Only floating views change output when moved. Non-floating
 	 * views (maximized/tiled/fullscreen) are tied to a particular
@@ -2304,6 +2308,7 @@ view_move_to_front(struct view *view)
 		move_to_front(view);
 	}
 
+	view->server->scene_generation++;
 	cursor_update_focus(view->server);
 	desktop_update_top_layer_visibility(view->server);
 }
@@ -2318,6 +2323,7 @@ view_move_to_back(struct view *view)
 	for_each_subview(root, move_to_back);
 	move_to_back(root);
 
+	view->server->scene_generation++;
 	cursor_update_focus(view->server);
 	desktop_update_top_layer_visibility(view->server);
 }
@@ -2360,6 +2366,108 @@ view_has_strut_partial(struct view *view)
 		view->impl->has_strut_partial(view);
 }
 
+static uint64_t
+timespec_to_ms(const struct timespec *ts)
+{
+	return (uint64_t)ts->tv_sec * 1000 + ts->tv_nsec / 1000000;
+}
+
+/* Hands the current title to the SSD and foreign-toplevel */
+static void
+publish_title(struct view *view, uint64_t now_ms)
+{
+	if (view->title_update.pending) {
+		view->title_update.pending = false;
+		wl_list_remove(&view->title_update.link);
+	}
+	view->title_update.last_publish_ms = now_ms;
+
+	ssd_update_title(view->ssd);
+	wl_signal_emit_mutable(&view->events.new_title, NULL);
+}
+
+/*
+ * Wakes up the outputs of views that were held back by
+ * <core><titleUpdateInterval>, so they are published on the next frame.
+ */
+static int
+handle_title_update_timer(void *data)
+{
+	struct server *server = data;
+	struct timespec now = { 0 };
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	uint64_t now_ms = timespec_to_ms(&now);
+
+	struct view *view, *tmp;
+	wl_list_for_each_safe(view, tmp, &server->pending_titles,
+			title_update.link) {
+		if (output_is_usable(view->output)) {
+			wlr_output_schedule_frame(view->output->wlr_output);
+		} else {
+			publish_title(view, now_ms);
+		}
+	}
+	return 0;
+}
+
+void
+view_title_updates_init(struct server *server)
+{
+	wl_list_init(&server->pending_titles);
+	server->title_update_timer = wl_event_loop_add_timer(
+		server->wl_event_loop, handle_title_update_timer, server);
+}
+
+void
+view_title_updates_finish(struct server *server)
+{
+	wl_event_source_remove(server->title_update_timer);
+	server->title_update_timer = NULL;
+}
+
+void
+view_publish_titles(struct server *server, struct output *output,
+		const struct timespec *now)
+{
+	uint64_t now_ms = timespec_to_ms(now);
+	uint64_t next_ms = UINT64_MAX;
+	struct view *view, *tmp;
+	wl_list_for_each_safe(view, tmp, &server->pending_titles,
+			title_update.link) {
+		/* Views that lost their output are published on any frame */
+		if (view->output != output && output_is_usable(view->output)) {
+			continue;
+		}
+		uint64_t due_ms = view->title_update.last_publish_ms
+			+ rc.title_update_interval;
+		if (now_ms < due_ms) {
+			next_ms = MIN(next_ms, due_ms);
+			continue;
+		}
+		publish_title(view, now_ms);
+	}
+	if (next_ms != UINT64_MAX) {
+		wl_event_source_timer_update(server->title_update_timer,
+			next_ms - now_ms);
+	}
+}
+
+void
+view_flush_titles(struct server *server, struct output *output)
+{
+	struct timespec now = { 0 };
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	uint64_t now_ms = timespec_to_ms(&now);
+
+	struct view *view, *tmp;
+	wl_list_for_each_safe(view, tmp, &server->pending_titles,
+			title_update.link) {
+		if (view->output == output) {
+			publish_title(view, now_ms);
+		}
+	}
+}
+
 void
 view_set_title(struct view *view, const char *title)
 {
@@ -2373,8 +2481,25 @@ view_set_title(struct view *view, const char *title)
 	}
 	xstrdup_replace(view->title, title);
 
-	ssd_update_title(view->ssd);
-	wl_signal_emit_mutable(&view->events.new_title, NULL);
+	/* A newer title is already waiting, it just got replaced */
+	if (view->title_update.pending) {
+		return;
+	}
+
+	/*
+	 * Titles are published on the next frame of the view's output, so
+	 * that clients changing it many times per frame cause one redraw.
+	 * Unmapped views have nothing to redraw and no frames to wait for.
+	 */
+	if (!view->mapped || !output_is_usable(view->output)) {
+		struct timespec now = { 0 };
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		publish_title(view, timespec_to_ms(&now));
+		return;
+	}
+	view->title_update.pending = true;
+	wl_list_insert(&view->server->pending_titles, &view->title_update.link);
+	wlr_output_schedule_frame(view->output->wlr_output);
 }
 
 void
@@ -2590,6 +2715,9 @@ view_destroy(struct view *view)
 	wl_list_remove(&view->request_fullscreen.link);
 	wl_list_remove(&view->set_title.link);
 	wl_list_remove(&view->destroy.link);
+	if (view->title_update.pending) {
+		wl_list_remove(&view->title_update.link);
+	}
 
 	zfree(view->title);
 	zfree(view->app_id);
@@ -0,0 +1,318 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Runs labwc on the headless backend with the pixman renderer, connects a
+ * number of xdg-shell clients that commit shm buffers at a fixed rate and
+ * drives the compositor through scripted phases: idle, interactive moves
+ * and resizes over IPC, focus cycling and workspace switches.
+ *
+ * Reports per phase the compositor frame time (build + commit, read from
+ * the LABWC_FRAME_TRACE file), the client commit to presentation latency
+ * (wp_presentation feedback) and the resident set size of the compositor.
+ *
+ * Run with 'meson test --benchmark', or by hand:
+ *   bench-headless <path to labwc> [clients] [seconds per phase]
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <wayland-client.h>
+#include "ext-workspace-v1-client-protocol.h"
+#include "headless.h"
+
+#define MAX_CLIENTS 64
+#define MAX_SAMPLES 65536
+#define CLIENT_HZ 60
+
+enum phase {
+	PHASE_IDLE,
+	PHASE_MOVE,
+	PHASE_RESIZE,
+	PHASE_FOCUS,
+	PHASE_WORKSPACE,
+	PHASE_COUNT,
+};
+
+static const char *const phase_names[PHASE_COUNT] = {
+	[PHASE_IDLE] = "idle",
+	[PHASE_MOVE] = "move",
+	[PHASE_RESIZE] = "resize",
+	[PHASE_FOCUS] = "focus",
+	[PHASE_WORKSPACE] = "workspace",
+};
+
+struct phase_stats {
+	uint64_t start_ns, end_ns;
+	uint32_t *latencies_us;
+	size_t nr_latencies;
+	size_t nr_discarded;
+	uint32_t *frames_us;
+	size_t nr_frames;
+	size_t nr_skipped;
+};
+
+static struct test_client clients[MAX_CLIENTS];
+static int nr_clients = 8;
+static struct phase_stats stats[PHASE_COUNT];
+static enum phase current_phase;
+
+static void
+die(const char *msg)
+{
+	perror(msg);
+	exit(EXIT_FAILURE);
+}
+
+static void
+handle_presented(struct test_client *client, uint32_t tag,
+		int64_t latency_ns)
+{
+	struct phase_stats *phase = &stats[tag];
+	if (latency_ns < 0) {
+		phase->nr_discarded++;
+	} else if (phase->nr_latencies < MAX_SAMPLES) {
+		phase->latencies_us[phase->nr_latencies++] = latency_ns / 1000;
+	}
+}
+
+/* Sorts the frame trace into the phases by frame start time */
+static void
+read_frame_trace(const char *path)
+{
+	FILE *csv = fopen(path, "r");
+	if (!csv) {
+		perror(path);
+		return;
+	}
+	char line[256];
+	/* Skip the header */
+	if (!fgets(line, sizeof(line), csv)) {
+		fclose(csv);
+		return;
+	}
+	while (fgets(line, sizeof(line), csv)) {
+		uint64_t start_ns;
+		uint32_t delay_us, build_us, commit_us;
+		int skipped;
+		char *p = strchr(line, ',');
+		if (!p || sscanf(p, ",%" SCNu64 ",%" SCNu32 ",%" SCNu32
+				",%" SCNu32 ",%*d,%*u,%d", &start_ns, &delay_us,
+				&build_us, &commit_us, &skipped) != 5) {
+			continue;
+		}
+		for (size_t i = 0; i < PHASE_COUNT; i++) {
+			struct phase_stats *phase = &stats[i];
+			if (start_ns < phase->start_ns
+					|| start_ns >= phase->end_ns) {
+				continue;
+			}
+			if (skipped) {
+				phase->nr_skipped++;
+			} else if (phase->nr_frames < MAX_SAMPLES) {
+				phase->frames_us[phase->nr_frames++] =
+					build_us + commit_us;
+			}
+			break;
+		}
+	}
+	fclose(csv);
+}
+
+static void
+report(long rss_kb, long hwm_kb)
+{
+	printf("%d clients at %dHz, frame time = build + commit in us\n",
+		nr_clients, CLIENT_HZ);
+	printf("%-10s %7s %7s  %8s %7s %7s  %9s %7s %9s\n", "phase",
+		"frames", "skipped", "mean", "p95", "max", "latency", "p95",
+		"discarded");
+	for (size_t i = 0; i < PHASE_COUNT; i++) {
+		struct phase_stats *phase = &stats[i];
+		struct summary frame, latency;
+		summarize(phase->frames_us, phase->nr_frames, &frame);
+		summarize(phase->latencies_us, phase->nr_latencies, &latency);
+		printf("%-10s %7zu %7zu  %8.1f %7" PRIu32 " %7" PRIu32
+			"  %9.1f %7" PRIu32 " %9zu\n", phase_names[i],
+			phase->nr_frames, phase->nr_skipped, frame.mean,
+			frame.p95, frame.max, latency.mean, latency.p95,
+			phase->nr_discarded);
+	}
+	printf("compositor RSS %ld kB, peak %ld kB\n", rss_kb, hwm_kb);
+}
+
+/* Scripted input for the current phase, run once per client frame */
+static void
+phase_step(int ipc_fd, char ids[][32], int nr_ids, uint32_t tick)
+{
+	switch (current_phase) {
+	case PHASE_IDLE:
+	case PHASE_COUNT:
+		break;
+	case PHASE_MOVE:
+		for (int i = 0; i < nr_ids; i++) {
+			int x = 40 * i + (tick * 7) % 400;
+			int y = 30 * i + (tick * 3) % 200;
+			ipc_send(ipc_fd, "{\"cmd\":\"move\",\"id\":\"%s\","
+				"\"x\":%d,\"y\":%d,\"width\":%d,\"height\":%d}\n",
+				ids[i], x, y, TEST_WINDOW_WIDTH, TEST_WINDOW_HEIGHT);
+		}
+		break;
+	case PHASE_RESIZE:
+		for (int i = 0; i < nr_ids; i++) {
+			int grow = (tick * 5 + i * 17) % 240;
+			ipc_send(ipc_fd, "{\"cmd\":\"move\",\"id\":\"%s\","
+				"\"x\":%d,\"y\":%d,\"width\":%d,\"height\":%d}\n",
+				ids[i], 40 * i, 30 * i, TEST_WINDOW_WIDTH + grow,
+				TEST_WINDOW_HEIGHT + grow / 2);
+		}
+		break;
+	case PHASE_FOCUS:
+		if (nr_ids) {
+			ipc_send(ipc_fd, "{\"cmd\":\"focus\",\"id\":\"%s\"}\n",
+				ids[tick % nr_ids]);
+		}
+		break;
+	case PHASE_WORKSPACE:
+		/* Every 6th frame, 10 switches per second at 60Hz */
+		if (clients[0].nr_workspaces && !(tick % 6)) {
+			ext_workspace_handle_v1_activate(clients[0].workspaces[
+				(tick / 6) % clients[0].nr_workspaces]);
+			ext_workspace_manager_v1_commit(
+				clients[0].workspace_manager);
+		}
+		break;
+	}
+}
+
+static void
+run(int ipc_fd, uint64_t phase_ns)
+{
+	char ids[MAX_CLIENTS][32];
+	int nr_ids = ipc_list_windows(ipc_fd, ids, MAX_CLIENTS);
+
+	int timer = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+	struct itimerspec interval = {
+		.it_interval.tv_nsec = 1000000000 / CLIENT_HZ,
+		.it_value.tv_nsec = 1000000000 / CLIENT_HZ,
+	};
+	if (timer < 0 || timerfd_settime(timer, 0, &interval, NULL) < 0) {
+		die("timerfd");
+	}
+
+	struct pollfd fds[MAX_CLIENTS + 1];
+	for (int i = 0; i < nr_clients; i++) {
+		fds[i] = (struct pollfd){
+			.fd = wl_display_get_fd(clients[i].display),
+			.events = POLLIN,
+		};
+	}
+	fds[nr_clients] = (struct pollfd){ .fd = timer, .events = POLLIN };
+
+	uint32_t tick = 0;
+	current_phase = PHASE_IDLE;
+	stats[current_phase].start_ns = now_ns();
+	while (current_phase < PHASE_COUNT) {
+		for (int i = 0; i < nr_clients; i++) {
+			wl_display_flush(clients[i].display);
+		}
+		if (poll(fds, nr_clients + 1, -1) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			die("poll");
+		}
+		for (int i = 0; i < nr_clients; i++) {
+			if (fds[i].revents & POLLIN) {
+				if (wl_display_dispatch(clients[i].display) < 0) {
+					die("wl_display_dispatch");
+				}
+			} else if (fds[i].revents & (POLLERR | POLLHUP)) {
+				fprintf(stderr, "compositor disconnected\n");
+				exit(EXIT_FAILURE);
+			}
+		}
+		if (!(fds[nr_clients].revents & POLLIN)) {
+			continue;
+		}
+
+		uint64_t expirations;
+		if (read(timer, &expirations, sizeof(expirations)) < 0) {
+			die("timerfd read");
+		}
+		for (int i = 0; i < nr_clients; i++) {
+			clients[i].tag = current_phase;
+			test_client_draw(&clients[i]);
+		}
+		phase_step(ipc_fd, ids, nr_ids, tick++);
+		ipc_drain(ipc_fd);
+
+		uint64_t now = now_ns();
+		if (now - stats[current_phase].start_ns >= phase_ns) {
+			stats[current_phase].end_ns = now;
+			if (++current_phase < PHASE_COUNT) {
+				stats[current_phase].start_ns = now;
+			}
+		}
+	}
+	close(timer);
+}
+
+int
+main(int argc, char **argv)
+{
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s <labwc> [clients] [seconds]\n",
+			argv[0]);
+		return EXIT_FAILURE;
+	}
+	if (argc > 2) {
+		nr_clients = atoi(argv[2]);
+		nr_clients = nr_clients < 1 ? 1 : nr_clients;
+		nr_clients = nr_clients > MAX_CLIENTS ? MAX_CLIENTS : nr_clients;
+	}
+	double seconds = argc > 3 ? atof(argv[3]) : 2.0;
+	uint64_t phase_ns = (seconds > 0 ? seconds : 2.0) * 1000000000;
+
+	for (size_t i = 0; i < PHASE_COUNT; i++) {
+		stats[i].latencies_us = calloc(MAX_SAMPLES, sizeof(uint32_t));
+		stats[i].frames_us = calloc(MAX_SAMPLES, sizeof(uint32_t));
+	}
+
+	struct headless headless;
+	headless_start(&headless, argv[1],
+		"  <desktops number=\"2\" popupTime=\"0\"/>\n");
+
+	int ipc_fd = ipc_connect(headless.ipc_path);
+	ipc_send(ipc_fd, "{\"cmd\":\"subscribe\",\"events\":0}\n");
+	for (int i = 0; i < nr_clients; i++) {
+		clients[i].bind_workspaces = i == 0;
+		clients[i].presented = handle_presented;
+		test_client_init(&clients[i], i);
+	}
+
+	run(ipc_fd, phase_ns);
+
+	long rss_kb = 0, hwm_kb = 0;
+	headless_read_rss(&headless, &rss_kb, &hwm_kb);
+
+	close(ipc_fd);
+	for (int i = 0; i < nr_clients; i++) {
+		test_client_finish(&clients[i]);
+	}
+	bool clean_exit = headless_stop(&headless);
+
+	read_frame_trace(headless.trace_path);
+	report(rss_kb, hwm_kb);
+
+	for (size_t i = 0; i < PHASE_COUNT; i++) {
+		free(stats[i].latencies_us);
+		free(stats[i].frames_us);
+	}
+	return clean_exit ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,460 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Measures the pointer motion path of the compositor: from the wlr_cursor
+ * motion event through hit-testing and focus handling to the IPC update,
+ * and the cost of publishing the coalesced IPC updates on each frame.
+ *
+ * A trace of pointer positions is replayed in real time through a
+ * virtual pointer into labwc on the headless backend, over a grid of
+ * windows. The replay runs once without and once with IPC clients that
+ * subscribe to all events. The per-event times are collected inside the
+ * compositor and read with the IPC command "input_timing".
+ *
+ * Run with 'meson test --benchmark' to replay a synthetic trace, or:
+ *   bench-input-replay <path to labwc> [trace] [ipc clients]
+ *   bench-input-replay record <trace> [seconds]
+ *
+ * The second form records a trace from the running compositor given by
+ * LABWC_IPC_SOCKET. IPC cursor updates are coalesced per output frame, so
+ * the recorded rate is the display refresh rate. Traces are text files
+ * with one "<microseconds> <x> <y>" line per event, '#' starts a comment.
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <inttypes.h>
+#include <math.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <wayland-client.h>
+#include "headless.h"
+#include "wlr-virtual-pointer-unstable-v1-client-protocol.h"
+
+#define MAX_IPC_CLIENTS 32
+#define NR_WINDOWS 6
+#define DEFAULT_IPC_CLIENTS 4
+/* Size of the output created by WLR_HEADLESS_OUTPUTS */
+#define OUTPUT_WIDTH 1920
+#define OUTPUT_HEIGHT 1080
+/* Synthetic trace: a 1000Hz mouse moving over all windows for 3s */
+#define SYNTHETIC_HZ 1000
+#define SYNTHETIC_EVENTS 3000
+/* Time for the last IPC updates to be published after the replay */
+#define SETTLE_MS 100
+
+struct trace_event {
+	uint64_t time_us;
+	uint32_t x, y;
+};
+
+struct trace {
+	struct trace_event *events;
+	size_t nr_events;
+};
+
+struct latency {
+	uint64_t count, mean, p50, p95, p99, max;
+};
+
+struct result {
+	int nr_ipc_clients;
+	struct latency motion;
+	struct latency publish;
+};
+
+static struct test_client windows[NR_WINDOWS];
+
+static struct {
+	struct wl_display *display;
+	struct wl_seat *seat;
+	struct zwlr_virtual_pointer_manager_v1 *manager;
+	struct zwlr_virtual_pointer_v1 *pointer;
+} vp;
+
+static void
+die(const char *msg)
+{
+	perror(msg);
+	exit(EXIT_FAILURE);
+}
+
+/* Traces */
+
+static void
+trace_add(struct trace *trace, uint64_t time_us, uint32_t x, uint32_t y)
+{
+	trace->events = realloc(trace->events,
+		(trace->nr_events + 1) * sizeof(*trace->events));
+	if (!trace->events) {
+		die("realloc");
+	}
+	trace->events[trace->nr_events++] = (struct trace_event){
+		.time_us = time_us,
+		.x = x < OUTPUT_WIDTH ? x : OUTPUT_WIDTH - 1,
+		.y = y < OUTPUT_HEIGHT ? y : OUTPUT_HEIGHT - 1,
+	};
+}
+
+static void
+trace_load(struct trace *trace, const char *path)
+{
+	FILE *file = fopen(path, "r");
+	if (!file) {
+		die(path);
+	}
+	char line[256];
+	uint64_t first_us = 0;
+	while (fgets(line, sizeof(line), file)) {
+		uint64_t time_us;
+		uint32_t x, y;
+		if (line[0] == '#' || sscanf(line, "%" SCNu64 " %" SCNu32
+				" %" SCNu32, &time_us, &x, &y) != 3) {
+			continue;
+		}
+		if (!trace->nr_events) {
+			first_us = time_us;
+		}
+		trace_add(trace, time_us - first_us, x, y);
+	}
+	fclose(file);
+	if (!trace->nr_events) {
+		fprintf(stderr, "%s: no events\n", path);
+		exit(EXIT_FAILURE);
+	}
+}
+
+/* A Lissajous figure, so that the pointer crosses all windows and edges */
+static void
+trace_synthesize(struct trace *trace)
+{
+	for (int i = 0; i < SYNTHETIC_EVENTS; i++) {
+		double t = (double)i / SYNTHETIC_HZ;
+		double x = OUTPUT_WIDTH / 2 + 0.47 * OUTPUT_WIDTH
+			* sin(2 * M_PI * 0.7 * t);
+		double y = OUTPUT_HEIGHT / 2 + 0.46 * OUTPUT_HEIGHT
+			* sin(2 * M_PI * 1.1 * t);
+		trace_add(trace, (uint64_t)i * 1000000 / SYNTHETIC_HZ, x, y);
+	}
+}
+
+static int
+record(const char *path, double seconds)
+{
+	const char *socket_path = getenv("LABWC_IPC_SOCKET");
+	if (!socket_path) {
+		fprintf(stderr, "LABWC_IPC_SOCKET is not set\n");
+		return EXIT_FAILURE;
+	}
+	FILE *file = fopen(path, "w");
+	if (!file) {
+		die(path);
+	}
+	fprintf(file, "# labwc pointer trace: <microseconds> <x> <y>\n");
+
+	int fd = ipc_connect(socket_path);
+	/* IPC_EVENT_CURSOR */
+	ipc_send(fd, "{\"cmd\":\"subscribe\",\"events\":1}\n");
+	uint64_t start_ns = now_ns();
+	uint64_t end_ns = start_ns + seconds * 1000000000;
+	size_t count = 0;
+	while (now_ns() < end_ns) {
+		char reply[256];
+		int x, y;
+		ipc_read_reply(fd, "\"cursor\"", reply, sizeof(reply));
+		char *p = strstr(reply, "\"x\":");
+		if (p && sscanf(p, "\"x\":%d,\"y\":%d", &x, &y) == 2
+				&& x >= 0 && y >= 0) {
+			fprintf(file, "%" PRIu64 " %d %d\n",
+				(now_ns() - start_ns) / 1000, x, y);
+			count++;
+		}
+	}
+	close(fd);
+	fclose(file);
+	printf("recorded %zu events to %s\n", count, path);
+	return EXIT_SUCCESS;
+}
+
+/* Virtual pointer */
+
+static void
+handle_global(void *data, struct wl_registry *registry, uint32_t name,
+		const char *interface, uint32_t version)
+{
+	if (!strcmp(interface, wl_seat_interface.name) && !vp.seat) {
+		vp.seat = wl_registry_bind(registry, name, &wl_seat_interface,
+			1);
+	} else if (!strcmp(interface,
+			zwlr_virtual_pointer_manager_v1_interface.name)) {
+		vp.manager = wl_registry_bind(registry, name,
+			&zwlr_virtual_pointer_manager_v1_interface, 1);
+	}
+}
+
+static void
+handle_global_remove(void *data, struct wl_registry *registry, uint32_t name)
+{
+	/* nop */
+}
+
+static const struct wl_registry_listener registry_listener = {
+	.global = handle_global,
+	.global_remove = handle_global_remove,
+};
+
+static void
+virtual_pointer_init(void)
+{
+	vp.display = wl_display_connect(NULL);
+	if (!vp.display) {
+		die("wl_display_connect");
+	}
+	struct wl_registry *registry = wl_display_get_registry(vp.display);
+	wl_registry_add_listener(registry, &registry_listener, NULL);
+	wl_display_roundtrip(vp.display);
+	if (!vp.manager) {
+		fprintf(stderr, "no zwlr_virtual_pointer_manager_v1\n");
+		exit(EXIT_FAILURE);
+	}
+	vp.pointer = zwlr_virtual_pointer_manager_v1_create_virtual_pointer(
+		vp.manager, vp.seat);
+	wl_display_roundtrip(vp.display);
+}
+
+static void
+virtual_pointer_move(const struct trace_event *event)
+{
+	zwlr_virtual_pointer_v1_motion_absolute(vp.pointer,
+		event->time_us / 1000, event->x, event->y, OUTPUT_WIDTH,
+		OUTPUT_HEIGHT);
+	zwlr_virtual_pointer_v1_frame(vp.pointer);
+	wl_display_flush(vp.display);
+}
+
+/* Replay */
+
+/* Lays out the windows in a 3x2 grid with gaps between them */
+static void
+arrange_windows(int ipc_fd)
+{
+	char ids[NR_WINDOWS][32];
+	int nr_ids = ipc_list_windows(ipc_fd, ids, NR_WINDOWS);
+	int width = OUTPUT_WIDTH / 3;
+	int height = OUTPUT_HEIGHT / 2;
+	for (int i = 0; i < nr_ids; i++) {
+		ipc_send(ipc_fd, "{\"cmd\":\"move\",\"id\":\"%s\",\"x\":%d,"
+			"\"y\":%d,\"width\":%d,\"height\":%d}\n", ids[i],
+			(i % 3) * width + 40, (i / 3) * height + 60,
+			width - 80, height - 120);
+	}
+	for (int i = 0; i < NR_WINDOWS; i++) {
+		wl_display_roundtrip(windows[i].display);
+		test_client_draw(&windows[i]);
+		wl_display_flush(windows[i].display);
+	}
+}
+
+/*
+ * Services the Wayland connections and drains the IPC listeners until
+ * @deadline_ns, so that nobody blocks the compositor in the meantime.
+ */
+static void
+wait_until(uint64_t deadline_ns, int *listeners, int nr_listeners)
+{
+	struct pollfd fds[NR_WINDOWS + MAX_IPC_CLIENTS + 1];
+	size_t nfds = 0;
+	for (int i = 0; i < NR_WINDOWS; i++) {
+		fds[nfds++] = (struct pollfd){
+			.fd = wl_display_get_fd(windows[i].display),
+			.events = POLLIN,
+		};
+	}
+	fds[nfds++] = (struct pollfd){
+		.fd = wl_display_get_fd(vp.display),
+		.events = POLLIN,
+	};
+	for (int i = 0; i < nr_listeners; i++) {
+		fds[nfds++] = (struct pollfd){
+			.fd = listeners[i],
+			.events = POLLIN,
+		};
+	}
+
+	for (;;) {
+		uint64_t now = now_ns();
+		if (now >= deadline_ns) {
+			return;
+		}
+		uint64_t remaining = deadline_ns - now;
+		struct timespec timeout = {
+			.tv_sec = remaining / 1000000000,
+			.tv_nsec = remaining % 1000000000,
+		};
+		if (ppoll(fds, nfds, &timeout, NULL) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			die("ppoll");
+		}
+		for (size_t i = 0; i < nfds; i++) {
+			if (!(fds[i].revents & (POLLIN | POLLERR | POLLHUP))) {
+				continue;
+			}
+			if (i < NR_WINDOWS) {
+				wl_display_dispatch(windows[i].display);
+			} else if (i == NR_WINDOWS) {
+				wl_display_dispatch(vp.display);
+			} else {
+				ipc_drain(fds[i].fd);
+			}
+		}
+	}
+}
+
+static void
+parse_latency(const char *reply, const char *name, struct latency *latency)
+{
+	char key[32];
+	snprintf(key, sizeof(key), "\"%s\":{", name);
+	const char *p = strstr(reply, key);
+	if (!p || sscanf(p + strlen(key), "\"count\":%" SCNu64
+			",\"mean_ns\":%" SCNu64 ",\"p50_ns\":%" SCNu64
+			",\"p95_ns\":%" SCNu64 ",\"p99_ns\":%" SCNu64
+			",\"max_ns\":%" SCNu64, &latency->count, &latency->mean,
+			&latency->p50, &latency->p95, &latency->p99,
+			&latency->max) != 6) {
+		fprintf(stderr, "cannot parse input_timing reply: %s\n", reply);
+		exit(EXIT_FAILURE);
+	}
+}
+
+/* Reads and resets the timing collected by the compositor */
+static void
+read_input_timing(int ipc_fd, struct result *result)
+{
+	char reply[1024];
+	ipc_send(ipc_fd, "{\"cmd\":\"input_timing\"}\n");
+	ipc_read_reply(ipc_fd, "\"input_timing\"", reply, sizeof(reply));
+	if (result) {
+		parse_latency(reply, "motion", &result->motion);
+		parse_latency(reply, "publish", &result->publish);
+	}
+}
+
+static void
+replay(const struct headless *headless, int ipc_fd,
+		const struct trace *trace, struct result *result)
+{
+	int listeners[MAX_IPC_CLIENTS];
+	for (int i = 0; i < result->nr_ipc_clients; i++) {
+		/* Subscribed to all events by default */
+		listeners[i] = ipc_connect(headless->ipc_path);
+	}
+
+	/* Start from the first position, and forget everything before */
+	virtual_pointer_move(&trace->events[0]);
+	wait_until(now_ns() + SETTLE_MS * 1000000, listeners,
+		result->nr_ipc_clients);
+	read_input_timing(ipc_fd, NULL);
+
+	uint64_t start_ns = now_ns();
+	for (size_t i = 0; i < trace->nr_events; i++) {
+		const struct trace_event *event = &trace->events[i];
+		wait_until(start_ns + event->time_us * 1000, listeners,
+			result->nr_ipc_clients);
+		virtual_pointer_move(event);
+	}
+	wait_until(now_ns() + SETTLE_MS * 1000000, listeners,
+		result->nr_ipc_clients);
+	read_input_timing(ipc_fd, result);
+
+	for (int i = 0; i < result->nr_ipc_clients; i++) {
+		close(listeners[i]);
+	}
+}
+
+static void
+report(const struct trace *trace, const struct result *results,
+		size_t nr_results)
+{
+	printf("replayed %zu events over %d windows, times in ns\n",
+		trace->nr_events, NR_WINDOWS);
+	printf("%-11s %7s %7s %7s %7s %7s %8s  %9s %7s %7s %8s\n",
+		"ipc clients", "motions", "mean", "p50", "p95", "p99", "max",
+		"publishes", "mean", "p95", "max");
+	for (size_t i = 0; i < nr_results; i++) {
+		const struct latency *motion = &results[i].motion;
+		const struct latency *publish = &results[i].publish;
+		printf("%11d %7" PRIu64 " %7" PRIu64 " %7" PRIu64 " %7" PRIu64
+			" %7" PRIu64 " %8" PRIu64 "  %9" PRIu64 " %7" PRIu64
+			" %7" PRIu64 " %8" PRIu64 "\n",
+			results[i].nr_ipc_clients, motion->count, motion->mean,
+			motion->p50, motion->p95, motion->p99, motion->max,
+			publish->count, publish->mean, publish->p95,
+			publish->max);
+	}
+}
+
+int
+main(int argc, char **argv)
+{
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s <labwc> [trace] [ipc clients]\n"
+			"       %s record <trace> [seconds]\n", argv[0],
+			argv[0]);
+		return EXIT_FAILURE;
+	}
+	if (!strcmp(argv[1], "record")) {
+		if (argc < 3) {
+			fprintf(stderr, "no trace file given\n");
+			return EXIT_FAILURE;
+		}
+		return record(argv[2], argc > 3 ? atof(argv[3]) : 10.0);
+	}
+
+	struct trace trace = {0};
+	if (argc > 2 && strcmp(argv[2], "-")) {
+		trace_load(&trace, argv[2]);
+	} else {
+		trace_synthesize(&trace);
+	}
+	int nr_ipc_clients = argc > 3 ? atoi(argv[3]) : DEFAULT_IPC_CLIENTS;
+	nr_ipc_clients = nr_ipc_clients < 0 ? 0 : nr_ipc_clients;
+	nr_ipc_clients = nr_ipc_clients > MAX_IPC_CLIENTS
+		? MAX_IPC_CLIENTS : nr_ipc_clients;
+
+	struct headless headless;
+	headless_start(&headless, argv[1], "");
+	int ipc_fd = ipc_connect(headless.ipc_path);
+	ipc_send(ipc_fd, "{\"cmd\":\"subscribe\",\"events\":0}\n");
+	for (int i = 0; i < NR_WINDOWS; i++) {
+		test_client_init(&windows[i], i);
+	}
+	arrange_windows(ipc_fd);
+	virtual_pointer_init();
+
+	struct result results[2] = {
+		{ .nr_ipc_clients = 0 },
+		{ .nr_ipc_clients = nr_ipc_clients },
+	};
+	size_t nr_results = nr_ipc_clients ? 2 : 1;
+	for (size_t i = 0; i < nr_results; i++) {
+		replay(&headless, ipc_fd, &trace, &results[i]);
+	}
+
+	close(ipc_fd);
+	zwlr_virtual_pointer_v1_destroy(vp.pointer);
+	wl_display_disconnect(vp.display);
+	for (int i = 0; i < NR_WINDOWS; i++) {
+		test_client_finish(&windows[i]);
+	}
+	bool clean_exit = headless_stop(&headless);
+
+	report(&trace, results, nr_results);
+	free(trace.events);
+	return clean_exit ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,87 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Compares the cost of encoding IPC events in JSON and binary mode.
+ * Run with 'meson test --benchmark'.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <wayland-util.h>
+#include "common/buf.h"
+#include "labwc-ipc-proto.h"
+
+#define ITERATIONS 1000000
+
+static uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Keeps the compiler from optimizing the encoders away */
+static volatile size_t sink;
+
+static void
+report(const char *name, uint64_t json_ns, uint64_t bin_ns)
+{
+	double json = (double)json_ns / ITERATIONS;
+	double bin = (double)bin_ns / ITERATIONS;
+	printf("%-14s json %7.1f ns/event  binary %7.1f ns/event  (%.1fx)\n",
+		name, json, bin, json / bin);
+}
+
+int
+main(void)
+{
+	struct ipc_window_info info = {
+		.id = 0x55d1c0ffee40,
+		.title = "~/src/labwc - vim - Terminal",
+		.app_id = "org.gnome.Terminal",
+		.x = 120, .y = 80, .width = 1280, .height = 720,
+		.focused = true,
+	};
+	char msg[1024];
+	struct buf json = BUF_INIT;
+	struct wl_array frames;
+	wl_array_init(&frames);
+
+	uint64_t start = now_ns();
+	for (int i = 0; i < ITERATIONS; i++) {
+		sink = ipc_json_encode_cursor(msg, sizeof(msg),
+			i % 1920 + 0.25, i % 1080 + 0.75);
+	}
+	uint64_t json_ns = now_ns() - start;
+
+	start = now_ns();
+	for (int i = 0; i < ITERATIONS; i++) {
+		frames.size = 0;
+		ipc_bin_encode_cursor(&frames, i % 1920 + 0.25, i % 1080 + 0.75);
+		sink = frames.size;
+	}
+	report("cursor", json_ns, now_ns() - start);
+
+	start = now_ns();
+	for (int i = 0; i < ITERATIONS; i++) {
+		info.x = i % 1920;
+		buf_clear(&json);
+		ipc_json_encode_window_event(&json, IPC_WINDOW_MOVED, &info);
+		sink = json.len;
+	}
+	json_ns = now_ns() - start;
+
+	start = now_ns();
+	for (int i = 0; i < ITERATIONS; i++) {
+		info.x = i % 1920;
+		frames.size = 0;
+		ipc_bin_encode_window_event(&frames, IPC_WINDOW_MOVED, &info);
+		sink = frames.size;
+	}
+	report("window event", json_ns, now_ns() - start);
+
+	buf_reset(&json);
+	wl_array_release(&frames);
+	return 0;
+}
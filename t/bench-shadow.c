@@ -0,0 +1,126 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Compares drawing the drop-shadow corner rasters with per-pixel exp(),
+ * as theme.c used to, against the falloff table with the scalar and the
+ * SIMD row kernel, and against the raster cache.
+ * Run with 'meson test --benchmark'.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "shadow-raster.h"
+
+#define ITERATIONS 200
+
+static const float shadow_color[4] = { 0.0f, 0.0f, 0.0f, 0.375f };
+
+static uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Keeps the compiler from optimizing the drawing away */
+static volatile uint32_t sink;
+
+static void
+draw_exp(uint32_t *pixels, int size)
+{
+	double variance = 0.3 * 0.3;
+	uint8_t *bytes = (uint8_t *)pixels;
+	for (int y = 0; y < size; y++) {
+		uint8_t *row = &bytes[y * size * 4];
+		for (int x = 0; x < size; x++) {
+			double x_norm = (double)x / (double)size;
+			double y_norm = (double)y / (double)size;
+			double alpha = exp(-(x_norm * x_norm) / variance)
+				* exp(-(y_norm * y_norm) / variance);
+			row[4 * x] = shadow_color[2] * alpha * 255;
+			row[4 * x + 1] = shadow_color[1] * alpha * 255;
+			row[4 * x + 2] = shadow_color[0] * alpha * 255;
+			row[4 * x + 3] = shadow_color[3] * alpha * 255;
+		}
+	}
+}
+
+static void
+draw_lut(uint32_t *pixels, int size, bool simd)
+{
+	float *lut = malloc(size * sizeof(*lut));
+	shadow_falloff_lut(lut, size);
+	for (int y = 0; y < size; y++) {
+		if (simd) {
+			shadow_fill_row(pixels + y * size, lut, lut[y], size,
+				shadow_color);
+		} else {
+			shadow_fill_row_scalar(pixels + y * size, lut, lut[y],
+				size, shadow_color);
+		}
+	}
+	free(lut);
+}
+
+static void
+bench(int shadow_size, float scale)
+{
+	struct shadow_raster_key key = {
+		.visible_size = shadow_size,
+		.total_size = shadow_size + shadow_size * 0.3,
+		.corner = true,
+		.scale = scale,
+	};
+	memcpy(key.color, shadow_color, sizeof(key.color));
+	int size, height;
+	shadow_raster_size(&key, &size, &height);
+	uint32_t *pixels = malloc(size * height * sizeof(*pixels));
+
+	uint64_t start = now_ns();
+	for (int i = 0; i < ITERATIONS; i++) {
+		draw_exp(pixels, size);
+		sink = pixels[i % size];
+	}
+	double exp_us = (double)(now_ns() - start) / ITERATIONS / 1000;
+
+	start = now_ns();
+	for (int i = 0; i < ITERATIONS; i++) {
+		draw_lut(pixels, size, false);
+		sink = pixels[i % size];
+	}
+	double scalar_us = (double)(now_ns() - start) / ITERATIONS / 1000;
+
+	start = now_ns();
+	for (int i = 0; i < ITERATIONS; i++) {
+		draw_lut(pixels, size, true);
+		sink = pixels[i % size];
+	}
+	double simd_us = (double)(now_ns() - start) / ITERATIONS / 1000;
+
+	start = now_ns();
+	for (int i = 0; i < ITERATIONS; i++) {
+		shadow_raster_draw(&key, (uint8_t *)pixels, size * 4);
+		sink = pixels[i % size];
+	}
+	double cached_us = (double)(now_ns() - start) / ITERATIONS / 1000;
+
+	printf("%3dpx @%.0fx %4dx%-4d exp %8.1f us  lut %7.1f us  "
+		"simd %6.1f us (%5.1fx)  cached %5.1f us\n", shadow_size, scale,
+		size, size, exp_us, scalar_us, simd_us, exp_us / simd_us,
+		cached_us);
+	free(pixels);
+}
+
+int
+main(void)
+{
+	bench(40, 1.0f);
+	bench(60, 1.0f);
+	bench(60, 2.0f);
+	bench(60, 3.0f);
+	return 0;
+}
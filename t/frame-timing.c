@@ -0,0 +1,139 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <cmocka.h>
+#include "frame-timing.h"
+
+static void
+record_frame(struct frame_timing *timing, uint32_t seq, bool skipped)
+{
+	struct frame_timing_sample sample = {
+		.start_ns = seq * 1000000ULL,
+		.commit_end_ns = seq * 1000000ULL + 500000,
+		.build_us = seq,
+		.commit_seq = seq,
+		.skipped = skipped,
+	};
+	frame_timing_record(timing, "DP-1", &sample);
+}
+
+static void
+test_ring_wraps(void **state)
+{
+	struct frame_timing *timing = calloc(1, sizeof(*timing));
+	struct frame_timing_sample out[FRAME_TIMING_SAMPLES];
+
+	assert_int_equal(frame_timing_get(timing, out, FRAME_TIMING_SAMPLES), 0);
+
+	for (uint32_t seq = 1; seq <= FRAME_TIMING_SAMPLES + 10; seq++) {
+		record_frame(timing, seq, seq % 3 == 0);
+	}
+	assert_int_equal(timing->nr_frames, FRAME_TIMING_SAMPLES + 10);
+	assert_int_equal(timing->nr_skipped, (FRAME_TIMING_SAMPLES + 10) / 3);
+
+	/* Oldest first, the first 10 frames were overwritten */
+	size_t count = frame_timing_get(timing, out, FRAME_TIMING_SAMPLES);
+	assert_int_equal(count, FRAME_TIMING_SAMPLES);
+	assert_int_equal(out[0].commit_seq, 11);
+	assert_int_equal(out[count - 1].commit_seq, FRAME_TIMING_SAMPLES + 10);
+
+	/* A smaller buffer receives the most recent frames */
+	count = frame_timing_get(timing, out, 2);
+	assert_int_equal(count, 2);
+	assert_int_equal(out[0].commit_seq, FRAME_TIMING_SAMPLES + 9);
+
+	free(timing);
+}
+
+static void
+test_presented(void **state)
+{
+	struct frame_timing *timing = calloc(1, sizeof(*timing));
+	struct frame_timing_sample out[3];
+
+	record_frame(timing, 1, false);
+	record_frame(timing, 2, false);
+	record_frame(timing, 3, true);
+
+	/* Matched by commit_seq, even if a later frame was recorded */
+	frame_timing_presented(timing, 1, 1000000 + 500000 + 16000);
+	/* Discarded frames stay unknown */
+	frame_timing_presented(timing, 2, 0);
+	/* Skipped frames have no commit and are never matched */
+	frame_timing_presented(timing, 3, 5000000);
+
+	assert_int_equal(frame_timing_get(timing, out, 3), 3);
+	assert_int_equal(out[0].present_us, 16);
+	assert_int_equal(out[1].present_us, -1);
+	assert_int_equal(out[2].present_us, -1);
+
+	free(timing);
+}
+
+static void
+test_render_estimate(void **state)
+{
+	struct frame_timing *timing = calloc(1, sizeof(*timing));
+
+	/* Not enough data yet */
+	for (uint32_t i = 1; i < 8; i++) {
+		record_frame(timing, 1000, false);
+	}
+	assert_int_equal(frame_timing_render_estimate(timing), 0);
+
+	/*
+	 * 100 frames of 1000us, with every 50th at 9000us and skipped frames
+	 * in between, which must not count
+	 */
+	for (uint32_t i = 0; i < 100; i++) {
+		record_frame(timing, i % 50 ? 1000 : 9000, false);
+		record_frame(timing, 20000, true);
+	}
+	/* Only 1 of the last 64 rendered frames is slow, below the 95th */
+	assert_int_equal(frame_timing_render_estimate(timing), 1000);
+
+	/* With 5 slow frames in the window the 95th percentile is slow */
+	for (uint32_t i = 0; i < 4; i++) {
+		record_frame(timing, 9000, false);
+	}
+	assert_int_equal(frame_timing_render_estimate(timing), 9000);
+
+	free(timing);
+}
+
+static void
+test_format_csv(void **state)
+{
+	struct frame_timing_sample sample = {
+		.start_ns = 123456789,
+		.build_us = 850,
+		.commit_us = 120,
+		.present_us = 15000,
+		.commit_seq = 42,
+		.delay_us = 7000,
+	};
+	char line[256];
+
+	frame_timing_format_csv(line, sizeof(line), "eDP-1", &sample);
+	assert_string_equal(line, "eDP-1,123456789,7000,850,120,15000,42,0\n");
+
+	sample.present_us = -1;
+	sample.skipped = true;
+	frame_timing_format_csv(line, sizeof(line), "eDP-1", &sample);
+	assert_string_equal(line, "eDP-1,123456789,7000,850,120,-1,42,1\n");
+}
+
+int main(int argc, char **argv)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(test_ring_wraps),
+		cmocka_unit_test(test_presented),
+		cmocka_unit_test(test_render_estimate),
+		cmocka_unit_test(test_format_csv),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,589 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#define _GNU_SOURCE
+#include "headless.h"
+#include <fcntl.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include <wayland-client.h>
+#include "ext-workspace-v1-client-protocol.h"
+#include "presentation-time-client-protocol.h"
+#include "xdg-shell-client-protocol.h"
+
+#define STARTUP_TIMEOUT_MS 10000
+
+static void
+die(const char *msg)
+{
+	perror(msg);
+	exit(EXIT_FAILURE);
+}
+
+uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Compositor process */
+
+static void
+write_config(const char *dir, const char *rc_xml)
+{
+	char path[PATH_MAX];
+	snprintf(path, sizeof(path), "%s/config", dir);
+	if (mkdir(path, 0700) < 0) {
+		die("mkdir");
+	}
+	snprintf(path, sizeof(path), "%s/config/rc.xml", dir);
+	FILE *rc = fopen(path, "w");
+	if (!rc) {
+		die("rc.xml");
+	}
+	fprintf(rc, "<?xml version=\"1.0\"?>\n<labwc_config>\n%s"
+		"</labwc_config>\n", rc_xml);
+	fclose(rc);
+}
+
+static void
+exec_compositor(const struct headless *headless, const char *labwc)
+{
+	char path[PATH_MAX];
+	snprintf(path, sizeof(path), "%s/labwc.log", headless->dir);
+	int log = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	if (log >= 0) {
+		dup2(log, STDOUT_FILENO);
+		dup2(log, STDERR_FILENO);
+	}
+	setenv("LABWC_FRAME_TRACE", headless->trace_path, 1);
+	setenv("WLR_BACKENDS", "headless", 1);
+	setenv("WLR_RENDERER", "pixman", 1);
+	setenv("WLR_HEADLESS_OUTPUTS", "1", 1);
+	setenv("WLR_LIBINPUT_NO_DEVICES", "1", 1);
+	unsetenv("WAYLAND_DISPLAY");
+	unsetenv("DISPLAY");
+
+	snprintf(path, sizeof(path), "%s/config", headless->dir);
+	execl(labwc, labwc, "-C", path, (char *)NULL);
+	perror("exec");
+	_exit(127);
+}
+
+void
+headless_start(struct headless *headless, const char *labwc,
+		const char *rc_xml)
+{
+	*headless = (struct headless){0};
+	snprintf(headless->dir, sizeof(headless->dir),
+		"/tmp/labwc-bench-XXXXXX");
+	if (!mkdtemp(headless->dir)) {
+		die("mkdtemp");
+	}
+	snprintf(headless->ipc_path, sizeof(headless->ipc_path),
+		"%s/labwc-ipc.wayland-0.sock", headless->dir);
+	snprintf(headless->trace_path, sizeof(headless->trace_path),
+		"%s/frames.csv", headless->dir);
+	write_config(headless->dir, rc_xml);
+
+	headless->pid = fork();
+	if (headless->pid < 0) {
+		die("fork");
+	} else if (headless->pid == 0) {
+		setenv("XDG_RUNTIME_DIR", headless->dir, 1);
+		exec_compositor(headless, labwc);
+	}
+	setenv("XDG_RUNTIME_DIR", headless->dir, 1);
+	setenv("WAYLAND_DISPLAY", "wayland-0", 1);
+
+	/* The IPC socket is bound right after the Wayland socket */
+	for (int ms = 0; ms < STARTUP_TIMEOUT_MS; ms += 10) {
+		if (!access(headless->ipc_path, F_OK)) {
+			return;
+		}
+		if (waitpid(headless->pid, NULL, WNOHANG) == headless->pid) {
+			fprintf(stderr, "compositor exited during startup, "
+				"see %s/labwc.log\n", headless->dir);
+			exit(EXIT_FAILURE);
+		}
+		usleep(10000);
+	}
+	fprintf(stderr, "timeout waiting for %s\n", headless->ipc_path);
+	kill(headless->pid, SIGKILL);
+	exit(EXIT_FAILURE);
+}
+
+void
+headless_read_rss(const struct headless *headless, long *rss_kb,
+		long *hwm_kb)
+{
+	char path[64], line[256];
+	snprintf(path, sizeof(path), "/proc/%d/status", (int)headless->pid);
+	FILE *status = fopen(path, "r");
+	if (!status) {
+		return;
+	}
+	while (fgets(line, sizeof(line), status)) {
+		sscanf(line, "VmRSS: %ld", rss_kb);
+		sscanf(line, "VmHWM: %ld", hwm_kb);
+	}
+	fclose(status);
+}
+
+bool
+headless_stop(struct headless *headless)
+{
+	int status;
+	kill(headless->pid, SIGTERM);
+	if (waitpid(headless->pid, &status, 0) < 0) {
+		return false;
+	}
+	return WIFEXITED(status) && !WEXITSTATUS(status);
+}
+
+/* Buffers */
+
+static void
+handle_buffer_release(void *data, struct wl_buffer *wl_buffer)
+{
+	struct test_buffer *buffer = data;
+	buffer->busy = false;
+}
+
+static const struct wl_buffer_listener buffer_listener = {
+	.release = handle_buffer_release,
+};
+
+static void
+buffer_finish(struct test_buffer *buffer)
+{
+	if (buffer->wl_buffer) {
+		wl_buffer_destroy(buffer->wl_buffer);
+		munmap(buffer->data, (size_t)buffer->width * buffer->height * 4);
+	}
+	*buffer = (struct test_buffer){0};
+}
+
+static void
+buffer_init(struct test_buffer *buffer, struct wl_shm *shm, int width,
+		int height)
+{
+	size_t size = (size_t)width * height * 4;
+	int fd = memfd_create("bench-headless", MFD_CLOEXEC);
+	if (fd < 0 || ftruncate(fd, size) < 0) {
+		die("memfd");
+	}
+	buffer->data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+		fd, 0);
+	if (buffer->data == MAP_FAILED) {
+		die("mmap");
+	}
+	struct wl_shm_pool *pool = wl_shm_create_pool(shm, fd, size);
+	buffer->wl_buffer = wl_shm_pool_create_buffer(pool, 0, width, height,
+		width * 4, WL_SHM_FORMAT_XRGB8888);
+	wl_shm_pool_destroy(pool);
+	close(fd);
+	wl_buffer_add_listener(buffer->wl_buffer, &buffer_listener, buffer);
+	buffer->width = width;
+	buffer->height = height;
+}
+
+/* Returns an idle buffer of the configured size, NULL if both are busy */
+static struct test_buffer *
+client_get_buffer(struct test_client *client)
+{
+	int width = client->width ? client->width : TEST_WINDOW_WIDTH;
+	int height = client->height ? client->height : TEST_WINDOW_HEIGHT;
+	for (size_t i = 0; i < 2; i++) {
+		struct test_buffer *buffer = &client->buffers[i];
+		if (buffer->busy) {
+			continue;
+		}
+		if (buffer->width != width || buffer->height != height) {
+			buffer_finish(buffer);
+			buffer_init(buffer, client->shm, width, height);
+		}
+		return buffer;
+	}
+	return NULL;
+}
+
+/* Presentation feedback */
+
+struct feedback {
+	struct test_client *client;
+	uint64_t commit_ns;
+	uint32_t tag;
+};
+
+static void
+handle_sync_output(void *data, struct wp_presentation_feedback *feedback,
+		struct wl_output *output)
+{
+	/* nop */
+}
+
+static void
+handle_presented(void *data, struct wp_presentation_feedback *wp_feedback,
+		uint32_t tv_sec_hi, uint32_t tv_sec_lo, uint32_t tv_nsec,
+		uint32_t refresh, uint32_t seq_hi, uint32_t seq_lo,
+		uint32_t flags)
+{
+	struct feedback *feedback = data;
+	uint64_t sec = ((uint64_t)tv_sec_hi << 32) | tv_sec_lo;
+	uint64_t present_ns = sec * 1000000000 + tv_nsec;
+	if (present_ns >= feedback->commit_ns) {
+		feedback->client->presented(feedback->client, feedback->tag,
+			present_ns - feedback->commit_ns);
+	}
+	wp_presentation_feedback_destroy(wp_feedback);
+	free(feedback);
+}
+
+static void
+handle_discarded(void *data, struct wp_presentation_feedback *wp_feedback)
+{
+	struct feedback *feedback = data;
+	feedback->client->presented(feedback->client, feedback->tag, -1);
+	wp_presentation_feedback_destroy(wp_feedback);
+	free(feedback);
+}
+
+static const struct wp_presentation_feedback_listener feedback_listener = {
+	.sync_output = handle_sync_output,
+	.presented = handle_presented,
+	.discarded = handle_discarded,
+};
+
+/*
+ * Redraws the whole window in a color that changes every frame, like a
+ * video player or a game would, and asks for presentation feedback.
+ */
+void
+test_client_draw(struct test_client *client)
+{
+	if (!client->configured) {
+		return;
+	}
+	struct test_buffer *buffer = client_get_buffer(client);
+	if (!buffer) {
+		return;
+	}
+	uint32_t color = 0xff000000 | (client->index * 0x3f1d27)
+		| (client->frame++ & 0xff);
+	uint32_t *pixels = buffer->data;
+	for (size_t i = 0; i < (size_t)buffer->width * buffer->height; i++) {
+		pixels[i] = color;
+	}
+
+	wl_surface_attach(client->surface, buffer->wl_buffer, 0, 0);
+	wl_surface_damage_buffer(client->surface, 0, 0, buffer->width,
+		buffer->height);
+	if (client->presentation && client->presented) {
+		struct feedback *feedback = calloc(1, sizeof(*feedback));
+		feedback->client = client;
+		feedback->tag = client->tag;
+		wp_presentation_feedback_add_listener(
+			wp_presentation_feedback(client->presentation,
+				client->surface),
+			&feedback_listener, feedback);
+		feedback->commit_ns = now_ns();
+	}
+	wl_surface_commit(client->surface);
+	buffer->busy = true;
+}
+
+/* xdg-shell */
+
+static void
+handle_wm_base_ping(void *data, struct xdg_wm_base *wm_base, uint32_t serial)
+{
+	xdg_wm_base_pong(wm_base, serial);
+}
+
+static const struct xdg_wm_base_listener wm_base_listener = {
+	.ping = handle_wm_base_ping,
+};
+
+static void
+handle_xdg_surface_configure(void *data, struct xdg_surface *xdg_surface,
+		uint32_t serial)
+{
+	struct test_client *client = data;
+	xdg_surface_ack_configure(xdg_surface, serial);
+	if (!client->configured) {
+		client->configured = true;
+		test_client_draw(client);
+	}
+}
+
+static const struct xdg_surface_listener xdg_surface_listener = {
+	.configure = handle_xdg_surface_configure,
+};
+
+static void
+handle_toplevel_configure(void *data, struct xdg_toplevel *toplevel,
+		int32_t width, int32_t height, struct wl_array *states)
+{
+	struct test_client *client = data;
+	client->width = width;
+	client->height = height;
+}
+
+static void
+handle_toplevel_close(void *data, struct xdg_toplevel *toplevel)
+{
+	/* Windows are only closed at the end of the run */
+}
+
+static const struct xdg_toplevel_listener toplevel_listener = {
+	.configure = handle_toplevel_configure,
+	.close = handle_toplevel_close,
+};
+
+/* ext-workspace */
+
+static void
+handle_workspace_group(void *data, struct ext_workspace_manager_v1 *manager,
+		struct ext_workspace_group_handle_v1 *group)
+{
+	/* Groups are not needed to activate workspaces */
+}
+
+static void
+handle_workspace(void *data, struct ext_workspace_manager_v1 *manager,
+		struct ext_workspace_handle_v1 *workspace)
+{
+	struct test_client *client = data;
+	if (client->nr_workspaces < HEADLESS_MAX_WORKSPACES) {
+		client->workspaces[client->nr_workspaces++] = workspace;
+	}
+}
+
+static void
+handle_workspace_done(void *data, struct ext_workspace_manager_v1 *manager)
+{
+	/* nop */
+}
+
+static void
+handle_workspace_finished(void *data,
+		struct ext_workspace_manager_v1 *manager)
+{
+	/* nop */
+}
+
+static const struct ext_workspace_manager_v1_listener workspace_listener = {
+	.workspace_group = handle_workspace_group,
+	.workspace = handle_workspace,
+	.done = handle_workspace_done,
+	.finished = handle_workspace_finished,
+};
+
+static void
+handle_global(void *data, struct wl_registry *registry, uint32_t name,
+		const char *interface, uint32_t version)
+{
+	struct test_client *client = data;
+	if (!strcmp(interface, wl_compositor_interface.name)) {
+		client->compositor = wl_registry_bind(registry, name,
+			&wl_compositor_interface, 4);
+	} else if (!strcmp(interface, wl_shm_interface.name)) {
+		client->shm = wl_registry_bind(registry, name,
+			&wl_shm_interface, 1);
+	} else if (!strcmp(interface, xdg_wm_base_interface.name)) {
+		client->wm_base = wl_registry_bind(registry, name,
+			&xdg_wm_base_interface, 1);
+		xdg_wm_base_add_listener(client->wm_base, &wm_base_listener,
+			client);
+	} else if (!strcmp(interface, wp_presentation_interface.name)) {
+		client->presentation = wl_registry_bind(registry, name,
+			&wp_presentation_interface, 1);
+	} else if (!strcmp(interface, ext_workspace_manager_v1_interface.name)
+			&& client->bind_workspaces) {
+		client->workspace_manager = wl_registry_bind(registry, name,
+			&ext_workspace_manager_v1_interface, 1);
+		ext_workspace_manager_v1_add_listener(
+			client->workspace_manager, &workspace_listener, client);
+	}
+}
+
+static void
+handle_global_remove(void *data, struct wl_registry *registry, uint32_t name)
+{
+	/* nop */
+}
+
+static const struct wl_registry_listener registry_listener = {
+	.global = handle_global,
+	.global_remove = handle_global_remove,
+};
+
+void
+test_client_init(struct test_client *client, int index)
+{
+	client->index = index;
+	client->display = wl_display_connect(NULL);
+	if (!client->display) {
+		die("wl_display_connect");
+	}
+	client->registry = wl_display_get_registry(client->display);
+	wl_registry_add_listener(client->registry, &registry_listener, client);
+	wl_display_roundtrip(client->display);
+	if (!client->compositor || !client->shm || !client->wm_base) {
+		fprintf(stderr, "missing required globals\n");
+		exit(EXIT_FAILURE);
+	}
+
+	char app_id[32];
+	snprintf(app_id, sizeof(app_id), "bench-%d", index);
+	client->surface = wl_compositor_create_surface(client->compositor);
+	client->xdg_surface = xdg_wm_base_get_xdg_surface(client->wm_base,
+		client->surface);
+	xdg_surface_add_listener(client->xdg_surface, &xdg_surface_listener,
+		client);
+	client->toplevel = xdg_surface_get_toplevel(client->xdg_surface);
+	xdg_toplevel_add_listener(client->toplevel, &toplevel_listener, client);
+	xdg_toplevel_set_app_id(client->toplevel, app_id);
+	xdg_toplevel_set_title(client->toplevel, app_id);
+	wl_surface_commit(client->surface);
+	while (!client->configured) {
+		if (wl_display_dispatch(client->display) < 0) {
+			die("wl_display_dispatch");
+		}
+	}
+	wl_display_roundtrip(client->display);
+}
+
+void
+test_client_finish(struct test_client *client)
+{
+	xdg_toplevel_destroy(client->toplevel);
+	xdg_surface_destroy(client->xdg_surface);
+	wl_surface_destroy(client->surface);
+	for (size_t i = 0; i < 2; i++) {
+		buffer_finish(&client->buffers[i]);
+	}
+	wl_display_disconnect(client->display);
+}
+
+/* IPC */
+
+int
+ipc_connect(const char *path)
+{
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+	if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		die("IPC connect");
+	}
+	return fd;
+}
+
+void
+ipc_send(int fd, const char *fmt, ...)
+{
+	char msg[256];
+	va_list ap;
+	va_start(ap, fmt);
+	int len = vsnprintf(msg, sizeof(msg), fmt, ap);
+	va_end(ap);
+	if (write(fd, msg, len) != len) {
+		die("IPC write");
+	}
+}
+
+void
+ipc_drain(int fd)
+{
+	char buf[4096];
+	while (recv(fd, buf, sizeof(buf), MSG_DONTWAIT) > 0) {
+		/* nop */
+	}
+}
+
+void
+ipc_read_reply(int fd, const char *match, char *reply, size_t size)
+{
+	size_t len = 0;
+	for (;;) {
+		char c;
+		if (read(fd, &c, 1) != 1) {
+			die("IPC read");
+		}
+		if (c != '\n') {
+			if (len < size - 1) {
+				reply[len++] = c;
+			}
+			continue;
+		}
+		reply[len] = '\0';
+		if (strstr(reply, match)) {
+			return;
+		}
+		len = 0;
+	}
+}
+
+int
+ipc_list_windows(int fd, char ids[][32], int max)
+{
+	static char reply[65536];
+	int count = 0;
+
+	ipc_send(fd, "{\"cmd\":\"list\"}\n");
+	ipc_read_reply(fd, "\"windows\"", reply, sizeof(reply));
+
+	for (char *p = strstr(reply, "{\"id\":\""); p && count < max;
+			p = strstr(p, "{\"id\":\"")) {
+		p += strlen("{\"id\":\"");
+		char *app_id = strstr(p, "\"app_id\":\"bench-");
+		char *next = strstr(p, "{\"id\":\"");
+		if (app_id && (!next || app_id < next)) {
+			snprintf(ids[count], sizeof(ids[count]), "%.*s",
+				(int)strcspn(p, "\""), p);
+			count++;
+		}
+	}
+	return count;
+}
+
+/* Statistics */
+
+static int
+compare_u32(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a;
+	uint32_t y = *(const uint32_t *)b;
+	return (x > y) - (x < y);
+}
+
+void
+summarize(uint32_t *values, size_t count, struct summary *summary)
+{
+	*summary = (struct summary){0};
+	if (!count) {
+		return;
+	}
+	qsort(values, count, sizeof(values[0]), compare_u32);
+	uint64_t sum = 0;
+	for (size_t i = 0; i < count; i++) {
+		sum += values[i];
+	}
+	summary->mean = (double)sum / count;
+	summary->p50 = values[(count * 50 - 1) / 100];
+	summary->p95 = values[(count * 95 - 1) / 100];
+	summary->p99 = values[(count * 99 - 1) / 100];
+	summary->max = values[count - 1];
+}
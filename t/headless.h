@@ -0,0 +1,121 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_T_HEADLESS_H
+#define LABWC_T_HEADLESS_H
+
+/*
+ * Helpers for the benchmarks that run labwc on the headless backend with
+ * the pixman renderer and talk to it over Wayland and IPC.
+ */
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+struct ext_workspace_handle_v1;
+struct ext_workspace_manager_v1;
+struct wl_buffer;
+struct wl_compositor;
+struct wl_display;
+struct wl_registry;
+struct wl_shm;
+struct wl_surface;
+struct wp_presentation;
+struct xdg_surface;
+struct xdg_toplevel;
+struct xdg_wm_base;
+
+#define HEADLESS_MAX_WORKSPACES 16
+
+/* Initial window size */
+#define TEST_WINDOW_WIDTH 480
+#define TEST_WINDOW_HEIGHT 320
+
+struct headless {
+	/* Private XDG_RUNTIME_DIR, also holds the config, log and trace */
+	char dir[32];
+	char ipc_path[PATH_MAX];
+	char trace_path[PATH_MAX];
+	pid_t pid;
+};
+
+/*
+ * Starts labwc with @rc_xml as the body of <labwc_config> and waits for
+ * its IPC socket. Sets XDG_RUNTIME_DIR and WAYLAND_DISPLAY for clients.
+ * Exits on failure, like all other helpers here.
+ */
+void headless_start(struct headless *headless, const char *labwc,
+	const char *rc_xml);
+void headless_read_rss(const struct headless *headless, long *rss_kb,
+	long *hwm_kb);
+/* Terminates the compositor, returns whether it exited cleanly */
+bool headless_stop(struct headless *headless);
+
+/* Single xdg-shell window that redraws itself from shm buffers */
+struct test_buffer {
+	struct wl_buffer *wl_buffer;
+	void *data;
+	int width, height;
+	bool busy;
+};
+
+struct test_client {
+	int index;
+	struct wl_display *display;
+	struct wl_registry *registry;
+	struct wl_compositor *compositor;
+	struct wl_shm *shm;
+	struct xdg_wm_base *wm_base;
+	struct wp_presentation *presentation;
+
+	/* Bound if set before test_client_init() */
+	bool bind_workspaces;
+	struct ext_workspace_manager_v1 *workspace_manager;
+	struct ext_workspace_handle_v1 *workspaces[HEADLESS_MAX_WORKSPACES];
+	int nr_workspaces;
+
+	struct wl_surface *surface;
+	struct xdg_surface *xdg_surface;
+	struct xdg_toplevel *toplevel;
+	struct test_buffer buffers[2];
+	/* Size of the last configure, 0 lets the client choose */
+	int width, height;
+	bool configured;
+	uint32_t frame;
+
+	/*
+	 * Called with the commit to presentation latency of every frame,
+	 * -1 if it was discarded. @tag is the value of the field at commit.
+	 */
+	void (*presented)(struct test_client *client, uint32_t tag,
+		int64_t latency_ns);
+	uint32_t tag;
+};
+
+/* Maps a window with the app_id "bench-<index>" */
+void test_client_init(struct test_client *client, int index);
+/* Commits a new frame unless both buffers are still in use */
+void test_client_draw(struct test_client *client);
+void test_client_finish(struct test_client *client);
+
+int ipc_connect(const char *path);
+void ipc_send(int fd, const char *fmt, ...);
+/* Reads and discards everything that arrived so far */
+void ipc_drain(int fd);
+/* Reads one reply line into @reply, skipping lines not containing @match */
+void ipc_read_reply(int fd, const char *match, char *reply, size_t size);
+/* Reads the ids of the "bench-*" windows from the "list" reply */
+int ipc_list_windows(int fd, char ids[][32], int max);
+
+uint64_t now_ns(void);
+
+struct summary {
+	double mean;
+	uint32_t p50, p95, p99, max;
+};
+
+/* Sorts @values */
+void summarize(uint32_t *values, size_t count, struct summary *summary);
+
+#endif /* LABWC_T_HEADLESS_H */
@@ -0,0 +1,71 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <cmocka.h>
+#include "common/id-map.h"
+
+#define NR_IDS 1000
+
+static int values[NR_IDS + 1];
+
+static void
+test_insert_lookup(void **state)
+{
+	struct lab_id_map map = { 0 };
+
+	assert_null(lab_id_map_lookup(&map, 1));
+	for (uint64_t id = 1; id <= NR_IDS; id++) {
+		lab_id_map_insert(&map, id, &values[id]);
+	}
+	assert_int_equal(map.count, NR_IDS);
+	for (uint64_t id = 1; id <= NR_IDS; id++) {
+		assert_ptr_equal(lab_id_map_lookup(&map, id), &values[id]);
+	}
+	assert_null(lab_id_map_lookup(&map, NR_IDS + 1));
+	assert_null(lab_id_map_lookup(&map, 0));
+
+	/* Inserting an existing id replaces its value */
+	lab_id_map_insert(&map, 7, &values[0]);
+	assert_int_equal(map.count, NR_IDS);
+	assert_ptr_equal(lab_id_map_lookup(&map, 7), &values[0]);
+
+	lab_id_map_finish(&map);
+}
+
+static void
+test_remove(void **state)
+{
+	struct lab_id_map map = { 0 };
+
+	for (uint64_t id = 1; id <= NR_IDS; id++) {
+		lab_id_map_insert(&map, id, &values[id]);
+	}
+	/* Removing every other id must not break probing for the rest */
+	for (uint64_t id = 1; id <= NR_IDS; id += 2) {
+		lab_id_map_remove(&map, id);
+	}
+	lab_id_map_remove(&map, NR_IDS + 1);
+	assert_int_equal(map.count, NR_IDS / 2);
+	for (uint64_t id = 1; id <= NR_IDS; id++) {
+		if (id % 2) {
+			assert_null(lab_id_map_lookup(&map, id));
+		} else {
+			assert_ptr_equal(lab_id_map_lookup(&map, id),
+				&values[id]);
+		}
+	}
+
+	lab_id_map_finish(&map);
+}
+
+int main(int argc, char **argv)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(test_insert_lookup),
+		cmocka_unit_test(test_remove),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
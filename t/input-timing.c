@@ -0,0 +1,79 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <cmocka.h>
+#include "input-timing.h"
+
+static void
+test_empty(void **state)
+{
+	struct latency_histogram histogram = {0};
+	assert_int_equal(latency_histogram_percentile(&histogram, 50), 0);
+}
+
+static void
+test_small_values_exact(void **state)
+{
+	struct latency_histogram histogram = {0};
+	for (uint64_t ns = 0; ns < 8; ns++) {
+		latency_histogram_add(&histogram, ns);
+	}
+	assert_int_equal(histogram.count, 8);
+	assert_int_equal(histogram.sum_ns, 28);
+	assert_int_equal(latency_histogram_percentile(&histogram, 50), 3);
+	assert_int_equal(latency_histogram_percentile(&histogram, 100), 7);
+}
+
+static void
+test_percentiles(void **state)
+{
+	struct latency_histogram *histogram = calloc(1, sizeof(*histogram));
+
+	/* 1000 values from 1us to 1ms */
+	for (uint64_t i = 1; i <= 1000; i++) {
+		latency_histogram_add(histogram, i * 1000);
+	}
+	assert_int_equal(histogram->max_ns, 1000000);
+
+	/* Bucket bounds are at most 12.5% above the real value */
+	uint64_t p50 = latency_histogram_percentile(histogram, 50);
+	assert_true(p50 >= 500000 && p50 <= 500000 * 9 / 8);
+	uint64_t p99 = latency_histogram_percentile(histogram, 99);
+	assert_true(p99 >= 990000 && p99 <= 1000000);
+
+	/* Never above the largest value */
+	assert_int_equal(latency_histogram_percentile(histogram, 100), 1000000);
+
+	free(histogram);
+}
+
+static void
+test_outlier(void **state)
+{
+	struct latency_histogram histogram = {0};
+	for (int i = 0; i < 99; i++) {
+		latency_histogram_add(&histogram, 2000);
+	}
+	/* Beyond the last bucket */
+	latency_histogram_add(&histogram, UINT64_C(1) << 50);
+
+	uint64_t p99 = latency_histogram_percentile(&histogram, 99);
+	assert_true(p99 >= 2000 && p99 < 2048);
+	assert_int_equal(latency_histogram_percentile(&histogram, 100),
+		UINT64_C(1) << 50);
+}
+
+int main(int argc, char **argv)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(test_empty),
+		cmocka_unit_test(test_small_values_exact),
+		cmocka_unit_test(test_percentiles),
+		cmocka_unit_test(test_outlier),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
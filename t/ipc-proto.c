@@ -0,0 +1,319 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cmocka.h>
+#include <wayland-util.h>
+#include "common/buf.h"
+#include "labwc-ipc-proto.h"
+
+/*
+ * Decodes the JSON string starting at @p, as written by the encoder,
+ * and returns a pointer past its closing quote
+ */
+static const char *
+json_unescape(struct buf *out, const char *p)
+{
+	buf_clear(out);
+	assert_int_equal(*p++, '"');
+	while (*p != '"') {
+		assert_true(*p);
+		if (*p != '\\') {
+			buf_add_char(out, *p++);
+			continue;
+		}
+		p++;
+		if (*p == 'u') {
+			char hex[5] = {0};
+			memcpy(hex, p + 1, 4);
+			buf_add_char(out, (char)strtol(hex, NULL, 16));
+			p += 5;
+		} else {
+			buf_add_char(out, *p++);
+		}
+	}
+	return p + 1;
+}
+
+static void
+test_window_event_escaping(void **state)
+{
+	/* Long enough to overflow any fixed-size message buffer */
+	char title[4096 + 1];
+	const char pattern[] = "say \"hi\"\\\n\tthere ";
+	for (size_t i = 0; i < sizeof(title) - 1; i++) {
+		title[i] = pattern[i % (sizeof(pattern) - 1)];
+	}
+	title[sizeof(title) - 1] = '\0';
+
+	struct ipc_window_info info = {
+		.id = 0x2a,
+		.title = title,
+		.app_id = "org.example.\"quoted\"",
+		.width = 640,
+		.height = 480,
+		.focused = true,
+	};
+	struct buf json = BUF_INIT;
+	ipc_json_encode_window_event(&json, IPC_WINDOW_TITLE_CHANGED, &info);
+
+	/* One complete line: no raw newline before the terminating one */
+	assert_true((size_t)json.len > sizeof(title));
+	assert_ptr_equal(strchr(json.data, '\n'), json.data + json.len - 1);
+	assert_string_equal(json.data + json.len - 2, "}\n");
+
+	const char prefix[] =
+		"{\"event\":\"title_changed\",\"id\":\"2a\",\"title\":";
+	assert_int_equal(strncmp(json.data, prefix, strlen(prefix)), 0);
+
+	struct buf decoded = BUF_INIT;
+	const char *p = json_unescape(&decoded, json.data + strlen(prefix));
+	assert_string_equal(decoded.data, title);
+
+	const char app_id_key[] = ",\"app_id\":";
+	assert_int_equal(strncmp(p, app_id_key, strlen(app_id_key)), 0);
+	p = json_unescape(&decoded, p + strlen(app_id_key));
+	assert_string_equal(decoded.data, info.app_id);
+
+	assert_string_equal(p, ",\"x\":0,\"y\":0,\"width\":640,\"height\":480,"
+		"\"minimized\":false,\"maximized\":0,\"fullscreen\":false,"
+		"\"focused\":true}\n");
+
+	buf_reset(&decoded);
+	buf_reset(&json);
+}
+
+static void
+test_json_string_escapes(void **state)
+{
+	struct ipc_subscription sub;
+	assert_true(ipc_json_parse_subscribe("{\"cmd\":\"subscribe\","
+		"\"app_id\":\"a\\\"b\\\\c\\/d\\n\\u00e9\\ud83d\\ude00\","
+		"\"output\":\"DP-1\"}", &sub));
+	assert_string_equal(sub.app_id, "a\"b\\c/d\n\xc3\xa9\xf0\x9f\x98\x80");
+	assert_string_equal(sub.output, "DP-1");
+	ipc_subscription_finish(&sub);
+
+	/* An escaped quote does not end the string */
+	struct ipc_command cmd;
+	assert_true(ipc_json_parse_command("{\"cmd\":\"move\","
+		"\"mode\":\"x\\\"y\",\"id\":\"2a\"}", &cmd));
+	assert_int_equal(cmd.type, IPC_CMD_MOVE);
+	assert_int_equal(cmd.id, 0x2a);
+
+	/* Malformed escapes are rejected rather than copied */
+	const char *const invalid[] = {
+		"{\"app_id\":\"\\x\"}",
+		"{\"app_id\":\"\\u00\"}",
+		"{\"app_id\":\"\\u0000\"}",
+		"{\"app_id\":\"\\ud83d\"}",
+		"{\"app_id\":\"\\ude00\"}",
+		"{\"app_id\":\"unterminated\\\"}",
+	};
+	for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+		assert_false(ipc_json_parse_subscribe(invalid[i], &sub));
+	}
+}
+
+static void
+test_json_filter_limit(void **state)
+{
+	/* The limit applies to the decoded string */
+	struct buf line = BUF_INIT;
+	buf_add(&line, "{\"app_id\":\"");
+	for (int i = 0; i < IPC_FILTER_MAX_LEN; i++) {
+		buf_add(&line, "\\u0041");
+	}
+	buf_add(&line, "\"}");
+
+	struct ipc_subscription sub;
+	assert_true(ipc_json_parse_subscribe(line.data, &sub));
+	assert_int_equal(strlen(sub.app_id), IPC_FILTER_MAX_LEN);
+	ipc_subscription_finish(&sub);
+
+	buf_clear(&line);
+	buf_add(&line, "{\"app_id\":\"");
+	for (int i = 0; i <= IPC_FILTER_MAX_LEN; i++) {
+		buf_add_char(&line, 'a');
+	}
+	buf_add(&line, "\"}");
+	assert_false(ipc_json_parse_subscribe(line.data, &sub));
+
+	buf_reset(&line);
+}
+
+static void
+put_le16(uint8_t *p, uint16_t v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+}
+
+static void
+put_le32(uint8_t *p, uint32_t v)
+{
+	put_le16(p, v);
+	put_le16(p + 2, v >> 16);
+}
+
+static void
+put_command(uint8_t *p, enum ipc_command_type type, uint32_t arg)
+{
+	memset(p, 0, IPC_COMMAND_RECORD_SIZE);
+	put_le32(p, type);
+	put_le32(p + 4, arg);
+}
+
+static void
+test_bin_decode_frame(void **state)
+{
+	uint8_t data[IPC_FRAME_HEADER_SIZE + 4] = {0};
+	put_le32(data, 4);
+	put_le16(data + 4, IPC_MSG_COMMAND);
+
+	uint16_t type;
+	const uint8_t *payload;
+	uint32_t payload_len;
+
+	/* Incomplete header and payload wait for more data */
+	for (size_t len = 0; len < sizeof(data); len++) {
+		assert_int_equal(ipc_bin_decode_frame(data, len, &type,
+			&payload, &payload_len), 0);
+	}
+
+	assert_int_equal(ipc_bin_decode_frame(data, sizeof(data), &type,
+		&payload, &payload_len), sizeof(data));
+	assert_int_equal(type, IPC_MSG_COMMAND);
+	assert_ptr_equal(payload, data + IPC_FRAME_HEADER_SIZE);
+	assert_int_equal(payload_len, 4);
+
+	/* Oversized lengths fail before their payload arrives */
+	put_le32(data, IPC_FRAME_MAX_PAYLOAD + 1);
+	assert_int_equal(ipc_bin_decode_frame(data, IPC_FRAME_HEADER_SIZE,
+		&type, &payload, &payload_len), -1);
+	put_le32(data, UINT32_MAX);
+	assert_int_equal(ipc_bin_decode_frame(data, IPC_FRAME_HEADER_SIZE,
+		&type, &payload, &payload_len), -1);
+
+	put_le32(data, 4);
+	put_le16(data + 6, 1);
+	assert_int_equal(ipc_bin_decode_frame(data, sizeof(data), &type,
+		&payload, &payload_len), -1);
+}
+
+static void
+test_bin_decode_command(void **state)
+{
+	uint8_t record[IPC_COMMAND_RECORD_SIZE];
+	struct ipc_command cmd;
+
+	put_command(record, IPC_CMD_FOCUS, 0);
+	put_le32(record + 8, 0x2a);
+	assert_true(ipc_bin_decode_command(record, sizeof(record), &cmd));
+	assert_int_equal(cmd.type, IPC_CMD_FOCUS);
+	assert_int_equal(cmd.id, 0x2a);
+
+	assert_false(ipc_bin_decode_command(record, sizeof(record) - 1, &cmd));
+
+	put_command(record, IPC_CMD_NONE, 0);
+	assert_false(ipc_bin_decode_command(record, sizeof(record), &cmd));
+	put_command(record, IPC_CMD_COUNT, 0);
+	assert_false(ipc_bin_decode_command(record, sizeof(record), &cmd));
+}
+
+static void
+test_bin_decode_batch(void **state)
+{
+	size_t len = (IPC_BATCH_MAX_OPS + 2) * IPC_COMMAND_RECORD_SIZE;
+	uint8_t *payload = calloc(1, len);
+	put_command(payload, IPC_CMD_BATCH, 0);
+	for (size_t i = 1; i <= IPC_BATCH_MAX_OPS + 1; i++) {
+		put_command(payload + i * IPC_COMMAND_RECORD_SIZE,
+			IPC_CMD_MINIMIZE, 0);
+	}
+
+	struct wl_array ops;
+	wl_array_init(&ops);
+	assert_true(ipc_bin_decode_batch(payload,
+		len - IPC_COMMAND_RECORD_SIZE, &ops));
+	assert_int_equal(ops.size / sizeof(struct ipc_command),
+		IPC_BATCH_MAX_OPS);
+	wl_array_release(&ops);
+
+	/* One operation too many */
+	wl_array_init(&ops);
+	assert_false(ipc_bin_decode_batch(payload, len, &ops));
+	wl_array_release(&ops);
+
+	/* Partial records */
+	wl_array_init(&ops);
+	assert_false(ipc_bin_decode_batch(payload,
+		2 * IPC_COMMAND_RECORD_SIZE - 1, &ops));
+	assert_false(ipc_bin_decode_batch(payload, 0, &ops));
+	wl_array_release(&ops);
+
+	/* Only commands acting on a single view can be batched */
+	put_command(payload + IPC_COMMAND_RECORD_SIZE, IPC_CMD_SHM, 0);
+	wl_array_init(&ops);
+	assert_false(ipc_bin_decode_batch(payload,
+		2 * IPC_COMMAND_RECORD_SIZE, &ops));
+	wl_array_release(&ops);
+
+	free(payload);
+}
+
+static void
+test_bin_decode_subscribe(void **state)
+{
+	uint8_t payload[IPC_COMMAND_RECORD_SIZE + 2 * (2 + IPC_FILTER_MAX_LEN)
+		+ 2];
+	put_command(payload, IPC_CMD_SUBSCRIBE, IPC_EVENT_CURSOR);
+	uint8_t *p = payload + IPC_COMMAND_RECORD_SIZE;
+	put_le16(p, IPC_FILTER_MAX_LEN);
+	memset(p + 2, 'a', IPC_FILTER_MAX_LEN);
+	p += 2 + IPC_FILTER_MAX_LEN;
+	put_le16(p, 4);
+	memcpy(p + 2, "DP-1", 4);
+	p += 2 + 4;
+
+	struct ipc_subscription sub;
+	assert_true(ipc_bin_decode_subscribe(payload, p - payload, &sub));
+	assert_int_equal(sub.events, IPC_EVENT_CURSOR);
+	assert_int_equal(strlen(sub.app_id), IPC_FILTER_MAX_LEN);
+	assert_string_equal(sub.output, "DP-1");
+	ipc_subscription_finish(&sub);
+
+	/* Without filters */
+	assert_true(ipc_bin_decode_subscribe(payload, IPC_COMMAND_RECORD_SIZE,
+		&sub));
+	assert_null(sub.app_id);
+	assert_null(sub.output);
+
+	/* Truncated filter, trailing bytes and the record itself */
+	assert_false(ipc_bin_decode_subscribe(payload, p - payload - 1, &sub));
+	assert_false(ipc_bin_decode_subscribe(payload, p - payload + 1, &sub));
+	assert_false(ipc_bin_decode_subscribe(payload,
+		IPC_COMMAND_RECORD_SIZE - 1, &sub));
+
+	/* Filter longer than the limit */
+	put_le16(payload + IPC_COMMAND_RECORD_SIZE, IPC_FILTER_MAX_LEN + 1);
+	assert_false(ipc_bin_decode_subscribe(payload, sizeof(payload), &sub));
+}
+
+int main(int argc, char **argv)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(test_window_event_escaping),
+		cmocka_unit_test(test_json_string_escapes),
+		cmocka_unit_test(test_json_filter_limit),
+		cmocka_unit_test(test_bin_decode_frame),
+		cmocka_unit_test(test_bin_decode_command),
+		cmocka_unit_test(test_bin_decode_batch),
+		cmocka_unit_test(test_bin_decode_subscribe),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,89 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#define _POSIX_C_SOURCE 200809L
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <cmocka.h>
+#include "labwc-ipc-queue.h"
+
+static void
+push_str(struct ipc_out_queue *queue, enum ipc_msg_type type,
+		enum ipc_window_event event, uint64_t view_id, const char *str)
+{
+	struct ipc_msg_key key = {
+		.type = type,
+		.event = event,
+		.view_id = view_id,
+	};
+	ipc_out_queue_push(queue, &key, str, strlen(str));
+}
+
+/* Flushes the queue into a pipe and returns what came out */
+static void
+drain(struct ipc_out_queue *queue, char *out, size_t size)
+{
+	int fds[2];
+	assert_int_equal(pipe(fds), 0);
+	assert_int_equal(ipc_out_queue_flush(queue, fds[1]), 0);
+	close(fds[1]);
+	ssize_t len = read(fds[0], out, size - 1);
+	assert_true(len >= 0);
+	out[len] = '\0';
+	close(fds[0]);
+}
+
+static void
+test_coalesce(void **state)
+{
+	struct ipc_out_queue queue;
+	ipc_out_queue_init(&queue, 64);
+
+	push_str(&queue, IPC_MSG_CURSOR, 0, 0, "c1;");
+	push_str(&queue, IPC_MSG_WINDOW_EVENT, IPC_WINDOW_MOVED, 1, "m1a;");
+	push_str(&queue, IPC_MSG_WINDOW_EVENT, IPC_WINDOW_MOVED, 2, "m2a;");
+	push_str(&queue, IPC_MSG_CURSOR, 0, 0, "c2;");
+	push_str(&queue, IPC_MSG_WINDOW_EVENT, IPC_WINDOW_MOVED, 1, "m1b;");
+	/* Must come after the pending "moved" of the same view */
+	push_str(&queue, IPC_MSG_WINDOW_EVENT, IPC_WINDOW_CLOSED, 1, "x1;");
+	assert_int_equal(queue.nr_coalesced, 2);
+
+	char out[128];
+	drain(&queue, out, sizeof(out));
+	assert_string_equal(out, "m1b;x1;m2a;c2;");
+	assert_true(ipc_out_queue_is_empty(&queue));
+
+	ipc_out_queue_finish(&queue);
+}
+
+static void
+test_drop_whole_messages(void **state)
+{
+	struct ipc_out_queue queue;
+	ipc_out_queue_init(&queue, 8);
+
+	push_str(&queue, IPC_MSG_WINDOW_LIST, 0, 0, "abcdef;");
+	push_str(&queue, IPC_MSG_WINDOW_LIST, 0, 0, "ghi;");
+	assert_int_equal(queue.nr_dropped, 1);
+	/* The unwritten rest of a message is never dropped silently */
+	assert_false(ipc_out_queue_push_tail(&queue, "jk", 2));
+	assert_true(ipc_out_queue_push_tail(&queue, "j", 1));
+
+	char out[32];
+	drain(&queue, out, sizeof(out));
+	assert_string_equal(out, "abcdef;j");
+
+	ipc_out_queue_finish(&queue);
+}
+
+int main(int argc, char **argv)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(test_coalesce),
+		cmocka_unit_test(test_drop_whole_messages),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,57 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <cmocka.h>
+#include "labwc-ipc-table.h"
+
+static void
+test_deltas(void **state)
+{
+	struct ipc_window_table table;
+	ipc_window_table_init(&table);
+
+	struct ipc_window_info info = {
+		.id = 1,
+		.title = "foo",
+		.app_id = "bar",
+		.width = 640,
+		.height = 480,
+	};
+	assert_int_equal(ipc_window_table_update(&table, &info),
+		IPC_WINDOW_FIELDS_ALL);
+	assert_int_equal(table.generation, 1);
+
+	/* Unchanged state does not produce a delta */
+	assert_int_equal(ipc_window_table_update(&table, &info), 0);
+	assert_int_equal(table.generation, 1);
+
+	info.x = 10;
+	info.title = "baz";
+	assert_int_equal(ipc_window_table_update(&table, &info),
+		IPC_WINDOW_FIELD_X | IPC_WINDOW_FIELD_TITLE);
+	assert_int_equal(table.generation, 2);
+
+	info.focused = true;
+	assert_int_equal(ipc_window_table_update(&table, &info),
+		IPC_WINDOW_FIELD_FOCUSED);
+	assert_int_equal(table.focused_id, 1);
+
+	assert_true(ipc_window_table_remove(&table, 1));
+	assert_false(ipc_window_table_remove(&table, 1));
+	assert_int_equal(table.generation, 4);
+	assert_int_equal(table.focused_id, 0);
+	assert_true(wl_list_empty(&table.entries));
+
+	ipc_window_table_finish(&table);
+}
+
+int main(int argc, char **argv)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(test_deltas),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
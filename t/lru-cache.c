@@ -0,0 +1,101 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <cmocka.h>
+#include "common/lru-cache.h"
+
+#define NR_ENTRIES 8
+
+static struct lab_lru_entry entries[NR_ENTRIES];
+static int nr_destroyed;
+
+static void destroy(struct lab_lru_entry *entry);
+
+static struct lab_lru_cache cache =
+	LAB_LRU_CACHE_INIT(cache, 3 * 100, destroy);
+
+static void
+destroy(struct lab_lru_entry *entry)
+{
+	lab_lru_cache_remove(&cache, entry);
+	nr_destroyed++;
+}
+
+static void
+test_chain(void **state)
+{
+	struct lab_id_map map = { 0 };
+	struct lab_id_chain nodes[3] = { 0 };
+
+	/* Colliding nodes are found by walking the chain */
+	for (int i = 0; i < 3; i++) {
+		lab_id_chain_insert(&map, &nodes[i], 42);
+	}
+	assert_int_equal(map.count, 1);
+	int found = 0;
+	for (struct lab_id_chain *node = lab_id_chain_first(&map, 42); node;
+			node = node->next) {
+		found++;
+	}
+	assert_int_equal(found, 3);
+
+	/* Unlink from the middle, the head and the end of the chain */
+	lab_id_chain_remove(&map, &nodes[1]);
+	assert_ptr_equal(lab_id_chain_first(&map, 42), &nodes[2]);
+	assert_ptr_equal(nodes[2].next, &nodes[0]);
+	lab_id_chain_remove(&map, &nodes[2]);
+	assert_ptr_equal(lab_id_chain_first(&map, 42), &nodes[0]);
+	assert_null(nodes[0].next);
+	lab_id_chain_remove(&map, &nodes[0]);
+	assert_null(lab_id_chain_first(&map, 42));
+	assert_int_equal(map.count, 0);
+
+	/* Nodes which are not in the map are ignored */
+	lab_id_chain_remove(&map, &nodes[0]);
+	assert_int_equal(nodes[0].id, 0);
+
+	lab_id_map_finish(&map);
+}
+
+static void
+test_evict(void **state)
+{
+	for (int i = 0; i < 4; i++) {
+		entries[i].bytes = 100;
+		lab_lru_cache_add(&cache, &entries[i], i + 1);
+	}
+	assert_int_equal(cache.bytes, 400);
+
+	/* The least recently used entry goes, unless it was just used */
+	lab_lru_cache_touch(&cache, &entries[0]);
+	lab_lru_cache_evict(&cache, &entries[0]);
+	assert_int_equal(nr_destroyed, 1);
+	assert_int_equal(entries[1].chain.id, 0);
+	assert_int_equal(cache.nr_entries, 3);
+	assert_int_equal(cache.bytes, 300);
+
+	/* An entry over the limit alone is kept if it is @keep */
+	lab_lru_cache_set_bytes(&cache, &entries[3], 500);
+	assert_int_equal(cache.bytes, 700);
+	lab_lru_cache_evict(&cache, &entries[3]);
+	assert_int_equal(nr_destroyed, 3);
+	assert_int_equal(cache.nr_entries, 1);
+	assert_ptr_equal(lab_id_chain_first(&cache.by_id, 4),
+		&entries[3].chain);
+
+	lab_lru_cache_clear(&cache);
+	assert_int_equal(nr_destroyed, 4);
+	assert_int_equal(cache.bytes, 0);
+}
+
+int main(int argc, char **argv)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(test_chain),
+		cmocka_unit_test(test_evict),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
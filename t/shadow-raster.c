@@ -0,0 +1,199 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <math.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cmocka.h>
+#include "shadow-raster.h"
+
+static const float shadow_color[4] = { 0.1f, 0.2f, 0.3f, 0.375f };
+
+/* The per-pixel exp() version the rasters used to be drawn with */
+static uint32_t
+reference_pixel(int x, int y, int total_size, int inset)
+{
+	/* Bottom corner, the square behind the window is clear */
+	if (x < inset && y < inset) {
+		return 0;
+	}
+	double x_norm = (double)x / (double)total_size;
+	double y_norm = (double)y / (double)total_size;
+	double alpha = exp(-(x_norm * x_norm) / (0.3 * 0.3))
+		* exp(-(y_norm * y_norm) / (0.3 * 0.3));
+	return (uint32_t)(uint8_t)(shadow_color[2] * alpha * 255)
+		| (uint32_t)(uint8_t)(shadow_color[1] * alpha * 255) << 8
+		| (uint32_t)(uint8_t)(shadow_color[0] * alpha * 255) << 16
+		| (uint32_t)(uint8_t)(shadow_color[3] * alpha * 255) << 24;
+}
+
+static bool
+channels_within_one(uint32_t a, uint32_t b)
+{
+	for (int shift = 0; shift < 32; shift += 8) {
+		int ca = (a >> shift) & 0xff;
+		int cb = (b >> shift) & 0xff;
+		if (abs(ca - cb) > 1) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static void
+test_simd_matches_scalar(void **state)
+{
+	float lut[77];
+	uint32_t simd[77], scalar[77];
+	shadow_falloff_lut(lut, 77);
+
+	/* Cover the vector bodies and every tail length */
+	for (int count = 0; count <= 77; count++) {
+		memset(simd, 0xaa, sizeof(simd));
+		memset(scalar, 0xaa, sizeof(scalar));
+		shadow_fill_row(simd, lut, 0.7f, count, shadow_color);
+		shadow_fill_row_scalar(scalar, lut, 0.7f, count, shadow_color);
+		assert_memory_equal(simd, scalar, sizeof(simd));
+	}
+}
+
+static void
+test_corner_matches_reference(void **state)
+{
+	struct shadow_raster_key key = {
+		.visible_size = 60,
+		.total_size = 78,
+		.corner = true,
+		.scale = 1.0f,
+	};
+	memcpy(key.color, shadow_color, sizeof(key.color));
+
+	int width, height;
+	shadow_raster_size(&key, &width, &height);
+	assert_int_equal(width, 78);
+	assert_int_equal(height, 78);
+
+	uint32_t *pixels = calloc(width * height, sizeof(*pixels));
+	shadow_raster_draw(&key, (uint8_t *)pixels, width * 4);
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			assert_true(channels_within_one(pixels[y * width + x],
+				reference_pixel(x, y, 78, 18)));
+		}
+	}
+	free(pixels);
+}
+
+static void
+test_corner_clears_behind_window(void **state)
+{
+	/* Inset of 18 pixels, 10 of which are behind the titlebar */
+	struct shadow_raster_key key = {
+		.visible_size = 60,
+		.total_size = 78,
+		.titlebar_height = 10,
+		.corner = true,
+		.scale = 1.0f,
+	};
+	memcpy(key.color, shadow_color, sizeof(key.color));
+
+	uint32_t *pixels = calloc(78 * 78, sizeof(*pixels));
+	shadow_raster_draw(&key, (uint8_t *)pixels, 78 * 4);
+
+	/* Above the titlebar the whole inset is clear */
+	assert_int_equal(pixels[7 * 78 + 17], 0);
+	assert_int_not_equal(pixels[7 * 78 + 18], 0);
+	/* Next to the titlebar only what it does not cover */
+	assert_int_equal(pixels[12 * 78 + 7], 0);
+	assert_int_not_equal(pixels[12 * 78 + 8], 0);
+	/* Below the inset nothing */
+	assert_int_not_equal(pixels[18 * 78], 0);
+	free(pixels);
+}
+
+static void
+test_edge_lines_up_with_corner(void **state)
+{
+	struct shadow_raster_key corner = {
+		.visible_size = 40,
+		.total_size = 52,
+		.corner = true,
+		.scale = 2.0f,
+	};
+	memcpy(corner.color, shadow_color, sizeof(corner.color));
+	struct shadow_raster_key edge = corner;
+	edge.corner = false;
+
+	int width, height;
+	shadow_raster_size(&edge, &width, &height);
+	assert_int_equal(width, 80);
+	/* One logical pixel */
+	assert_int_equal(height, 2);
+
+	uint32_t edge_pixels[2][80];
+	uint32_t *corner_pixels = calloc(104 * 104, sizeof(*corner_pixels));
+	shadow_raster_draw(&edge, (uint8_t *)edge_pixels,
+		sizeof(edge_pixels[0]));
+	shadow_raster_draw(&corner, (uint8_t *)corner_pixels, 104 * 4);
+
+	/* The first corner row runs at full strength past the inset */
+	assert_memory_equal(edge_pixels[0], corner_pixels + 24,
+		sizeof(edge_pixels[0]));
+	assert_memory_equal(edge_pixels[1], edge_pixels[0],
+		sizeof(edge_pixels[0]));
+	free(corner_pixels);
+}
+
+static void
+test_cache(void **state)
+{
+	struct shadow_raster_key key = {
+		.visible_size = 30,
+		.total_size = 39,
+		.titlebar_height = 5,
+		.corner = true,
+		.scale = 1.5f,
+	};
+	memcpy(key.color, shadow_color, sizeof(key.color));
+
+	int width, height;
+	shadow_raster_size(&key, &width, &height);
+	/* Padded rows */
+	int stride = (width + 3) * 4;
+	uint8_t *first = calloc(height, stride);
+	uint8_t *second = calloc(height, stride);
+
+	uint64_t hits, misses, hits_before, misses_before;
+	shadow_raster_cache_stats(&hits_before, &misses_before);
+	shadow_raster_draw(&key, first, stride);
+	shadow_raster_draw(&key, second, stride);
+	shadow_raster_cache_stats(&hits, &misses);
+	assert_int_equal(misses, misses_before + 1);
+	assert_int_equal(hits, hits_before + 1);
+	assert_memory_equal(first, second, height * stride);
+
+	/* A different color is a different raster */
+	key.color[3] = 0.5f;
+	shadow_raster_draw(&key, second, stride);
+	shadow_raster_cache_stats(&hits, &misses);
+	assert_int_equal(misses, misses_before + 2);
+	assert_memory_not_equal(first, second, height * stride);
+
+	free(first);
+	free(second);
+}
+
+int main(int argc, char **argv)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(test_simd_matches_scalar),
+		cmocka_unit_test(test_corner_matches_reference),
+		cmocka_unit_test(test_corner_clears_behind_window),
+		cmocka_unit_test(test_edge_lines_up_with_corner),
+		cmocka_unit_test(test_cache),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
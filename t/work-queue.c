@@ -0,0 +1,206 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <pthread.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <cmocka.h>
+#include <wayland-server-core.h>
+#include "work-queue.h"
+
+#define NR_JOBS 64
+
+struct job {
+	int index;
+	bool ran;
+	bool done;
+	bool on_worker;
+	struct work_queue *resubmit_to;
+};
+
+static pthread_t main_thread;
+static int nr_done;
+/* Indices in the order done callbacks were called */
+static int done_order[2 * NR_JOBS];
+
+static void
+job_work(void *data)
+{
+	struct job *job = data;
+	job->ran = true;
+	job->on_worker = !pthread_equal(pthread_self(), main_thread);
+}
+
+static void
+job_done(void *data)
+{
+	struct job *job = data;
+	assert_true(pthread_equal(pthread_self(), main_thread));
+	assert_false(job->done);
+	job->done = true;
+	done_order[nr_done++] = job->index;
+
+	if (job->resubmit_to) {
+		struct work_queue *queue = job->resubmit_to;
+		job->resubmit_to = NULL;
+		job->done = false;
+		work_queue_submit(queue, job_work, job_done, job);
+	}
+}
+
+static void
+dispatch_until(struct wl_event_loop *loop, int count)
+{
+	/* Bounded, so a lost wakeup fails instead of hanging */
+	for (int i = 0; i < 1000 && nr_done < count; i++) {
+		wl_event_loop_dispatch(loop, 10);
+	}
+}
+
+static void
+setup(void)
+{
+	main_thread = pthread_self();
+	nr_done = 0;
+}
+
+static void
+test_run_all(void **state)
+{
+	setup();
+	struct wl_event_loop *loop = wl_event_loop_create();
+	struct work_queue *queue = work_queue_create(loop, 4);
+	assert_non_null(queue);
+
+	struct job jobs[NR_JOBS] = { 0 };
+	for (int i = 0; i < NR_JOBS; i++) {
+		jobs[i].index = i;
+		work_queue_submit(queue, job_work, job_done, &jobs[i]);
+	}
+	dispatch_until(loop, NR_JOBS);
+
+	assert_int_equal(nr_done, NR_JOBS);
+	for (int i = 0; i < NR_JOBS; i++) {
+		assert_true(jobs[i].ran);
+		assert_true(jobs[i].done);
+		assert_true(jobs[i].on_worker);
+	}
+
+	work_queue_destroy(queue);
+	wl_event_loop_destroy(loop);
+}
+
+static void
+test_fifo_single_thread(void **state)
+{
+	setup();
+	struct wl_event_loop *loop = wl_event_loop_create();
+	struct work_queue *queue = work_queue_create(loop, 1);
+
+	struct job jobs[NR_JOBS] = { 0 };
+	for (int i = 0; i < NR_JOBS; i++) {
+		jobs[i].index = i;
+		work_queue_submit(queue, job_work, job_done, &jobs[i]);
+	}
+	dispatch_until(loop, NR_JOBS);
+
+	/* One worker completes jobs in the order they were submitted */
+	assert_int_equal(nr_done, NR_JOBS);
+	for (int i = 0; i < NR_JOBS; i++) {
+		assert_int_equal(done_order[i], i);
+	}
+
+	work_queue_destroy(queue);
+	wl_event_loop_destroy(loop);
+}
+
+static void
+test_submit_from_done(void **state)
+{
+	setup();
+	struct wl_event_loop *loop = wl_event_loop_create();
+	struct work_queue *queue = work_queue_create(loop, 2);
+
+	struct job jobs[NR_JOBS] = { 0 };
+	for (int i = 0; i < NR_JOBS; i++) {
+		jobs[i].index = i;
+		jobs[i].resubmit_to = queue;
+		work_queue_submit(queue, job_work, job_done, &jobs[i]);
+	}
+	dispatch_until(loop, 2 * NR_JOBS);
+
+	assert_int_equal(nr_done, 2 * NR_JOBS);
+	for (int i = 0; i < NR_JOBS; i++) {
+		assert_true(jobs[i].done);
+	}
+
+	work_queue_destroy(queue);
+	wl_event_loop_destroy(loop);
+}
+
+static void
+test_flush(void **state)
+{
+	setup();
+	struct wl_event_loop *loop = wl_event_loop_create();
+	struct work_queue *queue = work_queue_create(loop, 4);
+
+	struct job jobs[NR_JOBS] = { 0 };
+	for (int i = 0; i < NR_JOBS; i++) {
+		jobs[i].index = i;
+		jobs[i].resubmit_to = queue;
+		work_queue_submit(queue, job_work, job_done, &jobs[i]);
+	}
+
+	/* Without dispatching, including the jobs submitted by done */
+	work_queue_flush(queue);
+	assert_int_equal(nr_done, 2 * NR_JOBS);
+	for (int i = 0; i < NR_JOBS; i++) {
+		assert_true(jobs[i].done);
+		assert_true(jobs[i].on_worker);
+	}
+
+	/* Nothing is left for the event loop */
+	wl_event_loop_dispatch(loop, 0);
+	assert_int_equal(nr_done, 2 * NR_JOBS);
+
+	work_queue_destroy(queue);
+	wl_event_loop_destroy(loop);
+}
+
+static void
+test_destroy_completes_pending(void **state)
+{
+	setup();
+	struct wl_event_loop *loop = wl_event_loop_create();
+	struct work_queue *queue = work_queue_create(loop, 1);
+
+	struct job jobs[NR_JOBS] = { 0 };
+	for (int i = 0; i < NR_JOBS; i++) {
+		jobs[i].index = i;
+		work_queue_submit(queue, job_work, job_done, &jobs[i]);
+	}
+
+	/* Without dispatching, every job still gets its done callback */
+	work_queue_destroy(queue);
+	assert_int_equal(nr_done, NR_JOBS);
+	for (int i = 0; i < NR_JOBS; i++) {
+		assert_true(jobs[i].done);
+	}
+
+	wl_event_loop_destroy(loop);
+}
+
+int main(int argc, char **argv)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(test_run_all),
+		cmocka_unit_test(test_fifo_single_thread),
+		cmocka_unit_test(test_submit_from_done),
+		cmocka_unit_test(test_flush),
+		cmocka_unit_test(test_destroy_completes_pending),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -15,6 +15,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include <wlr/util/box.h>
 #include <wlr/util/log.h>
@@ -33,6 +34,7 @@
 #include "labwc.h"
 #include "buffer.h"
 #include "ssd.h"
+#include "work-queue.h"
 
 struct button {
 	const char *name;
@@ -389,7 +391,7 @@ load_button(struct theme *theme, struct button *b, enum ssd_active_state active)
  * ...in the button array definition below.
  */
 static void
-load_buttons(struct theme *theme)
+load_buttons(struct theme *theme, enum ssd_active_state active)
 {
 	struct button buttons[] = { {
 		.name = "menu",
@@ -506,9 +508,7 @@ load_buttons(struct theme *theme)
 	}, };
 
 	for (size_t i = 0; i < ARRAY_SIZE(buttons); ++i) {
-		struct button *b = &buttons[i];
-		load_button(theme, b, SSD_INACTIVE);
-		load_button(theme, b, SSD_ACTIVE);
+		load_button(theme, &buttons[i], active);
 	}
 }
 
@@ -1586,167 +1586,6 @@ create_corners(struct theme *theme)
 	zfree_pattern(frame_pattern);
 }
 
-/*
- * Draw the buffer used to render the edges of window drop-shadows. The buffer
- * is 1 pixel tall and `visible_size` pixels wide and can be rotated and scaled for the
- * different edges.  The buffer is drawn as would be found at the right-hand
- * edge of a window. The gradient has a color of `start_color` at its left edge
- * fading to clear at its right edge.
- */
-static void
-shadow_edge_gradient(struct lab_data_buffer *buffer,
-		int visible_size, int total_size, float start_color[4])
-{
-	if (!buffer) {
-		/* This type of shadow is disabled, do nothing */
-		return;
-	}
-
-	assert(buffer->format == DRM_FORMAT_ARGB8888);
-	uint8_t *pixels = buffer->data;
-
-	/* Inset portion which is obscured */
-	int inset = total_size - visible_size;
-
-	/* Standard deviation normalised against the shadow width, squared */
-	double variance = 0.3 * 0.3;
-
-	for (int x = 0; x < visible_size; x++) {
-		/*
-		 * x normalised against total shadow width. We add on inset here
-		 * because we don't bother drawing inset for the edge shadow
-		 * buffers but still need the pattern to line up with the corner
-		 * shadow buffers which do have inset drawn.
-		 */
-		double xn = (double)(x + inset) / (double)total_size;
-
-		/* Gaussian dropoff */
-		double alpha = exp(-(xn * xn) / variance);
-
-		/* RGBA values are all pre-multiplied */
-		pixels[4 * x] = start_color[2] * alpha * 255;
-		pixels[4 * x + 1] = start_color[1] * alpha * 255;
-		pixels[4 * x + 2] = start_color[0] * alpha * 255;
-		pixels[4 * x + 3] = start_color[3] * alpha * 255;
-	}
-}
-
-/*
- * Draw the buffer used to render the corners of window drop-shadows.  The
- * shadow looks better if the buffer is inset behind the window, so the buffer
- * is square with a size of radius+inset.  The buffer is drawn for the
- * bottom-right corner but can be rotated for other corners.  The gradient fades
- * from `start_color` at the top-left to clear at the opposite edge.
- *
- * If the window is translucent we don't want the shadow to be visible through
- * it.  For the bottom corners of the window this is easy, we just erase the
- * square of the buffer which will be behind the window.  For the top it's a
- * little more complicated because the titlebar can have rounded corners.
- * However, the titlebar itself is always opaque so we only have to erase the
- * L-shaped area of the buffer which can appear behind the non-titlebar part of
- * the window.
- */
-static void
-shadow_corner_gradient(struct lab_data_buffer *buffer, int visible_size,
-	int total_size, int titlebar_height, float start_color[4])
-{
-	if (!buffer) {
-		/* This type of shadow is disabled, do nothing */
-		return;
-	}
-
-	assert(buffer->format == DRM_FORMAT_ARGB8888);
-	uint8_t *pixels = buffer->data;
-
-	/* Standard deviation normalised against the shadow width, squared */
-	double variance = 0.3 * 0.3;
-
-	int inset = total_size - visible_size;
-
-	for (int y = 0; y < total_size; y++) {
-		uint8_t *pixel_row = &pixels[y * buffer->stride];
-		for (int x = 0; x < total_size; x++) {
-			/* x and y normalised against total shadow width */
-			double x_norm = (double)(x) / (double)total_size;
-			double y_norm = (double)(y) / (double)total_size;
-			/*
-			 * For Gaussian drop-off in 2d you can just calculate
-			 * the outer product of the horizontal and vertical
-			 * profiles.
-			 */
-			double gauss_x = exp(-(x_norm * x_norm) / variance);
-			double gauss_y = exp(-(y_norm * y_norm) / variance);
-			double alpha = gauss_x * gauss_y;
-
-			/*
-			 * Erase the L-shaped region which could be visible
-			 * through a transparent window but not obscured by the
-			 * titlebar. If inset is smaller than the titlebar
-			 * height then there's nothing to do, this is handled by
-			 * (inset - titlebar_height) being negative.
-			 */
-			bool in1 = x < inset && y < inset - titlebar_height;
-			bool in2 = x < inset - titlebar_height && y < inset;
-			if (in1 || in2) {
-				alpha = 0.0;
-			}
-
-			/* RGBA values are all pre-multiplied */
-			pixel_row[4 * x] = start_color[2] * alpha * 255;
-			pixel_row[4 * x + 1] = start_color[1] * alpha * 255;
-			pixel_row[4 * x + 2] = start_color[0] * alpha * 255;
-			pixel_row[4 * x + 3] = start_color[3] * alpha * 255;
-		}
-	}
-}
-
-static void
-create_shadow(struct theme *theme, enum ssd_active_state active)
-{
-	/* Size of shadow visible extending beyond the window */
-	int visible_size = theme->window[active].shadow_size;
-	/* How far inside the window the shadow inset begins */
-	int inset = (double)visible_size * SSD_SHADOW_INSET;
-	/* Total width including visible and obscured portion */
-	int total_size = visible_size + inset;
-
-	/*
-	 * Edge shadows don't need to be inset so the buffers are sized just for
-	 * the visible width.  Corners are inset so the buffers are larger for
-	 * this.
-	 */
-	if (visible_size > 0) {
-		theme->window[active].shadow_edge = buffer_create_cairo(
-			visible_size, 1, 1.0);
-		theme->window[active].shadow_corner_top = buffer_create_cairo(
-			total_size, total_size, 1.0);
-		theme->window[active].shadow_corner_bottom = buffer_create_cairo(
-			total_size, total_size, 1.0);
-		if (!theme->window[active].shadow_corner_top
-				|| !theme->window[active].shadow_corner_bottom
-				|| !theme->window[active].shadow_edge) {
-			wlr_log(WLR_ERROR, "Failed to allocate shadow buffer");
-			return;
-		}
-	}
-
-	shadow_edge_gradient(theme->window[active].shadow_edge, visible_size,
-		total_size, theme->window[active].shadow_color);
-	shadow_corner_gradient(theme->window[active].shadow_corner_top,
-		visible_size, total_size,
-		theme->titlebar_height, theme->window[active].shadow_color);
-	shadow_corner_gradient(theme->window[active].shadow_corner_bottom,
-		visible_size, total_size, 0,
-		theme->window[active].shadow_color);
-}
-
-static void
-create_shadows(struct theme *theme)
-{
-	create_shadow(theme, SSD_INACTIVE);
-	create_shadow(theme, SSD_ACTIVE);
-}
-
 static void
 copy_color_scaled(float dest[4], const float src[4], float scale)
 {
@@ -1960,9 +1799,147 @@ post_processing(struct theme *theme)
 	}
 }
 
-void
-theme_init(struct theme *theme, struct server *server, const char *theme_name)
+/* Stages of building a theme, timed separately for the log */
+enum theme_stage {
+	THEME_STAGE_READ = 0,
+	THEME_STAGE_BACKGROUNDS,
+	THEME_STAGE_CORNERS,
+	THEME_STAGE_BUTTONS_INACTIVE,
+	THEME_STAGE_BUTTONS_ACTIVE,
+
+	THEME_STAGE_COUNT
+};
+
+static const char *const theme_stage_names[THEME_STAGE_COUNT] = {
+	[THEME_STAGE_READ] = "read",
+	[THEME_STAGE_BACKGROUNDS] = "backgrounds",
+	[THEME_STAGE_CORNERS] = "corners",
+	[THEME_STAGE_BUTTONS_INACTIVE] = "inactive buttons",
+	[THEME_STAGE_BUTTONS_ACTIVE] = "active buttons",
+};
+
+/*
+ * The raster stages which run in parallel. They only write their own
+ * fields of the theme. Corners are drawn right after the backgrounds,
+ * whose patterns they may use.
+ */
+static const enum theme_stage theme_jobs[] = {
+	THEME_STAGE_BACKGROUNDS,
+	THEME_STAGE_BUTTONS_INACTIVE,
+	THEME_STAGE_BUTTONS_ACTIVE,
+};
+
+struct theme_job {
+	struct theme_build *build;
+	enum theme_stage stage;
+};
+
+struct theme_build {
+	struct server *server;
+	struct theme *theme;
+	/* NULL for theme_init(), which waits for the build */
+	theme_ready_func_t ready;
+	void *data;
+	bool cancelled;
+
+	struct theme_job jobs[ARRAY_SIZE(theme_jobs)];
+	int nr_running;
+
+	uint64_t start_ns;
+	/* Each stage is only written by the job running it */
+	uint64_t stage_ns[THEME_STAGE_COUNT];
+};
+
+static uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Runs on a worker thread */
+static void
+run_job(void *data)
+{
+	struct theme_job *job = data;
+	struct theme_build *build = job->build;
+	uint64_t start = now_ns();
+
+	switch (job->stage) {
+	case THEME_STAGE_BACKGROUNDS:
+		create_backgrounds(build->theme);
+		build->stage_ns[THEME_STAGE_BACKGROUNDS] = now_ns() - start;
+		start = now_ns();
+		create_corners(build->theme);
+		build->stage_ns[THEME_STAGE_CORNERS] = now_ns() - start;
+		return;
+	case THEME_STAGE_BUTTONS_INACTIVE:
+		load_buttons(build->theme, SSD_INACTIVE);
+		break;
+	case THEME_STAGE_BUTTONS_ACTIVE:
+		load_buttons(build->theme, SSD_ACTIVE);
+		break;
+	default:
+		assert(false);
+	}
+	build->stage_ns[job->stage] = now_ns() - start;
+}
+
+static void
+log_build(struct theme_build *build)
 {
+	char breakdown[256] = { 0 };
+	size_t len = 0;
+	for (int i = 0; i < THEME_STAGE_COUNT; i++) {
+		len += snprintf(breakdown + len, sizeof(breakdown) - len,
+			"%s%s %.1f ms", i ? ", " : "", theme_stage_names[i],
+			build->stage_ns[i] / 1e6);
+		if (len >= sizeof(breakdown)) {
+			break;
+		}
+	}
+	wlr_log(WLR_INFO, "theme built in %.1f ms (%s)",
+		(now_ns() - build->start_ns) / 1e6, breakdown);
+}
+
+static void
+handle_job_done(void *data)
+{
+	struct theme_job *job = data;
+	struct theme_build *build = job->build;
+	if (--build->nr_running) {
+		return;
+	}
+
+	if (build->server->theme_build == build) {
+		build->server->theme_build = NULL;
+	}
+	if (build->cancelled) {
+		/* Jobs may not have run at all, theme_finish() copes with that */
+		theme_finish(build->theme);
+		free(build->theme);
+	} else {
+		log_build(build);
+		if (build->ready) {
+			build->ready(build->theme, build->data);
+		}
+	}
+	free(build);
+}
+
+/*
+ * Reads the themerc files right away, as that also sets up fonts and
+ * rc values depending on the theme, and then starts the raster jobs.
+ */
+static struct theme_build *
+build_start(struct theme *theme, struct server *server, const char *theme_name)
+{
+	struct theme_build *build = znew(*build);
+	build->server = server;
+	build->theme = theme;
+	build->start_ns = now_ns();
+
 	/*
 	 * Set some default values. This is particularly important on
 	 * reconfigure as not all themes set all options
@@ -1988,10 +1965,69 @@ theme_init(struct theme *theme, struct server *server, const char *theme_name)
 	paths_destroy(&paths);
 
 	post_processing(theme);
-	create_backgrounds(theme);
-	create_corners(theme);
-	load_buttons(theme);
-	create_shadows(theme);
+	build->stage_ns[THEME_STAGE_READ] = now_ns() - build->start_ns;
+
+	return build;
+}
+
+static void
+build_submit(struct theme_build *build)
+{
+	struct work_queue *queue = build->server->theme_queue;
+	build->nr_running = ARRAY_SIZE(theme_jobs);
+	for (size_t i = 0; i < ARRAY_SIZE(theme_jobs); i++) {
+		struct theme_job *job = &build->jobs[i];
+		job->build = build;
+		job->stage = theme_jobs[i];
+		if (queue) {
+			work_queue_submit(queue, run_job, handle_job_done, job);
+		} else {
+			run_job(job);
+			handle_job_done(job);
+		}
+	}
+}
+
+void
+theme_init(struct theme *theme, struct server *server, const char *theme_name)
+{
+	build_submit(build_start(theme, server, theme_name));
+	if (server->theme_queue) {
+		work_queue_flush(server->theme_queue);
+	}
+}
+
+void
+theme_build_async(struct server *server, const char *theme_name,
+		theme_ready_func_t ready, void *data)
+{
+	assert(!server->theme_build);
+	struct theme *theme = znew(*theme);
+	struct theme_build *build = build_start(theme, server, theme_name);
+	build->ready = ready;
+	build->data = data;
+	server->theme_build = build;
+	build_submit(build);
+}
+
+void
+theme_builder_init(struct server *server)
+{
+	long nr_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	server->theme_queue = work_queue_create(server->wl_event_loop,
+		MIN(MAX(nr_cpus, 1), (long)ARRAY_SIZE(theme_jobs)));
+}
+
+void
+theme_builder_finish(struct server *server)
+{
+	if (server->theme_build) {
+		server->theme_build->cancelled = true;
+	}
+	/* Completes the build, if any */
+	work_queue_destroy(server->theme_queue);
+	server->theme_queue = NULL;
+	assert(!server->theme_build);
 }
 
 static void destroy_img(struct lab_img **img)
@@ -2022,8 +2058,5 @@ theme_finish(struct theme *theme)
 		zdrop(&theme->window[active].corner_top_right_normal);
 		zdrop(&theme->window[active].corner_bottom_left_normal);
 		zdrop(&theme->window[active].corner_bottom_right_normal);
-		zdrop(&theme->window[active].shadow_corner_top);
-		zdrop(&theme->window[active].shadow_corner_bottom);
-		zdrop(&theme->window[active].shadow_edge);
 	}
 }
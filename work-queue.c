@@ -0,0 +1,246 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#define _POSIX_C_SOURCE 200809L
+#include "work-queue.h"
+#include <assert.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <wayland-server-core.h>
+#include <wlr/util/log.h>
+#include "common/mem.h"
+
+struct work_item {
+	work_func_t work;
+	work_done_func_t done;
+	void *data;
+	struct wl_list link; /* work_queue.pending or work_queue.finished */
+};
+
+struct work_queue {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	/* Signaled when the last running job is finished */
+	pthread_cond_t idle;
+	/* Protected by lock */
+	struct wl_list pending;
+	struct wl_list finished;
+	int nr_idle;
+	int nr_running;
+	bool stopping;
+
+	/* Only touched by the event loop thread */
+	pthread_t *threads;
+	int nr_threads;
+	int max_threads;
+	int eventfd;
+	struct wl_event_source *source;
+};
+
+static void *
+worker_main(void *data)
+{
+	struct work_queue *queue = data;
+
+	pthread_mutex_lock(&queue->lock);
+	while (true) {
+		while (!queue->stopping && wl_list_empty(&queue->pending)) {
+			queue->nr_idle++;
+			pthread_cond_wait(&queue->cond, &queue->lock);
+			queue->nr_idle--;
+		}
+		if (queue->stopping) {
+			break;
+		}
+		struct work_item *item = wl_container_of(queue->pending.next,
+			item, link);
+		wl_list_remove(&item->link);
+		queue->nr_running++;
+		pthread_mutex_unlock(&queue->lock);
+
+		item->work(item->data);
+
+		pthread_mutex_lock(&queue->lock);
+		bool was_empty = wl_list_empty(&queue->finished);
+		wl_list_insert(queue->finished.prev, &item->link);
+		if (--queue->nr_running == 0 && wl_list_empty(&queue->pending)) {
+			pthread_cond_broadcast(&queue->idle);
+		}
+		if (was_empty) {
+			/* The event loop collects everything finished so far */
+			uint64_t one = 1;
+			if (write(queue->eventfd, &one, sizeof(one)) < 0) {
+				wlr_log_errno(WLR_ERROR, "work queue: write()");
+			}
+		}
+	}
+	pthread_mutex_unlock(&queue->lock);
+	return NULL;
+}
+
+static void
+run_done(struct wl_list *items)
+{
+	struct work_item *item, *tmp;
+	wl_list_for_each_safe(item, tmp, items, link) {
+		wl_list_remove(&item->link);
+		item->done(item->data);
+		free(item);
+	}
+}
+
+/* Called with the lock held */
+static void
+take_finished(struct work_queue *queue, struct wl_list *finished)
+{
+	wl_list_init(finished);
+	wl_list_insert_list(finished, &queue->finished);
+	wl_list_init(&queue->finished);
+}
+
+static int
+handle_eventfd(int fd, uint32_t mask, void *data)
+{
+	struct work_queue *queue = data;
+	uint64_t count;
+	if (read(fd, &count, sizeof(count)) < 0) {
+		wlr_log_errno(WLR_DEBUG, "work queue: read()");
+	}
+
+	struct wl_list finished;
+	pthread_mutex_lock(&queue->lock);
+	take_finished(queue, &finished);
+	pthread_mutex_unlock(&queue->lock);
+
+	/* Outside of the lock, done callbacks may submit new work */
+	run_done(&finished);
+	return 0;
+}
+
+struct work_queue *
+work_queue_create(struct wl_event_loop *loop, int max_threads)
+{
+	assert(max_threads > 0);
+
+	int fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (fd < 0) {
+		wlr_log_errno(WLR_ERROR, "work queue: eventfd()");
+		return NULL;
+	}
+
+	struct work_queue *queue = znew(*queue);
+	pthread_mutex_init(&queue->lock, NULL);
+	pthread_cond_init(&queue->cond, NULL);
+	pthread_cond_init(&queue->idle, NULL);
+	wl_list_init(&queue->pending);
+	wl_list_init(&queue->finished);
+	queue->max_threads = max_threads;
+	queue->threads = znew_n(*queue->threads, max_threads);
+	queue->eventfd = fd;
+	queue->source = wl_event_loop_add_fd(loop, fd, WL_EVENT_READABLE,
+		handle_eventfd, queue);
+	return queue;
+}
+
+static void
+start_thread(struct work_queue *queue)
+{
+	/*
+	 * Signals are handled by the event loop, keep them away from
+	 * workers by starting them with everything blocked.
+	 */
+	sigset_t all, old;
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK, &all, &old);
+	int ret = pthread_create(&queue->threads[queue->nr_threads], NULL,
+		worker_main, queue);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+	if (ret) {
+		wlr_log(WLR_ERROR, "work queue: failed to start thread");
+		return;
+	}
+	queue->nr_threads++;
+}
+
+void
+work_queue_submit(struct work_queue *queue, work_func_t work,
+		work_done_func_t done, void *data)
+{
+	struct work_item *item = znew(*item);
+	item->work = work;
+	item->done = done;
+	item->data = data;
+
+	pthread_mutex_lock(&queue->lock);
+	wl_list_insert(queue->pending.prev, &item->link);
+	bool need_thread = queue->nr_idle == 0
+		&& queue->nr_threads < queue->max_threads;
+	pthread_cond_signal(&queue->cond);
+	pthread_mutex_unlock(&queue->lock);
+
+	if (need_thread) {
+		start_thread(queue);
+	}
+
+	if (!queue->nr_threads) {
+		/* Could not start any thread, run it right away */
+		pthread_mutex_lock(&queue->lock);
+		wl_list_remove(&item->link);
+		pthread_mutex_unlock(&queue->lock);
+		work(data);
+		done(data);
+		free(item);
+	}
+}
+
+void
+work_queue_flush(struct work_queue *queue)
+{
+	while (true) {
+		struct wl_list finished;
+		pthread_mutex_lock(&queue->lock);
+		while (queue->nr_running || !wl_list_empty(&queue->pending)) {
+			pthread_cond_wait(&queue->idle, &queue->lock);
+		}
+		take_finished(queue, &finished);
+		pthread_mutex_unlock(&queue->lock);
+
+		if (wl_list_empty(&finished)) {
+			return;
+		}
+		/* Which may submit more work to wait for */
+		run_done(&finished);
+	}
+}
+
+void
+work_queue_destroy(struct work_queue *queue)
+{
+	if (!queue) {
+		return;
+	}
+
+	pthread_mutex_lock(&queue->lock);
+	queue->stopping = true;
+	pthread_cond_broadcast(&queue->cond);
+	pthread_mutex_unlock(&queue->lock);
+
+	for (int i = 0; i < queue->nr_threads; i++) {
+		pthread_join(queue->threads[i], NULL);
+	}
+
+	/* Jobs that never ran are only completed */
+	run_done(&queue->finished);
+	run_done(&queue->pending);
+
+	wl_event_source_remove(queue->source);
+	close(queue->eventfd);
+	pthread_cond_destroy(&queue->cond);
+	pthread_cond_destroy(&queue->idle);
+	pthread_mutex_destroy(&queue->lock);
+	free(queue->threads);
+	free(queue);
+}